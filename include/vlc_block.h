@@ -135,6 +135,14 @@ struct block_t
  *      with preheader and or body (increase
  *      and decrease are supported). Use it as it is optimised.
  * - block_Duplicate : create a copy of a block.
+ * - block_MakeShared : convert a block into a reference-counted one, so that
+ *      its payload can be shared with block_Share instead of being copied.
+ * - block_Share : create a new reference to the payload of a shared block
+ *      (or a copy of any other block).
+ * - block_Unshare : make the payload of a block writable, copying it if it
+ *      is shared.
+ * - block_PoolGetStats : get the counters of the pool recycling the buffers
+ *      of block_Alloc.
  ****************************************************************************/
 VLC_API void block_Init( block_t *, void *, size_t );
 VLC_API block_t *block_Alloc( size_t ) VLC_USED VLC_MALLOC;
@@ -168,6 +176,19 @@ static inline void block_Release( block_t *p_block )
     p_block->pf_release( p_block );
 }
 
+VLC_API block_t *block_MakeShared( block_t * ) VLC_USED;
+VLC_API block_t *block_Share( block_t * ) VLC_USED;
+VLC_API block_t *block_Unshare( block_t * ) VLC_USED;
+
+typedef struct block_pool_stats_t
+{
+    uint64_t i_hits; /**< allocations served from the pool */
+    uint64_t i_misses; /**< poolable allocations that required malloc() */
+    size_t   i_cached; /**< bytes of free buffers held by the pool */
+} block_pool_stats_t;
+
+VLC_API bool block_PoolGetStats( block_pool_stats_t * );
+
 VLC_API block_t *block_heap_Alloc(void *, size_t) VLC_USED VLC_MALLOC;
 VLC_API block_t *block_mmap_Alloc(void *addr, size_t length) VLC_USED VLC_MALLOC;
 VLC_API block_t * block_shm_Alloc(void *addr, size_t length) VLC_USED VLC_MALLOC;
@@ -50,6 +50,9 @@ typedef struct filter_owner_t
         struct
         {
             picture_t * (*buffer_new)( filter_t * );
+            void (*run_slices)( filter_t *,
+                                void (*)( void *, unsigned, unsigned ),
+                                void *, unsigned );
         } video;
         struct
         {
@@ -160,6 +163,46 @@ static inline picture_t *filter_NewPicture( filter_t *p_filter )
     return pic;
 }
 
+/**
+ * Runs a picture processing function over slices, possibly in parallel.
+ *
+ * This is meant for filters whose output rows only depend on a few input
+ * rows: pf_slice is called once for each slice index from 0 to the slice
+ * count (excluded), from the owner worker threads and the calling thread,
+ * and must only write to the rows of its own slice. The slice count is at
+ * most i_max_slices, and is 1 if the owner does not support slicing.
+ * This function returns once all slices are done.
+ *
+ * \param p_filter video filter_t object
+ * \param pf_slice slice function (data, slice index, slice count)
+ * \param p_data opaque pointer for pf_slice
+ * \param i_max_slices maximum number of slices
+ */
+static inline void filter_RunSlices( filter_t *p_filter,
+                                     void (*pf_slice)( void *, unsigned,
+                                                       unsigned ),
+                                     void *p_data, unsigned i_max_slices )
+{
+    if( p_filter->owner.video.run_slices != NULL && i_max_slices > 1 )
+        p_filter->owner.video.run_slices( p_filter, pf_slice, p_data,
+                                          i_max_slices );
+    else
+        pf_slice( p_data, 0, 1 );
+}
+
+/**
+ * Gets the rows of a plane that belong to a slice.
+ *
+ * Slices are contiguous bands of visible lines, in order.
+ */
+static inline void plane_SliceLines( const plane_t *p_plane, unsigned i_slice,
+                                     unsigned i_slices, int *pi_first,
+                                     int *pi_end )
+{
+    *pi_first = p_plane->i_visible_lines * i_slice / i_slices;
+    *pi_end = p_plane->i_visible_lines * (i_slice + 1) / i_slices;
+}
+
 /**
  * Flush a filter
  *
@@ -417,6 +417,8 @@ struct input_stats_t
     /* Input */
     int64_t i_read_packets;
     int64_t i_read_bytes;
+    int64_t i_read_dropped;  /* packets discarded or truncated by the access */
+    int64_t i_read_overruns; /* packets lost in the receive buffer */
     float f_input_bitrate;
     float f_average_input_bitrate;
 
@@ -104,6 +104,39 @@ VLC_API const char *vlc_strerror_c(int);
 typedef void (*vlc_log_cb) (void *data, int type, const vlc_log_t *item,
                             const char *fmt, va_list args);
 
+/**
+ * Asynchronous message logging.
+ *
+ * Messages are formatted by the emitting thread into a lock-free ring
+ * buffer, then passed to a log callback by a background thread, so that
+ * logging threads do not wait for the output. If the ring is full, messages
+ * are dropped; the number of dropped messages is logged afterwards.
+ */
+typedef struct vlc_log_async vlc_log_async_t;
+
+/**
+ * Creates an asynchronous logger.
+ * \param cb log callback, called from the background thread with "%s" as
+ *           format string
+ * \param data data pointer for the log callback
+ * \return the logger, or NULL on error
+ */
+VLC_API vlc_log_async_t *vlc_LogAsyncCreate(vlc_log_cb cb, void *data)
+VLC_USED;
+
+/**
+ * Passes the messages still in the ring to the log callback, and destroys
+ * an asynchronous logger. No messages may be emitted concurrently.
+ */
+VLC_API void vlc_LogAsyncDestroy(vlc_log_async_t *);
+
+/**
+ * Queues a message to an asynchronous logger. This function has the same
+ * parameters as a log callback. It is thread-safe and never blocks.
+ */
+VLC_API void vlc_LogAsync(vlc_log_async_t *, int type, const vlc_log_t *item,
+                          const char *fmt, va_list args);
+
 /**
  * @}
  */
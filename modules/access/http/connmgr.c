@@ -187,6 +187,9 @@ struct vlc_http_mgr
     vlc_tls_creds_t *creds;
     struct vlc_http_cookie_jar_t *jar;
     struct vlc_http_conn *conn;
+    unsigned long conn_gen; /* incremented whenever conn changes */
+    int version; /* HTTP version of the last connection, 0 if none */
+    vlc_mutex_t lock; /* protects creds, conn and version */
     bool use_h2c;
 };
 
@@ -202,6 +205,7 @@ static void vlc_http_mgr_release(struct vlc_http_mgr *mgr,
 {
     assert(mgr->conn == conn);
     mgr->conn = NULL;
+    mgr->conn_gen++;
 
     vlc_http_conn_release(conn);
 }
@@ -211,40 +215,78 @@ struct vlc_http_msg *vlc_http_mgr_reuse(struct vlc_http_mgr *mgr,
                                         const char *host, unsigned port,
                                         const struct vlc_http_msg *req)
 {
-    struct vlc_http_conn *conn = vlc_http_mgr_find(mgr, host, port);
-    if (conn == NULL)
-        return NULL;
+    struct vlc_http_stream *stream = NULL;
 
-    struct vlc_http_stream *stream = vlc_http_stream_open(conn, req);
-    if (stream != NULL)
+    vlc_mutex_lock(&mgr->lock);
+    struct vlc_http_conn *conn = vlc_http_mgr_find(mgr, host, port);
+    unsigned long gen = mgr->conn_gen;
+    if (conn != NULL)
     {
-        struct vlc_http_msg *m = vlc_http_msg_get_initial(stream);
-        if (m != NULL)
-            return m;
-
-        /* NOTE: If the request were not idempotent, we would not know if it
-         * was processed by the other end. Thus POST is not used/supported so
-         * far, and CONNECT is treated as if it were idempotent (which works
-         * fine here). */
+        stream = vlc_http_stream_open(conn, req);
+        if (stream == NULL) /* Get rid of closing, reset or busy connection */
+            vlc_http_mgr_release(mgr, conn);
     }
-    /* Get rid of closing or reset connection */
-    vlc_http_mgr_release(mgr, conn);
+    vlc_mutex_unlock(&mgr->lock);
+
+    if (stream == NULL)
+        return NULL;
+
+    /* Wait for the response without the lock, so that other requests can be
+     * multiplexed on the same connection meanwhile. */
+    struct vlc_http_msg *m = vlc_http_msg_get_initial(stream);
+    if (m != NULL)
+        return m;
+
+    /* NOTE: If the request were not idempotent, we would not know if it
+     * was processed by the other end. Thus POST is not used/supported so
+     * far, and CONNECT is treated as if it were idempotent (which works
+     * fine here). */
+    /* The connection may have been released (and freed) meanwhile, and
+     * another one allocated at the same address: compare generations. */
+    vlc_mutex_lock(&mgr->lock);
+    if (mgr->conn_gen == gen)
+        vlc_http_mgr_release(mgr, conn);
+    vlc_mutex_unlock(&mgr->lock);
     return NULL;
 }
 
+static void vlc_http_mgr_set_conn(struct vlc_http_mgr *mgr,
+                                  struct vlc_http_conn *conn, int version)
+{
+    vlc_mutex_lock(&mgr->lock);
+    /* Another request may have connected in the mean time */
+    if (mgr->conn != NULL)
+        vlc_http_mgr_release(mgr, mgr->conn);
+    mgr->conn = conn;
+    mgr->conn_gen++;
+    mgr->version = version;
+    vlc_mutex_unlock(&mgr->lock);
+}
+
 static struct vlc_http_msg *vlc_https_request(struct vlc_http_mgr *mgr,
                                               const char *host, unsigned port,
                                               const struct vlc_http_msg *req)
 {
+    vlc_tls_creds_t *creds;
+
+    vlc_mutex_lock(&mgr->lock);
     if (mgr->creds == NULL && mgr->conn != NULL)
+    {
+        vlc_mutex_unlock(&mgr->lock);
         return NULL; /* switch from HTTP to HTTPS not implemented */
+    }
 
     if (mgr->creds == NULL)
     {   /* First TLS connection: load x509 credentials */
         mgr->creds = vlc_tls_ClientCreate(mgr->obj);
         if (mgr->creds == NULL)
+        {
+            vlc_mutex_unlock(&mgr->lock);
             return NULL;
+        }
     }
+    creds = mgr->creds;
+    vlc_mutex_unlock(&mgr->lock);
 
     /* TODO? non-idempotent request support */
     struct vlc_http_msg *resp = vlc_http_mgr_reuse(mgr, host, port, req);
@@ -252,7 +294,7 @@ static struct vlc_http_msg *vlc_https_request(struct vlc_http_mgr *mgr,
         return resp; /* existing connection reused */
 
     bool http2 = true;
-    vlc_tls_t *tls = vlc_https_connect_i11e(mgr->creds, host, port, &http2);
+    vlc_tls_t *tls = vlc_https_connect_i11e(creds, host, port, &http2);
     if (tls == NULL)
         return NULL;
 
@@ -276,7 +318,7 @@ static struct vlc_http_msg *vlc_https_request(struct vlc_http_mgr *mgr,
         return NULL;
     }
 
-    mgr->conn = conn;
+    vlc_http_mgr_set_conn(mgr, conn, http2 ? 2 : 1);
 
     return vlc_http_mgr_reuse(mgr, host, port, req);
 }
@@ -285,7 +327,10 @@ static struct vlc_http_msg *vlc_http_request(struct vlc_http_mgr *mgr,
                                              const char *host, unsigned port,
                                              const struct vlc_http_msg *req)
 {
-    if (mgr->creds != NULL && mgr->conn != NULL)
+    vlc_mutex_lock(&mgr->lock);
+    bool secure = mgr->creds != NULL && mgr->conn != NULL;
+    vlc_mutex_unlock(&mgr->lock);
+    if (secure)
         return NULL; /* switch from HTTPS to HTTP not implemented */
 
     struct vlc_http_msg *resp = vlc_http_mgr_reuse(mgr, host, port, req);
@@ -310,7 +355,7 @@ static struct vlc_http_msg *vlc_http_request(struct vlc_http_mgr *mgr,
         return NULL;
     }
 
-    mgr->conn = conn;
+    vlc_http_mgr_set_conn(mgr, conn, mgr->use_h2c ? 2 : 1);
 
     return vlc_http_mgr_reuse(mgr, host, port, req);
 }
@@ -327,6 +372,14 @@ struct vlc_http_cookie_jar_t *vlc_http_mgr_get_jar(struct vlc_http_mgr *mgr)
     return mgr->jar;
 }
 
+int vlc_http_mgr_get_version(struct vlc_http_mgr *mgr)
+{
+    vlc_mutex_lock(&mgr->lock);
+    int version = mgr->version;
+    vlc_mutex_unlock(&mgr->lock);
+    return version;
+}
+
 struct vlc_http_mgr *vlc_http_mgr_create(vlc_object_t *obj,
                                          struct vlc_http_cookie_jar_t *jar,
                                          bool h2c)
@@ -339,6 +392,9 @@ struct vlc_http_mgr *vlc_http_mgr_create(vlc_object_t *obj,
     mgr->creds = NULL;
     mgr->jar = jar;
     mgr->conn = NULL;
+    mgr->conn_gen = 0;
+    mgr->version = 0;
+    vlc_mutex_init(&mgr->lock);
     mgr->use_h2c = h2c;
     return mgr;
 }
@@ -349,5 +405,6 @@ void vlc_http_mgr_destroy(struct vlc_http_mgr *mgr)
         vlc_http_mgr_release(mgr, mgr->conn);
     if (mgr->creds != NULL)
         vlc_tls_Delete(mgr->creds);
+    vlc_mutex_destroy(&mgr->lock);
     free(mgr);
 }
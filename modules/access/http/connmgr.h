@@ -39,6 +39,9 @@ struct vlc_http_cookie_jar_t;
  * establishing a new one. If succesful, the initial HTTP response header is
  * returned.
  *
+ * This function is thread-safe: concurrent requests share the current
+ * connection if it supports multiplexing (HTTP/2).
+ *
  * @param mgr HTTP connection manager
  * @param https whether to use HTTPS (true) or unencrypted HTTP (false)
  * @param host name of authoritative HTTP server to send the request to
@@ -53,6 +56,16 @@ struct vlc_http_msg *vlc_http_mgr_request(struct vlc_http_mgr *mgr, bool https,
 
 struct vlc_http_cookie_jar_t *vlc_http_mgr_get_jar(struct vlc_http_mgr *);
 
+/**
+ * Gets the HTTP version of the last connection
+ *
+ * For HTTPS, the version is negotiated through TLS-ALPN.
+ *
+ * @return the major HTTP version (1 or 2), or 0 if no connection was
+ * established yet.
+ */
+int vlc_http_mgr_get_version(struct vlc_http_mgr *mgr);
+
 /**
  * Creates an HTTP connection manager
  *
@@ -0,0 +1,344 @@
+/*****************************************************************************
+ * connmgr_test.c: HTTP connection manager test
+ *****************************************************************************
+ * Copyright (C) 2016 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#undef NDEBUG
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <sys/types.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#ifndef SOCK_CLOEXEC
+# define SOCK_CLOEXEC 0
+# define accept4(a,b,c,d) accept(a,b,c)
+#endif
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <vlc_common.h>
+#include <vlc_block.h>
+#include <vlc_network.h>
+#include "h2frame.h"
+#include "message.h"
+#include "connmgr.h"
+
+/* Number of requests sent at the same time. The local server only answers
+ * once it has received all of them, so the test would time out if the
+ * manager did not let them run in parallel. */
+#define PARALLEL 4
+
+static const char body[] = "Hello world!";
+
+static struct
+{
+    vlc_mutex_t lock;
+    vlc_cond_t wait;
+    vlc_thread_t threads[2 * PARALLEL];
+    unsigned connections;
+    unsigned requests;
+    unsigned barrier;
+    bool h2;
+} server;
+
+/* Blocks until the expected number of requests is in flight */
+static void server_barrier(void)
+{
+    vlc_mutex_lock(&server.lock);
+    server.requests++;
+    if (server.requests >= server.barrier)
+        vlc_cond_broadcast(&server.wait);
+    while (server.requests < server.barrier)
+        vlc_cond_wait(&server.wait, &server.lock);
+    vlc_mutex_unlock(&server.lock);
+}
+
+static void server_send(int fd, struct vlc_h2_frame *f)
+{
+    assert(f != NULL);
+
+    size_t len = vlc_h2_frame_size(f);
+    ssize_t val = send(fd, f->data, len, MSG_NOSIGNAL);
+    assert((size_t)val == len);
+    free(f);
+}
+
+static void server_h2_process(int fd)
+{
+    char hello[24];
+    uint_fast32_t ids[PARALLEL];
+    unsigned pending = 0;
+
+    if (recv(fd, hello, 24, MSG_WAITALL) != 24)
+        return;
+    assert(!memcmp(hello, "PRI * HTTP/2.0\r\n", 16));
+    server_send(fd, vlc_h2_frame_settings());
+
+    for (;;)
+    {
+        uint8_t hdr[9];
+
+        if (recv(fd, hdr, 9, MSG_WAITALL) != 9)
+            break;
+
+        size_t len = (hdr[0] << 16) | (hdr[1] << 8) | hdr[2];
+        uint_fast32_t id = GetDWBE(hdr + 5) & 0x7fffffff;
+        if (len > 0)
+        {
+            char buf[len];
+
+            if (recv(fd, buf, len, MSG_WAITALL) != (ssize_t)len)
+                break;
+        }
+
+        if (hdr[3] != 1 /* HEADERS */)
+            continue;
+
+        /* Hold the replies until all parallel requests were received here,
+         * i.e. on this one connection. */
+        ids[pending++] = id;
+        vlc_mutex_lock(&server.lock);
+        bool ready = ++server.requests >= server.barrier;
+        vlc_mutex_unlock(&server.lock);
+        if (!ready)
+            continue;
+
+        for (unsigned i = 0; i < pending; i++)
+        {
+            struct vlc_http_msg *m = vlc_http_resp_create(200);
+            assert(m != NULL);
+            vlc_http_msg_add_header(m, "Content-Length", "%zu",
+                                    strlen(body));
+            server_send(fd, vlc_http_msg_h2_frame(m, ids[i], false));
+            vlc_http_msg_destroy(m);
+            server_send(fd, vlc_h2_frame_data(ids[i], body, strlen(body),
+                                              true));
+        }
+        pending = 0;
+    }
+}
+
+static void server_h1_process(int fd)
+{
+    for (;;)
+    {
+        char buf[1024];
+        size_t buflen = 0;
+        ssize_t val;
+
+        while (strnstr(buf, "\r\n\r\n", buflen) == NULL)
+        {
+            val = recv(fd, buf + buflen, sizeof (buf) - buflen - 1, 0);
+            if (val <= 0)
+                return;
+            buflen += val;
+        }
+        assert(!strncmp(buf, "GET / HTTP/1.1\r\n", 16));
+
+        server_barrier();
+
+        char resp[256];
+        int len = snprintf(resp, sizeof (resp), "HTTP/1.1 200 OK\r\n"
+                           "Content-Length: %zu\r\n\r\n%s", strlen(body),
+                           body);
+        val = send(fd, resp, len, MSG_NOSIGNAL);
+        assert(val == len);
+    }
+}
+
+static void *server_conn_thread(void *data)
+{
+    int fd = (intptr_t)data;
+
+    if (server.h2)
+        server_h2_process(fd);
+    else
+        server_h1_process(fd);
+    vlc_close(fd);
+    return NULL;
+}
+
+static void *server_thread(void *data)
+{
+    int lfd = (intptr_t)data;
+
+    for (;;)
+    {
+        int cfd = accept4(lfd, NULL, NULL, SOCK_CLOEXEC);
+        if (cfd == -1)
+            continue;
+
+        int canc = vlc_savecancel();
+        vlc_mutex_lock(&server.lock);
+        assert(server.connections < ARRAY_SIZE(server.threads));
+        if (vlc_clone(&server.threads[server.connections], server_conn_thread,
+                      (void *)(intptr_t)cfd, VLC_THREAD_PRIORITY_LOW))
+            assert(!"Thread error");
+        server.connections++;
+        vlc_mutex_unlock(&server.lock);
+        vlc_restorecancel(canc);
+    }
+    vlc_assert_unreachable();
+}
+
+static int server_socket(unsigned *port)
+{
+    int fd = socket(PF_INET6, SOCK_STREAM|SOCK_CLOEXEC, IPPROTO_TCP);
+    if (fd == -1)
+        return -1;
+
+    struct sockaddr_in6 addr = {
+        .sin6_family = AF_INET6,
+#ifdef HAVE_SA_LEN
+        .sin6_len = sizeof (addr),
+#endif
+        .sin6_addr = in6addr_loopback,
+    };
+    socklen_t addrlen = sizeof (addr);
+
+    if (bind(fd, (struct sockaddr *)&addr, addrlen)
+     || getsockname(fd, (struct sockaddr *)&addr, &addrlen)
+     || listen(fd, 255))
+    {
+        vlc_close(fd);
+        return -1;
+    }
+
+    *port = ntohs(addr.sin6_port);
+    return fd;
+}
+
+static struct vlc_http_mgr *mgr;
+static unsigned port;
+
+static void *request_thread(void *data)
+{
+    char authority[32];
+
+    snprintf(authority, sizeof (authority), "[::1]:%u", port);
+
+    struct vlc_http_msg *req = vlc_http_req_create("GET", "http", authority,
+                                                   "/");
+    assert(req != NULL);
+
+    struct vlc_http_msg *resp = vlc_http_mgr_request(mgr, false, "::1", port,
+                                                     req);
+    vlc_http_msg_destroy(req);
+    resp = vlc_http_msg_get_final(resp);
+    assert(resp != NULL);
+    assert(vlc_http_msg_get_status(resp) == 200);
+
+    char buf[sizeof (body)];
+    size_t len = 0;
+    block_t *block;
+
+    while ((block = vlc_http_msg_read(resp)) != NULL)
+    {
+        assert(block != vlc_http_error);
+        assert(len + block->i_buffer < sizeof (buf));
+        memcpy(buf + len, block->p_buffer, block->i_buffer);
+        len += block->i_buffer;
+        block_Release(block);
+    }
+    assert(len == strlen(body) && !memcmp(buf, body, len));
+
+    vlc_http_msg_destroy(resp);
+    (void) data;
+    return NULL;
+}
+
+static void test(bool h2)
+{
+    vlc_thread_t th[PARALLEL];
+
+    server.requests = 0;
+    server.barrier = 1;
+    server.h2 = h2;
+
+    mgr = vlc_http_mgr_create(NULL, NULL, h2);
+    assert(mgr != NULL);
+
+    /* Set the connection up first, then send requests in parallel */
+    request_thread(NULL);
+
+    vlc_mutex_lock(&server.lock);
+    assert(server.connections == 1);
+    server.requests = 0;
+    server.barrier = PARALLEL;
+    vlc_mutex_unlock(&server.lock);
+
+    for (unsigned i = 0; i < PARALLEL; i++)
+        if (vlc_clone(&th[i], request_thread, NULL, VLC_THREAD_PRIORITY_LOW))
+            assert(!"Thread error");
+    for (unsigned i = 0; i < PARALLEL; i++)
+        vlc_join(th[i], NULL);
+
+    vlc_mutex_lock(&server.lock);
+    if (h2) /* all requests multiplexed on the first connection */
+        assert(server.connections == 1);
+    else /* at least one connection per request in flight */
+        assert(server.connections >= PARALLEL);
+    vlc_mutex_unlock(&server.lock);
+
+    vlc_http_mgr_destroy(mgr);
+
+    /* Connections are all closed now */
+    vlc_mutex_lock(&server.lock);
+    unsigned count = server.connections;
+    vlc_mutex_unlock(&server.lock);
+
+    for (unsigned i = 0; i < count; i++)
+        vlc_join(server.threads[i], NULL);
+    server.connections = 0;
+}
+
+int main(void)
+{
+    alarm(10);
+
+    int lfd = server_socket(&port);
+    if (lfd == -1)
+        return 77;
+
+    vlc_mutex_init(&server.lock);
+    vlc_cond_init(&server.wait);
+
+    vlc_thread_t th;
+    if (vlc_clone(&th, server_thread, (void *)(intptr_t)lfd,
+                  VLC_THREAD_PRIORITY_LOW))
+        assert(!"Thread error");
+
+    test(true);
+    test(false);
+
+    vlc_cancel(th);
+    vlc_join(th, NULL);
+    vlc_close(lfd);
+    vlc_cond_destroy(&server.wait);
+    vlc_mutex_destroy(&server.lock);
+    return 0;
+}
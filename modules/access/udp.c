@@ -56,6 +56,11 @@ static void Close( vlc_object_t * );
 #define BUFFER_TEXT N_("Receive buffer")
 #define BUFFER_LONGTEXT N_("UDP receive buffer size (bytes)" )
 #define TIMEOUT_TEXT N_("UDP Source timeout (sec)")
+#define BATCH_TEXT N_("Receive batch")
+#define BATCH_LONGTEXT N_( \
+    "Maximum number of datagrams to receive with a single system call." )
+
+#define UDP_BATCH_MAX 64
 
 vlc_module_begin ()
     set_shortname( N_("UDP" ) )
@@ -66,6 +71,8 @@ vlc_module_begin ()
     add_obsolete_integer( "server-port" ) /* since 2.0.0 */
     add_obsolete_integer( "udp-buffer" ) /* since 3.0.0 */
     add_integer( "udp-timeout", -1, TIMEOUT_TEXT, NULL, true )
+    add_integer_with_range( "udp-batch", 16, 1, UDP_BATCH_MAX,
+                            BATCH_TEXT, BATCH_LONGTEXT, true )
 
     set_capability( "access", 0 )
     add_shortcut( "udp", "udpstream", "udp4", "udp6" )
@@ -78,6 +85,17 @@ struct access_sys_t
     int fd;
     int timeout;
     size_t mtu;
+    unsigned batch;
+#ifdef SO_RXQ_OVFL
+    uint32_t rxq_ovfl;
+#endif
+    /* datagrams not reported yet, see STREAM_GET_PACKETS */
+    uint64_t packets;
+    /* losses not reported yet, see STREAM_GET_LOSS */
+    uint64_t dropped;
+    uint64_t overruns;
+    /* losses not flagged on a returned block yet */
+    bool discontinuity;
 };
 
 /*****************************************************************************
@@ -168,6 +186,21 @@ error:
     }
 
     sys->mtu = 7 * 188;
+#ifdef HAVE_RECVMMSG
+    sys->batch = var_InheritInteger( p_access, "udp-batch" );
+#else
+    sys->batch = 1;
+#endif
+    sys->packets = 0;
+    sys->dropped = 0;
+    sys->overruns = 0;
+    sys->discontinuity = false;
+
+#ifdef SO_RXQ_OVFL
+    /* Have the kernel report receive buffer overruns */
+    sys->rxq_ovfl = 0;
+    setsockopt( sys->fd, SOL_SOCKET, SO_RXQ_OVFL, &(int){ 1 }, sizeof (int) );
+#endif
 
     sys->timeout = var_InheritInteger( p_access, "udp-timeout");
     if( sys->timeout > 0)
@@ -193,6 +226,7 @@ static void Close( vlc_object_t *p_this )
  *****************************************************************************/
 static int Control( access_t *p_access, int i_query, va_list args )
 {
+    access_sys_t *sys = p_access->p_sys;
     bool    *pb_bool;
     int64_t *pi_64;
 
@@ -212,6 +246,18 @@ static int Control( access_t *p_access, int i_query, va_list args )
                    * var_InheritInteger(p_access, "network-caching");
             break;
 
+        case STREAM_GET_LOSS:
+            *va_arg( args, uint64_t * ) = sys->dropped;
+            *va_arg( args, uint64_t * ) = sys->overruns;
+            sys->dropped = 0;
+            sys->overruns = 0;
+            break;
+
+        case STREAM_GET_PACKETS:
+            *va_arg( args, uint64_t * ) = sys->packets;
+            sys->packets = 0;
+            break;
+
         default:
             return VLC_EGENERIC;
     }
@@ -221,29 +267,77 @@ static int Control( access_t *p_access, int i_query, va_list args )
 /*****************************************************************************
  * BlockUDP:
  *****************************************************************************/
+#ifdef SO_RXQ_OVFL
+typedef union
+{
+    char buf[CMSG_SPACE(sizeof (uint32_t))];
+    struct cmsghdr align;
+} udp_control_t;
+
+static void CheckOverflow(access_sys_t *sys, const struct msghdr *msg)
+{
+    for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(msg);
+         cmsg != NULL;
+         cmsg = CMSG_NXTHDR((struct msghdr *)msg, cmsg))
+    {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SO_RXQ_OVFL)
+        {
+            uint32_t ovfl;
+
+            memcpy(&ovfl, CMSG_DATA(cmsg), sizeof (ovfl));
+            if (ovfl != sys->rxq_ovfl)
+                sys->discontinuity = true;
+            sys->overruns += (uint32_t)(ovfl - sys->rxq_ovfl);
+            sys->rxq_ovfl = ovfl;
+        }
+    }
+}
+#endif
+
 static block_t *BlockUDP(access_t *access, bool *restrict eof)
 {
     access_sys_t *sys = access->p_sys;
+    const size_t mtu = sys->mtu;
+    const unsigned batch = sys->batch;
 
-    block_t *pkt = block_Alloc(sys->mtu);
+    /* All datagrams of a batch are received in a single pooled buffer */
+    block_t *pkt = block_Alloc(mtu * batch);
     if (unlikely(pkt == NULL))
     {   /* OOM - dequeue and discard one packet */
         char dummy;
         recv(sys->fd, &dummy, 1, 0);
+        sys->dropped++;
+        sys->discontinuity = true;
         return NULL;
     }
 
-    struct iovec iov = {
-        .iov_base = pkt->p_buffer,
-        .iov_len = sys->mtu,
-    };
-    struct msghdr msg = {
-        .msg_iov = &iov,
-        .msg_iovlen = 1,
-#ifdef __linux__
-        .msg_flags = MSG_TRUNC,
+    struct iovec iov[UDP_BATCH_MAX];
+#ifdef HAVE_RECVMMSG
+    struct mmsghdr msgs[UDP_BATCH_MAX];
+#else
+    struct
+    {
+        struct msghdr msg_hdr;
+        unsigned msg_len;
+    } msgs[1];
+#endif
+#ifdef SO_RXQ_OVFL
+    udp_control_t control[UDP_BATCH_MAX];
 #endif
-    };
+
+    for (unsigned i = 0; i < batch; i++)
+    {
+        iov[i].iov_base = pkt->p_buffer + i * mtu;
+        iov[i].iov_len = mtu;
+        msgs[i].msg_hdr = (struct msghdr) {
+            .msg_iov = &iov[i],
+            .msg_iovlen = 1,
+#ifdef SO_RXQ_OVFL
+            .msg_control = control[i].buf,
+            .msg_controllen = sizeof (control[i].buf),
+#endif
+        };
+    }
 
     struct pollfd ufd[1];
 
@@ -260,25 +354,78 @@ static block_t *BlockUDP(access_t *access, bool *restrict eof)
             goto skip;
      }
 
-    ssize_t len = recvmsg(sys->fd, &msg, 0);
-    if (len < 0)
+#ifdef __linux__
+    /* Report the real length of truncated datagrams */
+    const int flags = MSG_TRUNC;
+#else
+    const int flags = 0;
+#endif
+#ifdef HAVE_RECVMMSG
+    int count = recvmmsg(sys->fd, msgs, batch, flags | MSG_WAITFORONE, NULL);
+#else
+    ssize_t val = recvmsg(sys->fd, &msgs[0].msg_hdr, flags);
+    int count = (val >= 0) ? 1 : -1;
+    if (count > 0)
+        msgs[0].msg_len = val;
+#endif
+    if (count <= 0)
     {
 skip:
         block_Release(pkt);
         return NULL;
     }
 
+    sys->packets += count;
+
+    /* Pack the datagrams at the front of the buffer */
+    size_t len = 0;
+
+    for (int i = 0; i < count; i++)
+    {
+        size_t dlen = msgs[i].msg_len;
+
 #ifdef MSG_TRUNC
-    if (msg.msg_flags & MSG_TRUNC)
+        if ((msgs[i].msg_hdr.msg_flags & MSG_TRUNC) || dlen > mtu)
+        {
+            msg_Err(access, "%zu bytes packet truncated (MTU was %zu)",
+                    dlen, mtu);
+            pkt->i_flags |= BLOCK_FLAG_CORRUPTED;
+            sys->dropped++;
+            sys->discontinuity = true;
+            if (dlen > sys->mtu)
+                sys->mtu = dlen;
+            dlen = mtu;
+        }
+#endif
+        if (len != i * mtu)
+            memmove(pkt->p_buffer + len, iov[i].iov_base, dlen);
+        len += dlen;
+#ifdef SO_RXQ_OVFL
+        CheckOverflow(sys, &msgs[i].msg_hdr);
+#endif
+    }
+
+    pkt->i_buffer = len;
+
+    /* Do not hold a whole batch buffer for a few datagrams: low-rate
+     * streams would otherwise use up to batch times more memory while
+     * queued. The large buffer goes back to the block pool. */
+    if (len <= (mtu * batch) / 2)
     {
-        msg_Err(access, "%zd bytes packet truncated (MTU was %zu)",
-                len, sys->mtu);
-        pkt->i_flags |= BLOCK_FLAG_CORRUPTED;
-        sys->mtu = len;
+        block_t *copy = block_Alloc(len);
+        if (likely(copy != NULL))
+        {
+            memcpy(copy->p_buffer, pkt->p_buffer, len);
+            copy->i_flags = pkt->i_flags;
+            block_Release(pkt);
+            pkt = copy;
+        }
     }
-    else
-#endif
-        pkt->i_buffer = len;
 
+    if (sys->discontinuity)
+    {
+        pkt->i_flags |= BLOCK_FLAG_DISCONTINUITY;
+        sys->discontinuity = false;
+    }
     return pkt;
 }
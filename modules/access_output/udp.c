@@ -46,10 +46,17 @@
 #else
 #   include <sys/socket.h>
 #endif
+#ifdef __linux__
+#   include <netinet/udp.h>
+#endif
 
 #include <vlc_network.h>
 
 #define MAX_EMPTY_BLOCKS 200
+/* Maximum number of packets sent with a single system call */
+#define MAX_BATCH_PACKETS 64
+/* Maximum UDP payload of a segmentation offload send */
+#define MAX_GSO_BYTES 65000
 
 /*****************************************************************************
  * Module descriptor
@@ -120,6 +127,9 @@ struct sout_access_out_sys_t
     block_fifo_t *p_fifo;
     block_fifo_t *p_empty_blocks;
     block_t      *p_buffer;
+#ifdef UDP_SEGMENT
+    bool          b_gso;
+#endif
 
     vlc_thread_t  thread;
 };
@@ -213,6 +223,9 @@ static int Open( vlc_object_t *p_this )
     p_sys->p_fifo = block_FifoNew();
     p_sys->p_empty_blocks = block_FifoNew();
     p_sys->p_buffer = NULL;
+#ifdef UDP_SEGMENT
+    p_sys->b_gso = true;
+#endif
 
     if( vlc_clone( &p_sys->thread, ThreadWrite, p_access,
                            VLC_THREAD_PRIORITY_HIGHEST ) )
@@ -392,6 +405,140 @@ static block_t *NewUDPPacket( sout_access_out_t *p_access, mtime_t i_dts)
     return p_buffer;
 }
 
+#ifdef UDP_SEGMENT
+/*****************************************************************************
+ * SendGSO: send packets of the same size as one segmentation offload buffer
+ *****************************************************************************
+ * Returns the number of packets sent, 0 if offload is not applicable.
+ *****************************************************************************/
+static unsigned SendGSO( sout_access_out_t *p_access,
+                         block_t *const *pp_pk, unsigned i_count )
+{
+    sout_access_out_sys_t *p_sys = p_access->p_sys;
+    const size_t i_segment = pp_pk[0]->i_buffer;
+    struct iovec iov[MAX_BATCH_PACKETS];
+    size_t i_total = 0;
+    unsigned n = 0;
+
+    if( !p_sys->b_gso )
+        return 0;
+
+    /* All segments but the last one must have the same size, and the last
+     * one may only be shorter: a larger one would be split by the kernel */
+    while( n < i_count && pp_pk[n]->i_buffer <= i_segment
+        && i_total + pp_pk[n]->i_buffer <= MAX_GSO_BYTES )
+    {
+        iov[n].iov_base = pp_pk[n]->p_buffer;
+        iov[n].iov_len = pp_pk[n]->i_buffer;
+        i_total += pp_pk[n]->i_buffer;
+        if( pp_pk[n++]->i_buffer < i_segment )
+            break;
+    }
+    if( n < 2 || i_segment == 0 )
+        return 0;
+
+    union
+    {
+        char buf[CMSG_SPACE(sizeof (uint16_t))];
+        struct cmsghdr align;
+    } control;
+    struct msghdr msg = {
+        .msg_iov = iov,
+        .msg_iovlen = n,
+        .msg_control = control.buf,
+        .msg_controllen = sizeof (control.buf),
+    };
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    uint16_t i_gso_size = i_segment;
+
+    cmsg->cmsg_level = SOL_UDP;
+    cmsg->cmsg_type = UDP_SEGMENT;
+    cmsg->cmsg_len = CMSG_LEN(sizeof (i_gso_size));
+    memcpy( CMSG_DATA(cmsg), &i_gso_size, sizeof (i_gso_size) );
+
+    if( sendmsg( p_sys->i_handle, &msg, 0 ) == -1 )
+    {
+        if( errno != EINVAL && errno != EIO && errno != ENOPROTOOPT )
+        {
+            msg_Warn( p_access, "send error: %s", vlc_strerror_c(errno) );
+            return n;
+        }
+        msg_Dbg( p_access, "UDP segmentation offload not supported" );
+        p_sys->b_gso = false;
+        return 0;
+    }
+    return n;
+}
+#endif
+
+/*****************************************************************************
+ * SendBatch: send packets due at the same time with as few calls as possible
+ *****************************************************************************/
+static void SendBatch( sout_access_out_t *p_access,
+                       block_t *const *pp_pk, unsigned i_count )
+{
+    sout_access_out_sys_t *p_sys = p_access->p_sys;
+
+    while( i_count > 0 )
+    {
+        unsigned i_sent;
+#ifdef UDP_SEGMENT
+        i_sent = SendGSO( p_access, pp_pk, i_count );
+        if( i_sent == 0 )
+#endif
+#ifdef HAVE_SENDMMSG
+        {
+            struct mmsghdr msgs[MAX_BATCH_PACKETS];
+            struct iovec iov[MAX_BATCH_PACKETS];
+
+            for( unsigned i = 0; i < i_count; i++ )
+            {
+                iov[i].iov_base = pp_pk[i]->p_buffer;
+                iov[i].iov_len = pp_pk[i]->i_buffer;
+                msgs[i].msg_hdr = (struct msghdr) {
+                    .msg_iov = &iov[i],
+                    .msg_iovlen = 1,
+                };
+            }
+
+            int val = sendmmsg( p_sys->i_handle, msgs, i_count, 0 );
+            if( val <= 0 )
+            {   /* skip the failed packet */
+                msg_Warn( p_access, "send error: %s", vlc_strerror_c(errno) );
+                val = 1;
+            }
+            i_sent = val;
+        }
+#else
+        {
+            if( send( p_sys->i_handle, pp_pk[0]->p_buffer,
+                      pp_pk[0]->i_buffer, 0 ) == -1 )
+                msg_Warn( p_access, "send error: %s", vlc_strerror_c(errno) );
+            i_sent = 1;
+        }
+#endif
+        pp_pk += i_sent;
+        i_count -= i_sent;
+    }
+}
+
+typedef struct
+{
+    block_t  *pp_pk[MAX_BATCH_PACKETS];
+    unsigned  i_count;
+    block_t  *p_pending;
+} udp_batch_t;
+
+static void BatchCleanup( void *data )
+{
+    udp_batch_t *p_batch = data;
+
+    for( unsigned i = 0; i < p_batch->i_count; i++ )
+        block_Release( p_batch->pp_pk[i] );
+    if( p_batch->p_pending )
+        block_Release( p_batch->p_pending );
+}
+
 /*****************************************************************************
  * ThreadWrite: Write a packet on the network at the good time.
  *****************************************************************************/
@@ -400,16 +547,23 @@ static void* ThreadWrite( void *data )
     sout_access_out_t *p_access = data;
     sout_access_out_sys_t *p_sys = p_access->p_sys;
     mtime_t i_date_last = -1;
+    mtime_t i_date_waited = INT64_MIN;
     const unsigned i_group = var_GetInteger( p_access,
                                              SOUT_CFG_PREFIX "group" );
     mtime_t i_to_send = i_group;
     unsigned i_dropped_packets = 0;
+    udp_batch_t batch = { .i_count = 0, .p_pending = NULL };
 
     for (;;)
     {
-        block_t *p_pk = block_FifoGet( p_sys->p_fifo );
+        block_t *p_pk = batch.p_pending;
         mtime_t       i_date, i_sent;
 
+        if( p_pk != NULL )
+            batch.p_pending = NULL;
+        else
+            p_pk = block_FifoGet( p_sys->p_fifo );
+
         i_date = p_sys->i_caching + p_pk->i_dts;
         if( i_date_last > 0 )
         {
@@ -433,15 +587,45 @@ static void* ThreadWrite( void *data )
             }
         }
 
-        block_cleanup_push( p_pk );
+        batch.pp_pk[0] = p_pk;
+        batch.i_count = 1;
         i_to_send--;
         if( !i_to_send || (p_pk->i_flags & BLOCK_FLAG_CLOCK) )
         {
+            vlc_cleanup_push( BatchCleanup, &batch );
             mwait( i_date );
+            vlc_cleanup_pop();
+            i_date_waited = i_date;
             i_to_send = i_group;
         }
-        if ( send( p_sys->i_handle, p_pk->p_buffer, p_pk->i_buffer, 0 ) == -1 )
-            msg_Warn( p_access, "send error: %s", vlc_strerror_c(errno) );
+        i_date_last = i_date;
+
+        /* Gather the queued packets that would be sent right away, i.e.
+         * the rest of the group, and packets whose wait already expired */
+        vlc_fifo_Lock( p_sys->p_fifo );
+        while( batch.i_count < MAX_BATCH_PACKETS
+            && !vlc_fifo_IsEmpty( p_sys->p_fifo ) )
+        {
+            block_t *p_next = vlc_fifo_DequeueUnlocked( p_sys->p_fifo );
+            mtime_t i_next_date = p_sys->i_caching + p_next->i_dts;
+
+            if( i_next_date - i_date_last > 2000000
+             || ((i_to_send == 1 || (p_next->i_flags & BLOCK_FLAG_CLOCK))
+              && i_next_date > i_date_waited) )
+            {
+                batch.p_pending = p_next;
+                break;
+            }
+
+            if( --i_to_send == 0 || (p_next->i_flags & BLOCK_FLAG_CLOCK) )
+                i_to_send = i_group;
+            batch.pp_pk[batch.i_count++] = p_next;
+            i_date_last = i_next_date;
+        }
+        vlc_fifo_Unlock( p_sys->p_fifo );
+
+        vlc_cleanup_push( BatchCleanup, &batch );
+        SendBatch( p_access, batch.pp_pk, batch.i_count );
         vlc_cleanup_pop();
 
         if( i_dropped_packets )
@@ -459,9 +643,9 @@ static void* ThreadWrite( void *data )
         }
 #endif
 
-        block_FifoPut( p_sys->p_empty_blocks, p_pk );
-
-        i_date_last = i_date;
+        for( unsigned i = 0; i < batch.i_count; i++ )
+            block_FifoPut( p_sys->p_empty_blocks, batch.pp_pk[i] );
+        batch.i_count = 0;
     }
     return NULL;
 }
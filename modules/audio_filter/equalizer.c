@@ -39,6 +39,7 @@
 #include <vlc_filter.h>
 
 #include "equalizer_presets.h"
+#include "equalizer_fir.h"
 
 /* TODO:
  *  - optimize a bit (you can hardly do slower ;)
@@ -76,6 +77,17 @@ static void Close( vlc_object_t * );
 #define PREAMP_TEXT N_("Global gain" )
 #define PREAMP_LONGTEXT N_("Set the global gain in dB (-20 ... 20)." )
 
+#define ENGINE_TEXT N_( "Filter engine" )
+#define ENGINE_LONGTEXT N_( "The IIR engine runs one filter per band. " \
+         "The FFT engine applies the whole equalizer as one FIR, which is " \
+         "faster with many channels or two pass, but delays the audio by " \
+         "about 10 ms. The linear phase variant does not shift the phase of " \
+         "the bands, at the cost of about 40 ms more delay." )
+
+static const char *const engine_list[] = { "iir", "fft", "fft-linear" };
+static const char *const engine_list_text[] = {
+    N_("IIR"), N_("FFT"), N_("FFT, linear phase") };
+
 vlc_module_begin ()
     set_description( N_("Equalizer with 10 bands") )
     set_shortname( N_("Equalizer" ) )
@@ -94,6 +106,9 @@ vlc_module_begin ()
               VLC_BANDS_LONGTEXT, true )
     add_float( "equalizer-preamp", 12.0f, PREAMP_TEXT,
                PREAMP_LONGTEXT, true )
+    add_string( "equalizer-engine", "iir", ENGINE_TEXT,
+                ENGINE_LONGTEXT, true )
+        change_string_list( engine_list, engine_list_text )
     set_callbacks( Open, Close )
     add_shortcut( "equalizer" )
 vlc_module_end ()
@@ -122,6 +137,18 @@ struct filter_sys_t
     float x2[32][2];
     float y2[32][128][2];
 
+    /* FFT engine, p_fir is NULL with the IIR engine */
+    eqz_fir_t *p_fir;
+    eqz_fft_t *p_fft;       /* 2 * i_taps points, to design the filter */
+    unsigned i_taps;
+    bool b_linear;
+    bool b_dirty;           /* the FIR must be designed again */
+    mtime_t i_delay;        /* latency of the FIR */
+    float *f_response;      /* i_band impulse responses of i_taps samples */
+    double *f_sum;          /* EQZ_IN_FACTOR + sum of the amplified bands,
+                             * in double not to drift with the updates */
+    float *f_work;          /* 2 * i_taps complex */
+
     vlc_mutex_t lock;
 };
 
@@ -132,6 +159,11 @@ static int  EqzInit( filter_t *, int );
 static void EqzFilter( filter_t *, float *, float *, int, int );
 static void EqzClean( filter_t * );
 
+#define EQZ_FIR_BLOCK 512
+static int  EqzFirInit( filter_t *, int );
+static void EqzFirFilter( filter_t *, float *, float *, int );
+static void EqzFirClean( filter_sys_t * );
+
 static int PresetCallback ( vlc_object_t *, char const *, vlc_value_t,
                             vlc_value_t, void * );
 static int PreampCallback ( vlc_object_t *, char const *, vlc_value_t,
@@ -190,9 +222,22 @@ static void Close( vlc_object_t *p_this )
  *****************************************************************************/
 static block_t * DoWork( filter_t * p_filter, block_t * p_in_buf )
 {
-    EqzFilter( p_filter, (float*)p_in_buf->p_buffer,
-               (float*)p_in_buf->p_buffer, p_in_buf->i_nb_samples,
-               aout_FormatNbChannels( &p_filter->fmt_in.audio ) );
+    if( p_filter->p_sys->p_fir != NULL )
+    {
+        const mtime_t i_delay = p_filter->p_sys->i_delay;
+
+        EqzFirFilter( p_filter, (float*)p_in_buf->p_buffer,
+                      (float*)p_in_buf->p_buffer, p_in_buf->i_nb_samples );
+        /* The output lags the input by the latency of the FIR */
+        if( p_in_buf->i_pts > VLC_TS_INVALID )
+            p_in_buf->i_pts = __MAX( p_in_buf->i_pts - i_delay, VLC_TS_0 );
+        if( p_in_buf->i_dts > VLC_TS_INVALID )
+            p_in_buf->i_dts = __MAX( p_in_buf->i_dts - i_delay, VLC_TS_0 );
+    }
+    else
+        EqzFilter( p_filter, (float*)p_in_buf->p_buffer,
+                   (float*)p_in_buf->p_buffer, p_in_buf->i_nb_samples,
+                   aout_FormatNbChannels( &p_filter->fmt_in.audio ) );
     return p_in_buf;
 }
 
@@ -332,6 +377,12 @@ static int EqzInit( filter_t *p_filter, int i_rate )
         }
     }
 
+    if( EqzFirInit( p_filter, i_rate ) != VLC_SUCCESS )
+    {
+        free( p_sys->f_amp );
+        goto error;
+    }
+
     var_Create( p_aout, "equalizer-bands", VLC_VAR_STRING | VLC_VAR_DOINHERIT );
     var_Create( p_aout, "equalizer-preset", VLC_VAR_STRING | VLC_VAR_DOINHERIT );
 
@@ -356,6 +407,7 @@ static int EqzInit( filter_t *p_filter, int i_rate )
     {
         msg_Err(p_filter, "No preset selected");
         free( val2.psz_string );
+        EqzFirClean( p_sys );
         free( p_sys->f_amp );
         i_ret = VLC_EGENERIC;
         goto error;
@@ -370,6 +422,10 @@ static int EqzInit( filter_t *p_filter, int i_rate )
 
     msg_Dbg( p_filter, "equalizer loaded for %d Hz with %d bands %d pass",
                         i_rate, p_sys->i_band, p_sys->b_2eqz ? 2 : 1 );
+    if( p_sys->p_fir != NULL )
+        msg_Dbg( p_filter, "FFT engine with %u taps, %u samples delay",
+                 p_sys->i_taps, EQZ_FIR_BLOCK
+                                + (p_sys->b_linear ? p_sys->i_taps / 2 : 0) );
     for( i = 0; i < p_sys->i_band; i++ )
     {
         msg_Dbg( p_filter, "   %.2f Hz -> factor:%f alpha:%f beta:%f gamma:%f",
@@ -463,6 +519,204 @@ static void EqzClean( filter_t *p_filter )
     free( p_sys->f_gamma );
 
     free( p_sys->f_amp );
+    EqzFirClean( p_sys );
+}
+
+/*****************************************************************************
+ * FFT engine
+ *****************************************************************************
+ * The equalizer is linear: with the impulse response h_j of the band j
+ * filter, the output of one pass is gamp * s * x, with
+ * s = EQZ_IN_FACTOR * delta + sum( amp_j * h_j ), and two pass is
+ * gamp^2 * s * s * x. s is truncated to i_taps samples, long enough for the
+ * lowest band to decay, and applied with a partitioned FFT convolution.
+ *****************************************************************************/
+static unsigned EqzFirTaps( int i_rate )
+{
+    /* About 85 ms: the truncated tail of the lowest bands is below -75 dB */
+    if( i_rate <= 48000 )
+        return 4096;
+    if( i_rate <= 96000 )
+        return 8192;
+    return 16384;
+}
+
+static int EqzFirInit( filter_t *p_filter, int i_rate )
+{
+    filter_sys_t *p_sys = p_filter->p_sys;
+    vlc_object_t *p_aout = p_filter->obj.parent;
+
+    p_sys->p_fir = NULL;
+    p_sys->p_fft = NULL;
+    p_sys->f_response = p_sys->f_work = NULL;
+    p_sys->f_sum = NULL;
+
+    char *psz_engine = var_InheritString( p_aout, "equalizer-engine" );
+    if( psz_engine == NULL || !strcmp( psz_engine, "iir" ) )
+    {
+        free( psz_engine );
+        return VLC_SUCCESS;
+    }
+    p_sys->b_linear = !strcmp( psz_engine, "fft-linear" );
+    if( !p_sys->b_linear && strcmp( psz_engine, "fft" ) )
+        msg_Warn( p_filter, "unknown equalizer engine '%s'", psz_engine );
+    free( psz_engine );
+
+    const unsigned i_taps = p_sys->i_taps = EqzFirTaps( i_rate );
+
+    p_sys->p_fir = EqzFirNew( i_taps, EQZ_FIR_BLOCK,
+                              aout_FormatNbChannels( &p_filter->fmt_in.audio ) );
+    p_sys->p_fft = EqzFftNew( 2 * i_taps );
+    p_sys->f_response = malloc( p_sys->i_band * i_taps * sizeof(float) );
+    p_sys->f_sum = calloc( i_taps, sizeof(double) );
+    p_sys->f_work = malloc( 4 * i_taps * sizeof(float) );
+    if( !p_sys->p_fir || !p_sys->p_fft || !p_sys->f_response
+     || !p_sys->f_sum || !p_sys->f_work )
+    {
+        EqzFirClean( p_sys );
+        return VLC_ENOMEM;
+    }
+
+    for( int j = 0; j < p_sys->i_band; j++ )
+    {
+        float *h = &p_sys->f_response[j * i_taps];
+        double y1 = 0., y2 = 0.;
+
+        for( unsigned n = 0; n < i_taps; n++ )
+        {
+            /* x - x[n-2] of EqzFilter() for a unit impulse */
+            double x = (n == 0) - (n == 2);
+            double y = p_sys->f_alpha[j] * x + p_sys->f_gamma[j] * y1
+                     - p_sys->f_beta[j] * y2;
+            y2 = y1;
+            y1 = y;
+            h[n] = y;
+        }
+    }
+    /* All f_amp are still 0 */
+    p_sys->f_sum[0] = EQZ_IN_FACTOR;
+    p_sys->b_dirty = true;
+
+    const unsigned i_delay = EQZ_FIR_BLOCK
+                           + (p_sys->b_linear ? i_taps / 2 : 0);
+    p_sys->i_delay = CLOCK_FREQ * i_delay / i_rate;
+    return VLC_SUCCESS;
+}
+
+static void EqzFirClean( filter_sys_t *p_sys )
+{
+    if( p_sys->p_fir != NULL )
+        EqzFirDelete( p_sys->p_fir );
+    if( p_sys->p_fft != NULL )
+        EqzFftDelete( p_sys->p_fft );
+    free( p_sys->f_response );
+    free( p_sys->f_sum );
+    free( p_sys->f_work );
+    p_sys->p_fir = NULL;
+}
+
+/* Changes the gain of one band: only its own response is added to the sum */
+static void EqzFirSetBand( filter_sys_t *p_sys, int i_band, float f_amp )
+{
+    const double f_delta = (double)f_amp - p_sys->f_amp[i_band];
+    const float *h = &p_sys->f_response[i_band * p_sys->i_taps];
+
+    if( f_delta == 0. )
+        return;
+    for( unsigned n = 0; n < p_sys->i_taps; n++ )
+        p_sys->f_sum[n] += f_delta * h[n];
+    p_sys->b_dirty = true;
+}
+
+/* Designs the taps from the copy of s at the start of f_work. Only the
+ * audio thread uses f_work and p_fir, so this runs without the lock. */
+static void EqzFirDesign( filter_sys_t *p_sys, float f_gamp, bool b_2eqz )
+{
+    const unsigned i_taps = p_sys->i_taps;
+    const unsigned i_size = 2 * i_taps;
+    float *w = p_sys->f_work;
+    float f_gain = f_gamp;
+
+    if( b_2eqz )
+        f_gain *= f_gamp;
+
+    if( !b_2eqz && !p_sys->b_linear )
+    {
+        for( unsigned n = 0; n < i_taps; n++ )
+            w[n] *= f_gain;
+        EqzFirSetTaps( p_sys->p_fir, w );
+        return;
+    }
+
+    /* Work on the spectrum of s, zero padded against circular aliasing */
+    float *re = w, *im = w + i_size;
+
+    memset( &re[i_taps], 0, i_taps * sizeof(float) );
+    memset( im, 0, i_size * sizeof(float) );
+    EqzFft( p_sys->p_fft, re, im );
+
+    for( unsigned k = 0; k < i_size; k++ )
+    {
+        const float r = re[k], m = im[k];
+
+        if( p_sys->b_linear )
+        {
+            /* Zero phase: keep only the magnitude */
+            re[k] = b_2eqz ? r * r + m * m : sqrtf( r * r + m * m );
+            im[k] = 0.f;
+        }
+        else
+        {
+            re[k] = r * r - m * m;
+            im[k] = 2.f * r * m;
+        }
+    }
+    EqzFft( p_sys->p_fft, im, re ); /* inverse */
+    f_gain /= i_size;
+
+    if( p_sys->b_linear )
+    {
+        /* The zero phase response is centered on 0: window it and delay it
+         * by half the length */
+        for( unsigned n = 0; n < i_taps; n++ )
+        {
+            const unsigned i = (n + i_size - i_taps / 2) % i_size;
+            const float f_win = .5f - .5f * cosf( 2.f * (float)M_PI * n
+                                                  / i_taps );
+            im[n] = f_gain * f_win * re[i];
+        }
+        w = im;
+    }
+    else
+    {
+        for( unsigned n = 0; n < i_taps; n++ )
+            re[n] *= f_gain;
+    }
+    EqzFirSetTaps( p_sys->p_fir, w );
+}
+
+static void EqzFirFilter( filter_t *p_filter, float *out, float *in,
+                          int i_samples )
+{
+    filter_sys_t *p_sys = p_filter->p_sys;
+
+    /* Only copy the settings under the lock: designing the taps takes FFTs
+     * of up to 2 * 16384 points and would stall the callbacks */
+    vlc_mutex_lock( &p_sys->lock );
+    const bool b_dirty = p_sys->b_dirty;
+    const float f_gamp = p_sys->f_gamp;
+    const bool b_2eqz = p_sys->b_2eqz;
+    if( b_dirty )
+    {
+        for( unsigned n = 0; n < p_sys->i_taps; n++ )
+            p_sys->f_work[n] = p_sys->f_sum[n];
+        p_sys->b_dirty = false;
+    }
+    vlc_mutex_unlock( &p_sys->lock );
+
+    if( b_dirty )
+        EqzFirDesign( p_sys, f_gamp, b_2eqz );
+    EqzFirProcess( p_sys->p_fir, out, in, i_samples );
 }
 
 
@@ -529,10 +783,18 @@ static int PreampCallback( vlc_object_t *p_this, char const *psz_cmd,
 
     vlc_mutex_lock( &p_sys->lock );
     p_sys->f_gamp = preamp;
+    p_sys->b_dirty = true;
     vlc_mutex_unlock( &p_sys->lock );
     return VLC_SUCCESS;
 }
 
+static void EqzSetBand( filter_sys_t *p_sys, int i_band, float f_amp )
+{
+    if( p_sys->p_fir != NULL )
+        EqzFirSetBand( p_sys, i_band, f_amp );
+    p_sys->f_amp[i_band] = f_amp;
+}
+
 static int BandsCallback( vlc_object_t *p_this, char const *psz_cmd,
                          vlc_value_t oldval, vlc_value_t newval, void *p_data )
 {
@@ -551,14 +813,14 @@ static int BandsCallback( vlc_object_t *p_this, char const *psz_cmd,
         if( next == p || isnan( f ) )
             break; /* no conversion */
 
-        p_sys->f_amp[i++] = EqzConvertdB( f );
+        EqzSetBand( p_sys, i++, EqzConvertdB( f ) );
 
         if( *next == '\0' )
             break; /* end of line */
         p = &next[1];
     }
     while( i < p_sys->i_band )
-        p_sys->f_amp[i++] = EqzConvertdB( 0.f );
+        EqzSetBand( p_sys, i++, EqzConvertdB( 0.f ) );
     vlc_mutex_unlock( &p_sys->lock );
     return VLC_SUCCESS;
 }
@@ -570,6 +832,7 @@ static int TwoPassCallback( vlc_object_t *p_this, char const *psz_cmd,
 
     vlc_mutex_lock( &p_sys->lock );
     p_sys->b_2eqz = newval.b_bool;
+    p_sys->b_dirty = true;
     vlc_mutex_unlock( &p_sys->lock );
     return VLC_SUCCESS;
 }
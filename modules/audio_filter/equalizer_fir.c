@@ -0,0 +1,334 @@
+/*****************************************************************************
+ * equalizer_fir.c: uniformly partitioned FFT convolution
+ *****************************************************************************
+ * Copyright (C) 2016 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <assert.h>
+#include <math.h>
+
+#include <vlc_common.h>
+
+#include "equalizer_fir.h"
+
+/*****************************************************************************
+ * FFT
+ *****************************************************************************/
+struct eqz_fft
+{
+    unsigned  i_size;
+    unsigned *p_reverse;  /* bit reversed indexes */
+    /* Twiddle factors of each stage, stored one after the other: the stage
+     * of half size h uses exp(-i pi k / h) at index h + k, for k < h */
+    float    *p_twiddle_re;
+    float    *p_twiddle_im;
+};
+
+eqz_fft_t *EqzFftNew( unsigned i_size )
+{
+    assert( i_size >= 4 && (i_size & (i_size - 1)) == 0 );
+
+    eqz_fft_t *p_fft = malloc( sizeof(*p_fft) );
+    if( unlikely(p_fft == NULL) )
+        return NULL;
+
+    p_fft->i_size = i_size;
+    p_fft->p_reverse = malloc( i_size * sizeof(*p_fft->p_reverse) );
+    p_fft->p_twiddle_re = malloc( i_size * sizeof(float) );
+    p_fft->p_twiddle_im = malloc( i_size * sizeof(float) );
+    if( unlikely(p_fft->p_reverse == NULL || p_fft->p_twiddle_re == NULL
+              || p_fft->p_twiddle_im == NULL) )
+    {
+        EqzFftDelete( p_fft );
+        return NULL;
+    }
+
+    unsigned i_bits = 0;
+    while( (1u << i_bits) < i_size )
+        i_bits++;
+    for( unsigned i = 0; i < i_size; i++ )
+    {
+        unsigned r = 0;
+        for( unsigned b = 0; b < i_bits; b++ )
+            if( i & (1u << b) )
+                r |= 1u << (i_bits - 1 - b);
+        p_fft->p_reverse[i] = r;
+    }
+
+    for( unsigned h = 1; h < i_size; h <<= 1 )
+        for( unsigned k = 0; k < h; k++ )
+        {
+            double f_angle = -M_PI * k / h;
+            p_fft->p_twiddle_re[h + k] = cos( f_angle );
+            p_fft->p_twiddle_im[h + k] = sin( f_angle );
+        }
+    return p_fft;
+}
+
+void EqzFftDelete( eqz_fft_t *p_fft )
+{
+    free( p_fft->p_twiddle_im );
+    free( p_fft->p_twiddle_re );
+    free( p_fft->p_reverse );
+    free( p_fft );
+}
+
+void EqzFft( const eqz_fft_t *p_fft, float *restrict re, float *restrict im )
+{
+    const unsigned n = p_fft->i_size;
+
+    for( unsigned i = 0; i < n; i++ )
+    {
+        unsigned j = p_fft->p_reverse[i];
+        if( i < j )
+        {
+            float r = re[i], m = im[i];
+            re[i] = re[j];
+            im[i] = im[j];
+            re[j] = r;
+            im[j] = m;
+        }
+    }
+
+    /* The first two stages only use 1 and -i as twiddle factors */
+    for( unsigned i = 0; i < n; i += 4 )
+    {
+        const float r0 = re[i] + re[i + 1], m0 = im[i] + im[i + 1];
+        const float r1 = re[i] - re[i + 1], m1 = im[i] - im[i + 1];
+        const float r2 = re[i + 2] + re[i + 3], m2 = im[i + 2] + im[i + 3];
+        const float r3 = re[i + 2] - re[i + 3], m3 = im[i + 2] - im[i + 3];
+
+        re[i]     = r0 + r2;
+        im[i]     = m0 + m2;
+        re[i + 2] = r0 - r2;
+        im[i + 2] = m0 - m2;
+        re[i + 1] = r1 + m3;
+        im[i + 1] = m1 - r3;
+        re[i + 3] = r1 - m3;
+        im[i + 3] = m1 + r3;
+    }
+
+    /* Iterative radix-2 decimation in time. The inner loop runs on
+     * contiguous butterflies, so that it can be vectorized. */
+    for( unsigned h = 4; h < n; h <<= 1 )
+    {
+        const float *wr = &p_fft->p_twiddle_re[h];
+        const float *wi = &p_fft->p_twiddle_im[h];
+
+        for( unsigned i = 0; i < n; i += 2 * h )
+        {
+            float *restrict ar = &re[i], *restrict ai = &im[i];
+            float *restrict br = &re[i + h], *restrict bi = &im[i + h];
+
+            for( unsigned k = 0; k < h; k++ )
+            {
+                const float tr = br[k] * wr[k] - bi[k] * wi[k];
+                const float ti = br[k] * wi[k] + bi[k] * wr[k];
+
+                br[k] = ar[k] - tr;
+                bi[k] = ai[k] - ti;
+                ar[k] += tr;
+                ai[k] += ti;
+            }
+        }
+    }
+}
+
+/*****************************************************************************
+ * Partitioned convolution
+ *****************************************************************************
+ * Overlap-save with a frequency-domain delay line: every i_block input
+ * samples, the spectrum of the last 2 * i_block samples is computed once,
+ * and multiplied with the spectra of all the filter partitions, each
+ * applied to the input spectrum that is as many blocks old.
+ *****************************************************************************/
+struct eqz_fir
+{
+    eqz_fft_t *p_fft;     /* 2 * i_block points */
+    unsigned   i_block;
+    unsigned   i_parts;
+    unsigned   i_channels;
+    unsigned   i_pairs;
+
+    /* Complex arrays of 2 * i_block points, stored as the real parts
+     * followed by the imaginary parts */
+    float     *p_filter;  /* i_parts filter spectra */
+    float     *p_fdl;     /* i_pairs * i_parts input spectra */
+    float     *p_frame;   /* i_pairs * last 2 * i_block input samples */
+    float     *p_output;  /* i_pairs * i_block output samples */
+    float     *p_work;
+    unsigned   i_fdl;     /* most recent input spectrum */
+    unsigned   i_fill;    /* samples in the current block */
+};
+
+eqz_fir_t *EqzFirNew( unsigned i_taps, unsigned i_block, unsigned i_channels )
+{
+    assert( i_taps % i_block == 0 && i_channels > 0 );
+
+    eqz_fir_t *p_fir = calloc( 1, sizeof(*p_fir) );
+    if( unlikely(p_fir == NULL) )
+        return NULL;
+
+    const unsigned i_size = 2 * i_block;
+
+    p_fir->i_block = i_block;
+    p_fir->i_parts = i_taps / i_block;
+    p_fir->i_channels = i_channels;
+    p_fir->i_pairs = (i_channels + 1) / 2;
+    p_fir->p_fft = EqzFftNew( i_size );
+    p_fir->p_filter = calloc( p_fir->i_parts * 2 * i_size, sizeof(float) );
+    p_fir->p_fdl = calloc( p_fir->i_pairs * p_fir->i_parts * 2 * i_size,
+                           sizeof(float) );
+    p_fir->p_frame = calloc( p_fir->i_pairs * 2 * i_size, sizeof(float) );
+    p_fir->p_output = calloc( p_fir->i_pairs * 2 * i_block, sizeof(float) );
+    p_fir->p_work = calloc( 2 * i_size, sizeof(float) );
+    if( unlikely(p_fir->p_fft == NULL || p_fir->p_filter == NULL
+              || p_fir->p_fdl == NULL || p_fir->p_frame == NULL
+              || p_fir->p_output == NULL || p_fir->p_work == NULL) )
+    {
+        EqzFirDelete( p_fir );
+        return NULL;
+    }
+    return p_fir;
+}
+
+void EqzFirDelete( eqz_fir_t *p_fir )
+{
+    free( p_fir->p_work );
+    free( p_fir->p_output );
+    free( p_fir->p_frame );
+    free( p_fir->p_fdl );
+    free( p_fir->p_filter );
+    if( p_fir->p_fft != NULL )
+        EqzFftDelete( p_fir->p_fft );
+    free( p_fir );
+}
+
+void EqzFirSetTaps( eqz_fir_t *p_fir, const float *p_taps )
+{
+    const unsigned i_block = p_fir->i_block;
+    const unsigned i_size = 2 * i_block;
+    /* The inverse FFT is not scaled: do it once here */
+    const float f_scale = 1.f / i_size;
+
+    for( unsigned p = 0; p < p_fir->i_parts; p++ )
+    {
+        float *re = &p_fir->p_filter[p * 2 * i_size], *im = re + i_size;
+
+        for( unsigned i = 0; i < i_block; i++ )
+            re[i] = p_taps[p * i_block + i] * f_scale;
+        memset( &re[i_block], 0, i_block * sizeof(float) );
+        memset( im, 0, i_size * sizeof(float) );
+        EqzFft( p_fir->p_fft, re, im );
+    }
+}
+
+static void EqzFirBlock( eqz_fir_t *p_fir, unsigned i_pair )
+{
+    const unsigned i_block = p_fir->i_block;
+    const unsigned i_size = 2 * i_block;
+    const unsigned i_parts = p_fir->i_parts;
+    float *p_fdl = &p_fir->p_fdl[i_pair * i_parts * 2 * i_size];
+    float *p_frame = &p_fir->p_frame[i_pair * 2 * i_size];
+    float *restrict yr = p_fir->p_work, *restrict yi = yr + i_size;
+
+    float *X = &p_fdl[p_fir->i_fdl * 2 * i_size];
+    memcpy( X, p_frame, 2 * i_size * sizeof(float) );
+    EqzFft( p_fir->p_fft, X, X + i_size );
+
+    memset( p_fir->p_work, 0, 2 * i_size * sizeof(float) );
+    for( unsigned p = 0; p < i_parts; p++ )
+    {
+        const float *restrict hr = &p_fir->p_filter[p * 2 * i_size];
+        const float *restrict hi = hr + i_size;
+        const float *restrict xr = &p_fdl[((p_fir->i_fdl + i_parts - p)
+                                           % i_parts) * 2 * i_size];
+        const float *restrict xi = xr + i_size;
+
+        for( unsigned k = 0; k < i_size; k++ )
+        {
+            yr[k] += xr[k] * hr[k] - xi[k] * hi[k];
+            yi[k] += xr[k] * hi[k] + xi[k] * hr[k];
+        }
+    }
+    EqzFft( p_fir->p_fft, yi, yr ); /* inverse */
+
+    /* The first half is circular convolution garbage */
+    float *p_output = &p_fir->p_output[i_pair * 2 * i_block];
+    memcpy( p_output, &yr[i_block], i_block * sizeof(float) );
+    memcpy( &p_output[i_block], &yi[i_block], i_block * sizeof(float) );
+
+    /* Slide the input frame by one block */
+    memcpy( p_frame, &p_frame[i_block], i_block * sizeof(float) );
+    memcpy( &p_frame[i_size], &p_frame[i_size + i_block],
+            i_block * sizeof(float) );
+}
+
+void EqzFirProcess( eqz_fir_t *p_fir, float *p_out, const float *p_in,
+                    unsigned i_samples )
+{
+    const unsigned i_block = p_fir->i_block;
+    const unsigned i_channels = p_fir->i_channels;
+
+    while( i_samples > 0 )
+    {
+        const unsigned i_fill = p_fir->i_fill;
+        const unsigned i_count = __MIN( i_samples, i_block - i_fill );
+
+        for( unsigned i_pair = 0; i_pair < p_fir->i_pairs; i_pair++ )
+        {
+            const unsigned ch = 2 * i_pair;
+            const bool b_odd = ch + 1 < i_channels;
+            float *re = &p_fir->p_frame[i_pair * 4 * i_block
+                                        + i_block + i_fill];
+            float *im = re + 2 * i_block;
+            const float *out_re = &p_fir->p_output[i_pair * 2 * i_block
+                                                   + i_fill];
+            const float *out_im = out_re + i_block;
+
+            /* p_out may be p_in: read each sample before writing it */
+            for( unsigned i = 0; i < i_count; i++ )
+            {
+                const float *in = &p_in[i * i_channels + ch];
+                float *out = &p_out[i * i_channels + ch];
+
+                re[i] = in[0];
+                im[i] = b_odd ? in[1] : 0.f;
+                out[0] = out_re[i];
+                if( b_odd )
+                    out[1] = out_im[i];
+            }
+        }
+
+        p_fir->i_fill += i_count;
+        if( p_fir->i_fill == i_block )
+        {
+            for( unsigned i_pair = 0; i_pair < p_fir->i_pairs; i_pair++ )
+                EqzFirBlock( p_fir, i_pair );
+            p_fir->i_fdl = (p_fir->i_fdl + 1) % p_fir->i_parts;
+            p_fir->i_fill = 0;
+        }
+
+        p_in += i_count * i_channels;
+        p_out += i_count * i_channels;
+        i_samples -= i_count;
+    }
+}
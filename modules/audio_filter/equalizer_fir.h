@@ -0,0 +1,47 @@
+/*****************************************************************************
+ * equalizer_fir.h: uniformly partitioned FFT convolution
+ *****************************************************************************
+ * Copyright (C) 2016 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifndef VLC_EQUALIZER_FIR_H_
+#define VLC_EQUALIZER_FIR_H_
+
+/* In-place complex FFT of a power of two size, on separate real and
+ * imaginary arrays so that the compiler can vectorize it. The inverse
+ * transform is done by swapping p_re and p_im, and is not scaled. */
+typedef struct eqz_fft eqz_fft_t;
+
+eqz_fft_t *EqzFftNew( unsigned i_size );
+void EqzFftDelete( eqz_fft_t * );
+void EqzFft( const eqz_fft_t *, float *restrict p_re, float *restrict p_im );
+
+/* Filters interleaved float samples with a FIR of i_taps taps, cut in
+ * partitions of i_block taps. Channels are processed in pairs, as the real
+ * and imaginary parts of one complex signal, since the filter is real.
+ * The output is delayed by i_block samples. */
+typedef struct eqz_fir eqz_fir_t;
+
+eqz_fir_t *EqzFirNew( unsigned i_taps, unsigned i_block,
+                      unsigned i_channels );
+void EqzFirDelete( eqz_fir_t * );
+/* Sets the i_taps coefficients of the filter */
+void EqzFirSetTaps( eqz_fir_t *, const float *p_taps );
+void EqzFirProcess( eqz_fir_t *, float *p_out, const float *p_in,
+                    unsigned i_samples );
+
+#endif
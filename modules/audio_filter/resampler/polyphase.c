@@ -0,0 +1,650 @@
+/*****************************************************************************
+ * polyphase.c : polyphase FIR resampler
+ *****************************************************************************
+ * Copyright (C) 2016 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/*****************************************************************************
+ * Preamble:
+ *
+ * Every output sample is the inner product of the last input samples with
+ * one phase of a Kaiser-windowed sinc low-pass filter. For a given ratio
+ * reduced to out/in, the output positions only fall on out distinct phases:
+ * when out is small enough, as with all the usual sampling rates, one row
+ * of coefficients is precomputed per phase. Otherwise (e.g. while the audio
+ * output adjusts the rate to compensate the clock drift) the coefficients
+ * are linearly interpolated between a fixed number of rows.
+ *
+ * The channels are deinterleaved into contiguous histories, so that the
+ * inner products run on SIMD registers.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <assert.h>
+#include <limits.h>
+#include <math.h>
+
+#include <vlc_common.h>
+#include <vlc_aout.h>
+#include <vlc_filter.h>
+#include <vlc_plugin.h>
+#include <vlc_cpu.h>
+
+#define QUALITY_TEXT N_("Resampling quality")
+#define QUALITY_LONGTEXT N_( \
+    "Resampling quality (0 = worst and fastest, 10 = best and slowest).")
+
+static int Open (vlc_object_t *);
+static int OpenResampler (vlc_object_t *);
+static void Close (vlc_object_t *);
+
+vlc_module_begin ()
+    set_shortname (N_("Polyphase resampler"))
+    set_description (N_("Polyphase FIR resampler"))
+    set_category (CAT_AUDIO)
+    set_subcategory (SUBCAT_AUDIO_RESAMPLER)
+    add_integer ("polyphase-resampler-quality", 4,
+                 QUALITY_TEXT, QUALITY_LONGTEXT, true)
+        change_integer_range (0, 10)
+    /* Preferred over the ugly, Speex and SoX resamplers: this is the default
+     * resampler unless libsamplerate is available */
+    set_capability ("audio converter", 10)
+    set_callbacks (Open, Close)
+
+    add_submodule ()
+    set_capability ("audio resampler", 10)
+    set_callbacks (OpenResampler, Close)
+    add_shortcut ("polyphase")
+vlc_module_end ()
+
+/* Filter length, cut-off frequency relative to the Nyquist frequency of the
+ * lowest rate, and Kaiser window shape for each quality level */
+static const struct
+{
+    unsigned taps;
+    float    cutoff;
+    float    beta;
+} qualities[] = {
+    {   8, 0.830f,  5.f },
+    {  16, 0.850f,  6.f },
+    {  32, 0.882f,  7.f },
+    {  48, 0.895f,  8.f },
+    {  64, 0.921f,  8.5f },
+    {  80, 0.922f,  9.f },
+    {  96, 0.940f,  9.5f },
+    { 128, 0.950f, 10.f },
+    { 160, 0.960f, 11.f },
+    { 192, 0.968f, 12.f },
+    { 256, 0.975f, 13.f },
+};
+
+#define BANKS_MAX        4
+#define BANK_SIZE_MAX    65536 /* coefficients in one bank of exact phases */
+#define INTERP_PHASES    256   /* rows of the interpolated banks */
+
+typedef float (*dot_t) (const float *, const float *, unsigned);
+
+/* Coefficients for one ratio */
+typedef struct
+{
+    float    *rows;      /* phases (+ 1 if interpolated) rows of taps */
+    float    *deltas;    /* difference with the next row, if interpolated */
+    unsigned  phases;    /* row p is for the phase p / phases */
+    bool      interp;
+    float     cutoff;
+    unsigned  used;      /* last use, for replacement */
+} bank_t;
+
+struct filter_sys_t
+{
+    unsigned  taps;
+    float     cutoff;
+    float     beta;
+    dot_t     dot;
+
+    bank_t    banks[BANKS_MAX];
+    bank_t   *bank;
+    unsigned  uses;
+
+    /* Current ratio, reduced: an output sample every in / out input */
+    unsigned  in_rate, out_rate;
+    unsigned  den;       /* out_rate / gcd */
+    unsigned  step;      /* in_rate / gcd */
+
+    /* Position of the next output: history index + phase / den */
+    unsigned  index;
+    unsigned  phase;
+
+    float    *history;   /* one contiguous history per channel */
+    size_t    history_size; /* per channel, allocated */
+    size_t    history_len;  /* per channel, filled */
+    unsigned  channels;
+};
+
+/*****************************************************************************
+ * Inner products
+ *****************************************************************************/
+static float DotC (const float *x, const float *h, unsigned n)
+{
+    float a0 = 0.f, a1 = 0.f, a2 = 0.f, a3 = 0.f;
+
+    /* The number of taps is a multiple of 8 */
+    for (unsigned i = 0; i < n; i += 4)
+    {
+        a0 += x[i] * h[i];
+        a1 += x[i + 1] * h[i + 1];
+        a2 += x[i + 2] * h[i + 2];
+        a3 += x[i + 3] * h[i + 3];
+    }
+    return (a0 + a1) + (a2 + a3);
+}
+
+#if defined(__x86_64__) && (VLC_GCC_VERSION(4, 9) || defined(__clang__))
+# define POLYPHASE_X86 1
+# include <immintrin.h>
+
+__attribute__ ((__target__ ("sse")))
+static float DotSSE (const float *x, const float *h, unsigned n)
+{
+    __m128 a = _mm_setzero_ps (), b = _mm_setzero_ps ();
+
+    for (unsigned i = 0; i < n; i += 8)
+    {
+        a = _mm_add_ps (a, _mm_mul_ps (_mm_loadu_ps (x + i),
+                                       _mm_loadu_ps (h + i)));
+        b = _mm_add_ps (b, _mm_mul_ps (_mm_loadu_ps (x + i + 4),
+                                       _mm_loadu_ps (h + i + 4)));
+    }
+    a = _mm_add_ps (a, b);
+    a = _mm_add_ps (a, _mm_movehl_ps (a, a));
+    a = _mm_add_ss (a, _mm_shuffle_ps (a, a, 1));
+    return _mm_cvtss_f32 (a);
+}
+
+__attribute__ ((__target__ ("avx")))
+static float DotAVX (const float *x, const float *h, unsigned n)
+{
+    __m256 a = _mm256_setzero_ps ();
+    unsigned i = 0;
+
+    if (n & 8)
+    {
+        a = _mm256_mul_ps (_mm256_loadu_ps (x), _mm256_loadu_ps (h));
+        i = 8;
+    }
+
+    __m256 b = _mm256_setzero_ps ();
+    for (; i < n; i += 16)
+    {
+        a = _mm256_add_ps (a, _mm256_mul_ps (_mm256_loadu_ps (x + i),
+                                             _mm256_loadu_ps (h + i)));
+        b = _mm256_add_ps (b, _mm256_mul_ps (_mm256_loadu_ps (x + i + 8),
+                                             _mm256_loadu_ps (h + i + 8)));
+    }
+    a = _mm256_add_ps (a, b);
+
+    __m128 s = _mm_add_ps (_mm256_castps256_ps128 (a),
+                           _mm256_extractf128_ps (a, 1));
+    s = _mm_add_ps (s, _mm_movehl_ps (s, s));
+    s = _mm_add_ss (s, _mm_shuffle_ps (s, s, 1));
+    return _mm_cvtss_f32 (s);
+}
+#endif
+
+#if defined(__aarch64__) || defined(__ARM_NEON__)
+# define POLYPHASE_NEON 1
+# include <arm_neon.h>
+
+static float DotNEON (const float *x, const float *h, unsigned n)
+{
+    float32x4_t a = vdupq_n_f32 (0.f), b = vdupq_n_f32 (0.f);
+
+    for (unsigned i = 0; i < n; i += 8)
+    {
+        a = vmlaq_f32 (a, vld1q_f32 (x + i), vld1q_f32 (h + i));
+        b = vmlaq_f32 (b, vld1q_f32 (x + i + 4), vld1q_f32 (h + i + 4));
+    }
+    a = vaddq_f32 (a, b);
+
+    float32x2_t s = vadd_f32 (vget_low_f32 (a), vget_high_f32 (a));
+    return vget_lane_f32 (vpadd_f32 (s, s), 0);
+}
+#endif
+
+static dot_t SelectDot (void)
+{
+#ifdef POLYPHASE_X86
+    if (vlc_CPU_AVX ())
+        return DotAVX;
+    if (vlc_CPU_SSE ())
+        return DotSSE;
+#endif
+#ifdef POLYPHASE_NEON
+    return DotNEON;
+#else
+    return DotC;
+#endif
+}
+
+/*****************************************************************************
+ * Coefficient banks
+ *****************************************************************************/
+static double BesselI0 (double x)
+{
+    double sum = 1., term = 1.;
+
+    for (unsigned k = 1; term > sum * 1e-12; k++)
+    {
+        term *= (x * x) / (4. * k * k);
+        sum += term;
+    }
+    return sum;
+}
+
+/* Taps for an output at the given phase (0 <= phase <= 1) after the middle
+ * of the history window, normalized for unity gain at DC */
+static void DesignRow (const filter_sys_t *sys, float cutoff, double phase,
+                       float *row)
+{
+    const double half = sys->taps / 2;
+    const double norm = BesselI0 (sys->beta);
+    double sum = 0.;
+
+    for (unsigned k = 0; k < sys->taps; k++)
+    {
+        const double x = k - (half - 1.) - phase;
+        const double r = x / half;
+        double v = cutoff;
+
+        if (x != 0.)
+            v = sin (M_PI * cutoff * x) / (M_PI * x);
+        v *= (r * r < 1.) ? BesselI0 (sys->beta * sqrt (1. - r * r)) / norm
+                          : 0.;
+        row[k] = v;
+        sum += v;
+    }
+    for (unsigned k = 0; k < sys->taps; k++)
+        row[k] /= sum;
+}
+
+static void BankClean (bank_t *bank)
+{
+    vlc_free (bank->rows);
+    vlc_free (bank->deltas);
+    bank->rows = bank->deltas = NULL;
+}
+
+static int BankInit (const filter_sys_t *sys, bank_t *bank, unsigned den,
+                     float cutoff)
+{
+    const unsigned taps = sys->taps;
+
+    bank->interp = (size_t)den * taps > BANK_SIZE_MAX;
+    bank->phases = bank->interp ? INTERP_PHASES : den;
+    bank->cutoff = cutoff;
+
+    const unsigned rows = bank->phases + bank->interp;
+
+    bank->rows = vlc_memalign (32, rows * taps * sizeof (float));
+    bank->deltas = bank->interp
+                 ? vlc_memalign (32, bank->phases * taps * sizeof (float))
+                 : NULL;
+    if (unlikely(bank->rows == NULL || (bank->interp && bank->deltas == NULL)))
+    {
+        BankClean (bank);
+        return VLC_ENOMEM;
+    }
+
+    for (unsigned p = 0; p < rows; p++)
+        DesignRow (sys, cutoff, (double)p / bank->phases,
+                   bank->rows + p * taps);
+
+    if (bank->interp)
+        for (unsigned i = 0; i < bank->phases * taps; i++)
+            bank->deltas[i] = bank->rows[i + taps] - bank->rows[i];
+    return VLC_SUCCESS;
+}
+
+/* Returns the bank for the reduced ratio, from the cache if possible */
+static bank_t *BankGet (filter_sys_t *sys, unsigned den, float cutoff)
+{
+    const bool interp = (size_t)den * sys->taps > BANK_SIZE_MAX;
+    bank_t *bank = NULL;
+
+    for (unsigned i = 0; i < BANKS_MAX; i++)
+    {
+        bank_t *b = &sys->banks[i];
+
+        if (b->rows != NULL && b->interp == interp
+         && (interp || b->phases == den)
+         && fabsf (b->cutoff - cutoff) <= 1e-3f * cutoff)
+        {
+            bank = b;
+            break;
+        }
+    }
+
+    if (bank == NULL)
+    {
+        /* Replace the least recently used bank */
+        bank = &sys->banks[0];
+        for (unsigned i = 1; i < BANKS_MAX; i++)
+            if (sys->banks[i].used < bank->used)
+                bank = &sys->banks[i];
+
+        BankClean (bank);
+        if (BankInit (sys, bank, den, cutoff))
+            return NULL;
+    }
+    bank->used = ++sys->uses;
+    return bank;
+}
+
+static unsigned gcd (unsigned a, unsigned b)
+{
+    while (b != 0)
+    {
+        unsigned c = a % b;
+        a = b;
+        b = c;
+    }
+    return a;
+}
+
+static int SetRatio (filter_sys_t *sys, unsigned in_rate, unsigned out_rate)
+{
+    const unsigned g = gcd (in_rate, out_rate);
+    const unsigned den = out_rate / g;
+    float cutoff = sys->cutoff;
+
+    if (out_rate < in_rate)
+        cutoff = cutoff * out_rate / in_rate;
+
+    bank_t *bank = BankGet (sys, den, cutoff);
+    if (unlikely(bank == NULL))
+        return VLC_ENOMEM;
+
+    /* Keep the current position with the new denominator */
+    if (sys->den != 0)
+        sys->phase = (uint64_t)sys->phase * den / sys->den;
+    sys->bank = bank;
+    sys->den = den;
+    sys->step = in_rate / g;
+    sys->in_rate = in_rate;
+    sys->out_rate = out_rate;
+    return VLC_SUCCESS;
+}
+
+/*****************************************************************************
+ * Processing
+ *****************************************************************************/
+static void Reset (filter_sys_t *sys)
+{
+    /* The first output is centered on the first input sample */
+    sys->history_len = sys->taps / 2 - 1;
+    for (unsigned c = 0; c < sys->channels; c++)
+        memset (sys->history + c * sys->history_size, 0,
+                sys->history_len * sizeof (float));
+    sys->index = 0;
+    sys->phase = 0;
+}
+
+static int Append (filter_sys_t *sys, const block_t *in, vlc_fourcc_t fmt)
+{
+    const unsigned channels = sys->channels;
+    const size_t needed = sys->history_len + in->i_nb_samples;
+
+    if (needed > sys->history_size)
+    {
+        const size_t size = needed + needed / 2;
+        float *history = malloc (channels * size * sizeof (float));
+        if (unlikely(history == NULL))
+            return VLC_ENOMEM;
+
+        for (unsigned c = 0; c < channels; c++)
+            memcpy (history + c * size, sys->history + c * sys->history_size,
+                    sys->history_len * sizeof (float));
+        free (sys->history);
+        sys->history = history;
+        sys->history_size = size;
+    }
+
+    for (unsigned c = 0; c < channels; c++)
+    {
+        float *h = sys->history + c * sys->history_size + sys->history_len;
+
+        if (fmt == VLC_CODEC_FL32)
+        {
+            const float *p = (const float *)in->p_buffer + c;
+            for (unsigned i = 0; i < in->i_nb_samples; i++)
+                h[i] = p[i * channels];
+        }
+        else
+        {
+            const int16_t *p = (const int16_t *)in->p_buffer + c;
+            for (unsigned i = 0; i < in->i_nb_samples; i++)
+                h[i] = p[i * channels] * (1.f / 32768.f);
+        }
+    }
+    sys->history_len = needed;
+    return VLC_SUCCESS;
+}
+
+static float Output (const filter_sys_t *sys, const float *x, unsigned phase)
+{
+    const bank_t *bank = sys->bank;
+    const unsigned taps = sys->taps;
+
+    if (!bank->interp)
+        return sys->dot (x, bank->rows + phase * taps, taps);
+
+    const uint64_t pos = (uint64_t)phase * INTERP_PHASES;
+    const unsigned row = pos / sys->den;
+    const float frac = (float)(pos % sys->den) / sys->den;
+
+    return sys->dot (x, bank->rows + row * taps, taps)
+         + frac * sys->dot (x, bank->deltas + row * taps, taps);
+}
+
+static block_t *Resample (filter_t *filter, block_t *in)
+{
+    filter_sys_t *sys = filter->p_sys;
+    const vlc_fourcc_t fmt = filter->fmt_in.audio.i_format;
+    const unsigned channels = sys->channels;
+    const unsigned taps = sys->taps;
+    block_t *out = NULL;
+
+    if (in->i_flags & BLOCK_FLAG_DISCONTINUITY)
+        Reset (sys);
+
+    if ((filter->fmt_in.audio.i_rate != sys->in_rate
+      || filter->fmt_out.audio.i_rate != sys->out_rate)
+     && SetRatio (sys, filter->fmt_in.audio.i_rate,
+                  filter->fmt_out.audio.i_rate))
+        goto error;
+
+    if (Append (sys, in, fmt))
+        goto error;
+
+    /* Outputs k such that index + (phase + k * step) / den + taps <= len */
+    size_t count = 0;
+    if (sys->index + taps <= sys->history_len)
+    {
+        const uint64_t last = sys->history_len - taps - sys->index;
+        count = ((last + 1) * sys->den - sys->phase + sys->step - 1)
+              / sys->step;
+    }
+
+    const size_t framesize = filter->fmt_out.audio.i_bytes_per_frame;
+    out = block_Alloc (count * framesize);
+    if (unlikely(out == NULL))
+        goto error;
+
+    const unsigned whole = sys->step / sys->den;
+    const unsigned frac = sys->step % sys->den;
+
+    for (unsigned c = 0; c < channels; c++)
+    {
+        const float *x = sys->history + c * sys->history_size + sys->index;
+        unsigned phase = sys->phase;
+
+        if (fmt == VLC_CODEC_FL32)
+        {
+            float *p = (float *)out->p_buffer + c;
+
+            for (size_t k = 0; k < count; k++)
+            {
+                p[k * channels] = Output (sys, x, phase);
+                x += whole;
+                phase += frac;
+                if (phase >= sys->den)
+                {
+                    phase -= sys->den;
+                    x++;
+                }
+            }
+        }
+        else
+        {
+            int16_t *p = (int16_t *)out->p_buffer + c;
+
+            for (size_t k = 0; k < count; k++)
+            {
+                long v = lroundf (Output (sys, x, phase) * 32768.f);
+                p[k * channels] = VLC_CLIP (v, INT16_MIN, INT16_MAX);
+                x += whole;
+                phase += frac;
+                if (phase >= sys->den)
+                {
+                    phase -= sys->den;
+                    x++;
+                }
+            }
+        }
+    }
+
+    /* Advance, and drop the input samples that will not be used anymore */
+    const uint64_t pos = sys->phase + (uint64_t)count * sys->step;
+    sys->index += pos / sys->den;
+    sys->phase = pos % sys->den;
+    if (sys->index > 0)
+    {
+        const size_t drop = __MIN(sys->index, sys->history_len);
+
+        for (unsigned c = 0; c < channels; c++)
+        {
+            float *h = sys->history + c * sys->history_size;
+            memmove (h, h + drop, (sys->history_len - drop) * sizeof (float));
+        }
+        sys->history_len -= drop;
+        sys->index -= drop;
+    }
+
+    out->i_nb_samples = count;
+    out->i_pts = in->i_pts;
+    out->i_length = count * CLOCK_FREQ / filter->fmt_out.audio.i_rate;
+error:
+    block_Release (in);
+    return out;
+}
+
+static void Flush (filter_t *filter)
+{
+    Reset (filter->p_sys);
+}
+
+/*****************************************************************************
+ * Open/Close
+ *****************************************************************************/
+static int OpenResampler (vlc_object_t *obj)
+{
+    filter_t *filter = (filter_t *)obj;
+
+    /* Cannot convert format */
+    if (filter->fmt_in.audio.i_format != filter->fmt_out.audio.i_format
+    /* Cannot remix */
+     || filter->fmt_in.audio.i_physical_channels
+                                  != filter->fmt_out.audio.i_physical_channels
+     || filter->fmt_in.audio.i_original_channels
+                                  != filter->fmt_out.audio.i_original_channels)
+        return VLC_EGENERIC;
+
+    switch (filter->fmt_in.audio.i_format)
+    {
+        case VLC_CODEC_FL32: break;
+        case VLC_CODEC_S16N: break;
+        default:             return VLC_EGENERIC;
+    }
+
+    filter_sys_t *sys = calloc (1, sizeof (*sys));
+    if (unlikely(sys == NULL))
+        return VLC_ENOMEM;
+
+    unsigned q = var_InheritInteger (obj, "polyphase-resampler-quality");
+    if (unlikely(q >= ARRAY_SIZE(qualities)))
+        q = 4;
+
+    sys->taps = qualities[q].taps;
+    sys->cutoff = qualities[q].cutoff;
+    sys->beta = qualities[q].beta;
+    sys->dot = SelectDot ();
+    sys->channels = aout_FormatNbChannels (&filter->fmt_in.audio);
+    sys->history_size = sys->taps + 4096;
+    sys->history = malloc (sys->channels * sys->history_size
+                           * sizeof (float));
+    if (unlikely(sys->history == NULL)
+     || SetRatio (sys, filter->fmt_in.audio.i_rate,
+                  filter->fmt_out.audio.i_rate))
+    {
+        free (sys->history);
+        free (sys);
+        return VLC_ENOMEM;
+    }
+    Reset (sys);
+
+    msg_Dbg (obj, "%u taps, %u/%u phases", sys->taps, sys->bank->phases,
+             sys->den);
+
+    filter->p_sys = sys;
+    filter->pf_audio_filter = Resample;
+    filter->pf_flush = Flush;
+    return VLC_SUCCESS;
+}
+
+static int Open (vlc_object_t *obj)
+{
+    filter_t *filter = (filter_t *)obj;
+
+    /* Will change rate */
+    if (filter->fmt_in.audio.i_rate == filter->fmt_out.audio.i_rate)
+        return VLC_EGENERIC;
+    return OpenResampler (obj);
+}
+
+static void Close (vlc_object_t *obj)
+{
+    filter_t *filter = (filter_t *)obj;
+    filter_sys_t *sys = filter->p_sys;
+
+    for (unsigned i = 0; i < BANKS_MAX; i++)
+        BankClean (&sys->banks[i]);
+    free (sys->history);
+    free (sys);
+}
@@ -32,9 +32,11 @@
 #include <vlc_plugin.h>
 #include <vlc_aout.h>
 #include <vlc_filter.h>
+#include <vlc_cpu.h>
 
 #include <string.h> /* for memset */
 #include <limits.h> /* form INT_MIN */
+#include <math.h>
 
 /*****************************************************************************
  * Module descriptor
@@ -43,6 +45,10 @@ static int  Open( vlc_object_t * );
 static void Close( vlc_object_t * );
 static block_t *DoWork( filter_t *, block_t * );
 
+static const char *const ppsz_search_modes[] = { "full", "coarse" };
+static const char *const ppsz_search_modes_text[] = {
+    N_("Exhaustive"), N_("Coarse to fine") };
+
 vlc_module_begin ()
     set_description( N_("Audio tempo scaler synched with rate") )
     set_shortname( N_("Scaletempo") )
@@ -56,6 +62,9 @@ vlc_module_begin ()
         N_("Overlap Length"), N_("Percentage of stride to overlap"), true )
     add_integer_with_range( "scaletempo-search", 14, 0, 200,
         N_("Search Length"), N_("Length in milliseconds to search for best overlap position"), true )
+    add_string( "scaletempo-search-mode", "full",
+        N_("Search Mode"), N_("Exhaustive search correlates every position at full resolution. Coarse to fine search correlates a decimated mono downmix first, then refines its best peaks at full resolution: it is faster, but may miss the best overlap of high pitched sounds."), true )
+        change_string_list( ppsz_search_modes, ppsz_search_modes_text )
 
     set_callbacks( Open, Close )
 vlc_module_end ()
@@ -71,11 +80,21 @@ vlc_module_end ()
  * for the best overlap position.  Scaletempo uses a statistical cross correlation
  * (roughly a dot-product).  Scaletempo consumes most of its CPU cycles here.
  *
+ * In coarse to fine mode, the overlap and the search window are first downmixed
+ * to mono and decimated by summing blocks of frames, the decimated correlation
+ * selects its best peaks, and only their neighbourhoods are correlated at
+ * full resolution.
+ *
  * NOTE:
  * sample: a single audio sample for one channel
  * frame: a single set of samples, one for each channel
  * VLC uses these terms differently
  */
+/* coarse to fine search: number of peaks of the decimated correlation ranked
+ * at full resolution, and number of the best of them refined */
+#define COARSE_PEAKS      64
+#define COARSE_CANDIDATES 8
+
 struct filter_sys_t
 {
     /* Filter static config */
@@ -111,18 +130,151 @@ struct filter_sys_t
     void     *buf_pre_corr;
     void     *table_window;
     unsigned(*best_overlap_offset)( filter_t *p_filter );
+    float   (*dot)( const float *, const float *, unsigned );
+    /* coarse to fine search */
+    bool      b_coarse;
+    unsigned  coarse_factor;    /* frames summed per coarse sample */
+    unsigned  coarse_overlap;   /* coarse samples correlated */
+    unsigned  coarse_search;    /* coarse offsets searched */
+    float    *buf_coarse_pre_corr;
+    float    *buf_coarse_queue;
 };
 
+/*****************************************************************************
+ * dot: inner products for the cross correlation
+ *****************************************************************************/
+static float dot_c( const float *a, const float *b, unsigned n )
+{
+    float s0 = 0.f, s1 = 0.f, s2 = 0.f, s3 = 0.f;
+    unsigned i = 0;
+
+    for( ; i + 4 <= n; i += 4 ) {
+        s0 += a[i]     * b[i];
+        s1 += a[i + 1] * b[i + 1];
+        s2 += a[i + 2] * b[i + 2];
+        s3 += a[i + 3] * b[i + 3];
+    }
+    for( ; i < n; i++ )
+        s0 += a[i] * b[i];
+    return ( s0 + s1 ) + ( s2 + s3 );
+}
+
+#if defined(__x86_64__) && (VLC_GCC_VERSION(4, 9) || defined(__clang__))
+# define SCALETEMPO_X86 1
+# include <immintrin.h>
+
+__attribute__ ((__target__ ("sse")))
+static float dot_sse( const float *a, const float *b, unsigned n )
+{
+    __m128 s0 = _mm_setzero_ps(), s1 = _mm_setzero_ps();
+    unsigned i = 0;
+
+    for( ; i + 8 <= n; i += 8 ) {
+        s0 = _mm_add_ps( s0, _mm_mul_ps( _mm_loadu_ps( a + i ),
+                                         _mm_loadu_ps( b + i ) ) );
+        s1 = _mm_add_ps( s1, _mm_mul_ps( _mm_loadu_ps( a + i + 4 ),
+                                         _mm_loadu_ps( b + i + 4 ) ) );
+    }
+    if( i + 4 <= n ) {
+        s0 = _mm_add_ps( s0, _mm_mul_ps( _mm_loadu_ps( a + i ),
+                                         _mm_loadu_ps( b + i ) ) );
+        i += 4;
+    }
+    s0 = _mm_add_ps( s0, s1 );
+    s0 = _mm_add_ps( s0, _mm_movehl_ps( s0, s0 ) );
+    s0 = _mm_add_ss( s0, _mm_shuffle_ps( s0, s0, 1 ) );
+
+    float sum = _mm_cvtss_f32( s0 );
+    for( ; i < n; i++ )
+        sum += a[i] * b[i];
+    return sum;
+}
+
+__attribute__ ((__target__ ("avx")))
+static float dot_avx( const float *a, const float *b, unsigned n )
+{
+    __m256 s0 = _mm256_setzero_ps(), s1 = _mm256_setzero_ps();
+    unsigned i = 0;
+
+    for( ; i + 16 <= n; i += 16 ) {
+        s0 = _mm256_add_ps( s0, _mm256_mul_ps( _mm256_loadu_ps( a + i ),
+                                               _mm256_loadu_ps( b + i ) ) );
+        s1 = _mm256_add_ps( s1, _mm256_mul_ps( _mm256_loadu_ps( a + i + 8 ),
+                                               _mm256_loadu_ps( b + i + 8 ) ) );
+    }
+    if( i + 8 <= n ) {
+        s0 = _mm256_add_ps( s0, _mm256_mul_ps( _mm256_loadu_ps( a + i ),
+                                               _mm256_loadu_ps( b + i ) ) );
+        i += 8;
+    }
+    s0 = _mm256_add_ps( s0, s1 );
+
+    __m128 s = _mm_add_ps( _mm256_castps256_ps128( s0 ),
+                           _mm256_extractf128_ps( s0, 1 ) );
+    if( i + 4 <= n ) {
+        s = _mm_add_ps( s, _mm_mul_ps( _mm_loadu_ps( a + i ),
+                                       _mm_loadu_ps( b + i ) ) );
+        i += 4;
+    }
+    s = _mm_add_ps( s, _mm_movehl_ps( s, s ) );
+    s = _mm_add_ss( s, _mm_shuffle_ps( s, s, 1 ) );
+
+    float sum = _mm_cvtss_f32( s );
+    for( ; i < n; i++ )
+        sum += a[i] * b[i];
+    return sum;
+}
+#endif /* SCALETEMPO_X86 */
+
+#if defined(__aarch64__) || defined(__ARM_NEON__)
+# define SCALETEMPO_NEON 1
+# include <arm_neon.h>
+
+static float dot_neon( const float *a, const float *b, unsigned n )
+{
+    float32x4_t s0 = vdupq_n_f32( 0.f ), s1 = vdupq_n_f32( 0.f );
+    unsigned i = 0;
+
+    for( ; i + 8 <= n; i += 8 ) {
+        s0 = vmlaq_f32( s0, vld1q_f32( a + i ), vld1q_f32( b + i ) );
+        s1 = vmlaq_f32( s1, vld1q_f32( a + i + 4 ), vld1q_f32( b + i + 4 ) );
+    }
+    if( i + 4 <= n ) {
+        s0 = vmlaq_f32( s0, vld1q_f32( a + i ), vld1q_f32( b + i ) );
+        i += 4;
+    }
+    s0 = vaddq_f32( s0, s1 );
+
+    float32x2_t s = vadd_f32( vget_low_f32( s0 ), vget_high_f32( s0 ) );
+    float sum = vget_lane_f32( vpadd_f32( s, s ), 0 );
+    for( ; i < n; i++ )
+        sum += a[i] * b[i];
+    return sum;
+}
+#endif /* SCALETEMPO_NEON */
+
+static float (*select_dot( void ))( const float *, const float *, unsigned )
+{
+#ifdef SCALETEMPO_X86
+    if( vlc_CPU_AVX() )
+        return dot_avx;
+    if( vlc_CPU_SSE() )
+        return dot_sse;
+#endif
+#ifdef SCALETEMPO_NEON
+    return dot_neon;
+#else
+    return dot_c;
+#endif
+}
+
 /*****************************************************************************
  * best_overlap_offset: calculate best offset for overlap
  *****************************************************************************/
-static unsigned best_overlap_offset_float( filter_t *p_filter )
+static void pre_correlate( filter_sys_t *p )
 {
-    filter_sys_t *p = p_filter->p_sys;
-    float *pw, *po, *ppc, *search_start;
-    float best_corr = INT_MIN;
-    unsigned best_off = 0;
-    unsigned i, off;
+    float *pw, *po, *ppc;
+    unsigned i;
 
     pw  = p->table_window;
     po  = p->buf_overlap;
@@ -131,21 +283,137 @@ static unsigned best_overlap_offset_float( filter_t *p_filter )
     for( i = p->samples_per_frame; i < p->samples_overlap; i++ ) {
       *ppc++ = *pw++ * *po++;
     }
+}
 
-    search_start = (float *)p->buf_queue + p->samples_per_frame;
-    for( off = 0; off < p->frames_search; off++ ) {
-      float corr = 0;
-      float *ps = search_start;
-      ppc = p->buf_pre_corr;
-      for( i = p->samples_per_frame; i < p->samples_overlap; i++ ) {
-        corr += *ppc++ * *ps++;
-      }
-      if( corr > best_corr ) {
-        best_corr = corr;
-        best_off  = off;
+/* Correlates the offsets [off, off_end[ at full resolution */
+static void search_range( filter_sys_t *p, unsigned off, unsigned off_end,
+                          float *best_corr, unsigned *best_off )
+{
+    const unsigned samples_corr = p->samples_overlap - p->samples_per_frame;
+    const float *search_start = (float *)p->buf_queue
+                              + ( off + 1 ) * p->samples_per_frame;
+
+    for( ; off < off_end; off++ ) {
+      float corr = p->dot( p->buf_pre_corr, search_start, samples_corr );
+      if( corr > *best_corr ) {
+        *best_corr = corr;
+        *best_off  = off;
       }
       search_start += p->samples_per_frame;
     }
+}
+
+static unsigned best_overlap_offset_float( filter_t *p_filter )
+{
+    filter_sys_t *p = p_filter->p_sys;
+    float best_corr = INT_MIN;
+    unsigned best_off = 0;
+
+    pre_correlate( p );
+    search_range( p, 0, p->frames_search, &best_corr, &best_off );
+
+    return best_off * p->bytes_per_frame;
+}
+
+/* Downmixes and decimates: each output sample is the sum of all the samples of
+ * factor frames */
+static void coarse_sum( float *dst, const float *src, unsigned count,
+                        unsigned samples_per_frame, unsigned factor )
+{
+    const unsigned n = samples_per_frame * factor;
+
+    for( unsigned k = 0; k < count; k++ ) {
+        float sum = 0.f;
+        for( unsigned i = 0; i < n; i++ )
+            sum += src[i];
+        dst[k] = sum;
+        src += n;
+    }
+}
+
+/* Inserts a peak in a list of count peaks, sorted by decreasing correlation */
+static void add_peak( float *peak_corr, unsigned *peak, unsigned count,
+                      float corr, unsigned off )
+{
+    unsigned i = count;
+    if( corr <= peak_corr[i - 1] )
+        return;
+    while( i > 1 && corr > peak_corr[i - 2] ) {
+      peak_corr[i - 1] = peak_corr[i - 2];
+      peak[i - 1]      = peak[i - 2];
+      i--;
+    }
+    peak_corr[i - 1] = corr;
+    peak[i - 1]      = off;
+}
+
+static unsigned best_overlap_offset_coarse( filter_t *p_filter )
+{
+    filter_sys_t *p = p_filter->p_sys;
+    const unsigned factor = p->coarse_factor;
+    const unsigned samples_corr = p->samples_overlap - p->samples_per_frame;
+    float peak_corr[COARSE_PEAKS], cand_corr[COARSE_CANDIDATES];
+    unsigned peak[COARSE_PEAKS], cand[COARSE_CANDIDATES];
+
+    for( unsigned i = 0; i < COARSE_PEAKS; i++ ) {
+      peak_corr[i] = INT_MIN;
+      peak[i]      = UINT_MAX;
+    }
+    for( unsigned i = 0; i < COARSE_CANDIDATES; i++ ) {
+      cand_corr[i] = INT_MIN;
+      cand[i]      = UINT_MAX;
+    }
+
+    pre_correlate( p );
+    coarse_sum( p->buf_coarse_pre_corr, p->buf_pre_corr, p->coarse_overlap,
+                p->samples_per_frame, factor );
+    coarse_sum( p->buf_coarse_queue,
+                (float *)p->buf_queue + p->samples_per_frame,
+                p->coarse_search + p->coarse_overlap - 1,
+                p->samples_per_frame, factor );
+
+    /* keep the best peaks of the coarse correlation, with their position and
+     * height interpolated by a parabola: the coarse grid may sample them far
+     * from their top */
+    float prev = INT_MIN, cur = INT_MIN;
+    for( unsigned m = 0; m <= p->coarse_search; m++ ) {
+      float next = INT_MIN;
+      if( m < p->coarse_search )
+        next = p->dot( p->buf_coarse_pre_corr, p->buf_coarse_queue + m,
+                       p->coarse_overlap );
+      if( m > 0 && cur >= prev && cur > next ) {
+        float height = cur, center = m - 1;
+        float curv = prev - 2.f * cur + next;
+        if( m > 1 && m < p->coarse_search && curv < 0.f ) {
+          height -= ( prev - next ) * ( prev - next ) / ( 8.f * curv );
+          center += .5f * ( prev - next ) / curv;
+        }
+        add_peak( peak_corr, peak, COARSE_PEAKS, height,
+                  __MIN( lroundf( center * factor + .5f * ( factor - 1 ) ),
+                         p->frames_search - 1 ) );
+      }
+      prev = cur;
+      cur  = next;
+    }
+
+    /* periodic signals have many peaks of about the same height, which the
+     * coarse correlation cannot rank: rank them at full resolution */
+    for( unsigned i = 0; i < COARSE_PEAKS && peak[i] != UINT_MAX; i++ ) {
+      const float *ps = (float *)p->buf_queue
+                      + ( peak[i] + 1 ) * p->samples_per_frame;
+      add_peak( cand_corr, cand, COARSE_CANDIDATES,
+                p->dot( p->buf_pre_corr, ps, samples_corr ), peak[i] );
+    }
+
+    /* and refine around the best ones */
+    const unsigned radius = factor / 2;
+    float best_corr = INT_MIN;
+    unsigned best_off = 0;
+    for( unsigned i = 0; i < COARSE_CANDIDATES && cand[i] != UINT_MAX; i++ ) {
+      unsigned off = cand[i] > radius ? cand[i] - radius : 0;
+      unsigned off_end = __MIN( cand[i] + radius + 1, p->frames_search );
+      search_range( p, off, off_end, &best_corr, &best_off );
+    }
 
     return best_off * p->bytes_per_frame;
 }
@@ -338,6 +606,23 @@ static int reinit_buffers( filter_t *p_filter )
                 *pw++ = v;
         }
         p->best_overlap_offset = best_overlap_offset_float;
+
+        /* decimate down to about 11 kHz, if there is enough to correlate */
+        unsigned factor = p->sample_rate / 11025;
+        if( p->b_coarse && factor >= 2
+         && ( frames_overlap - 1 ) / factor >= 8
+         && p->frames_search >= 4 * factor )
+        {
+            p->coarse_factor  = factor;
+            p->coarse_overlap = ( frames_overlap - 1 ) / factor;
+            p->coarse_search  = ( p->frames_search + factor - 1 ) / factor;
+            p->buf_coarse_pre_corr = malloc( p->coarse_overlap * sizeof (float) );
+            p->buf_coarse_queue    = malloc( ( p->coarse_search + p->coarse_overlap )
+                                             * sizeof (float) );
+            if( ! p->buf_coarse_pre_corr || ! p->buf_coarse_queue )
+                return VLC_ENOMEM;
+            p->best_overlap_offset = best_overlap_offset_coarse;
+        }
     }
 
     unsigned new_size = ( p->frames_search + frames_stride + frames_overlap ) * p->bytes_per_frame;
@@ -367,13 +652,14 @@ static int reinit_buffers( filter_t *p_filter )
     p->frames_stride_scaled = p->bytes_stride_scaled / p->bytes_per_frame;
 
     msg_Dbg( VLC_OBJECT(p_filter),
-             "%.3f scale, %.3f stride_in, %i stride_out, %i standing, %i overlap, %i search, %i queue, %s mode",
+             "%.3f scale, %.3f stride_in, %i stride_out, %i standing, %i overlap, %i search (%s), %i queue, %s mode",
              p->scale,
              p->frames_stride_scaled,
              (int)( p->bytes_stride / p->bytes_per_frame ),
              (int)( p->bytes_standing / p->bytes_per_frame ),
              (int)( p->bytes_overlap / p->bytes_per_frame ),
              p->frames_search,
+             p->best_overlap_offset == best_overlap_offset_coarse ? "coarse" : "full",
              (int)( p->bytes_queue_max / p->bytes_per_frame ),
              "fl32");
 
@@ -411,11 +697,18 @@ static int Open( vlc_object_t *p_this )
     msg_Dbg( p_this, "params: %i stride, %.3f overlap, %i search",
              p_sys->ms_stride, p_sys->percent_overlap, p_sys->ms_search );
 
+    char *psz_mode = var_InheritString( p_this, "scaletempo-search-mode" );
+    p_sys->b_coarse = psz_mode != NULL && !strcmp( psz_mode, "coarse" );
+    free( psz_mode );
+    p_sys->dot = select_dot();
+
     p_sys->buf_queue      = NULL;
     p_sys->buf_overlap    = NULL;
     p_sys->table_blend    = NULL;
     p_sys->buf_pre_corr   = NULL;
     p_sys->table_window   = NULL;
+    p_sys->buf_coarse_pre_corr = NULL;
+    p_sys->buf_coarse_queue    = NULL;
     p_sys->bytes_overlap  = 0;
     p_sys->bytes_queued   = 0;
     p_sys->bytes_to_slide = 0;
@@ -442,6 +735,8 @@ static void Close( vlc_object_t *p_this )
     free( p_sys->table_blend );
     free( p_sys->buf_pre_corr );
     free( p_sys->table_window );
+    free( p_sys->buf_coarse_pre_corr );
+    free( p_sys->buf_coarse_queue );
     free( p_sys );
 }
 
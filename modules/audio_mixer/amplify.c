@@ -0,0 +1,310 @@
+/*****************************************************************************
+ * amplify.c: software volume kernels
+ *****************************************************************************
+ * Copyright (C) 2016 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <math.h>
+#include <limits.h>
+
+#include <vlc_common.h>
+#include <vlc_cpu.h>
+#include <vlc_block.h>
+
+#include "amplify.h"
+
+static inline int16_t ScaleS16(int16_t sample, int_fast32_t mult)
+{
+    int_fast32_t s = (sample * mult) >> 8;
+    if (s > INT16_MAX)
+        s = INT16_MAX;
+    else
+    if (s < INT16_MIN)
+        s = INT16_MIN;
+    return s;
+}
+
+void amplify_FL32_c(audio_volume_t *vol, block_t *block, float mult)
+{
+    if (mult == 1.f)
+        return; /* nothing to do */
+
+    float *p = (float *)block->p_buffer;
+    for (size_t n = block->i_buffer / sizeof (*p); n > 0; n--)
+        *(p++) *= mult;
+    (void) vol;
+}
+
+void amplify_FL64_c(audio_volume_t *vol, block_t *block, float volume)
+{
+    double *p = (double *)block->p_buffer;
+    double mult = volume;
+    if (mult == 1.)
+        return; /* nothing to do */
+
+    for (size_t n = block->i_buffer / sizeof (*p); n > 0; n--)
+        *(p++) *= mult;
+    (void) vol;
+}
+
+void amplify_S16N_c(audio_volume_t *vol, block_t *block, float volume)
+{
+    int16_t *p = (int16_t *)block->p_buffer;
+
+    int_fast16_t mult = lroundf(volume * 0x1.p8f);
+    if (mult == (1 << 8))
+        return;
+
+    for (size_t n = block->i_buffer / sizeof (*p); n > 0; n--, p++)
+        *p = ScaleS16(*p, mult);
+    (void) vol;
+}
+
+#ifdef AMPLIFY_X86
+# include <immintrin.h>
+
+__attribute__ ((__target__ ("sse")))
+void amplify_FL32_sse(audio_volume_t *vol, block_t *block, float mult)
+{
+    if (mult == 1.f)
+        return;
+
+    float *p = (float *)block->p_buffer;
+    size_t n = block->i_buffer / sizeof (*p);
+    const __m128 m = _mm_set1_ps(mult);
+
+    for (; n >= 8; n -= 8, p += 8) {
+        _mm_storeu_ps(p, _mm_mul_ps(_mm_loadu_ps(p), m));
+        _mm_storeu_ps(p + 4, _mm_mul_ps(_mm_loadu_ps(p + 4), m));
+    }
+    for (; n > 0; n--)
+        *(p++) *= mult;
+    (void) vol;
+}
+
+__attribute__ ((__target__ ("avx")))
+void amplify_FL32_avx(audio_volume_t *vol, block_t *block, float mult)
+{
+    if (mult == 1.f)
+        return;
+
+    float *p = (float *)block->p_buffer;
+    size_t n = block->i_buffer / sizeof (*p);
+    const __m256 m = _mm256_set1_ps(mult);
+
+    for (; n >= 16; n -= 16, p += 16) {
+        _mm256_storeu_ps(p, _mm256_mul_ps(_mm256_loadu_ps(p), m));
+        _mm256_storeu_ps(p + 8, _mm256_mul_ps(_mm256_loadu_ps(p + 8), m));
+    }
+    for (; n > 0; n--)
+        *(p++) *= mult;
+    (void) vol;
+}
+
+__attribute__ ((__target__ ("sse2")))
+void amplify_FL64_sse2(audio_volume_t *vol, block_t *block, float volume)
+{
+    const double mult = volume;
+    if (mult == 1.)
+        return;
+
+    double *p = (double *)block->p_buffer;
+    size_t n = block->i_buffer / sizeof (*p);
+    const __m128d m = _mm_set1_pd(mult);
+
+    for (; n >= 4; n -= 4, p += 4) {
+        _mm_storeu_pd(p, _mm_mul_pd(_mm_loadu_pd(p), m));
+        _mm_storeu_pd(p + 2, _mm_mul_pd(_mm_loadu_pd(p + 2), m));
+    }
+    for (; n > 0; n--)
+        *(p++) *= mult;
+    (void) vol;
+}
+
+__attribute__ ((__target__ ("avx")))
+void amplify_FL64_avx(audio_volume_t *vol, block_t *block, float volume)
+{
+    const double mult = volume;
+    if (mult == 1.)
+        return;
+
+    double *p = (double *)block->p_buffer;
+    size_t n = block->i_buffer / sizeof (*p);
+    const __m256d m = _mm256_set1_pd(mult);
+
+    for (; n >= 8; n -= 8, p += 8) {
+        _mm256_storeu_pd(p, _mm256_mul_pd(_mm256_loadu_pd(p), m));
+        _mm256_storeu_pd(p + 4, _mm256_mul_pd(_mm256_loadu_pd(p + 4), m));
+    }
+    for (; n > 0; n--)
+        *(p++) *= mult;
+    (void) vol;
+}
+
+/* The 32-bits products are rebuilt from their low and high halves, shifted,
+ * and packed back to 16-bits with signed saturation, which is the clipping
+ * of the C version. */
+__attribute__ ((__target__ ("sse2")))
+void amplify_S16N_sse2(audio_volume_t *vol, block_t *block, float volume)
+{
+    int_fast32_t mult = lroundf(volume * 0x1.p8f);
+    if (mult == (1 << 8))
+        return;
+    if (mult > INT16_MAX) {
+        amplify_S16N_c(vol, block, volume);
+        return;
+    }
+
+    int16_t *p = (int16_t *)block->p_buffer;
+    size_t n = block->i_buffer / sizeof (*p);
+    const __m128i m = _mm_set1_epi16(mult);
+
+    for (; n >= 8; n -= 8, p += 8) {
+        __m128i x = _mm_loadu_si128((__m128i *)p);
+        __m128i lo = _mm_mullo_epi16(x, m);
+        __m128i hi = _mm_mulhi_epi16(x, m);
+        __m128i a = _mm_srai_epi32(_mm_unpacklo_epi16(lo, hi), 8);
+        __m128i b = _mm_srai_epi32(_mm_unpackhi_epi16(lo, hi), 8);
+        _mm_storeu_si128((__m128i *)p, _mm_packs_epi32(a, b));
+    }
+    for (; n > 0; n--, p++)
+        *p = ScaleS16(*p, mult);
+    (void) vol;
+}
+
+__attribute__ ((__target__ ("avx2")))
+void amplify_S16N_avx2(audio_volume_t *vol, block_t *block, float volume)
+{
+    int_fast32_t mult = lroundf(volume * 0x1.p8f);
+    if (mult == (1 << 8))
+        return;
+    if (mult > INT16_MAX) {
+        amplify_S16N_c(vol, block, volume);
+        return;
+    }
+
+    int16_t *p = (int16_t *)block->p_buffer;
+    size_t n = block->i_buffer / sizeof (*p);
+    const __m256i m = _mm256_set1_epi16(mult);
+
+    /* unpack and pack both work within 128-bits lanes, so the samples
+     * stay in order */
+    for (; n >= 16; n -= 16, p += 16) {
+        __m256i x = _mm256_loadu_si256((__m256i *)p);
+        __m256i lo = _mm256_mullo_epi16(x, m);
+        __m256i hi = _mm256_mulhi_epi16(x, m);
+        __m256i a = _mm256_srai_epi32(_mm256_unpacklo_epi16(lo, hi), 8);
+        __m256i b = _mm256_srai_epi32(_mm256_unpackhi_epi16(lo, hi), 8);
+        _mm256_storeu_si256((__m256i *)p, _mm256_packs_epi32(a, b));
+    }
+    for (; n > 0; n--, p++)
+        *p = ScaleS16(*p, mult);
+    (void) vol;
+}
+#endif /* AMPLIFY_X86 */
+
+#ifdef AMPLIFY_NEON
+# include <arm_neon.h>
+
+void amplify_FL32_neon(audio_volume_t *vol, block_t *block, float mult)
+{
+    if (mult == 1.f)
+        return;
+
+    float *p = (float *)block->p_buffer;
+    size_t n = block->i_buffer / sizeof (*p);
+
+    for (; n >= 8; n -= 8, p += 8) {
+        vst1q_f32(p, vmulq_n_f32(vld1q_f32(p), mult));
+        vst1q_f32(p + 4, vmulq_n_f32(vld1q_f32(p + 4), mult));
+    }
+    for (; n > 0; n--)
+        *(p++) *= mult;
+    (void) vol;
+}
+
+/* vqshrn shifts and narrows with signed saturation, like the C clipping */
+void amplify_S16N_neon(audio_volume_t *vol, block_t *block, float volume)
+{
+    int_fast32_t mult = lroundf(volume * 0x1.p8f);
+    if (mult == (1 << 8))
+        return;
+    if (mult > INT16_MAX) {
+        amplify_S16N_c(vol, block, volume);
+        return;
+    }
+
+    int16_t *p = (int16_t *)block->p_buffer;
+    size_t n = block->i_buffer / sizeof (*p);
+    const int16x4_t m = vdup_n_s16(mult);
+
+    for (; n >= 8; n -= 8, p += 8) {
+        int16x8_t x = vld1q_s16(p);
+        int32x4_t a = vmull_s16(vget_low_s16(x), m);
+        int32x4_t b = vmull_s16(vget_high_s16(x), m);
+        vst1q_s16(p, vcombine_s16(vqshrn_n_s32(a, 8), vqshrn_n_s32(b, 8)));
+    }
+    for (; n > 0; n--, p++)
+        *p = ScaleS16(*p, mult);
+    (void) vol;
+}
+#endif /* AMPLIFY_NEON */
+
+amplify_t amplify_SelectFL32(void)
+{
+#ifdef AMPLIFY_X86
+    if (vlc_CPU_AVX())
+        return amplify_FL32_avx;
+    if (vlc_CPU_SSE())
+        return amplify_FL32_sse;
+#endif
+#ifdef AMPLIFY_NEON
+    return amplify_FL32_neon;
+#else
+    return amplify_FL32_c;
+#endif
+}
+
+amplify_t amplify_SelectFL64(void)
+{
+#ifdef AMPLIFY_X86
+    if (vlc_CPU_AVX())
+        return amplify_FL64_avx;
+    if (vlc_CPU_SSE2())
+        return amplify_FL64_sse2;
+#endif
+    return amplify_FL64_c;
+}
+
+amplify_t amplify_SelectS16N(void)
+{
+#ifdef AMPLIFY_X86
+    if (vlc_CPU_AVX2())
+        return amplify_S16N_avx2;
+    if (vlc_CPU_SSE2())
+        return amplify_S16N_sse2;
+#endif
+#ifdef AMPLIFY_NEON
+    return amplify_S16N_neon;
+#else
+    return amplify_S16N_c;
+#endif
+}
@@ -0,0 +1,57 @@
+/*****************************************************************************
+ * amplify.h: software volume kernels
+ *****************************************************************************
+ * Copyright (C) 2016 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifndef VLC_AUDIO_MIXER_AMPLIFY_H
+#define VLC_AUDIO_MIXER_AMPLIFY_H 1
+
+#include <vlc_aout_volume.h>
+
+/* All the kernels have the audio_volume_t.amplify signature, and scale
+ * every sample of the buffer, whatever the channel layout. Integer samples
+ * are clipped. The SIMD variants give exactly the same output as the C
+ * ones. */
+typedef void (*amplify_t)(audio_volume_t *, block_t *, float);
+
+void amplify_FL32_c(audio_volume_t *, block_t *, float);
+void amplify_FL64_c(audio_volume_t *, block_t *, float);
+void amplify_S16N_c(audio_volume_t *, block_t *, float);
+
+#if defined(__x86_64__) && (VLC_GCC_VERSION(4, 9) || defined(__clang__))
+# define AMPLIFY_X86 1
+void amplify_FL32_sse(audio_volume_t *, block_t *, float);
+void amplify_FL32_avx(audio_volume_t *, block_t *, float);
+void amplify_FL64_sse2(audio_volume_t *, block_t *, float);
+void amplify_FL64_avx(audio_volume_t *, block_t *, float);
+void amplify_S16N_sse2(audio_volume_t *, block_t *, float);
+void amplify_S16N_avx2(audio_volume_t *, block_t *, float);
+#endif
+
+#if defined(__aarch64__) || defined(__ARM_NEON__)
+# define AMPLIFY_NEON 1
+void amplify_FL32_neon(audio_volume_t *, block_t *, float);
+void amplify_S16N_neon(audio_volume_t *, block_t *, float);
+#endif
+
+/* Return the fastest kernel for the CPU */
+amplify_t amplify_SelectFL32(void);
+amplify_t amplify_SelectFL64(void);
+amplify_t amplify_SelectS16N(void);
+
+#endif
@@ -29,6 +29,7 @@
 #include <vlc_plugin.h>
 #include <vlc_aout.h>
 #include <vlc_aout_volume.h>
+#include "amplify.h"
 
 static int Activate (vlc_object_t *);
 
@@ -61,27 +62,6 @@ static void FilterS32N (audio_volume_t *vol, block_t *block, float volume)
     (void) vol;
 }
 
-static void FilterS16N (audio_volume_t *vol, block_t *block, float volume)
-{
-    int16_t *p = (int16_t *)block->p_buffer;
-
-    int_fast16_t mult = lroundf (volume * 0x1.p8f);
-    if (mult == (1 << 8))
-        return;
-
-    for (size_t n = block->i_buffer / sizeof (*p); n > 0; n--)
-    {
-        int_fast32_t s = (*p * (int_fast32_t)mult) >> 8;
-        if (s > INT16_MAX)
-            s = INT16_MAX;
-        else
-        if (s < INT16_MIN)
-            s = INT16_MIN;
-        *(p++) = s;
-    }
-    (void) vol;
-}
-
 static void FilterU8 (audio_volume_t *vol, block_t *block, float volume)
 {
     uint8_t *p = (uint8_t *)block->p_buffer;
@@ -113,7 +93,7 @@ static int Activate (vlc_object_t *obj)
             vol->amplify = FilterS32N;
             break;
         case VLC_CODEC_S16N:
-            vol->amplify = FilterS16N;
+            vol->amplify = amplify_SelectS16N();
             break;
         case VLC_CODEC_U8:
             vol->amplify = FilterU8;
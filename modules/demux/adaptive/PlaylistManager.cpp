@@ -34,6 +34,7 @@
 #include "logic/RateBasedAdaptationLogic.h"
 #include "logic/AlwaysLowestAdaptationLogic.hpp"
 #include "logic/PredictiveAdaptationLogic.hpp"
+#include "logic/BolaAdaptationLogic.hpp"
 #include "tools/Debug.hpp"
 #include <vlc_stream.h>
 #include <vlc_demux.h>
@@ -735,6 +736,13 @@ AbstractAdaptationLogic *PlaylistManager::createLogic(AbstractAdaptationLogic::L
                 conn->setDownloadRateObserver(logic);
             return logic;
         }
+        case AbstractAdaptationLogic::Bola:
+        {
+            AbstractAdaptationLogic *logic = new (std::nothrow) BolaAdaptationLogic(VLC_OBJECT(p_demux));
+            if(logic)
+                conn->setDownloadRateObserver(logic);
+            return logic;
+        }
 
         default:
             return NULL;
@@ -126,6 +126,7 @@ bool SegmentTracker::segmentsListReady() const
 
 void SegmentTracker::reset()
 {
+    flushPrefetched();
     notify(SegmentTrackerEvent(curRepresentation, NULL));
     curRepresentation = NULL;
     init_sent = false;
@@ -164,6 +165,7 @@ SegmentChunk * SegmentTracker::getNextChunk(bool switch_allowed,
 
     if(rep != curRepresentation)
     {
+        flushPrefetched();
         notify(SegmentTrackerEvent(curRepresentation, rep));
         prevRep = curRepresentation;
         curRepresentation = rep;
@@ -190,6 +192,7 @@ SegmentChunk * SegmentTracker::getNextChunk(bool switch_allowed,
 
     if(b_updated)
     {
+        flushPrefetched();
         if(!rep->consistentSegmentNumber())
             curRepresentation->pruneBySegmentNumber(curNumber);
         curRepresentation->scheduleNextUpdate(next);
@@ -246,7 +249,9 @@ SegmentChunk * SegmentTracker::getNextChunk(bool switch_allowed,
         initializing = false;
     }
 
-    SegmentChunk *chunk = segment->toChunk(next, rep, connManager);
+    SegmentChunk *chunk = getPrefetchedChunk(rep, next);
+    if(!chunk)
+        chunk = segment->toChunk(next, rep, connManager);
 
     /* Notify new segment length for stats / logic */
     if(chunk)
@@ -278,6 +283,56 @@ SegmentChunk * SegmentTracker::getNextChunk(bool switch_allowed,
     return chunk;
 }
 
+void SegmentTracker::prefetch(unsigned count, AbstractConnectionManager *connManager)
+{
+    BaseRepresentation *rep = curRepresentation;
+
+    /* Only for known segments: on live, next ones might not be available yet */
+    if(!rep || initializing || rep->getPlaylist()->isLive())
+        return;
+
+    uint64_t number = prefetched.empty() ? next : prefetched.back().number + 1;
+    while(prefetched.size() < count)
+    {
+        bool b_gap;
+        ISegment *segment = rep->getNextSegment(BaseRepresentation::INFOTYPE_MEDIA,
+                                                number, &number, &b_gap);
+        if(!segment)
+            break;
+        SegmentChunk *chunk = segment->toChunk(number, rep, connManager);
+        if(!chunk)
+            break;
+        prefetched.push_back(PrefetchedChunk(rep, number, chunk));
+        number++;
+    }
+}
+
+SegmentChunk * SegmentTracker::getPrefetchedChunk(BaseRepresentation *rep, uint64_t number)
+{
+    if(prefetched.empty())
+        return NULL;
+
+    const PrefetchedChunk &front = prefetched.front();
+    if(front.rep != rep || front.number != number)
+    {
+        /* out of sequence, prefetch was wasted */
+        flushPrefetched();
+        return NULL;
+    }
+
+    SegmentChunk *chunk = front.chunk;
+    prefetched.pop_front();
+    return chunk;
+}
+
+void SegmentTracker::flushPrefetched()
+{
+    std::list<PrefetchedChunk>::const_iterator it;
+    for(it = prefetched.begin(); it != prefetched.end(); ++it)
+        delete (*it).chunk;
+    prefetched.clear();
+}
+
 bool SegmentTracker::setPositionByTime(mtime_t time, bool restarted, bool tryonly)
 {
     uint64_t segnumber;
@@ -297,6 +352,7 @@ bool SegmentTracker::setPositionByTime(mtime_t time, bool restarted, bool tryonl
 
 void SegmentTracker::setPositionByNumber(uint64_t segnumber, bool restarted)
 {
+    flushPrefetched();
     if(restarted)
     {
         initializing = true;
@@ -118,6 +118,7 @@ namespace adaptive
             bool segmentsListReady() const;
             void reset();
             SegmentChunk* getNextChunk(bool, AbstractConnectionManager *);
+            void prefetch(unsigned, AbstractConnectionManager *);
             bool setPositionByTime(mtime_t, bool, bool);
             void setPositionByNumber(uint64_t, bool);
             mtime_t getPlaybackTime() const; /* Current segment start time if selected */
@@ -130,6 +131,8 @@ namespace adaptive
         private:
             void setAdaptationLogic(AbstractAdaptationLogic *);
             void notify(const SegmentTrackerEvent &) const;
+            SegmentChunk * getPrefetchedChunk(BaseRepresentation *, uint64_t);
+            void flushPrefetched();
             bool first;
             bool initializing;
             bool index_sent;
@@ -141,6 +144,17 @@ namespace adaptive
             BaseAdaptationSet *adaptationSet;
             BaseRepresentation *curRepresentation;
             std::list<SegmentTrackerListenerInterface *> listeners;
+
+            class PrefetchedChunk
+            {
+                public:
+                    PrefetchedChunk(BaseRepresentation *r, uint64_t n, SegmentChunk *c)
+                        : rep(r), number(n), chunk(c) {}
+                    BaseRepresentation *rep;
+                    uint64_t number;
+                    SegmentChunk *chunk;
+            };
+            std::list<PrefetchedChunk> prefetched; /* already downloading */
     };
 }
 
@@ -41,6 +41,8 @@ AbstractStream::AbstractStream(demux_t * demux_)
     p_realdemux = demux_;
     format = StreamFormat::UNSUPPORTED;
     currentChunk = NULL;
+    int64_t prefetch = var_InheritInteger(p_realdemux, "adaptive-prefetch");
+    prefetchcount = prefetch > 0 ? prefetch : 0;
     eof = false;
     dead = false;
     disabled = false;
@@ -431,7 +433,11 @@ AbstractStream::status AbstractStream::dequeue(mtime_t nz_deadline, mtime_t *pi_
 block_t * AbstractStream::readNextBlock()
 {
     if (currentChunk == NULL && !eof)
+    {
         currentChunk = segmentTracker->getNextChunk(!fakeesout->restarting(), connManager);
+        if(currentChunk && prefetchcount)
+            segmentTracker->prefetch(prefetchcount, connManager);
+    }
 
     if(discontinuity || needrestart)
     {
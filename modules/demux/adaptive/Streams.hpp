@@ -117,6 +117,7 @@ namespace adaptive
         SegmentTracker *segmentTracker;
 
         SegmentChunk *currentChunk;
+        unsigned prefetchcount; /* segments to download ahead */
         bool eof;
         std::string language;
         std::string description;
@@ -75,13 +75,26 @@ static void Close   (vlc_object_t *);
 #define ADAPT_ACCESS_TEXT N_("Use regular HTTP modules")
 #define ADAPT_ACCESS_LONGTEXT N_("Connect using http access instead of custom http code")
 
+#define ADAPT_HTTP2_TEXT N_("Use HTTP/2 when available")
+#define ADAPT_HTTP2_LONGTEXT N_("Send all requests to a server over a single multiplexed HTTP/2 connection when it supports it")
+
+#define ADAPT_MAXDL_TEXT N_("Maximum concurrent downloads")
+#define ADAPT_MAXDL_LONGTEXT N_("Number of segments that can be downloaded at the same time, across all streams")
+
+#define ADAPT_PREFETCH_TEXT N_("Segments prefetched per stream")
+#define ADAPT_PREFETCH_LONGTEXT N_("Number of segments to start downloading ahead of the current one")
+
+#define ADAPT_PREFETCHSIZE_TEXT N_("Download buffer size (KiB)")
+#define ADAPT_PREFETCHSIZE_LONGTEXT N_("Maximum amount of downloaded but unread data, shared by all streams. 0 is unlimited")
+
 static const AbstractAdaptationLogic::LogicType pi_logics[] = {
                                 AbstractAdaptationLogic::Default,
                                 AbstractAdaptationLogic::Predictive,
                                 AbstractAdaptationLogic::RateBased,
                                 AbstractAdaptationLogic::FixedRate,
                                 AbstractAdaptationLogic::AlwaysLowest,
-                                AbstractAdaptationLogic::AlwaysBest};
+                                AbstractAdaptationLogic::AlwaysBest,
+                                AbstractAdaptationLogic::Bola};
 
 static const char *const ppsz_logics_values[] = {
                                 "",
@@ -89,14 +102,16 @@ static const char *const ppsz_logics_values[] = {
                                 "rate",
                                 "fixedrate",
                                 "lowest",
-                                "highest"};
+                                "highest",
+                                "bola"};
 
 static const char *const ppsz_logics[] = { N_("Default"),
                                            N_("Predictive"),
                                            N_("Bandwidth Adaptive"),
                                            N_("Fixed Bandwidth"),
                                            N_("Lowest Bandwidth/Quality"),
-                                           N_("Highest Bandwidth/Quality")};
+                                           N_("Highest Bandwidth/Quality"),
+                                           N_("Buffer Occupancy (BOLA)")};
 
 static_assert( ARRAY_SIZE( pi_logics ) == ARRAY_SIZE( ppsz_logics ),
     "pi_logics and ppsz_logics shall have the same number of elements" );
@@ -116,6 +131,13 @@ vlc_module_begin ()
         add_integer( "adaptive-height", 0, ADAPT_HEIGHT_TEXT, ADAPT_HEIGHT_TEXT, true )
         add_integer( "adaptive-bw",     250, ADAPT_BW_TEXT,     ADAPT_BW_LONGTEXT,     false )
         add_bool   ( "adaptive-use-access", false, ADAPT_ACCESS_TEXT, ADAPT_ACCESS_LONGTEXT, true );
+        add_bool   ( "adaptive-use-http2", true, ADAPT_HTTP2_TEXT, ADAPT_HTTP2_LONGTEXT, true )
+        add_integer_with_range( "adaptive-maxdownloads", 3, 1, 16,
+                                ADAPT_MAXDL_TEXT, ADAPT_MAXDL_LONGTEXT, true )
+        add_integer_with_range( "adaptive-prefetch", 1, 0, 8,
+                                ADAPT_PREFETCH_TEXT, ADAPT_PREFETCH_LONGTEXT, true )
+        add_integer( "adaptive-prefetch-size", 32768,
+                     ADAPT_PREFETCHSIZE_TEXT, ADAPT_PREFETCHSIZE_LONGTEXT, true )
         set_callbacks( Open, Close )
 vlc_module_end ()
 
@@ -184,7 +184,8 @@ block_t * HTTPChunkSource::read(size_t readsize)
 
     mtime_t time = mdate();
     ssize_t ret = connection->read(p_block->p_buffer, readsize);
-    time = mdate() - time;
+    const mtime_t end = mdate();
+    time = end - time;
     if(ret < 0)
     {
         block_Release(p_block);
@@ -197,7 +198,7 @@ block_t * HTTPChunkSource::read(size_t readsize)
         consumed += p_block->i_buffer;
         if((size_t)ret < readsize)
             eof = true;
-        connManager->updateDownloadRate(sourceid, p_block->i_buffer, time);
+        connManager->updateDownloadRate(sourceid, p_block->i_buffer, time, end);
     }
 
     return p_block;
@@ -275,6 +276,15 @@ bool HTTPChunkBufferedSource::isDone() const
     return b_done;
 }
 
+size_t HTTPChunkBufferedSource::getBufferedSize() const
+{
+    size_t size;
+    vlc_mutex_lock(const_cast<vlc_mutex_t *>(&lock));
+    size = buffered;
+    vlc_mutex_unlock(const_cast<vlc_mutex_t *>(&lock));
+    return size;
+}
+
 void HTTPChunkBufferedSource::bufferize(size_t readsize)
 {
     vlc_mutex_lock(&lock);
@@ -306,7 +316,8 @@ void HTTPChunkBufferedSource::bufferize(size_t readsize)
     {
         size_t size;
         mtime_t time;
-    } rate = {0,0};
+        mtime_t end;
+    } rate = {0,0,0};
 
     ssize_t ret = connection->read(p_block->p_buffer, readsize);
     if(ret <= 0)
@@ -315,7 +326,8 @@ void HTTPChunkBufferedSource::bufferize(size_t readsize)
         vlc_mutex_lock(&lock);
         done = true;
         rate.size = buffered + consumed;
-        rate.time = mdate() - downloadstart;
+        rate.end = mdate();
+        rate.time = rate.end - downloadstart;
         downloadstart = 0;
         vlc_mutex_unlock(&lock);
     }
@@ -329,7 +341,8 @@ void HTTPChunkBufferedSource::bufferize(size_t readsize)
         {
             done = true;
             rate.size = buffered + consumed;
-            rate.time = mdate() - downloadstart;
+            rate.end = mdate();
+            rate.time = rate.end - downloadstart;
             downloadstart = 0;
         }
         vlc_mutex_unlock(&lock);
@@ -337,7 +350,7 @@ void HTTPChunkBufferedSource::bufferize(size_t readsize)
 
     if(rate.size)
     {
-        connManager->updateDownloadRate(sourceid, rate.size, rate.time);
+        connManager->updateDownloadRate(sourceid, rate.size, rate.time, rate.end);
     }
 
     vlc_cond_signal(&avail);
@@ -396,6 +409,8 @@ block_t * HTTPChunkBufferedSource::readBlock()
 
     vlc_mutex_unlock(&lock);
 
+    connManager->notifyConsumed(this);
+
     return p_block;
 }
 
@@ -443,6 +458,8 @@ block_t * HTTPChunkBufferedSource::read(size_t readsize)
 
     vlc_mutex_unlock(&lock);
 
+    connManager->notifyConsumed(this);
+
     return p_block;
 }
 
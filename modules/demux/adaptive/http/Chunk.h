@@ -123,6 +123,7 @@ namespace adaptive
                 virtual bool       prepare(); /* reimpl */
                 void               bufferize(size_t);
                 bool               isDone() const;
+                size_t             getBufferedSize() const;
 
             private:
                 block_t            *p_head; /* read cache buffer */
@@ -28,34 +28,41 @@
 
 using namespace adaptive::http;
 
-Downloader::Downloader()
+Downloader::Downloader(unsigned maxthreads_, size_t maxbuffered_)
 {
     vlc_mutex_init(&lock);
     vlc_cond_init(&waitcond);
+    vlc_cond_init(&donecond);
     killed = false;
-    thread_handle_valid = false;
+    maxthreads = maxthreads_ ? maxthreads_ : 1;
+    maxbuffered = maxbuffered_;
 }
 
 bool Downloader::start()
 {
-    if(!thread_handle_valid &&
-       vlc_clone(&thread_handle, downloaderThread,
-                 reinterpret_cast<void *>(this), VLC_THREAD_PRIORITY_INPUT))
+    while(thread_handles.size() < maxthreads)
     {
-        return false;
+        vlc_thread_t thread_handle;
+        if(vlc_clone(&thread_handle, downloaderThread,
+                     reinterpret_cast<void *>(this), VLC_THREAD_PRIORITY_INPUT))
+            break;
+        thread_handles.push_back(thread_handle);
     }
-    thread_handle_valid = true;
-    return true;
+    return !thread_handles.empty();
 }
 
 Downloader::~Downloader()
 {
+    vlc_mutex_lock(&lock);
     killed = true;
-    vlc_cond_signal(&waitcond);
-    if(thread_handle_valid)
-        vlc_join(thread_handle, NULL);
+    vlc_cond_broadcast(&waitcond);
+    vlc_mutex_unlock(&lock);
+    std::vector<vlc_thread_t>::const_iterator it;
+    for(it = thread_handles.begin(); it != thread_handles.end(); ++it)
+        vlc_join(*it, NULL);
     vlc_mutex_destroy(&lock);
     vlc_cond_destroy(&waitcond);
+    vlc_cond_destroy(&donecond);
 }
 void Downloader::schedule(HTTPChunkBufferedSource *source)
 {
@@ -69,9 +76,23 @@ void Downloader::cancel(HTTPChunkBufferedSource *source)
 {
     vlc_mutex_lock(&lock);
     chunks.remove(source);
+    /* source is going away, wait for any pending read on it */
+    while(isActive(source))
+        vlc_cond_wait(&donecond, &lock);
     vlc_mutex_unlock(&lock);
 }
 
+void Downloader::notifyConsumed(HTTPChunkBufferedSource *)
+{
+    /* Buffered size has shrunk, throttled sources might be able to resume */
+    if(maxbuffered)
+    {
+        vlc_mutex_lock(&lock);
+        vlc_cond_broadcast(&waitcond);
+        vlc_mutex_unlock(&lock);
+    }
+}
+
 void * Downloader::downloaderThread(void *opaque)
 {
     Downloader *instance = reinterpret_cast<Downloader *>(opaque);
@@ -87,31 +108,64 @@ void Downloader::DownloadSource(HTTPChunkBufferedSource *source)
         source->bufferize(HTTPChunkSource::CHUNK_SIZE);
 }
 
+bool Downloader::isActive(HTTPChunkBufferedSource *source) const
+{
+    std::list<HTTPChunkBufferedSource *>::const_iterator it;
+    for(it = active.begin(); it != active.end(); ++it)
+        if(*it == source)
+            return true;
+    return false;
+}
+
+HTTPChunkBufferedSource * Downloader::getNextSource() const
+{
+    size_t buffered = 0;
+    std::list<HTTPChunkBufferedSource *>::const_iterator it;
+    if(maxbuffered)
+    {
+        for(it = chunks.begin(); it != chunks.end(); ++it)
+            buffered += (*it)->getBufferedSize();
+    }
+
+    /* Oldest first. Over budget, only sources with nothing left to read
+     * are downloaded, so that a reader can never be starved. */
+    for(it = chunks.begin(); it != chunks.end(); ++it)
+    {
+        HTTPChunkBufferedSource *source = *it;
+        if(isActive(source) || source->isDone())
+            continue;
+        if(maxbuffered && buffered >= maxbuffered &&
+           source->getBufferedSize() > 0)
+            continue;
+        return source;
+    }
+    return NULL;
+}
+
 void Downloader::Run()
 {
+    vlc_mutex_lock(&lock);
     while(1)
     {
-        vlc_mutex_lock(&lock);
-        if(killed)
-            break;
+        HTTPChunkBufferedSource *source;
 
-        while(chunks.empty() && !killed)
-        {
+        while(!killed && (source = getNextSource()) == NULL)
             vlc_cond_wait(&waitcond, &lock);
-        }
 
         if(killed)
             break;
 
-        if(!chunks.empty())
-        {
-            HTTPChunkBufferedSource *source = chunks.front();
-            DownloadSource(source);
-            if(source->isDone())
-                chunks.pop_front();
-        }
-
+        active.push_back(source);
         vlc_mutex_unlock(&lock);
+
+        DownloadSource(source);
+
+        vlc_mutex_lock(&lock);
+        active.remove(source);
+        /* Done sources stay listed until cancelled, as their data still
+         * counts against the buffering budget */
+        vlc_cond_broadcast(&donecond);
+        vlc_cond_signal(&waitcond);
     }
     vlc_mutex_unlock(&lock);
 }
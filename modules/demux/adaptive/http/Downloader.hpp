@@ -24,6 +24,7 @@
 
 #include <vlc_common.h>
 #include <list>
+#include <vector>
 
 namespace adaptive
 {
@@ -34,23 +35,28 @@ namespace adaptive
         class Downloader
         {
             public:
-                Downloader();
+                Downloader(unsigned = 1, size_t = 0);
                 ~Downloader();
                 bool start();
                 void schedule(HTTPChunkBufferedSource *);
                 void cancel(HTTPChunkBufferedSource *);
+                void notifyConsumed(HTTPChunkBufferedSource *);
 
             private:
                 static void * downloaderThread(void *);
                 void Run();
                 void DownloadSource(HTTPChunkBufferedSource *);
-                vlc_thread_t thread_handle;
+                HTTPChunkBufferedSource * getNextSource() const;
+                bool isActive(HTTPChunkBufferedSource *) const;
+                std::vector<vlc_thread_t> thread_handles;
+                unsigned     maxthreads;
+                size_t       maxbuffered; /* shared across sources, 0 = unlimited */
                 vlc_mutex_t  lock;
                 vlc_cond_t   waitcond;
-                vlc_mutex_t  processlock;
-                bool         thread_handle_valid;
+                vlc_cond_t   donecond; /* a download step has completed */
                 bool         killed;
                 std::list<HTTPChunkBufferedSource *> chunks;
+                std::list<HTTPChunkBufferedSource *> active; /* being downloaded */
         };
 
     }
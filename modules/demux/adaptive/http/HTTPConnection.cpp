@@ -27,7 +27,16 @@
 #include "../adaptive/tools/Helper.h"
 
 #include <sstream>
+#include <cstring>
 #include <vlc_stream.h>
+#include <vlc_block.h>
+
+extern "C"
+{
+    #include "../../../access/http/message.h"
+    #include "../../../access/http/resource.h"
+    #include "../../../access/http/connmgr.h"
+}
 
 using namespace adaptive::http;
 
@@ -398,6 +407,172 @@ void StreamUrlConnection::setUsed( bool b )
        reset();
 }
 
+static int LibVLCHTTPRequestFormat(const struct vlc_http_resource *,
+                                   struct vlc_http_msg *req, void *opaque)
+{
+    const BytesRange *range = static_cast<const BytesRange *>(opaque);
+
+    vlc_http_msg_add_header(req, "Cache-Control", "no-cache");
+    vlc_http_msg_add_header(req, "Accept-Encoding", "identity");
+    if(range->isValid())
+    {
+        if(range->getEndByte())
+            return vlc_http_msg_add_header(req, "Range", "bytes=%zu-%zu",
+                                           range->getStartByte(), range->getEndByte());
+        else
+            return vlc_http_msg_add_header(req, "Range", "bytes=%zu-",
+                                           range->getStartByte());
+    }
+    return 0;
+}
+
+static int LibVLCHTTPResponseValidate(const struct vlc_http_resource *,
+                                      const struct vlc_http_msg *resp, void *)
+{
+    const int status = vlc_http_msg_get_status(resp);
+    return (status == 200 || status == 206) ? 0 : -1;
+}
+
+static const struct vlc_http_resource_cbs LibVLCHTTPCallbacks =
+{
+    LibVLCHTTPRequestFormat,
+    LibVLCHTTPResponseValidate,
+};
+
+LibVLCHTTPConnection::LibVLCHTTPConnection(vlc_object_t *p_object_, struct vlc_http_mgr *manager_)
+    : AbstractConnection(p_object_)
+{
+    manager = manager_;
+    response = NULL;
+    p_pending = NULL;
+    psz_useragent = var_InheritString(p_object_, "http-user-agent");
+}
+
+LibVLCHTTPConnection::~LibVLCHTTPConnection()
+{
+    reset();
+    free(psz_useragent);
+}
+
+void LibVLCHTTPConnection::reset()
+{
+    if(p_pending)
+        block_Release(p_pending);
+    p_pending = NULL;
+    if(response)
+        vlc_http_msg_destroy(response);
+    response = NULL;
+    bytesRead = 0;
+    contentLength = 0;
+    bytesRange = BytesRange();
+}
+
+bool LibVLCHTTPConnection::canReuse(const ConnectionParams &params_) const
+{
+    /* managers are per origin */
+    return ( available &&
+             params.getHostname() == params_.getHostname() &&
+             params.getScheme() == params_.getScheme() &&
+             params.getPort() == params_.getPort() );
+}
+
+int LibVLCHTTPConnection::request(const std::string &path, const BytesRange &range)
+{
+    reset();
+
+    /* Set new path for this query */
+    params.setPath(path);
+
+    msg_Dbg(p_object, "Retrieving %s @%zu", params.getUrl().c_str(),
+                      range.isValid() ? range.getStartByte() : 0);
+
+    struct vlc_http_resource *res = (struct vlc_http_resource *) malloc(sizeof(*res));
+    if(!res)
+        return VLC_ENOMEM;
+
+    if(vlc_http_res_init(res, &LibVLCHTTPCallbacks, manager,
+                         params.getUrl().c_str(), psz_useragent, NULL))
+    {
+        free(res);
+        return VLC_EGENERIC;
+    }
+
+    BytesRange requestedRange = range;
+    response = vlc_http_res_open(res, &requestedRange);
+    vlc_http_res_destroy(res);
+    if(!response)
+        return VLC_EGENERIC;
+
+    bytesRange = range;
+    if(range.isValid() && range.getEndByte() > 0)
+        contentLength = range.getEndByte() - range.getStartByte() + 1;
+
+    const uintmax_t i_size = vlc_http_msg_get_size(response);
+    if(i_size != (uintmax_t) -1)
+    {
+        if(!contentLength || contentLength > i_size)
+            contentLength = i_size;
+    }
+    return VLC_SUCCESS;
+}
+
+ssize_t LibVLCHTTPConnection::read(void *p_buffer, size_t len)
+{
+    if( !response )
+        return VLC_EGENERIC;
+
+    if(len == 0)
+        return VLC_SUCCESS;
+
+    const size_t toRead = (contentLength) ? contentLength - bytesRead : len;
+    if (toRead == 0)
+        return VLC_SUCCESS;
+
+    if(len > toRead)
+        len = toRead;
+
+    size_t copied = 0;
+    while(copied < len)
+    {
+        if(!p_pending)
+        {
+            block_t *p_block = vlc_http_msg_read(response);
+            if(p_block == NULL || p_block == vlc_http_error)
+                break;
+            p_pending = p_block;
+        }
+
+        const size_t tocopy = std::min(p_pending->i_buffer, len - copied);
+        memcpy(static_cast<uint8_t *>(p_buffer) + copied, p_pending->p_buffer, tocopy);
+        copied += tocopy;
+        p_pending->p_buffer += tocopy;
+        p_pending->i_buffer -= tocopy;
+        if(p_pending->i_buffer == 0)
+        {
+            block_Release(p_pending);
+            p_pending = NULL;
+        }
+    }
+    bytesRead += copied;
+
+    if(copied < len || /* set EOF */
+       contentLength == bytesRead )
+    {
+        reset();
+        if(copied == 0)
+            return VLC_EGENERIC;
+    }
+
+    return copied;
+}
+
+void LibVLCHTTPConnection::setUsed( bool b )
+{
+    available = !b;
+    if(available)
+        reset();
+}
+
 ConnectionFactory::ConnectionFactory()
 {
 }
@@ -435,3 +610,58 @@ AbstractConnection * StreamUrlConnectionFactory::createConnection(vlc_object_t *
 {
     return new (std::nothrow) StreamUrlConnection(p_object);
 }
+
+LibVLCHTTPConnectionFactory::LibVLCHTTPConnectionFactory(vlc_object_t *p_object_)
+    : ConnectionFactory()
+{
+    p_object = p_object_;
+    jar = static_cast<struct vlc_http_cookie_jar_t *>(var_InheritAddress(p_object, "http-cookies"));
+    h2c = var_InheritBool(p_object, "http2");
+}
+
+LibVLCHTTPConnectionFactory::~LibVLCHTTPConnectionFactory()
+{
+    std::map<std::string, struct vlc_http_mgr *>::const_iterator it;
+    for(it = managers.begin(); it != managers.end(); ++it)
+        vlc_http_mgr_destroy((*it).second);
+}
+
+struct vlc_http_mgr * LibVLCHTTPConnectionFactory::getManager(const ConnectionParams &params)
+{
+    /* One manager, thus one connection, per origin */
+    std::stringstream ss;
+    ss.imbue(std::locale("C"));
+    ss << params.getScheme() << "://" << params.getHostname() << ":" << params.getPort();
+    const std::string origin = ss.str();
+
+    std::map<std::string, struct vlc_http_mgr *>::const_iterator it = managers.find(origin);
+    if(it != managers.end())
+        return (*it).second;
+
+    struct vlc_http_mgr *mgr = vlc_http_mgr_create(p_object, jar, h2c);
+    if(mgr)
+        managers[origin] = mgr;
+    return mgr;
+}
+
+AbstractConnection * LibVLCHTTPConnectionFactory::createConnection(vlc_object_t *p_object_,
+                                                                   const ConnectionParams &params)
+{
+    /* Without TLS, HTTP/2 can only be used if known to be supported.
+     * Otherwise, keep our own persistent HTTP/1.1 connections. */
+    if(params.getHostname().empty() ||
+       (params.getScheme() != "https" && (params.getScheme() != "http" || !h2c)))
+        return ConnectionFactory::createConnection(p_object_, params);
+
+    struct vlc_http_mgr *mgr = getManager(params);
+    if(!mgr)
+        return NULL;
+
+    /* The manager only tracks one connection. If the server did not
+     * negotiate HTTP/2, parallel requests cannot share it, and would each
+     * get a new TLS connection: use our pooled persistent connections. */
+    if(vlc_http_mgr_get_version(mgr) == 1)
+        return ConnectionFactory::createConnection(p_object_, params);
+
+    return new (std::nothrow) LibVLCHTTPConnection(p_object_, mgr);
+}
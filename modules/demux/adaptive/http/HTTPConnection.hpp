@@ -29,6 +29,11 @@
 #include "BytesRange.hpp"
 #include <vlc_common.h>
 #include <string>
+#include <map>
+
+struct vlc_http_mgr;
+struct vlc_http_msg;
+struct vlc_http_cookie_jar_t;
 
 namespace adaptive
 {
@@ -115,6 +120,29 @@ namespace adaptive
                 stream_t *p_streamurl;
        };
 
+       /* Uses the http access stack, which multiplexes concurrent requests
+        * to the same server on one HTTP/2 connection */
+       class LibVLCHTTPConnection : public AbstractConnection
+       {
+            public:
+                LibVLCHTTPConnection(vlc_object_t *, struct vlc_http_mgr *);
+                virtual ~LibVLCHTTPConnection();
+
+                virtual bool    canReuse     (const ConnectionParams &) const;
+
+                virtual int     request     (const std::string& path, const BytesRange & = BytesRange());
+                virtual ssize_t read        (void *p_buffer, size_t len);
+
+                virtual void    setUsed( bool );
+
+            protected:
+                void reset();
+                struct vlc_http_mgr *manager; /* not owned */
+                struct vlc_http_msg *response;
+                block_t *p_pending;
+                char * psz_useragent;
+       };
+
        class ConnectionFactory
        {
            public:
@@ -128,6 +156,21 @@ namespace adaptive
            public:
                virtual AbstractConnection * createConnection(vlc_object_t *, const ConnectionParams &);
        };
+
+       class LibVLCHTTPConnectionFactory : public ConnectionFactory
+       {
+           public:
+               LibVLCHTTPConnectionFactory(vlc_object_t *);
+               virtual ~LibVLCHTTPConnectionFactory();
+               virtual AbstractConnection * createConnection(vlc_object_t *, const ConnectionParams &);
+
+           private:
+               struct vlc_http_mgr * getManager(const ConnectionParams &);
+               vlc_object_t *p_object;
+               struct vlc_http_cookie_jar_t *jar; /* not owned */
+               bool h2c;
+               std::map<std::string, struct vlc_http_mgr *> managers; /* by origin */
+       };
     }
 }
 
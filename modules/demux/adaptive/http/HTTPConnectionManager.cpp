@@ -46,10 +46,11 @@ AbstractConnectionManager::~AbstractConnectionManager()
 
 }
 
-void AbstractConnectionManager::updateDownloadRate(const adaptive::ID &sourceid, size_t size, mtime_t time)
+void AbstractConnectionManager::updateDownloadRate(const adaptive::ID &sourceid, size_t size,
+                                                   mtime_t time, mtime_t end)
 {
     if(rateObserver)
-        rateObserver->updateDownloadRate(sourceid, size, time);
+        rateObserver->updateDownloadRate(sourceid, size, time, end);
 }
 
 void AbstractConnectionManager::setDownloadRateObserver(IDownloadRateObserver *obs)
@@ -61,12 +62,18 @@ HTTPConnectionManager::HTTPConnectionManager    (vlc_object_t *p_object_, Connec
     : AbstractConnectionManager( p_object_ )
 {
     vlc_mutex_init(&lock);
-    downloader = new (std::nothrow) Downloader();
-    downloader->start();
+    const int64_t maxdownloads = var_InheritInteger(p_object, "adaptive-maxdownloads");
+    const int64_t maxbuffered = var_InheritInteger(p_object, "adaptive-prefetch-size");
+    downloader = new (std::nothrow) Downloader(maxdownloads > 0 ? maxdownloads : 1,
+                                               maxbuffered > 0 ? maxbuffered * 1024 : 0);
+    if(downloader)
+        downloader->start();
     if(!factory_)
     {
         if(var_InheritBool(p_object, "adaptive-use-access"))
             factory = new (std::nothrow) StreamUrlConnectionFactory();
+        else if(var_InheritBool(p_object, "adaptive-use-http2"))
+            factory = new (std::nothrow) LibVLCHTTPConnectionFactory(p_object);
         else
             factory = new (std::nothrow) ConnectionFactory();
     }
@@ -76,8 +83,8 @@ HTTPConnectionManager::HTTPConnectionManager    (vlc_object_t *p_object_, Connec
 HTTPConnectionManager::~HTTPConnectionManager   ()
 {
     delete downloader;
-    delete factory;
     this->closeAllConnections();
+    delete factory;
     vlc_mutex_destroy(&lock);
 }
 
@@ -151,3 +158,10 @@ void HTTPConnectionManager::cancel(AbstractChunkSource *source)
     if(src)
         downloader->cancel(src);
 }
+
+void HTTPConnectionManager::notifyConsumed(AbstractChunkSource *source)
+{
+    HTTPChunkBufferedSource *src = dynamic_cast<HTTPChunkBufferedSource *>(source);
+    if(src)
+        downloader->notifyConsumed(src);
+}
@@ -50,8 +50,9 @@ namespace adaptive
                 virtual AbstractConnection * getConnection(ConnectionParams &) = 0;
                 virtual void start(AbstractChunkSource *) = 0;
                 virtual void cancel(AbstractChunkSource *) = 0;
+                virtual void notifyConsumed(AbstractChunkSource *) = 0;
 
-                virtual void updateDownloadRate(const ID &, size_t, mtime_t); /* impl */
+                virtual void updateDownloadRate(const ID &, size_t, mtime_t, mtime_t); /* impl */
                 void setDownloadRateObserver(IDownloadRateObserver *);
 
             protected:
@@ -72,6 +73,7 @@ namespace adaptive
 
                 virtual void start(AbstractChunkSource *) /* impl */;
                 virtual void cancel(AbstractChunkSource *) /* impl */;
+                virtual void notifyConsumed(AbstractChunkSource *) /* impl */;
 
             private:
                 void    releaseAllConnections ();
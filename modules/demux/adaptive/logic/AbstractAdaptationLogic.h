@@ -48,7 +48,7 @@ namespace adaptive
                 virtual ~AbstractAdaptationLogic    ();
 
                 virtual BaseRepresentation* getNextRepresentation(BaseAdaptationSet *, BaseRepresentation *) = 0;
-                virtual void                updateDownloadRate     (const ID &, size_t, mtime_t);
+                virtual void                updateDownloadRate     (const ID &, size_t, mtime_t, mtime_t);
                 virtual void                trackerEvent           (const SegmentTrackerEvent &) {}
 
                 enum LogicType
@@ -58,7 +58,8 @@ namespace adaptive
                     AlwaysLowest,
                     RateBased,
                     FixedRate,
-                    Predictive
+                    Predictive,
+                    Bola
                 };
         };
     }
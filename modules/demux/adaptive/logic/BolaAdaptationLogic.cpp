@@ -0,0 +1,262 @@
+/*
+ * BolaAdaptationLogic.cpp
+ *****************************************************************************
+ * Copyright (C) 2016 - VideoLAN Authors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include "BolaAdaptationLogic.hpp"
+
+#include "Representationselectors.hpp"
+
+#include "../playlist/BaseAdaptationSet.h"
+#include "../playlist/BaseRepresentation.h"
+#include "../tools/Debug.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace adaptive::logic;
+using namespace adaptive;
+
+/* Buffer level below which BOLA always picks the lowest quality */
+#define BOLA_MIN_BUFFER     (CLOCK_FREQ * 10)
+/* Share of the measured throughput used when matching it to bitrates */
+#define BOLA_SAFETY_FACTOR  0.9
+
+BolaStats::BolaStats()
+{
+    steady = false;
+    buffering_level = 0;
+    buffering_target = 1;
+    last_download_rate = 0;
+}
+
+BolaAdaptationLogic::BolaAdaptationLogic(vlc_object_t *p_obj_)
+    : AbstractAdaptationLogic()
+{
+    p_obj = p_obj_;
+    usedBps = 0;
+    vlc_mutex_init(&lock);
+}
+
+BolaAdaptationLogic::~BolaAdaptationLogic()
+{
+    vlc_mutex_destroy(&lock);
+}
+
+size_t BolaAdaptationLogic::getBufferIndex(const std::vector<BaseRepresentation *> &reps,
+                                           const BolaStats &stats) const
+{
+    /* Utilities are the log of the bitrate ratio to the lowest one,
+     * offset by one so that the lowest quality has a non zero utility */
+    const double lowest = std::max((uint64_t)1, reps.front()->getBandwidth());
+    const double umax = std::log(reps.back()->getBandwidth() / lowest) + 1.0;
+    if(umax <= 1.0)
+        return 0;
+
+    /* Spread the switching thresholds between the minimum buffer and the
+     * buffering target: the lowest quality is chosen below the former, and
+     * the highest one once the latter is reached. */
+    const double target = (double) stats.buffering_target / CLOCK_FREQ;
+    const double minbuf = std::min((double) BOLA_MIN_BUFFER / CLOCK_FREQ, target / 2);
+    if(minbuf <= 0)
+        return 0;
+    const double gp = (umax - 1.0) / (target / minbuf - 1.0);
+    const double Vp = minbuf / gp;
+    const double level = (double) stats.buffering_level / CLOCK_FREQ;
+
+    size_t index = 0;
+    double score = 0;
+    for(size_t i = 0; i < reps.size(); i++)
+    {
+        const double bw = std::max((uint64_t)1, reps[i]->getBandwidth());
+        const double u = std::log(bw / lowest) + 1.0;
+        const double s = (Vp * (u + gp) - level) / bw;
+        if(i == 0 || s >= score)
+        {
+            score = s;
+            index = i;
+        }
+    }
+    return index;
+}
+
+size_t BolaAdaptationLogic::getThroughputIndex(const std::vector<BaseRepresentation *> &reps,
+                                               uint64_t bps) const
+{
+    size_t index = 0;
+    for(size_t i = 1; i < reps.size(); i++)
+    {
+        if(reps[i]->getBandwidth() <= bps)
+            index = i;
+    }
+    return index;
+}
+
+uint64_t BolaAdaptationLogic::getAvailableBw(unsigned i_bw, const BaseRepresentation *curRep) const
+{
+    /* Other streams share the same link */
+    uint64_t i_others = usedBps;
+    if(curRep)
+        i_others -= std::min(i_others, curRep->getBandwidth());
+    i_bw *= BOLA_SAFETY_FACTOR;
+    return (i_bw > i_others) ? i_bw - i_others : 0;
+}
+
+BaseRepresentation *BolaAdaptationLogic::getNextRepresentation(BaseAdaptationSet *adaptSet, BaseRepresentation *prevRep)
+{
+    if(adaptSet == NULL)
+        return NULL;
+
+    const std::vector<BaseRepresentation *> &reps = adaptSet->getRepresentations();
+    if(reps.empty())
+        return NULL;
+
+    RepresentationSelector selector;
+    BaseRepresentation *rep;
+
+    vlc_mutex_lock(&lock);
+
+    std::map<ID, BolaStats>::iterator it = streams.find(adaptSet->getID());
+    if(it == streams.end() || !(*it).second.last_download_rate)
+    {
+        /* Nothing measured yet */
+        rep = (prevRep) ? prevRep : selector.lowest(adaptSet);
+    }
+    else
+    {
+        BolaStats &stats = (*it).second;
+
+        const size_t i_bw_index = getThroughputIndex(reps,
+                                    getAvailableBw(stats.last_download_rate, prevRep));
+        const size_t i_buf_index = getBufferIndex(reps, stats);
+
+        /* Restart from throughput estimates once the buffer ran dry */
+        if(stats.buffering_level == 0)
+            stats.steady = false;
+
+        size_t index;
+        if(!stats.steady)
+        {
+            /* Buffer is too low to be meaningful, until BOLA catches up
+             * with what throughput allows */
+            index = i_bw_index;
+            if(i_buf_index >= i_bw_index)
+                stats.steady = true;
+        }
+        else
+        {
+            index = i_buf_index;
+            if(prevRep)
+            {
+                const size_t i_prev_index = std::lower_bound(reps.begin(), reps.end(), prevRep,
+                                                             BaseRepresentation::bwCompare) - reps.begin();
+                /* BOLA-O: only switch up as far as throughput sustains */
+                if(index > i_prev_index && index > i_bw_index)
+                    index = std::max(i_prev_index, i_bw_index);
+            }
+        }
+        rep = reps[std::min(index, reps.size() - 1)];
+
+        BwDebug( msg_Info(p_obj, "Stream %s buffering %" PRId64 "/%" PRId64 " ms, "
+                          "buffer index %zu, throughput index %zu%s",
+                          adaptSet->getID().str().c_str(),
+                          stats.buffering_level / 1000, stats.buffering_target / 1000,
+                          i_buf_index, i_bw_index, stats.steady ? "" : " (startup)") );
+
+        BwDebug( if( rep != prevRep )
+                    msg_Info(p_obj, "Stream %s new bandwidth usage %zu KiB/s",
+                         adaptSet->getID().str().c_str(), rep->getBandwidth() / 8000); );
+    }
+
+    vlc_mutex_unlock(&lock);
+
+    return rep;
+}
+
+void BolaAdaptationLogic::updateDownloadRate(const ID &id, size_t dlsize, mtime_t time, mtime_t)
+{
+    if(unlikely(time == 0))
+        return;
+
+    vlc_mutex_lock(&lock);
+    std::map<ID, BolaStats>::iterator it = streams.find(id);
+    if(it != streams.end())
+    {
+        BolaStats &stats = (*it).second;
+        stats.last_download_rate = stats.average.push(CLOCK_FREQ * dlsize * 8 / time);
+    }
+    vlc_mutex_unlock(&lock);
+}
+
+void BolaAdaptationLogic::trackerEvent(const SegmentTrackerEvent &event)
+{
+    switch(event.type)
+    {
+    case SegmentTrackerEvent::SWITCHING:
+        {
+            vlc_mutex_lock(&lock);
+            if(event.u.switching.prev)
+                usedBps -= event.u.switching.prev->getBandwidth();
+            if(event.u.switching.next)
+                usedBps += event.u.switching.next->getBandwidth();
+            vlc_mutex_unlock(&lock);
+        }
+        break;
+
+    case SegmentTrackerEvent::BUFFERING_STATE:
+        {
+            const ID &id = *event.u.buffering.id;
+            vlc_mutex_lock(&lock);
+            if(event.u.buffering.enabled)
+            {
+                if(streams.find(id) == streams.end())
+                    streams.insert(std::pair<ID, BolaStats>(id, BolaStats()));
+            }
+            else
+            {
+                std::map<ID, BolaStats>::iterator it = streams.find(id);
+                if(it != streams.end())
+                    streams.erase(it);
+            }
+            vlc_mutex_unlock(&lock);
+        }
+        break;
+
+    case SegmentTrackerEvent::BUFFERING_LEVEL_CHANGE:
+        {
+            const ID &id = *event.u.buffering_level.id;
+            vlc_mutex_lock(&lock);
+            /* Late events for removed streams must not recreate them */
+            std::map<ID, BolaStats>::iterator it = streams.find(id);
+            if(it != streams.end())
+            {
+                BolaStats &stats = (*it).second;
+                stats.buffering_level = event.u.buffering_level.current;
+                stats.buffering_target = event.u.buffering_level.target;
+            }
+            vlc_mutex_unlock(&lock);
+        }
+        break;
+
+    default:
+            break;
+    }
+}
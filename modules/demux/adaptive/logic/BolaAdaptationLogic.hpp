@@ -0,0 +1,75 @@
+/*
+ * BolaAdaptationLogic.hpp
+ *****************************************************************************
+ * Copyright (C) 2016 - VideoLAN Authors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+#ifndef BOLAADAPTATIONLOGIC_HPP
+#define BOLAADAPTATIONLOGIC_HPP
+
+#include "AbstractAdaptationLogic.h"
+#include "../tools/MovingAverage.hpp"
+#include <map>
+#include <vector>
+
+namespace adaptive
+{
+    namespace logic
+    {
+        class BolaStats
+        {
+            friend class BolaAdaptationLogic;
+
+            public:
+                BolaStats();
+
+            private:
+                bool    steady;
+                mtime_t buffering_level;
+                mtime_t buffering_target;
+                unsigned last_download_rate;
+                MovingAverage<unsigned> average;
+        };
+
+        /* Buffer Occupancy based Lyapunov Algorithm (Spiteri et al.), with
+         * throughput based startup and the BOLA-O oscillation control:
+         * the buffer level drives the choice, but it never climbs above
+         * what the measured throughput can sustain. */
+        class BolaAdaptationLogic : public AbstractAdaptationLogic
+        {
+            public:
+                BolaAdaptationLogic(vlc_object_t *);
+                virtual ~BolaAdaptationLogic();
+
+                virtual BaseRepresentation* getNextRepresentation(BaseAdaptationSet *, BaseRepresentation *);
+                virtual void                updateDownloadRate     (const ID &, size_t, mtime_t, mtime_t); /* reimpl */
+                virtual void                trackerEvent           (const SegmentTrackerEvent &); /* reimpl */
+
+            private:
+                size_t                      getBufferIndex(const std::vector<BaseRepresentation *> &,
+                                                           const BolaStats &) const;
+                size_t                      getThroughputIndex(const std::vector<BaseRepresentation *> &,
+                                                               uint64_t) const;
+                uint64_t                    getAvailableBw(unsigned, const BaseRepresentation *) const;
+                std::map<adaptive::ID, BolaStats> streams;
+                uint64_t                    usedBps;
+                vlc_object_t *              p_obj;
+                vlc_mutex_t                 lock;
+        };
+    }
+}
+
+#endif // BOLAADAPTATIONLOGIC_HPP
@@ -34,7 +34,8 @@ namespace adaptive
     class IDownloadRateObserver
     {
         public:
-            virtual void updateDownloadRate(const ID &, size_t, mtime_t) = 0;
+            /* size bytes downloaded in time, completed at date end */
+            virtual void updateDownloadRate(const ID &, size_t, mtime_t, mtime_t) = 0;
             virtual ~IDownloadRateObserver(){}
     };
 }
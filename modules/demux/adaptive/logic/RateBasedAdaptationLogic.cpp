@@ -45,6 +45,7 @@ RateBasedAdaptationLogic::RateBasedAdaptationLogic  (vlc_object_t *p_obj_, int w
     height = h;
     usedBps = 0;
     dllength = 0;
+    dlstart = dlend = dlfloor = 0;
     p_obj = p_obj_;
     dlsize = 0;
     vlc_mutex_init(&lock);
@@ -80,20 +81,39 @@ BaseRepresentation *RateBasedAdaptationLogic::getNextRepresentation(BaseAdaptati
     return rep;
 }
 
-void RateBasedAdaptationLogic::updateDownloadRate(const ID &, size_t size, mtime_t time)
+void RateBasedAdaptationLogic::updateDownloadRate(const ID &, size_t size,
+                                                  mtime_t time, mtime_t end)
 {
     if(unlikely(time == 0))
         return;
-    /* Accumulate up to observation window */
-    dllength += time;
+
+    vlc_mutex_lock(&lock);
+
+    /* Accumulate up to observation window, over the union of the
+     * download intervals rather than the sum of their durations */
+    mtime_t start = __MAX(end - time, dlfloor);
+    if(start > dlend)
+    {
+        dllength += dlend - dlstart;
+        dlstart = start;
+        dlend = end;
+    }
+    else
+    {
+        dlstart = __MIN(dlstart, start);
+        dlend = __MAX(dlend, end);
+    }
     dlsize += size;
 
-    if(dllength < CLOCK_FREQ / 4)
+    const mtime_t length = dllength + dlend - dlstart;
+    if(length < CLOCK_FREQ / 4)
+    {
+        vlc_mutex_unlock(&lock);
         return;
+    }
 
-    const size_t bps = CLOCK_FREQ * dlsize * 8 / dllength;
+    const size_t bps = CLOCK_FREQ * dlsize * 8 / length;
 
-    vlc_mutex_lock(&lock);
     bpsAvg = average.push(bps);
 
     BwDebug(msg_Dbg(p_obj, "alpha1 %lf alpha0 %lf dmax %ld ds %ld", alpha,
@@ -103,6 +123,7 @@ void RateBasedAdaptationLogic::updateDownloadRate(const ID &, size_t size, mtime
 
     currentBps = bpsAvg * 3/4;
     dlsize = dllength = 0;
+    dlstart = dlfloor = dlend;
 
     BwDebug(msg_Info(p_obj, "Current bandwidth %zu KiB/s using %u%%",
                     (bpsAvg / 8000), (bpsAvg) ? (unsigned)(usedBps * 100.0 / bpsAvg) : 0));
@@ -40,7 +40,7 @@ namespace adaptive
                 virtual ~RateBasedAdaptationLogic   ();
 
                 BaseRepresentation *getNextRepresentation(BaseAdaptationSet *, BaseRepresentation *);
-                virtual void updateDownloadRate(const ID &, size_t, mtime_t); /* reimpl */
+                virtual void updateDownloadRate(const ID &, size_t, mtime_t, mtime_t); /* reimpl */
                 virtual void trackerEvent(const SegmentTrackerEvent &); /* reimpl */
 
             private:
@@ -53,8 +53,13 @@ namespace adaptive
 
                 MovingAverage<size_t>   average;
 
+                /* Observation window: downloads may run in parallel, so
+                 * only the time some download was running is counted */
                 size_t                  dlsize;
-                mtime_t                 dllength;
+                mtime_t                 dllength; /* closed busy periods */
+                mtime_t                 dlstart;  /* current busy period */
+                mtime_t                 dlend;
+                mtime_t                 dlfloor;  /* already measured */
 
                 vlc_mutex_t             lock;
         };
@@ -0,0 +1,620 @@
+/*
+ * abrsim.cpp: offline adaptation logic simulator
+ *****************************************************************************
+ * Copyright (C) 2016 - VideoLAN Authors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/* Replays a recorded bandwidth trace against a manifest, feeding the
+ * adaptation logics the same events the segment trackers would, and
+ * reports startup delay, rebuffering, switches and average bitrate.
+ *
+ * Segments are downloaded one at a time over a single link. Their size is
+ * derived from the representation bandwidth, as manifests don't carry it.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <vlc_common.h>
+#include <vlc_stream.h>
+#include <vlc_url.h>
+#include <vlc/vlc.h>
+#include "../../../../lib/libvlc_internal.h"
+
+#include "playlist/AbstractPlaylist.hpp"
+#include "playlist/BasePeriod.h"
+#include "playlist/BaseAdaptationSet.h"
+#include "playlist/BaseRepresentation.h"
+#include "playlist/Segment.h"
+#include "logic/AlwaysBestAdaptationLogic.h"
+#include "logic/AlwaysLowestAdaptationLogic.hpp"
+#include "logic/BolaAdaptationLogic.hpp"
+#include "logic/PredictiveAdaptationLogic.hpp"
+#include "logic/RateBasedAdaptationLogic.h"
+#include "xml/DOMParser.h"
+
+#include "../dash/DASHManager.h"
+#include "../dash/mpd/IsoffMainParser.h"
+#include "../hls/HLSManager.hpp"
+#include "../hls/playlist/Parser.hpp"
+#include "../hls/playlist/M3U8.hpp"
+#include "../hls/playlist/Representation.hpp"
+#include "../smooth/SmoothManager.hpp"
+#include "../smooth/playlist/Parser.hpp"
+
+#include <algorithm>
+#include <set>
+#include <string>
+#include <vector>
+
+using namespace adaptive;
+using namespace adaptive::logic;
+using namespace adaptive::playlist;
+using namespace adaptive::xml;
+
+/* Piecewise constant link capacity, looped over when exhausted */
+class BandwidthTrace
+{
+    public:
+        bool load(const char *);
+        mtime_t transfer(mtime_t, uint64_t) const;
+
+    private:
+        std::vector<mtime_t>  starts;
+        std::vector<uint64_t> rates; /* bits per second */
+        mtime_t               period;
+};
+
+bool BandwidthTrace::load(const char *psz_path)
+{
+    FILE *fp = fopen(psz_path, "r");
+    if(fp == NULL)
+    {
+        perror(psz_path);
+        return false;
+    }
+
+    char line[256];
+    unsigned lineno = 0;
+    bool b_usable = false;
+    period = 0;
+    while(fgets(line, sizeof(line), fp))
+    {
+        lineno++;
+        if(line[strspn(line, " \t\r\n")] == '\0' || line[strspn(line, " \t")] == '#')
+            continue;
+
+        double duration, kbps;
+        if(sscanf(line, "%lf %lf", &duration, &kbps) != 2 || duration <= 0 || kbps < 0)
+        {
+            fprintf(stderr, "%s:%u: expected <seconds> <kbit/s>\n", psz_path, lineno);
+            fclose(fp);
+            return false;
+        }
+        starts.push_back(period);
+        rates.push_back(kbps * 1000);
+        period += duration * CLOCK_FREQ;
+        b_usable |= (kbps > 0);
+    }
+    fclose(fp);
+
+    if(!b_usable)
+        fprintf(stderr, "%s: no usable bandwidth in trace\n", psz_path);
+    return b_usable;
+}
+
+/* Returns when a transfer of the given amount of bits started at the given
+ * time completes */
+mtime_t BandwidthTrace::transfer(mtime_t start, uint64_t bits) const
+{
+    mtime_t now = start;
+    double left = bits;
+
+    size_t i = std::upper_bound(starts.begin(), starts.end(), now % period)
+               - starts.begin() - 1;
+    mtime_t offset = now % period - starts[i];
+    for(;;)
+    {
+        const mtime_t end = (i + 1 < starts.size()) ? starts[i + 1] : period;
+        const mtime_t span = end - starts[i] - offset;
+        const double capacity = (double) rates[i] * span / CLOCK_FREQ;
+        if(rates[i] && capacity >= left)
+            return now + left * CLOCK_FREQ / rates[i];
+        left -= capacity;
+        now += span;
+        offset = 0;
+        i = (i + 1) % starts.size();
+    }
+}
+
+class SimulatedStream
+{
+    public:
+        SimulatedStream(BaseAdaptationSet *);
+
+        BaseAdaptationSet  *adaptSet;
+        BaseRepresentation *rep;
+        uint64_t            next;
+        mtime_t             buffered; /* media time downloaded so far */
+        bool                eos;
+
+        unsigned            segments;
+        unsigned            switches;
+        double              bitsum; /* bandwidth weighted by duration */
+};
+
+SimulatedStream::SimulatedStream(BaseAdaptationSet *set)
+{
+    adaptSet = set;
+    rep = NULL;
+    next = 0;
+    buffered = 0;
+    eos = false;
+    segments = 0;
+    switches = 0;
+    bitsum = 0;
+}
+
+class Simulator
+{
+    public:
+        Simulator(AbstractAdaptationLogic *, const BandwidthTrace &);
+        ~Simulator();
+
+        void addStream(BaseAdaptationSet *);
+        void run();
+        void report(const char *) const;
+
+        mtime_t rtt;
+        mtime_t min_buffering;
+        mtime_t max_buffering;
+        mtime_t max_duration;
+        bool    verbose;
+
+    private:
+        SimulatedStream *nextStream() const;
+        mtime_t playable() const;
+        void advance(mtime_t);
+        bool step(SimulatedStream *);
+
+        AbstractAdaptationLogic *logic;
+        const BandwidthTrace &trace;
+        std::vector<SimulatedStream *> streams;
+
+        mtime_t now;
+        mtime_t playhead;
+        bool    playing;
+        bool    started;
+        mtime_t startup_delay;
+        mtime_t rebuffer_time;
+        unsigned rebuffers;
+};
+
+Simulator::Simulator(AbstractAdaptationLogic *logic_, const BandwidthTrace &trace_)
+    : trace(trace_)
+{
+    logic = logic_;
+    rtt = CLOCK_FREQ / 20;
+    min_buffering = 0;
+    max_buffering = 0;
+    max_duration = 0;
+    verbose = false;
+    now = playhead = 0;
+    playing = started = false;
+    startup_delay = rebuffer_time = 0;
+    rebuffers = 0;
+}
+
+Simulator::~Simulator()
+{
+    for(size_t i = 0; i < streams.size(); i++)
+    {
+        logic->trackerEvent(SegmentTrackerEvent(streams[i]->adaptSet->getID(), false));
+        delete streams[i];
+    }
+}
+
+void Simulator::addStream(BaseAdaptationSet *adaptSet)
+{
+    streams.push_back(new SimulatedStream(adaptSet));
+    logic->trackerEvent(SegmentTrackerEvent(adaptSet->getID(), true));
+}
+
+/* Like the playlist manager, always feed the least buffered stream */
+SimulatedStream * Simulator::nextStream() const
+{
+    SimulatedStream *st = NULL;
+    for(size_t i = 0; i < streams.size(); i++)
+    {
+        if(!streams[i]->eos && (!st || streams[i]->buffered < st->buffered))
+            st = streams[i];
+    }
+    return st;
+}
+
+/* Media time up to which all streams can be played */
+mtime_t Simulator::playable() const
+{
+    mtime_t i_min = INT64_MAX, i_max = 0;
+    for(size_t i = 0; i < streams.size(); i++)
+    {
+        if(!streams[i]->eos)
+            i_min = std::min(i_min, streams[i]->buffered);
+        i_max = std::max(i_max, streams[i]->buffered);
+    }
+    return (i_min == INT64_MAX) ? i_max : i_min;
+}
+
+void Simulator::advance(mtime_t dt)
+{
+    now += dt;
+    while(dt > 0)
+    {
+        if(!playing)
+        {
+            if(started)
+                rebuffer_time += dt;
+            else
+                startup_delay += dt;
+            break;
+        }
+
+        const mtime_t avail = playable() - playhead;
+        if(avail >= dt)
+        {
+            playhead += dt;
+            break;
+        }
+        playhead += avail;
+        dt -= avail;
+        if(nextStream() == NULL)
+            break; /* played until the end */
+        playing = false;
+        rebuffers++;
+        if(verbose)
+            printf("%9.3f stall at %.3f\n", (double) now / CLOCK_FREQ,
+                   (double) playhead / CLOCK_FREQ);
+    }
+}
+
+bool Simulator::step(SimulatedStream *st)
+{
+    const ID &id = st->adaptSet->getID();
+
+    if(max_duration && st->buffered >= max_duration)
+        return false;
+
+    /* Downloads pause while the buffer is full */
+    mtime_t level = st->buffered - playhead;
+    if(playing && level > max_buffering)
+    {
+        advance(level - max_buffering);
+        level = st->buffered - playhead;
+    }
+    logic->trackerEvent(SegmentTrackerEvent(id, level, max_buffering));
+
+    BaseRepresentation *rep = logic->getNextRepresentation(st->adaptSet, st->rep);
+    if(rep == NULL)
+        return false;
+    if(rep != st->rep)
+    {
+        logic->trackerEvent(SegmentTrackerEvent(st->rep, rep));
+        if(st->rep)
+        {
+            st->switches++;
+            if(!rep->consistentSegmentNumber())
+                st->next = rep->translateSegmentNumber(st->next, st->rep);
+        }
+        st->rep = rep;
+    }
+
+    bool b_gap;
+    ISegment *segment = rep->getNextSegment(BaseRepresentation::INFOTYPE_MEDIA,
+                                            st->next, &st->next, &b_gap);
+    if(segment == NULL)
+        return false;
+
+    /* Timelines only have the duration of each segment */
+    mtime_t time, duration = 0;
+    if(!segment->isTemplate())
+        duration = rep->inheritTimescale().ToTime(segment->duration.Get());
+    if(duration <= 0 &&
+       !rep->getPlaybackTimeDurationBySegmentNumber(st->next, &time, &duration))
+        return false;
+    if(duration <= 0)
+        return false;
+    logic->trackerEvent(SegmentTrackerEvent(id, duration));
+
+    const uint64_t size = rep->getBandwidth() * duration / CLOCK_FREQ / 8;
+    const mtime_t start = now;
+    advance(trace.transfer(now + rtt, size * 8) - now);
+    logic->updateDownloadRate(id, size, now - start, now);
+
+    st->buffered += duration;
+    st->next++;
+    st->segments++;
+    st->bitsum += (double) rep->getBandwidth() * duration;
+
+    if(verbose)
+        printf("%9.3f %s segment %" PRIu64 " %7" PRIu64 " kbit/s %7.3f s, "
+               "buffer %6.3f s\n", (double) now / CLOCK_FREQ,
+               id.str().c_str(), st->next - 1, rep->getBandwidth() / 1000,
+               (double) (now - start) / CLOCK_FREQ,
+               (double) (st->buffered - playhead) / CLOCK_FREQ);
+    return true;
+}
+
+void Simulator::run()
+{
+    SimulatedStream *st;
+    while((st = nextStream()) != NULL)
+    {
+        if(!step(st))
+            st->eos = true;
+
+        if(!playing)
+        {
+            /* Start, or resume, once every stream is buffered enough */
+            bool b_ready = true;
+            for(size_t i = 0; i < streams.size(); i++)
+            {
+                if(!streams[i]->eos && streams[i]->buffered - playhead < min_buffering)
+                    b_ready = false;
+            }
+            if(b_ready)
+                playing = started = true;
+        }
+    }
+    /* Play out what remains */
+    if(playing)
+        now += playable() - playhead;
+}
+
+void Simulator::report(const char *psz_logic) const
+{
+    double bitrate = 0;
+    mtime_t media = 0;
+
+    printf("logic:           %s\n", psz_logic);
+    for(size_t i = 0; i < streams.size(); i++)
+    {
+        const SimulatedStream *st = streams[i];
+        const double avg = (st->buffered) ? st->bitsum / st->buffered : 0;
+        printf("stream %s: %u segments, %.3f s, %u switches, "
+               "average %.0f kbit/s\n", st->adaptSet->getID().str().c_str(),
+               st->segments, (double) st->buffered / CLOCK_FREQ,
+               st->switches, avg / 1000);
+        bitrate += avg;
+        media = std::max(media, st->buffered);
+    }
+    unsigned switches = 0;
+    for(size_t i = 0; i < streams.size(); i++)
+        switches += streams[i]->switches;
+
+    printf("media duration:  %.3f s\n", (double) media / CLOCK_FREQ);
+    printf("session time:    %.3f s\n", (double) now / CLOCK_FREQ);
+    printf("startup delay:   %.3f s\n", (double) startup_delay / CLOCK_FREQ);
+    printf("rebuffering:     %u times, %.3f s\n", rebuffers,
+           (double) rebuffer_time / CLOCK_FREQ);
+    printf("switches:        %u\n", switches);
+    printf("average bitrate: %.0f kbit/s\n", bitrate / 1000);
+}
+
+static AbstractPlaylist * LoadPlaylist(vlc_object_t *obj, const char *psz_path)
+{
+    char *psz_url = strstr(psz_path, "://") ? strdup(psz_path)
+                                            : vlc_path2uri(psz_path, NULL);
+    if(psz_url == NULL)
+        return NULL;
+
+    const std::string playlisturl(psz_url);
+    stream_t *s = vlc_stream_NewMRL(obj, psz_url);
+    free(psz_url);
+    if(s == NULL)
+        return NULL;
+
+    AbstractPlaylist *playlist = NULL;
+    if(hls::HLSManager::isHTTPLiveStreaming(s))
+    {
+        hls::playlist::M3U8Parser parser;
+        playlist = parser.parse(obj, s, playlisturl);
+
+        /* Variant playlists are only loaded on demand */
+        BasePeriod *period = (playlist) ? playlist->getFirstPeriod() : NULL;
+        for(size_t i = 0; period && i < period->getAdaptationSets().size(); i++)
+        {
+            std::vector<BaseRepresentation *> &reps =
+                    period->getAdaptationSets()[i]->getRepresentations();
+            for(size_t j = 0; j < reps.size(); j++)
+            {
+                hls::playlist::Representation *rep =
+                        dynamic_cast<hls::playlist::Representation *>(reps[j]);
+                if(rep == NULL || rep->initialized())
+                    continue;
+                stream_t *sub = vlc_stream_NewMRL(obj, rep->getPlaylistUrl().toString().c_str());
+                if(sub)
+                {
+                    parser.appendSegmentsFromPlaylistStream(obj, rep, sub);
+                    vlc_stream_Delete(sub);
+                }
+            }
+        }
+    }
+    else
+    {
+        DOMParser xmlParser(s);
+        if(xmlParser.parse(true))
+        {
+            if(dash::DASHManager::isDASH(xmlParser.getRootNode()))
+            {
+                dash::mpd::IsoffMainParser parser(xmlParser.getRootNode(), obj, s, playlisturl);
+                playlist = parser.parse();
+            }
+            else if(smooth::SmoothManager::isSmoothStreaming(xmlParser.getRootNode()))
+            {
+                smooth::playlist::ManifestParser parser(xmlParser.getRootNode(), obj, s, playlisturl);
+                playlist = parser.parse();
+            }
+        }
+    }
+    vlc_stream_Delete(s);
+    return playlist;
+}
+
+static AbstractAdaptationLogic * CreateLogic(vlc_object_t *obj, const char *psz_logic,
+                                             uint64_t fixedbps)
+{
+    if(!strcmp(psz_logic, "predictive"))
+        return new PredictiveAdaptationLogic(obj);
+    if(!strcmp(psz_logic, "rate"))
+        return new RateBasedAdaptationLogic(obj, 0, 0);
+    if(!strcmp(psz_logic, "fixedrate"))
+        return new FixedRateAdaptationLogic(fixedbps);
+    if(!strcmp(psz_logic, "lowest"))
+        return new AlwaysLowestAdaptationLogic();
+    if(!strcmp(psz_logic, "highest"))
+        return new AlwaysBestAdaptationLogic();
+    if(!strcmp(psz_logic, "bola"))
+        return new BolaAdaptationLogic(obj);
+    return NULL;
+}
+
+static void Usage(const char *psz_name)
+{
+    printf("Usage: %s [options] <manifest> <trace>\n"
+           "\n"
+           "Replays a bandwidth trace against a DASH, HLS or Smooth manifest.\n"
+           "The trace holds one \"<seconds> <kbit/s>\" interval per line.\n"
+           "\n"
+           "  -l <logic>    predictive, rate, fixedrate, lowest, highest, bola\n"
+           "                (default: predictive)\n"
+           "  -f <kbit/s>   bandwidth of the fixedrate logic (default: 2048)\n"
+           "  -r <ms>       request round trip time (default: 50)\n"
+           "  -m <seconds>  buffering before playback starts (default: manifest)\n"
+           "  -b <seconds>  maximum buffering (default: manifest)\n"
+           "  -t <seconds>  stop after this much media (default: all)\n"
+           "  -v            print every download\n", psz_name);
+}
+
+int main(int argc, char *argv[])
+{
+    const char *psz_logic = "predictive";
+    double fixed = 2048, rtt = 50, minbuf = 0, maxbuf = 0, duration = 0;
+    bool verbose = false;
+    int c;
+
+    while((c = getopt(argc, argv, "l:f:r:m:b:t:vh")) != -1)
+    {
+        switch(c)
+        {
+            case 'l': psz_logic = optarg; break;
+            case 'f': fixed = atof(optarg); break;
+            case 'r': rtt = atof(optarg); break;
+            case 'm': minbuf = atof(optarg); break;
+            case 'b': maxbuf = atof(optarg); break;
+            case 't': duration = atof(optarg); break;
+            case 'v': verbose = true; break;
+            case 'h':
+                Usage(argv[0]);
+                return 0;
+            default:
+                Usage(argv[0]);
+                return 1;
+        }
+    }
+    if(argc - optind != 2)
+    {
+        Usage(argv[0]);
+        return 1;
+    }
+
+    BandwidthTrace trace;
+    if(!trace.load(argv[optind + 1]))
+        return 1;
+
+    const char *args[] = { "--quiet" };
+    libvlc_instance_t *vlc = libvlc_new(ARRAY_SIZE(args), args);
+    if(vlc == NULL)
+        return 1;
+    vlc_object_t *obj = VLC_OBJECT(vlc->p_libvlc_int);
+
+    int ret = 1;
+    AbstractAdaptationLogic *logic = NULL;
+    AbstractPlaylist *playlist = LoadPlaylist(obj, argv[optind]);
+    BasePeriod *period = (playlist) ? playlist->getFirstPeriod() : NULL;
+    if(period == NULL)
+    {
+        fprintf(stderr, "%s: cannot load manifest\n", argv[optind]);
+        goto out;
+    }
+    if(playlist->isLive())
+    {
+        fprintf(stderr, "%s: live manifests are not supported\n", argv[optind]);
+        goto out;
+    }
+
+    logic = CreateLogic(obj, psz_logic, fixed * 1000);
+    if(logic == NULL)
+    {
+        fprintf(stderr, "unknown logic %s\n", psz_logic);
+        goto out;
+    }
+
+    {
+        Simulator sim(logic, trace);
+        sim.rtt = rtt * CLOCK_FREQ / 1000;
+        sim.min_buffering = (minbuf > 0) ? minbuf * CLOCK_FREQ
+                                         : playlist->getMinBuffering();
+        sim.max_buffering = (maxbuf > 0) ? maxbuf * CLOCK_FREQ
+                                         : playlist->getMaxBuffering();
+        sim.max_buffering = std::max(sim.max_buffering, sim.min_buffering);
+        /* Templates without timeline only end with the presentation */
+        sim.max_duration = (duration > 0) ? duration * CLOCK_FREQ
+                                          : playlist->duration.Get();
+        sim.verbose = verbose;
+
+        /* One stream per content type, as only selected ES are fetched */
+        std::set<std::string> types;
+        const std::vector<BaseAdaptationSet *> &sets = period->getAdaptationSets();
+        for(size_t i = 0; i < sets.size(); i++)
+        {
+            if(sets[i]->getRepresentations().empty())
+                continue;
+            std::string mime = sets[i]->getRepresentations().front()->getMimeType();
+            if(mime.empty())
+                mime = sets[i]->getMimeType();
+            if(types.insert(mime.substr(0, mime.find('/'))).second)
+                sim.addStream(sets[i]);
+        }
+
+        sim.run();
+        sim.report(psz_logic);
+    }
+    ret = 0;
+
+out:
+    delete logic;
+    delete playlist;
+    libvlc_release(vlc);
+    return ret;
+}
@@ -166,12 +166,8 @@ bool M3U8Parser::appendSegmentsFromPlaylistURI(vlc_object_t *p_obj, Representati
         stream_t *substream = vlc_stream_MemoryNew(p_obj, p_block->p_buffer, p_block->i_buffer, true);
         if(substream)
         {
-            std::list<Tag *> tagslist = parseEntries(substream);
+            appendSegmentsFromPlaylistStream(p_obj, rep, substream);
             vlc_stream_Delete(substream);
-
-            parseSegments(p_obj, rep, tagslist);
-
-            releaseTagsList(tagslist);
         }
         block_Release(p_block);
         return true;
@@ -179,6 +175,15 @@ bool M3U8Parser::appendSegmentsFromPlaylistURI(vlc_object_t *p_obj, Representati
     return false;
 }
 
+bool M3U8Parser::appendSegmentsFromPlaylistStream(vlc_object_t *p_obj, Representation *rep,
+                                                  stream_t *substream)
+{
+    std::list<Tag *> tagslist = parseEntries(substream);
+    parseSegments(p_obj, rep, tagslist);
+    releaseTagsList(tagslist);
+    return true;
+}
+
 void M3U8Parser::parseSegments(vlc_object_t *p_obj, Representation *rep, const std::list<Tag *> &tagslist)
 {
     SegmentList *segmentList = new (std::nothrow) SegmentList(rep);
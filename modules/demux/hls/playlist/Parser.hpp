@@ -57,6 +57,7 @@ namespace hls
 
                 M3U8 *             parse  (vlc_object_t *p_obj, stream_t *p_stream, const std::string &);
                 bool appendSegmentsFromPlaylistURI(vlc_object_t *, Representation *);
+                bool appendSegmentsFromPlaylistStream(vlc_object_t *, Representation *, stream_t *);
 
             private:
                 Representation * createRepresentation(BaseAdaptationSet *, const AttributesTag *);
@@ -1136,6 +1136,9 @@ typedef struct MP4_Box_data_tfhd_s
 #define MP4_TRUN_SAMPLE_SIZE         (1<<9)
 #define MP4_TRUN_SAMPLE_FLAGS        (1<<10)
 #define MP4_TRUN_SAMPLE_TIME_OFFSET  (1<<11)
+
+/* sample flags, in trun, tfhd and trex */
+#define MP4_SAMPLE_FLAG_IS_NON_SYNC  (1<<16)
 typedef struct MP4_descriptor_trun_sample_t
 {
     uint32_t i_duration;
@@ -33,8 +33,11 @@
 #include <vlc_input.h>
 #include <vlc_aout.h>
 #include <vlc_plugin.h>
+#include <vlc_md5.h>
+#include <vlc_fs.h>
 #include <assert.h>
 #include <limits.h>
+#include <sys/stat.h>
 #include "../codec/cc.h"
 
 /*****************************************************************************
@@ -43,6 +46,11 @@
 static int  Open ( vlc_object_t * );
 static void Close( vlc_object_t * );
 
+#define SEEKINDEX_CACHE_TEXT N_("Cache fragmented files seek index")
+#define SEEKINDEX_CACHE_LONGTEXT N_("Store the keyframes index of fragmented " \
+    "files in the cache directory, so that seeking into them again does not " \
+    "need to read all their fragments.")
+
 vlc_module_begin ()
     set_category( CAT_INPUT )
     set_subcategory( SUBCAT_INPUT_DEMUX )
@@ -50,6 +58,9 @@ vlc_module_begin ()
     set_shortname( N_("MP4") )
     set_capability( "demux", 240 )
     set_callbacks( Open, Close )
+
+    add_bool( "mp4-seek-index-cache", false, SEEKINDEX_CACHE_TEXT,
+              SEEKINDEX_CACHE_LONGTEXT, true )
 vlc_module_end ()
 
 /*****************************************************************************
@@ -86,6 +97,15 @@ struct demux_sys_t
 
     mp4_fragments_t fragments;
 
+    /* fragmented files seek index, built on first seek */
+    struct
+    {
+        mp4_seekindex_t *p_tracks;      /* one for each track */
+        mp4_fragment_t **pp_fragments;  /* known fragments, by position */
+        uint32_t         i_fragments;
+        bool             b_built;
+    } seekindex;
+
     struct
     {
         mp4_fragment_t *p_fragment;
@@ -137,6 +157,7 @@ static void MP4_GetDefaultSizeAndDuration( demux_t *p_demux,
 static bool AddFragment( demux_t *p_demux, MP4_Box_t *p_moox );
 static int  ProbeFragments( demux_t *p_demux, bool b_force );
 static int  ProbeIndex( demux_t *p_demux );
+static void LeafSeekIndexClean( demux_sys_t *p_sys );
 
 static int LeafIndexGetMoofPosByTime( demux_t *p_demux, const mtime_t i_target_time,
                                       uint64_t *pi_pos, mtime_t *pi_mooftime );
@@ -1255,7 +1276,8 @@ static int Seek( demux_t *p_demux, mtime_t i_date )
     return VLC_SUCCESS;
 }
 
-static int LeafSeekIntoFragment( demux_t *p_demux, mp4_fragment_t *p_fragment )
+static int LeafSeekIntoFragment( demux_t *p_demux, mp4_fragment_t *p_fragment,
+                                 bool b_settimes )
 {
     demux_sys_t *p_sys = p_demux->p_sys;
     uint64_t i64 = p_fragment->i_chunk_range_min_offset;
@@ -1290,6 +1312,9 @@ static int LeafSeekIntoFragment( demux_t *p_demux, mp4_fragment_t *p_fragment )
     LeafMapTrafTrunContextes( p_demux, p_fragment->p_moox );
     p_sys->context.i_mdatbytesleft = p_fragment->i_chunk_range_max_offset - i64;
 
+    if( !b_settimes )
+        return VLC_SUCCESS;
+
     mtime_t i_time_base = 0;
     for( unsigned int i_track = 0; i_track < p_sys->i_tracks; i_track++ )
     {
@@ -1304,6 +1329,341 @@ static int LeafSeekIntoFragment( demux_t *p_demux, mp4_fragment_t *p_fragment )
     return VLC_SUCCESS;
 }
 
+/* Fragmented files seek index: for each track, the start time of its runs
+ * in each fragment, with the moof position and whether the run starts with
+ * a sync sample. It is built from the probed fragments or loaded from the
+ * cache, and replaces the linear walk of the fragments on every seek. */
+#define SEEKINDEX_KEY_MAX_MOOV (1 << 20)
+#define SEEKINDEX_KEY_TAIL     (1 << 16)
+
+static void LeafSeekIndexClean( demux_sys_t *p_sys )
+{
+    if( p_sys->seekindex.p_tracks )
+    {
+        for( unsigned i = 0; i < p_sys->i_tracks; i++ )
+            MP4_SeekIndex_Clean( &p_sys->seekindex.p_tracks[i] );
+        free( p_sys->seekindex.p_tracks );
+        p_sys->seekindex.p_tracks = NULL;
+    }
+    free( p_sys->seekindex.pp_fragments );
+    p_sys->seekindex.pp_fragments = NULL;
+    p_sys->seekindex.i_fragments = 0;
+}
+
+static void LeafSeekIndexHashRange( demux_t *p_demux, struct md5_s *p_md5,
+                                    uint64_t i_pos, uint64_t i_size )
+{
+    uint8_t buf[4096];
+
+    if( vlc_stream_Seek( p_demux->s, i_pos ) != VLC_SUCCESS )
+        return;
+    while( i_size )
+    {
+        ssize_t i_read = vlc_stream_Read( p_demux->s, buf, __MIN( i_size, sizeof(buf) ) );
+        if( i_read <= 0 )
+            break;
+        AddMD5( p_md5, buf, i_read );
+        i_size -= i_read;
+    }
+}
+
+/* The file is identified by its size, its moov, and its end that holds the
+ * mfra or the last moof: recordings of the same size may have identical
+ * moov boxes. The date and inode of local files are also taken. */
+static char * LeafSeekIndexGetKey( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    const MP4_Box_t *p_moov = MP4_BoxGet( p_sys->p_root, "/moov" );
+    if( !p_moov )
+        return NULL;
+
+    struct md5_s md5;
+    uint8_t buf[8];
+    uint64_t i_backup_pos = vlc_stream_Tell( p_demux->s );
+    const uint64_t i_size = stream_Size( p_demux->s );
+
+    InitMD5( &md5 );
+    SetQWBE( buf, i_size );
+    AddMD5( &md5, buf, 8 );
+
+    struct stat st;
+    if( p_demux->psz_file && !strcmp( p_demux->psz_access, "file" ) &&
+        vlc_stat( p_demux->psz_file, &st ) == 0 )
+    {
+        SetQWBE( buf, st.st_mtime );
+        AddMD5( &md5, buf, 8 );
+        SetQWBE( buf, st.st_ino );
+        AddMD5( &md5, buf, 8 );
+    }
+
+    LeafSeekIndexHashRange( p_demux, &md5, p_moov->i_pos,
+                            __MIN( p_moov->i_size, SEEKINDEX_KEY_MAX_MOOV ) );
+    if( i_size > p_moov->i_pos + p_moov->i_size )
+    {
+        const uint64_t i_tail = __MIN( i_size - p_moov->i_pos - p_moov->i_size,
+                                       SEEKINDEX_KEY_TAIL );
+        LeafSeekIndexHashRange( p_demux, &md5, i_size - i_tail, i_tail );
+    }
+    EndMD5( &md5 );
+
+    if( vlc_stream_Seek( p_demux->s, i_backup_pos ) != VLC_SUCCESS )
+        return NULL;
+
+    return psz_md5_hash( &md5 );
+}
+
+static bool LeafFragmentTrackStartsWithSync( demux_t *p_demux, const MP4_Box_t *p_moof,
+                                             unsigned int i_track_ID )
+{
+    const MP4_Box_t *p_traf = MP4_BoxGet( p_moof, "traf" );
+    for( ; p_traf; p_traf = p_traf->p_next )
+    {
+        const MP4_Box_t *p_tfhd = MP4_BoxGet( p_traf, "tfhd" );
+        if( p_traf->i_type != ATOM_traf || !p_tfhd || !BOXDATA(p_tfhd) ||
+            BOXDATA(p_tfhd)->i_track_ID != i_track_ID )
+            continue;
+
+        const MP4_Box_t *p_trun = MP4_BoxGet( p_traf, "trun" );
+        if( !p_trun || !BOXDATA(p_trun) )
+            return true;
+
+        const MP4_Box_data_trun_t *p_trun_data = BOXDATA(p_trun);
+        uint32_t i_flags;
+        if( p_trun_data->i_flags & MP4_TRUN_FIRST_FLAGS )
+            i_flags = p_trun_data->i_first_sample_flags;
+        else if( ( p_trun_data->i_flags & MP4_TRUN_SAMPLE_FLAGS ) &&
+                 p_trun_data->i_sample_count )
+            i_flags = p_trun_data->p_samples[0].i_flags;
+        else if( BOXDATA(p_tfhd)->i_flags & MP4_TFHD_DFLT_SAMPLE_FLAGS )
+            i_flags = BOXDATA(p_tfhd)->i_default_sample_flags;
+        else
+        {
+            const MP4_Box_t *p_trex = MP4_GetTrexByTrackID(
+                        MP4_BoxGet( p_demux->p_sys->p_root, "moov" ), i_track_ID );
+            if( !p_trex )
+                return true;
+            i_flags = BOXDATA(p_trex)->i_default_sample_flags;
+        }
+        return !( i_flags & MP4_SAMPLE_FLAG_IS_NON_SYNC );
+    }
+    return true;
+}
+
+static int LeafSeekIndexFromFragments( demux_t *p_demux, bool b_points )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    mp4_fragment_t *p_moovfragment = MP4_Fragment_Moov( &p_sys->fragments );
+
+    uint32_t i_fragments = 0;
+    for( mp4_fragment_t *p_fragment = p_moovfragment; p_fragment;
+         p_fragment = p_fragment->p_next )
+        i_fragments++;
+
+    stime_t *pi_times = calloc( p_sys->i_tracks, sizeof(*pi_times) );
+    p_sys->seekindex.pp_fragments = malloc( i_fragments * sizeof(mp4_fragment_t *) );
+    if( !pi_times || !p_sys->seekindex.pp_fragments )
+    {
+        free( pi_times );
+        return VLC_ENOMEM;
+    }
+
+    for( mp4_fragment_t *p_fragment = p_moovfragment; p_fragment;
+         p_fragment = p_fragment->p_next )
+    {
+        /* same rule as GetTrackFragmentTimeOffset() */
+        if( !p_fragment->p_moox ||
+            ( p_fragment == p_moovfragment && !p_fragment->i_chunk_range_max_offset ) )
+            continue;
+
+        p_sys->seekindex.pp_fragments[p_sys->seekindex.i_fragments++] = p_fragment;
+
+        for( unsigned int i_duration = 0; i_duration < p_fragment->i_durations; i_duration++ )
+        {
+            const unsigned int i_track_ID = p_fragment->p_durations[i_duration].i_track_ID;
+            unsigned int i_track = 0;
+            while( i_track < p_sys->i_tracks &&
+                   p_sys->track[i_track].i_track_ID != i_track_ID )
+                i_track++;
+            if( i_track == p_sys->i_tracks )
+                continue;
+
+            if( b_points )
+            {
+                const mp4_track_t *p_track = &p_sys->track[i_track];
+                const bool b_sync = p_fragment->p_moox->i_type == ATOM_moov ||
+                    LeafFragmentTrackStartsWithSync( p_demux, p_fragment->p_moox,
+                                                     i_track_ID );
+                if( !MP4_SeekIndex_Append( &p_sys->seekindex.p_tracks[i_track],
+                        pi_times[i_track] * p_track->i_timescale / p_sys->i_timescale,
+                        p_fragment->p_moox->i_pos, 0, b_sync ? MP4_SEEKPOINT_SYNC : 0 ) )
+                {
+                    free( pi_times );
+                    return VLC_ENOMEM;
+                }
+            }
+            pi_times[i_track] += p_fragment->p_durations[i_duration].i_duration;
+        }
+    }
+
+    free( pi_times );
+    return VLC_SUCCESS;
+}
+
+static void LeafBuildSeekIndex( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+
+    p_sys->seekindex.b_built = true;
+    if( !p_sys->i_tracks || !p_sys->i_timescale )
+        return;
+
+    p_sys->seekindex.p_tracks = malloc( p_sys->i_tracks * sizeof(mp4_seekindex_t) );
+    if( !p_sys->seekindex.p_tracks )
+        return;
+    for( unsigned i = 0; i < p_sys->i_tracks; i++ )
+        MP4_SeekIndex_Init( &p_sys->seekindex.p_tracks[i], p_sys->track[i].i_track_ID );
+
+    char *psz_key = NULL;
+    if( var_InheritBool( p_demux, "mp4-seek-index-cache" ) )
+        psz_key = LeafSeekIndexGetKey( p_demux );
+
+    bool b_loaded = psz_key &&
+        MP4_SeekIndex_Load( VLC_OBJECT(p_demux), psz_key,
+                            p_sys->seekindex.p_tracks, p_sys->i_tracks ) == VLC_SUCCESS;
+
+    if( p_sys->b_fragments_probed )
+    {
+        if( LeafSeekIndexFromFragments( p_demux, !b_loaded ) != VLC_SUCCESS )
+            LeafSeekIndexClean( p_sys );
+        else if( psz_key && !b_loaded )
+            MP4_SeekIndex_Save( VLC_OBJECT(p_demux), psz_key,
+                                p_sys->seekindex.p_tracks, p_sys->i_tracks );
+    }
+    else if( !b_loaded )
+    {
+        /* fragments are only known up to the playback position */
+        LeafSeekIndexClean( p_sys );
+    }
+    free( psz_key );
+}
+
+static mp4_fragment_t * LeafSeekIndexGetFragment( demux_sys_t *p_sys, uint64_t i_pos )
+{
+    uint32_t i_low = 0, i_high = p_sys->seekindex.i_fragments;
+    while( i_low < i_high )
+    {
+        uint32_t i_mid = i_low + (i_high - i_low) / 2;
+        mp4_fragment_t *p_fragment = p_sys->seekindex.pp_fragments[i_mid];
+        if( p_fragment->p_moox->i_pos == i_pos )
+            return p_fragment;
+        if( p_fragment->p_moox->i_pos < i_pos )
+            i_low = i_mid + 1;
+        else
+            i_high = i_mid;
+    }
+    return NULL;
+}
+
+/* Time of the first sample of the track at or after the fragment */
+static stime_t LeafSeekIndexGetTrackTime( const mp4_seekindex_t *p_index, uint64_t i_pos,
+                                          stime_t i_fallback )
+{
+    const mp4_seekpoint_t *p_point = MP4_SeekIndex_LookupPos( p_index, i_pos );
+    if( p_point && p_point->i_pos == i_pos )
+        return p_point->i_time;
+    p_point = p_point ? p_point + 1 : p_index->p_points;
+    if( p_point && p_point < &p_index->p_points[p_index->i_count] )
+        return p_point->i_time;
+    return i_fallback;
+}
+
+static int LeafSeekIndexSeek( demux_t *p_demux, mtime_t i_nztime )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+
+    if( !p_sys->seekindex.b_built )
+        LeafBuildSeekIndex( p_demux );
+    if( !p_sys->seekindex.p_tracks )
+        return VLC_EGENERIC;
+
+    /* The video track gives the keyframes, else audio, else anything */
+    static const int pi_cats[] = { VIDEO_ES, AUDIO_ES, -1 };
+    unsigned int i_ref = p_sys->i_tracks;
+    for( size_t i_cat = 0; i_cat < ARRAY_SIZE(pi_cats) && i_ref == p_sys->i_tracks; i_cat++ )
+    {
+        for( unsigned int i = 0; i < p_sys->i_tracks; i++ )
+        {
+            if( p_sys->seekindex.p_tracks[i].i_count &&
+                ( pi_cats[i_cat] == -1 || p_sys->track[i].fmt.i_cat == pi_cats[i_cat] ) )
+            {
+                i_ref = i;
+                break;
+            }
+        }
+    }
+    if( i_ref == p_sys->i_tracks )
+        return VLC_EGENERIC;
+
+    const mp4_track_t *p_reftrack = &p_sys->track[i_ref];
+    const mp4_seekindex_t *p_refindex = &p_sys->seekindex.p_tracks[i_ref];
+    const mp4_seekpoint_t *p_point =
+        MP4_SeekIndex_LookupTime( p_refindex, i_nztime * p_reftrack->i_timescale / CLOCK_FREQ,
+                                  true );
+    if( !p_point )
+        p_point = &p_refindex->p_points[0];
+
+    const uint64_t i_pos = p_point->i_pos;
+    mp4_fragment_t *p_fragment = LeafSeekIndexGetFragment( p_sys, i_pos );
+    if( p_fragment )
+    {
+        msg_Dbg( p_demux, "seek index gives fragment at %"PRIu64" for time %"PRId64,
+                 i_pos, i_nztime );
+        if( LeafSeekIntoFragment( p_demux, p_fragment, false ) != VLC_SUCCESS )
+            return VLC_EGENERIC;
+    }
+    else
+    {
+        /* not probed yet, or the moov which can't be reparsed */
+        const MP4_Box_t *p_moov = MP4_Fragment_Moov( &p_sys->fragments )->p_moox;
+        if( !p_moov || p_moov->i_pos == i_pos )
+            return VLC_EGENERIC;
+        msg_Dbg( p_demux, "seek index gives unknown fragment at %"PRIu64" for time %"PRId64,
+                 i_pos, i_nztime );
+        const uint64_t i_backup_pos = vlc_stream_Tell( p_demux->s );
+        if( vlc_stream_Seek( p_demux->s, i_pos ) )
+        {
+            msg_Err( p_demux, "seek to moof failed %"PRIu64, i_pos );
+            return VLC_EGENERIC;
+        }
+
+        /* Do not trust a cached index that does not match the file */
+        const uint8_t *p_peek;
+        if( vlc_stream_Peek( p_demux->s, &p_peek, 8 ) < 8 ||
+            VLC_FOURCC( p_peek[4], p_peek[5], p_peek[6], p_peek[7] ) != ATOM_moof )
+        {
+            msg_Warn( p_demux, "no moof at %"PRIu64", discarding seek index", i_pos );
+            LeafSeekIndexClean( p_sys );
+            if( vlc_stream_Seek( p_demux->s, i_backup_pos ) )
+                msg_Err( p_demux, "cannot seek back to %"PRIu64, i_backup_pos );
+            return VLC_EGENERIC;
+        }
+        p_sys->context.i_current_box_type = 0;
+        p_sys->context.i_mdatbytesleft = 0;
+        p_sys->context.p_fragment = NULL;
+    }
+
+    for( unsigned int i_track = 0; i_track < p_sys->i_tracks; i_track++ )
+    {
+        mp4_track_t *p_track = &p_sys->track[i_track];
+        p_track->i_time = LeafSeekIndexGetTrackTime( &p_sys->seekindex.p_tracks[i_track], i_pos,
+                                p_point->i_time * p_track->i_timescale / p_reftrack->i_timescale );
+    }
+    p_sys->i_time = p_point->i_time * p_sys->i_timescale / p_reftrack->i_timescale;
+    p_sys->i_pcr  = VLC_TS_INVALID;
+
+    return VLC_SUCCESS;
+}
+
 static int LeafSeekToTime( demux_t *p_demux, mtime_t i_nztime )
 {
     demux_sys_t *p_sys = p_demux->p_sys;
@@ -1312,6 +1672,13 @@ static int LeafSeekToTime( demux_t *p_demux, mtime_t i_nztime )
     if ( !p_sys->i_timescale || !p_sys->i_overall_duration || !p_sys->b_seekable )
          return VLC_EGENERIC;
 
+    if ( LeafSeekIndexSeek( p_demux, i_nztime ) == VLC_SUCCESS )
+    {
+        MP4ASF_ResetFrames( p_sys );
+        es_out_Control( p_demux->out, ES_OUT_SET_NEXT_DISPLAY_TIME, VLC_TS_0 + i_nztime );
+        return VLC_SUCCESS;
+    }
+
     if ( !p_sys->b_fragments_probed && !p_sys->b_index_probed && p_sys->b_seekable )
     {
         ProbeIndex( p_demux );
@@ -1366,7 +1733,7 @@ static int LeafSeekToTime( demux_t *p_demux, mtime_t i_nztime )
     {
         msg_Dbg( p_demux, "seeking to fragment data starting at %"PRIu64" for time %"PRId64,
                            p_fragment->i_chunk_range_min_offset, i_nztime );
-        if ( LeafSeekIntoFragment( p_demux, p_fragment ) != VLC_SUCCESS )
+        if ( LeafSeekIntoFragment( p_demux, p_fragment, true ) != VLC_SUCCESS )
             return VLC_EGENERIC;
     }
 
@@ -1405,7 +1772,7 @@ static int LeafSeekToPos( demux_t *p_demux, double f )
                  p_fragment->i_chunk_range_max_offset );
         msg_Dbg( p_demux, "Seeking to fragment data starting at %"PRIu64" for pos %"PRIu64,
                  p_fragment->i_chunk_range_min_offset, i64 );
-        return LeafSeekIntoFragment( p_demux, p_fragment );
+        return LeafSeekIntoFragment( p_demux, p_fragment, true );
     }
     else
     {
@@ -1785,6 +2152,7 @@ static void Close ( vlc_object_t * p_this )
         vlc_input_title_Delete( p_sys->p_title );
 
     MP4_Fragments_Clean( &p_sys->fragments );
+    LeafSeekIndexClean( p_sys );
 
     free( p_sys );
 }
@@ -2537,74 +2905,163 @@ static int TrackCreateES( demux_t *p_demux, mp4_track_t *p_track,
     return VLC_SUCCESS;
 }
 
-/* *** Try to find nearest sync points *** */
-static int TrackGetNearestSeekPoint( demux_t *p_demux, mp4_track_t *p_track,
-                                     uint32_t i_sample, uint32_t *pi_sync_sample )
+/* Returns the last chunk starting at or before the given sample */
+static uint32_t TrackGetChunkBySample( const mp4_track_t *p_track, uint32_t i_sample )
 {
-    int i_ret = VLC_EGENERIC;
-    *pi_sync_sample = 0;
+    uint32_t i_low = 0, i_high = p_track->i_chunk_count;
+    while( i_high - i_low > 1 )
+    {
+        uint32_t i_mid = i_low + (i_high - i_low) / 2;
+        if( p_track->chunk[i_mid].i_sample_first <= i_sample )
+            i_low = i_mid;
+        else
+            i_high = i_mid;
+    }
+    return i_low;
+}
+
+/* Returns the last chunk starting at or before the given dts */
+static uint32_t TrackGetChunkByDts( const mp4_track_t *p_track, uint64_t i_dts )
+{
+    uint32_t i_low = 0, i_high = p_track->i_chunk_count;
+    while( i_high - i_low > 1 )
+    {
+        uint32_t i_mid = i_low + (i_high - i_low) / 2;
+        if( p_track->chunk[i_mid].i_first_dts <= i_dts )
+            i_low = i_mid;
+        else
+            i_high = i_mid;
+    }
+    return i_low;
+}
+
+static int CmpUint32( const void *a, const void *b )
+{
+    const uint32_t i_a = *(const uint32_t *)a, i_b = *(const uint32_t *)b;
+    return ( i_a > i_b ) - ( i_a < i_b );
+}
+
+/* Builds the index of the sync samples of the track, from the Sync Sample
+ * Box and the rap samples groups, with their dts and file offset */
+static void TrackBuildSyncIndex( demux_t *p_demux, mp4_track_t *p_track )
+{
+    uint32_t *pi_samples = NULL;
+    size_t i_samples = 0, i_alloc = 0;
+
+    p_track->b_seekindex = true;
+    MP4_SeekIndex_Init( &p_track->seekindex, p_track->i_track_ID );
 
-    const MP4_Box_t *p_stss;
-    if( ( p_stss = MP4_BoxGet( p_track->p_stbl, "stss" ) ) )
+    const MP4_Box_t *p_stss = MP4_BoxGet( p_track->p_stbl, "stss" );
+    if( p_stss && BOXDATA(p_stss) )
     {
         const MP4_Box_data_stss_t *p_stss_data = BOXDATA(p_stss);
         msg_Dbg( p_demux, "track[Id 0x%x] using Sync Sample Box (stss)",
                  p_track->i_track_ID );
-        for( unsigned i_index = 0; i_index < p_stss_data->i_entry_count; i_index++ )
-        {
-            if( i_index >= p_stss_data->i_entry_count - 1 ||
-                i_sample < p_stss_data->i_sample_number[i_index+1] )
-            {
-                *pi_sync_sample = p_stss_data->i_sample_number[i_index];
-                msg_Dbg( p_demux, "stss gives %d --> %" PRIu32 " (sample number)",
-                         i_sample, *pi_sync_sample );
-                i_ret = VLC_SUCCESS;
-                break;
-            }
-        }
+        i_alloc = p_stss_data->i_entry_count;
+        pi_samples = malloc( i_alloc * sizeof(*pi_samples) );
+        if( !pi_samples )
+            return;
+        memcpy( pi_samples, p_stss_data->i_sample_number,
+                i_alloc * sizeof(*pi_samples) );
+        i_samples = i_alloc;
     }
 
-    /* try rap samples groups */
     const MP4_Box_t *p_sbgp = MP4_BoxGet( p_track->p_stbl, "sbgp" );
     for( ; p_sbgp; p_sbgp = p_sbgp->p_next )
     {
         const MP4_Box_data_sbgp_t *p_sbgp_data = BOXDATA(p_sbgp);
-        if( p_sbgp->i_type != ATOM_sbgp || !p_sbgp_data )
+        if( p_sbgp->i_type != ATOM_sbgp || !p_sbgp_data ||
+            p_sbgp_data->i_grouping_type != SAMPLEGROUP_rap )
             continue;
 
-        if( p_sbgp_data->i_grouping_type == SAMPLEGROUP_rap )
+        uint32_t i_group_sample = 0;
+        for( uint32_t i = 0; i < p_sbgp_data->i_entry_count; i++ )
         {
-            uint32_t i_group_sample = 0;
-            for ( uint32_t i=0; i<p_sbgp_data->i_entry_count; i++ )
+            /* Sample belongs to rap group ? */
+            if( p_sbgp_data->entries.pi_group_description_index[i] != 0 )
             {
-                /* Sample belongs to rap group ? */
-                if( p_sbgp_data->entries.pi_group_description_index[i] != 0 )
+                if( i_samples == i_alloc )
                 {
-                    if( i_sample < i_group_sample )
+                    size_t i_new = i_alloc ? i_alloc * 2 : 64;
+                    uint32_t *pi_realloc = realloc( pi_samples,
+                                                    i_new * sizeof(*pi_samples) );
+                    if( !pi_realloc )
                     {
-                        msg_Dbg( p_demux, "sbgp lookup failed %" PRIu32 " (sample number)",
-                                 i_sample );
-                        break;
-                    }
-                    else if ( i_sample >= i_group_sample &&
-                              *pi_sync_sample < i_group_sample )
-                    {
-                        *pi_sync_sample = i_group_sample;
-                        i_ret = VLC_SUCCESS;
+                        free( pi_samples );
+                        return;
                     }
+                    pi_samples = pi_realloc;
+                    i_alloc = i_new;
                 }
-                i_group_sample += p_sbgp_data->entries.pi_sample_count[i];
+                pi_samples[i_samples++] = i_group_sample;
             }
+            i_group_sample += p_sbgp_data->entries.pi_sample_count[i];
+        }
+    }
 
-            if( i_ret == VLC_SUCCESS && *pi_sync_sample )
-            {
-                msg_Dbg( p_demux, "sbgp gives %d --> %" PRIu32 " (sample number)",
-                         i_sample, *pi_sync_sample );
-            }
+    if( i_samples > 1 )
+        qsort( pi_samples, i_samples, sizeof(*pi_samples), CmpUint32 );
+
+    /* Sync samples are sorted, walk the chunks and their dts entries once */
+    uint32_t i_chunk = 0, i_last_sample = 0;
+    for( size_t i = 0; i < i_samples && p_track->i_chunk_count; i++ )
+    {
+        const uint32_t i_sample = pi_samples[i];
+        if( ( i > 0 && i_sample == i_last_sample ) ||
+            i_sample >= p_track->i_sample_count )
+            continue;
+        i_last_sample = i_sample;
+
+        while( i_chunk + 1 < p_track->i_chunk_count &&
+               p_track->chunk[i_chunk + 1].i_sample_first <= i_sample )
+            i_chunk++;
+
+        const mp4_chunk_t *ck = &p_track->chunk[i_chunk];
+        uint64_t i_dts = ck->i_first_dts;
+        uint64_t i_pos = ck->i_offset;
+        uint32_t i_left = i_sample - __MIN( i_sample, ck->i_sample_first );
+
+        for( uint32_t j = 0; j < ck->i_entries_dts && i_left; j++ )
+        {
+            uint32_t i_count = __MIN( i_left, ck->p_sample_count_dts[j] );
+            i_dts += (uint64_t) i_count * ck->p_sample_delta_dts[j];
+            i_left -= i_count;
         }
+
+        if( p_track->i_sample_size )
+            i_pos += (uint64_t) p_track->i_sample_size * ( i_sample - ck->i_sample_first );
+        else
+            for( uint32_t j = ck->i_sample_first; j < i_sample; j++ )
+                i_pos += p_track->p_sample_size[j];
+
+        if( !MP4_SeekIndex_Append( &p_track->seekindex, i_dts, i_pos,
+                                   i_sample, MP4_SEEKPOINT_SYNC ) )
+            break;
     }
+    free( pi_samples );
 
-    return i_ret;
+    msg_Dbg( p_demux, "track[Id 0x%x] indexed %"PRIu32" sync samples",
+             p_track->i_track_ID, p_track->seekindex.i_count );
+}
+
+/* *** Try to find nearest sync points *** */
+static int TrackGetNearestSeekPoint( demux_t *p_demux, mp4_track_t *p_track,
+                                     uint32_t i_sample, uint32_t *pi_sync_sample )
+{
+    *pi_sync_sample = 0;
+
+    if( !p_track->b_seekindex )
+        TrackBuildSyncIndex( p_demux, p_track );
+
+    const mp4_seekpoint_t *p_point =
+            MP4_SeekIndex_LookupSample( &p_track->seekindex, i_sample );
+    if( !p_point )
+        return VLC_EGENERIC;
+
+    *pi_sync_sample = p_point->i_sample;
+    msg_Dbg( p_demux, "sync index gives %"PRIu32" --> %"PRIu32" (sample number)",
+             i_sample, *pi_sync_sample );
+    return VLC_SUCCESS;
 }
 
 /* given a time it return sample/chunk
@@ -2662,24 +3119,8 @@ static int TrackTimeToSampleChunk( demux_t *p_demux, mp4_track_t *p_track,
         i_start = i_start * p_track->i_timescale / CLOCK_FREQ;
     }
 
-    /* we start from sample 0/chunk 0, hope it won't take too much time */
     /* *** find good chunk *** */
-    for( i_chunk = 0; ; i_chunk++ )
-    {
-        if( i_chunk + 1 >= p_track->i_chunk_count )
-        {
-            /* at the end and can't check if i_start in this chunk,
-               it will be check while searching i_sample */
-            i_chunk = p_track->i_chunk_count - 1;
-            break;
-        }
-
-        if( (uint64_t)i_start >= p_track->chunk[i_chunk].i_first_dts &&
-            (uint64_t)i_start <  p_track->chunk[i_chunk + 1].i_first_dts )
-        {
-            break;
-        }
-    }
+    i_chunk = TrackGetChunkByDts( p_track, i_start );
 
     /* *** find sample in the chunk *** */
     i_sample = p_track->chunk[i_chunk].i_sample_first;
@@ -2724,19 +3165,7 @@ static int TrackTimeToSampleChunk( demux_t *p_demux, mp4_track_t *p_track,
         TrackGetNearestSeekPoint( p_demux, p_track, i_sample, &i_sync_sample ) )
     {
         /* Go to chunk */
-        if( i_sync_sample <= i_sample )
-        {
-            while( i_chunk > 0 &&
-                   i_sync_sample < p_track->chunk[i_chunk].i_sample_first )
-                i_chunk--;
-        }
-        else
-        {
-            while( i_chunk < p_track->i_chunk_count - 1 &&
-                   i_sync_sample >= p_track->chunk[i_chunk].i_sample_first +
-                                    p_track->chunk[i_chunk].i_sample_count )
-                i_chunk++;
-        }
+        i_chunk = TrackGetChunkBySample( p_track, i_sync_sample );
         i_sample = i_sync_sample;
     }
 
@@ -3181,6 +3610,8 @@ static void MP4_TrackDestroy( demux_t *p_demux, mp4_track_t *p_track )
 
     if ( p_track->asfinfo.p_frame )
         block_ChainRelease( p_track->asfinfo.p_frame );
+
+    MP4_SeekIndex_Clean( &p_track->seekindex );
 }
 
 static int MP4_TrackSelect( demux_t *p_demux, mp4_track_t *p_track,
@@ -28,6 +28,7 @@
 #include <vlc_common.h>
 #include "libmp4.h"
 #include "fragments.h"
+#include "seekindex.h"
 #include "../asf/asfpacket.h"
 
 /* Contain all information about a chunk */
@@ -129,6 +130,10 @@ typedef struct
     bool b_has_non_empty_cchunk;
     bool b_codec_need_restart;
 
+    /* sync samples (stss and rap sample groups), built on first seek */
+    mp4_seekindex_t seekindex;
+    bool            b_seekindex;
+
     mtime_t i_time; // track scaled
 
     /* rrtp reception hint track */
@@ -0,0 +1,470 @@
+/*****************************************************************************
+ * seekindex.c : MP4 tracks seek index
+ *****************************************************************************
+ * Copyright (C) 2016 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>     // getpid()
+#include <sys/stat.h>
+
+#include <vlc_common.h>
+#include <vlc_fs.h>
+#include <vlc_configuration.h>
+
+#include "seekindex.h"
+
+void MP4_SeekIndex_Init( mp4_seekindex_t *p_index, unsigned int i_track_ID )
+{
+    p_index->i_track_ID = i_track_ID;
+    p_index->i_count = 0;
+    p_index->i_alloc = 0;
+    p_index->p_points = NULL;
+    p_index->i_sync_count = 0;
+    p_index->i_sync_alloc = 0;
+    p_index->p_sync = NULL;
+}
+
+void MP4_SeekIndex_Clean( mp4_seekindex_t *p_index )
+{
+    free( p_index->p_points );
+    free( p_index->p_sync );
+    MP4_SeekIndex_Init( p_index, p_index->i_track_ID );
+}
+
+static bool SeekIndex_Reserve( mp4_seekindex_t *p_index, uint32_t i_count )
+{
+    if( i_count <= p_index->i_alloc )
+        return true;
+#if SIZE_MAX <= UINT32_MAX
+    if( i_count > SIZE_MAX / sizeof(mp4_seekpoint_t) )
+        return false;
+#endif
+    mp4_seekpoint_t *p_realloc = realloc( p_index->p_points,
+                                          i_count * sizeof(mp4_seekpoint_t) );
+    if( !p_realloc )
+        return false;
+    p_index->p_points = p_realloc;
+    p_index->i_alloc = i_count;
+    return true;
+}
+
+/* Records the last point as a sync point */
+static bool SeekIndex_AppendSync( mp4_seekindex_t *p_index )
+{
+    if( p_index->i_sync_count == p_index->i_sync_alloc )
+    {
+        uint32_t i_alloc = p_index->i_sync_alloc ?
+                           __MIN( (uint64_t) p_index->i_sync_alloc * 2, UINT32_MAX ) : 64;
+#if SIZE_MAX <= UINT32_MAX
+        if( i_alloc > SIZE_MAX / sizeof(uint32_t) )
+            return false;
+#endif
+        uint32_t *p_realloc = realloc( p_index->p_sync, i_alloc * sizeof(uint32_t) );
+        if( !p_realloc )
+            return false;
+        p_index->p_sync = p_realloc;
+        p_index->i_sync_alloc = i_alloc;
+    }
+    p_index->p_sync[p_index->i_sync_count++] = p_index->i_count - 1;
+    return true;
+}
+
+bool MP4_SeekIndex_Append( mp4_seekindex_t *p_index, stime_t i_time, uint64_t i_pos,
+                           uint32_t i_sample, uint32_t i_flags )
+{
+    if( p_index->i_count == p_index->i_alloc &&
+       ( p_index->i_count == UINT32_MAX ||
+        !SeekIndex_Reserve( p_index, p_index->i_alloc ?
+                                     __MIN( (uint64_t) p_index->i_alloc * 2, UINT32_MAX ) : 64 ) ) )
+        return false;
+
+    mp4_seekpoint_t *p_point = &p_index->p_points[p_index->i_count++];
+    p_point->i_time = i_time;
+    p_point->i_pos = i_pos;
+    p_point->i_sample = i_sample;
+    p_point->i_flags = i_flags;
+
+    if( ( i_flags & MP4_SEEKPOINT_SYNC ) && !SeekIndex_AppendSync( p_index ) )
+    {
+        p_index->i_count--;
+        return false;
+    }
+    return true;
+}
+
+/* Binary searches for the last point with key <= value, -1 if none */
+#define SEEKINDEX_UPPER_BOUND( p_index, field, value ) do {\
+        uint32_t i_low = 0, i_high = (p_index)->i_count;\
+        while( i_low < i_high )\
+        {\
+            uint32_t i_mid = i_low + (i_high - i_low) / 2;\
+            if( (p_index)->p_points[i_mid].field <= (value) )\
+                i_low = i_mid + 1;\
+            else\
+                i_high = i_mid;\
+        }\
+        i_found = (int64_t) i_low - 1;\
+    } while(0)
+
+const mp4_seekpoint_t * MP4_SeekIndex_LookupTime( const mp4_seekindex_t *p_index,
+                                                  stime_t i_time, bool b_sync )
+{
+    if( b_sync )
+    {
+        /* same search, over the sync points only */
+        uint32_t i_low = 0, i_high = p_index->i_sync_count;
+        while( i_low < i_high )
+        {
+            uint32_t i_mid = i_low + (i_high - i_low) / 2;
+            if( p_index->p_points[p_index->p_sync[i_mid]].i_time <= i_time )
+                i_low = i_mid + 1;
+            else
+                i_high = i_mid;
+        }
+        return i_low ? &p_index->p_points[p_index->p_sync[i_low - 1]] : NULL;
+    }
+
+    int64_t i_found;
+    SEEKINDEX_UPPER_BOUND( p_index, i_time, i_time );
+    return ( i_found >= 0 ) ? &p_index->p_points[i_found] : NULL;
+}
+
+const mp4_seekpoint_t * MP4_SeekIndex_LookupSample( const mp4_seekindex_t *p_index,
+                                                    uint32_t i_sample )
+{
+    int64_t i_found;
+    if( p_index->i_count == 0 )
+        return NULL;
+    SEEKINDEX_UPPER_BOUND( p_index, i_sample, i_sample );
+    return &p_index->p_points[ ( i_found >= 0 ) ? i_found : 0 ];
+}
+
+const mp4_seekpoint_t * MP4_SeekIndex_LookupPos( const mp4_seekindex_t *p_index,
+                                                 uint64_t i_pos )
+{
+    int64_t i_found;
+    SEEKINDEX_UPPER_BOUND( p_index, i_pos, i_pos );
+    return ( i_found >= 0 ) ? &p_index->p_points[i_found] : NULL;
+}
+
+/*****************************************************************************
+ * On disk cache
+ *****************************************************************************
+ * "VLCMP4SI", version, tracks count, then for each track its ID and points
+ * count followed by the points. All values are big endian.
+ *****************************************************************************/
+#define SEEKINDEX_MAGIC     "VLCMP4SI"
+#define SEEKINDEX_VERSION   1
+#define SEEKINDEX_POINT_SIZE 24
+/* Cache limits: the least recently written indexes are removed first */
+#define SEEKINDEX_MAX_FILES 256
+#define SEEKINDEX_MAX_AGE   (90 * 24 * 3600) /* seconds */
+
+static char * SeekIndex_GetDir( bool b_create )
+{
+    char *psz_cachedir = config_GetUserDir( VLC_CACHE_DIR );
+    if( !psz_cachedir )
+        return NULL;
+
+    char *psz_path;
+    if( b_create )
+        vlc_mkdir( psz_cachedir, 0700 );
+    if( asprintf( &psz_path, "%s"DIR_SEP"mp4index", psz_cachedir ) == -1 )
+        psz_path = NULL;
+    free( psz_cachedir );
+    return psz_path;
+}
+
+static char * SeekIndex_GetPath( const char *psz_key, bool b_create )
+{
+    char *psz_path = SeekIndex_GetDir( b_create );
+    if( !psz_path )
+        return NULL;
+
+    if( b_create && vlc_mkdir( psz_path, 0700 ) != 0 && errno != EEXIST )
+    {
+        free( psz_path );
+        return NULL;
+    }
+
+    char *psz_file;
+    if( asprintf( &psz_file, "%s"DIR_SEP"%s", psz_path, psz_key ) == -1 )
+        psz_file = NULL;
+    free( psz_path );
+    return psz_file;
+}
+
+typedef struct
+{
+    char  *psz_path;
+    time_t i_mtime;
+} seekindex_file_t;
+
+static int SeekIndex_CmpFiles( const void *a, const void *b )
+{
+    const seekindex_file_t *p_a = a, *p_b = b;
+    return ( p_a->i_mtime > p_b->i_mtime ) - ( p_a->i_mtime < p_b->i_mtime );
+}
+
+/* Removes the indexes older than SEEKINDEX_MAX_AGE, then the oldest ones
+ * past SEEKINDEX_MAX_FILES */
+static void SeekIndex_Prune( vlc_object_t *p_obj )
+{
+    char *psz_dir = SeekIndex_GetDir( false );
+    if( !psz_dir )
+        return;
+
+    DIR *p_dir = vlc_opendir( psz_dir );
+    if( !p_dir )
+    {
+        free( psz_dir );
+        return;
+    }
+
+    seekindex_file_t *p_files = NULL;
+    size_t i_files = 0, i_alloc = 0;
+    const time_t i_now = time( NULL );
+    const char *psz_name;
+
+    while( ( psz_name = vlc_readdir( p_dir ) ) != NULL )
+    {
+        char *psz_path;
+        struct stat st;
+
+        if( psz_name[0] == '.' ||
+            asprintf( &psz_path, "%s"DIR_SEP"%s", psz_dir, psz_name ) == -1 )
+            continue;
+        if( vlc_stat( psz_path, &st ) || !S_ISREG( st.st_mode ) )
+        {
+            free( psz_path );
+            continue;
+        }
+        if( i_now - st.st_mtime > SEEKINDEX_MAX_AGE )
+        {
+            vlc_unlink( psz_path );
+            free( psz_path );
+            continue;
+        }
+
+        if( i_files == i_alloc )
+        {
+            size_t i_new = i_alloc ? i_alloc * 2 : 64;
+            seekindex_file_t *p_realloc = realloc( p_files, i_new * sizeof(*p_files) );
+            if( !p_realloc )
+            {
+                free( psz_path );
+                break;
+            }
+            p_files = p_realloc;
+            i_alloc = i_new;
+        }
+        p_files[i_files].psz_path = psz_path;
+        p_files[i_files].i_mtime = st.st_mtime;
+        i_files++;
+    }
+    closedir( p_dir );
+    free( psz_dir );
+
+    if( i_files > SEEKINDEX_MAX_FILES )
+    {
+        msg_Dbg( p_obj, "removing %zu old seek indexes",
+                 i_files - SEEKINDEX_MAX_FILES );
+        qsort( p_files, i_files, sizeof(*p_files), SeekIndex_CmpFiles );
+        for( size_t i = 0; i < i_files - SEEKINDEX_MAX_FILES; i++ )
+            vlc_unlink( p_files[i].psz_path );
+    }
+    for( size_t i = 0; i < i_files; i++ )
+        free( p_files[i].psz_path );
+    free( p_files );
+}
+
+static bool SeekIndex_Read( FILE *p_file, void *p_buf, size_t i_size )
+{
+    return fread( p_buf, 1, i_size, p_file ) == i_size;
+}
+
+int MP4_SeekIndex_Load( vlc_object_t *p_obj, const char *psz_key,
+                        mp4_seekindex_t *p_indexes, unsigned i_indexes )
+{
+    char *psz_file = SeekIndex_GetPath( psz_key, false );
+    if( !psz_file )
+        return VLC_ENOMEM;
+
+    FILE *p_file = vlc_fopen( psz_file, "rb" );
+    if( !p_file )
+    {
+        free( psz_file );
+        return VLC_EGENERIC;
+    }
+
+    uint8_t header[16];
+    unsigned i_loaded = 0;
+    struct stat st;
+    if( fstat( fileno( p_file ), &st ) || st.st_size < 16 ||
+        !SeekIndex_Read( p_file, header, 16 ) ||
+        memcmp( header, SEEKINDEX_MAGIC, 8 ) ||
+        GetDWBE( &header[8] ) != SEEKINDEX_VERSION )
+        goto error;
+
+    /* Counts are checked against the file size before use */
+    uint64_t i_left = st.st_size - 16;
+
+    for( uint32_t i_tracks = GetDWBE( &header[12] ); i_tracks > 0; i_tracks-- )
+    {
+        uint8_t track[8];
+        if( i_left < 8 || !SeekIndex_Read( p_file, track, 8 ) )
+            goto error;
+        i_left -= 8;
+
+        const uint32_t i_track_ID = GetDWBE( &track[0] );
+        const uint32_t i_count = GetDWBE( &track[4] );
+        if( i_count > i_left / SEEKINDEX_POINT_SIZE )
+            goto error;
+        i_left -= (uint64_t) i_count * SEEKINDEX_POINT_SIZE;
+
+        mp4_seekindex_t *p_index = NULL;
+        for( unsigned i = 0; i < i_indexes; i++ )
+        {
+            if( p_indexes[i].i_track_ID == i_track_ID )
+            {
+                p_index = &p_indexes[i];
+                break;
+            }
+        }
+
+        if( !p_index || p_index->i_count )
+        {
+            /* unknown or duplicate track */
+            if( fseeko( p_file, (off_t) i_count * SEEKINDEX_POINT_SIZE, SEEK_CUR ) )
+                goto error;
+            continue;
+        }
+
+        if( !SeekIndex_Reserve( p_index, i_count ) )
+            goto error;
+
+        for( uint32_t i = 0; i < i_count; i++ )
+        {
+            uint8_t point[SEEKINDEX_POINT_SIZE];
+            if( !SeekIndex_Read( p_file, point, SEEKINDEX_POINT_SIZE ) )
+                goto error;
+            p_index->p_points[i].i_time = (stime_t) GetQWBE( &point[0] );
+            p_index->p_points[i].i_pos = GetQWBE( &point[8] );
+            p_index->p_points[i].i_sample = GetDWBE( &point[16] );
+            p_index->p_points[i].i_flags = GetDWBE( &point[20] );
+            if( i > 0 && p_index->p_points[i].i_time < p_index->p_points[i - 1].i_time )
+                goto error;
+            p_index->i_count = i + 1;
+            if( ( p_index->p_points[i].i_flags & MP4_SEEKPOINT_SYNC ) &&
+                !SeekIndex_AppendSync( p_index ) )
+                goto error;
+        }
+        i_loaded++;
+    }
+
+    if( i_loaded != i_indexes )
+        goto error;
+
+    fclose( p_file );
+    msg_Dbg( p_obj, "loaded seek index from %s", psz_file );
+    free( psz_file );
+    return VLC_SUCCESS;
+
+error:
+    fclose( p_file );
+    msg_Warn( p_obj, "discarding invalid seek index %s", psz_file );
+    free( psz_file );
+    for( unsigned i = 0; i < i_indexes; i++ )
+        MP4_SeekIndex_Clean( &p_indexes[i] );
+    return VLC_EGENERIC;
+}
+
+int MP4_SeekIndex_Save( vlc_object_t *p_obj, const char *psz_key,
+                        const mp4_seekindex_t *p_indexes, unsigned i_indexes )
+{
+    char *psz_file = SeekIndex_GetPath( psz_key, true );
+    if( !psz_file )
+        return VLC_ENOMEM;
+
+    char *psz_tmp;
+    if( asprintf( &psz_tmp, "%s.tmp%"PRIu32, psz_file, (uint32_t) getpid() ) == -1 )
+    {
+        free( psz_file );
+        return VLC_ENOMEM;
+    }
+
+    FILE *p_file = vlc_fopen( psz_tmp, "wb" );
+    if( !p_file )
+    {
+        msg_Warn( p_obj, "cannot create seek index %s: %s", psz_tmp,
+                  vlc_strerror_c(errno) );
+        free( psz_tmp );
+        free( psz_file );
+        return VLC_EGENERIC;
+    }
+
+    uint8_t header[16];
+    memcpy( header, SEEKINDEX_MAGIC, 8 );
+    SetDWBE( &header[8], SEEKINDEX_VERSION );
+    SetDWBE( &header[12], i_indexes );
+    bool b_error = fwrite( header, 1, 16, p_file ) != 16;
+
+    for( unsigned i = 0; i < i_indexes && !b_error; i++ )
+    {
+        const mp4_seekindex_t *p_index = &p_indexes[i];
+        uint8_t track[8];
+        SetDWBE( &track[0], p_index->i_track_ID );
+        SetDWBE( &track[4], p_index->i_count );
+        b_error = fwrite( track, 1, 8, p_file ) != 8;
+
+        for( uint32_t j = 0; j < p_index->i_count && !b_error; j++ )
+        {
+            uint8_t point[SEEKINDEX_POINT_SIZE];
+            SetQWBE( &point[0], (uint64_t) p_index->p_points[j].i_time );
+            SetQWBE( &point[8], p_index->p_points[j].i_pos );
+            SetDWBE( &point[16], p_index->p_points[j].i_sample );
+            SetDWBE( &point[20], p_index->p_points[j].i_flags );
+            b_error = fwrite( point, 1, SEEKINDEX_POINT_SIZE, p_file ) != SEEKINDEX_POINT_SIZE;
+        }
+    }
+
+    if( fclose( p_file ) )
+        b_error = true;
+
+    /* atomic replacement, concurrent readers never see a partial file */
+    if( b_error || vlc_rename( psz_tmp, psz_file ) )
+    {
+        msg_Warn( p_obj, "cannot write seek index %s", psz_file );
+        vlc_unlink( psz_tmp );
+        free( psz_tmp );
+        free( psz_file );
+        return VLC_EGENERIC;
+    }
+
+    msg_Dbg( p_obj, "saved seek index to %s", psz_file );
+    free( psz_tmp );
+    free( psz_file );
+    SeekIndex_Prune( p_obj );
+    return VLC_SUCCESS;
+}
@@ -0,0 +1,76 @@
+/*****************************************************************************
+ * seekindex.h : MP4 tracks seek index
+ *****************************************************************************
+ * Copyright (C) 2016 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+#ifndef VLC_MP4_SEEKINDEX_H_
+#define VLC_MP4_SEEKINDEX_H_
+
+#include <vlc_common.h>
+#include "libmp4.h"
+
+#define MP4_SEEKPOINT_SYNC  (1<<0)
+
+/* A seek point: a sync sample of a track, or the start of a track run in
+ * a fragment */
+typedef struct
+{
+    stime_t  i_time;    /* decoding time, track scaled */
+    uint64_t i_pos;     /* file offset of the sample, or of its moof */
+    uint32_t i_sample;  /* sample number (unfragmented tracks only) */
+    uint32_t i_flags;
+} mp4_seekpoint_t;
+
+/* Seek points of a track, sorted by time, position and sample number */
+typedef struct
+{
+    unsigned int     i_track_ID;
+    uint32_t         i_count;
+    uint32_t         i_alloc;
+    mp4_seekpoint_t *p_points;
+    /* indexes of the sync points, for sync lookups in O(log n) */
+    uint32_t         i_sync_count;
+    uint32_t         i_sync_alloc;
+    uint32_t        *p_sync;
+} mp4_seekindex_t;
+
+void MP4_SeekIndex_Init( mp4_seekindex_t *, unsigned int i_track_ID );
+void MP4_SeekIndex_Clean( mp4_seekindex_t * );
+bool MP4_SeekIndex_Append( mp4_seekindex_t *, stime_t i_time, uint64_t i_pos,
+                           uint32_t i_sample, uint32_t i_flags );
+
+/* Returns the last point at or before the given time (sync only if b_sync),
+ * or NULL */
+const mp4_seekpoint_t * MP4_SeekIndex_LookupTime( const mp4_seekindex_t *,
+                                                  stime_t i_time, bool b_sync );
+/* Returns the last point at or before the given sample, or the first one */
+const mp4_seekpoint_t * MP4_SeekIndex_LookupSample( const mp4_seekindex_t *,
+                                                    uint32_t i_sample );
+/* Returns the last point at or before the given position, or NULL */
+const mp4_seekpoint_t * MP4_SeekIndex_LookupPos( const mp4_seekindex_t *,
+                                                 uint64_t i_pos );
+
+/* On disk cache of the indexes of all the tracks of a file. psz_key
+ * identifies the file. Load fills the indexes matching the track IDs of
+ * p_indexes, and fails if the file has not all of them. Save removes the
+ * oldest cached indexes past a count and an age limit. */
+int MP4_SeekIndex_Load( vlc_object_t *, const char *psz_key,
+                        mp4_seekindex_t *p_indexes, unsigned i_indexes );
+int MP4_SeekIndex_Save( vlc_object_t *, const char *psz_key,
+                        const mp4_seekindex_t *p_indexes, unsigned i_indexes );
+
+#endif
@@ -179,6 +179,7 @@ static bool GatherPESData( demux_t *p_demux, ts_pid_t *pid, block_t *p_bk, size_
 static void ProgramSetPCR( demux_t *p_demux, ts_pmt_t *p_prg, mtime_t i_pcr );
 
 static block_t* ReadTSPacket( demux_t *p_demux );
+static block_t* ReadDescrambledTSPacket( demux_t *p_demux );
 static int SeekToTime( demux_t *p_demux, const ts_pmt_t *, int64_t time );
 static void ReadyQueuesPostSeek( demux_t *p_demux );
 static void PCRHandle( demux_t *p_demux, ts_pid_t *, mtime_t );
@@ -190,6 +191,14 @@ static void PCRFixHandle( demux_t *, ts_pmt_t *, block_t * );
 #define TS_PACKET_SIZE_MAX 204
 #define TS_HEADER_SIZE 4
 
+/* Number of packets read ahead to be descrambled together: twice the lanes
+ * of the descrambler, as even and odd packets are descrambled separately and
+ * some packets are in the clear, but at least 256 */
+#define TS_CSA_BATCH_MIN 256
+#define TS_CSA_BATCH_MAX (2 * 256)
+/* Set on packets that were scrambled before being read ahead */
+#define BLOCK_FLAG_PRIVATE_DESCRAMBLED (1 << BLOCK_FLAG_PRIVATE_SHIFT)
+
 static int DetectPacketSize( demux_t *p_demux, unsigned *pi_header_size, int i_offset )
 {
     const uint8_t *p_peek;
@@ -385,6 +394,7 @@ static int Open( vlc_object_t *p_this )
     p_sys->i_packet_header_size = i_packet_header_size;
     p_sys->i_ts_read = 50;
     p_sys->csa = NULL;
+    p_sys->p_csa_queue = NULL;
     p_sys->b_start_record = false;
 
     p_sys->patfix.i_first_dts = -1;
@@ -539,6 +549,7 @@ static void Close( vlc_object_t *p_this )
         csa_Delete( p_sys->csa );
     }
     vlc_mutex_unlock( &p_sys->csa_lock );
+    block_ChainRelease( p_sys->p_csa_queue );
 
     ARRAY_RESET( p_sys->programs );
 
@@ -603,7 +614,7 @@ static int Demux( demux_t *p_demux )
     {
         bool         b_frame = false;
         block_t     *p_pkt;
-        if( !(p_pkt = ReadTSPacket( p_demux )) )
+        if( !(p_pkt = ReadDescrambledTSPacket( p_demux )) )
         {
             return VLC_DEMUXER_EOF;
         }
@@ -619,10 +630,12 @@ static int Demux( demux_t *p_demux )
         /* Parse the TS packet */
         ts_pid_t *p_pid = GetPID( p_sys, PIDGet( p_pkt ) );
 
+        const bool b_scrambled = (p_pkt->p_buffer[3] & 0x80) ||
+                                 (p_pkt->i_flags & BLOCK_FLAG_PRIVATE_DESCRAMBLED);
         if( (p_pkt->p_buffer[1] & 0x40) && (p_pkt->p_buffer[3] & 0x10) &&
-            !SCRAMBLED(*p_pid) != !(p_pkt->p_buffer[3] & 0x80) )
+            !SCRAMBLED(*p_pid) != !b_scrambled )
         {
-            UpdatePIDScrambledState( p_demux, p_pid, p_pkt->p_buffer[3] & 0x80 );
+            UpdatePIDScrambledState( p_demux, p_pid, b_scrambled );
         }
 
         if( !SEEN(p_pid) )
@@ -1666,6 +1679,64 @@ static block_t* ReadTSPacket( demux_t *p_demux )
     return p_pkt;
 }
 
+/* With CSA keys, packets are read ahead, so that they can be descrambled
+ * in batches, much faster than one by one. */
+static block_t* ReadDescrambledTSPacket( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+
+    if( !p_sys->csa )
+        return ReadTSPacket( p_demux );
+
+    if( !p_sys->p_csa_queue )
+    {
+        block_t **pp_last = &p_sys->p_csa_queue;
+        uint8_t *pkts[TS_CSA_BATCH_MAX];
+        unsigned i_scrambled = 0;
+        unsigned i_batch = 2 * csa_GetBatchLanes( p_sys->csa );
+
+        if( i_batch < TS_CSA_BATCH_MIN )
+            i_batch = TS_CSA_BATCH_MIN;
+        assert( i_batch <= TS_CSA_BATCH_MAX );
+
+        for( unsigned i = 0; i < i_batch; i++ )
+        {
+            block_t *p_pkt = ReadTSPacket( p_demux );
+            if( !p_pkt )
+                break;
+            block_ChainLastAppend( &pp_last, p_pkt );
+
+            if( !(p_pkt->p_buffer[3] & 0x80) )
+                continue;
+
+            /* Only descramble what ProcessTSPacket() will use */
+            const ts_pid_t *p_pid = GetPID( p_sys, PIDGet( p_pkt ) );
+            if( p_pid->type == TYPE_PES &&
+                ( p_sys->b_access_control || (p_pid->i_flags & FLAG_FILTERED) ) )
+            {
+                p_pkt->i_flags |= BLOCK_FLAG_PRIVATE_DESCRAMBLED;
+                pkts[i_scrambled++] = p_pkt->p_buffer;
+            }
+        }
+
+        if( i_scrambled > 0 )
+        {
+            vlc_mutex_lock( &p_sys->csa_lock );
+            csa_DecryptBatch( p_sys->csa, pkts, i_scrambled,
+                              p_sys->i_csa_pkt_size );
+            vlc_mutex_unlock( &p_sys->csa_lock );
+        }
+    }
+
+    block_t *p_pkt = p_sys->p_csa_queue;
+    if( p_pkt )
+    {
+        p_sys->p_csa_queue = p_pkt->p_next;
+        p_pkt->p_next = NULL;
+    }
+    return p_pkt;
+}
+
 static mtime_t GetPCR( const block_t *p_pkt )
 {
     const uint8_t *p = p_pkt->p_buffer;
@@ -1737,6 +1808,10 @@ static void ReadyQueuesPostSeek( demux_t *p_demux )
 {
     demux_sys_t *p_sys = p_demux->p_sys;
 
+    /* Packets read ahead are from before the seek */
+    block_ChainRelease( p_sys->p_csa_queue );
+    p_sys->p_csa_queue = NULL;
+
     ts_pat_t *p_pat = GetPID(p_sys, 0)->u.p_pat;
     for( int i=0; i< p_pat->programs.i_size; i++ )
     {
@@ -93,6 +93,7 @@ struct demux_sys_t
 
     csa_t       *csa;
     int         i_csa_pkt_size;
+    block_t     *p_csa_queue; /* packets read ahead and descrambled at once */
     bool        b_split_es;
     bool        b_valid_scrambling;
 
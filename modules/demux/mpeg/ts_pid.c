@@ -40,8 +40,7 @@ void ts_pid_list_Init( ts_pid_list_t *p_list )
     p_list->pp_all = NULL;
     p_list->i_all = 0;
     p_list->i_all_alloc = 0;
-    p_list->i_last_pid = 0;
-    p_list->p_last = NULL;
+    memset( p_list->i_index, 0, sizeof(p_list->i_index) );
 }
 
 void ts_pid_list_Release( demux_t *p_demux, ts_pid_list_t *p_list )
@@ -69,20 +68,12 @@ ts_pid_t * ts_pid_Get( ts_pid_list_t *p_list, uint16_t i_pid )
         case 0x1FFF:
             return &p_list->dummy;
         default:
-            if( p_list->i_last_pid == i_pid )
-                return p_list->p_last;
         break;
     }
 
-    for( int i=0; i < p_list->i_all; i++ )
-    {
-        if( p_list->pp_all[i]->i_pid == i_pid )
-        {
-            p_list->p_last = p_list->pp_all[i];
-            p_list->i_last_pid = i_pid;
-            return p_list->p_last;
-        }
-    }
+    i_pid &= 0x1FFF;
+    if( likely(p_list->i_index[i_pid]) )
+        return p_list->pp_all[p_list->i_index[i_pid] - 1];
 
     if( p_list->i_all >= p_list->i_all_alloc )
     {
@@ -106,9 +97,7 @@ ts_pid_t * ts_pid_Get( ts_pid_list_t *p_list, uint16_t i_pid )
 
     p_pid->i_pid = i_pid;
     p_list->pp_all[p_list->i_all++] = p_pid;
-
-    p_list->p_last = p_pid;
-    p_list->i_last_pid = i_pid;
+    p_list->i_index[i_pid] = p_list->i_all;
 
     return p_pid;
 }
@@ -86,9 +86,8 @@ struct ts_pid_list_t
     ts_pid_t **pp_all;
     int        i_all;
     int        i_all_alloc;
-    /* last recently used */
-    uint16_t   i_last_pid;
-    ts_pid_t  *p_last;
+    /* direct lookup: pp_all index + 1 by 13 bits pid, 0 if not allocated */
+    uint16_t   i_index[0x2000];
 
 };
 
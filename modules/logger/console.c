@@ -34,6 +34,12 @@
 static const int ptr_width = 2 * /* hex digits */ sizeof (uintptr_t);
 static const char msg_type[4][9] = { "", " error", " warning", " debug" };
 
+typedef struct
+{
+    int verbosity;
+    vlc_log_async_t *async;
+} vlc_logger_sys_t;
+
 #ifndef _WIN32
 # define COL(x,y) "\033[" #x ";" #y "m"
 # define RED      COL(31,1)
@@ -47,9 +53,9 @@ static void LogConsoleColor(void *opaque, int type, const vlc_log_t *meta,
                             const char *format, va_list ap)
 {
     FILE *stream = stderr;
-    int verbose = (intptr_t)opaque;
+    const vlc_logger_sys_t *sys = opaque;
 
-    if (verbose < type)
+    if (sys->verbosity < type)
         return;
 
     flockfile(stream);
@@ -69,9 +75,9 @@ static void LogConsoleGray(void *opaque, int type, const vlc_log_t *meta,
                            const char *format, va_list ap)
 {
     FILE *stream = stderr;
-    int verbose = (intptr_t)opaque;
+    const vlc_logger_sys_t *sys = opaque;
 
-    if (verbose < type)
+    if (sys->verbosity < type)
         return;
 
     flockfile(stream);
@@ -85,6 +91,17 @@ static void LogConsoleGray(void *opaque, int type, const vlc_log_t *meta,
     funlockfile(stream);
 }
 
+static void LogAsync(void *opaque, int type, const vlc_log_t *meta,
+                     const char *format, va_list ap)
+{
+    const vlc_logger_sys_t *sys = opaque;
+
+    if (sys->verbosity < type)
+        return;
+
+    vlc_LogAsync(sys->async, type, meta, format, ap);
+}
+
 static vlc_log_cb Open(vlc_object_t *obj, void **sysp)
 {
     int verbosity = -1;
@@ -101,14 +118,37 @@ static vlc_log_cb Open(vlc_object_t *obj, void **sysp)
     if (verbosity < 0)
         return NULL;
 
-    verbosity += VLC_MSG_ERR;
-    *sysp = (void *)(uintptr_t)verbosity;
+    vlc_logger_sys_t *sys = malloc(sizeof (*sys));
+    if (unlikely(sys == NULL))
+        return NULL;
+
+    sys->verbosity = verbosity + VLC_MSG_ERR;
+    sys->async = NULL;
 
+    vlc_log_cb cb = LogConsoleGray;
 #if defined (HAVE_ISATTY) && !defined (_WIN32)
     if (isatty(STDERR_FILENO) && var_InheritBool(obj, "color"))
-        return LogConsoleColor;
+        cb = LogConsoleColor;
 #endif
-    return LogConsoleGray;
+
+    if (var_InheritBool(obj, "log-async"))
+    {
+        sys->async = vlc_LogAsyncCreate(cb, sys);
+        if (sys->async != NULL)
+            cb = LogAsync;
+    }
+
+    *sysp = sys;
+    return cb;
+}
+
+static void Close(void *opaque)
+{
+    vlc_logger_sys_t *sys = opaque;
+
+    if (sys->async != NULL)
+        vlc_LogAsyncDestroy(sys->async);
+    free(sys);
 }
 
 #define QUIET_TEXT N_("Be quiet")
@@ -120,7 +160,7 @@ vlc_module_begin()
     set_category(CAT_ADVANCED)
     set_subcategory(SUBCAT_ADVANCED_MISC)
     set_capability("logger", 10)
-    set_callbacks(Open, NULL)
+    set_callbacks(Open, Close)
 
     add_bool("quiet", false, QUIET_TEXT, QUIET_LONGTEXT, false)
         change_short('q')
@@ -42,6 +42,7 @@ typedef struct
     FILE *stream;
     const char *footer;
     int verbosity;
+    vlc_log_async_t *async;
 } vlc_logger_sys_t;
 
 #define TEXT_FILENAME "vlc-log.txt"
@@ -105,6 +106,17 @@ static void LogHtml(void *opaque, int type, const vlc_log_t *meta,
     funlockfile(stream);
 }
 
+static void LogAsync(void *opaque, int type, const vlc_log_t *meta,
+                     const char *format, va_list ap)
+{
+    vlc_logger_sys_t *sys = opaque;
+
+    if (sys->verbosity < type)
+        return;
+
+    vlc_LogAsync(sys->async, type, meta, format, ap);
+}
+
 static vlc_log_cb Open(vlc_object_t *obj, void **restrict sysp)
 {
     if (!var_InheritBool(obj, "file-logging"))
@@ -176,6 +188,14 @@ static vlc_log_cb Open(vlc_object_t *obj, void **restrict sysp)
     setvbuf(sys->stream, NULL, _IONBF, 0);
     fputs(header, sys->stream);
 
+    sys->async = NULL;
+    if (var_InheritBool(obj, "log-async"))
+    {
+        sys->async = vlc_LogAsyncCreate(cb, sys);
+        if (sys->async != NULL)
+            cb = LogAsync;
+    }
+
     *sysp = sys;
     return cb;
 }
@@ -184,6 +204,8 @@ static void Close(void *opaque)
 {
     vlc_logger_sys_t *sys = opaque;
 
+    if (sys->async != NULL)
+        vlc_LogAsyncDestroy(sys->async);
     fputs(sys->footer, sys->stream);
     fclose(sys->stream);
     free(sys);
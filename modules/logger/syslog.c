@@ -37,6 +37,13 @@ static const int priorities[4] = {
     [VLC_MSG_DBG]  = LOG_DEBUG,
 };
 
+typedef struct
+{
+    char *ident;
+    bool debug;
+    vlc_log_async_t *async;
+} vlc_logger_sys_t;
+
 static void Log(void *opaque, int type, const vlc_log_t *meta,
                 const char *format, va_list ap)
 {
@@ -101,15 +108,31 @@ static int var_InheritFacility(vlc_object_t *obj, const char *varname)
 
 static const char default_ident[] = PACKAGE;
 
+static void LogAsync(void *opaque, int type, const vlc_log_t *meta,
+                     const char *format, va_list ap)
+{
+    vlc_logger_sys_t *sys = opaque;
+
+    /* Do not queue messages that the priority filter would discard */
+    if (type == VLC_MSG_DBG && !sys->debug)
+        return;
+
+    vlc_LogAsync(sys->async, type, meta, format, ap);
+}
+
 static vlc_log_cb Open(vlc_object_t *obj, void **sysp)
 {
     if (!var_InheritBool(obj, "syslog"))
         return NULL;
 
+    vlc_logger_sys_t *sys = malloc(sizeof (*sys));
+    if (unlikely(sys == NULL))
+        return NULL;
+
     char *ident = var_InheritString(obj, "syslog-ident");
     if (ident == NULL)
         ident = (char *)default_ident;
-    *sysp = ident;
+    sys->ident = ident;
 
     /* Open log */
     int facility = var_InheritFacility(obj, "syslog-facility");
@@ -118,21 +141,36 @@ static vlc_log_cb Open(vlc_object_t *obj, void **sysp)
 
     /* Set priority filter */
     int mask = LOG_MASK(LOG_ERR) | LOG_MASK(LOG_WARNING) | LOG_MASK(LOG_INFO);
-    if (var_InheritBool(obj, "syslog-debug"))
+    sys->debug = var_InheritBool(obj, "syslog-debug");
+    if (sys->debug)
         mask |= LOG_MASK(LOG_DEBUG);
 
     setlogmask(mask);
 
-    return Log;
+    vlc_log_cb cb = Log;
+
+    sys->async = NULL;
+    if (var_InheritBool(obj, "log-async"))
+    {
+        sys->async = vlc_LogAsyncCreate(cb, sys);
+        if (sys->async != NULL)
+            cb = LogAsync;
+    }
+
+    *sysp = sys;
+    return cb;
 }
 
 static void Close(void *opaque)
 {
-    char *ident = opaque;
+    vlc_logger_sys_t *sys = opaque;
 
+    if (sys->async != NULL)
+        vlc_LogAsyncDestroy(sys->async);
     closelog();
-    if (ident != default_ident)
-        free(ident);
+    if (sys->ident != default_ident)
+        free(sys->ident);
+    free(sys);
 }
 
 #define SYSLOG_TEXT N_("System log (syslog)")
@@ -26,10 +26,21 @@
 # include "config.h"
 #endif
 
+#include <assert.h>
+
 #include <vlc_common.h>
+#include <vlc_cpu.h>
 
 #include "csa.h"
 
+/* Bitsliced descramblers work on at most this many packets at once */
+#define CSA_BS_MAX_LANES 256
+
+typedef void (*csa_bs_stream_t)( const uint8_t ck[8], uint8_t *const *,
+                                 const unsigned *, unsigned );
+typedef void (*csa_bs_block_t)( const uint8_t kk[57], uint8_t *const *,
+                                const unsigned *, unsigned );
+
 struct csa_t
 {
     /* odd and even keys */
@@ -47,6 +58,11 @@ struct csa_t
     int     p, q, r;
 
     bool    use_odd;
+
+    /* batch descrambler */
+    csa_bs_stream_t pf_bs_stream;
+    csa_bs_block_t  pf_bs_block;
+    unsigned        i_bs_lanes;
 };
 
 static void csa_ComputeKey( uint8_t kk[57], uint8_t ck[8] );
@@ -56,12 +72,17 @@ static void csa_StreamCypher( csa_t *c, int b_init, uint8_t *ck, uint8_t *sb, ui
 static void csa_BlockDecypher( uint8_t kk[57], uint8_t ib[8], uint8_t bd[8] );
 static void csa_BlockCypher( uint8_t kk[57], uint8_t bd[8], uint8_t ib[8] );
 
+static void csa_BatchInit( csa_t * );
+
 /*****************************************************************************
  * csa_New:
  *****************************************************************************/
 csa_t *csa_New( void )
 {
-    return calloc( 1, sizeof( csa_t ) );
+    csa_t *c = calloc( 1, sizeof( csa_t ) );
+    if( c )
+        csa_BatchInit( c );
+    return c;
 }
 
 /*****************************************************************************
@@ -138,55 +159,23 @@ int csa_UseKey( vlc_object_t *p_caller, csa_t *c, bool use_odd )
 /*****************************************************************************
  * csa_Decrypt:
  *****************************************************************************/
-void csa_Decrypt( csa_t *c, uint8_t *pkt, int i_pkt_size )
+static void csa_DecryptPayload( csa_t *c, uint8_t *ck, uint8_t *kk,
+                                uint8_t *p, int i_size )
 {
-    uint8_t *ck;
-    uint8_t *kk;
-
     uint8_t  ib[8], stream[8], block[8];
 
-    int     i_hdr, i_residue;
+    int     i_residue;
     int     i, j, n;
 
-    /* transport scrambling control */
-    if( (pkt[3]&0x80) == 0 )
-    {
-        /* not scrambled */
-        return;
-    }
-    if( pkt[3]&0x40 )
-    {
-        ck = c->o_ck;
-        kk = c->o_kk;
-    }
-    else
-    {
-        ck = c->e_ck;
-        kk = c->e_kk;
-    }
-
-    /* clear transport scrambling control */
-    pkt[3] &= 0x3f;
-
-    i_hdr = 4;
-    if( pkt[3]&0x20 )
-    {
-        /* skip adaption field */
-        i_hdr += pkt[4] + 1;
-    }
-
-    if( 188 - i_hdr < 8 )
-        return;
-
     /* init csa state */
-    csa_StreamCypher( c, 1, ck, &pkt[i_hdr], ib );
+    csa_StreamCypher( c, 1, ck, p, ib );
 
     /* */
-    n = (i_pkt_size - i_hdr) / 8;
+    n = i_size / 8;
     if( n < 0 )
         return;
  
-    i_residue = (i_pkt_size - i_hdr) % 8;
+    i_residue = i_size % 8;
     for( i = 1; i < n + 1; i++ )
     {
         csa_BlockDecypher( kk, ib, block );
@@ -196,7 +185,7 @@ void csa_Decrypt( csa_t *c, uint8_t *pkt, int i_pkt_size )
             for( j = 0; j < 8; j++ )
             {
                 /* xor ib with stream */
-                ib[j] = pkt[i_hdr+8*i+j] ^ stream[j];
+                ib[j] = p[8*i+j] ^ stream[j];
             }
         }
         else
@@ -210,7 +199,7 @@ void csa_Decrypt( csa_t *c, uint8_t *pkt, int i_pkt_size )
         /* xor ib with block */
         for( j = 0; j < 8; j++ )
         {
-            pkt[i_hdr+8*(i-1)+j] = ib[j] ^ block[j];
+            p[8*(i-1)+j] = ib[j] ^ block[j];
         }
     }
 
@@ -219,11 +208,51 @@ void csa_Decrypt( csa_t *c, uint8_t *pkt, int i_pkt_size )
         csa_StreamCypher( c, 0, ck, NULL, stream );
         for( j = 0; j < i_residue; j++ )
         {
-            pkt[i_pkt_size - i_residue + j] ^= stream[j];
+            p[i_size - i_residue + j] ^= stream[j];
         }
     }
 }
 
+void csa_Decrypt( csa_t *c, uint8_t *pkt, int i_pkt_size )
+{
+    uint8_t *ck;
+    uint8_t *kk;
+
+    int     i_hdr;
+
+    /* transport scrambling control */
+    if( (pkt[3]&0x80) == 0 )
+    {
+        /* not scrambled */
+        return;
+    }
+    if( pkt[3]&0x40 )
+    {
+        ck = c->o_ck;
+        kk = c->o_kk;
+    }
+    else
+    {
+        ck = c->e_ck;
+        kk = c->e_kk;
+    }
+
+    /* clear transport scrambling control */
+    pkt[3] &= 0x3f;
+
+    i_hdr = 4;
+    if( pkt[3]&0x20 )
+    {
+        /* skip adaption field */
+        i_hdr += pkt[4] + 1;
+    }
+
+    if( 188 - i_hdr < 8 )
+        return;
+
+    csa_DecryptPayload( c, ck, kk, &pkt[i_hdr], i_pkt_size - i_hdr );
+}
+
 /*****************************************************************************
  * csa_Encrypt:
  *****************************************************************************/
@@ -610,3 +639,141 @@ static void csa_BlockCypher( uint8_t kk[57], uint8_t bd[8], uint8_t ib[8] )
     }
 }
 
+
+/*****************************************************************************
+ * Batch descrambling
+ *****************************************************************************/
+#if defined(__SSE2__)
+# include <emmintrin.h>
+# define CSA_BS_WORD       __m128i
+# define CSA_BS_ZERO       _mm_setzero_si128()
+# define CSA_BS_SPLAT(c)   _mm_set1_epi64x(c)
+# define CSA_BS_SHL(w, n)  _mm_slli_epi64(w, n)
+# define CSA_BS_SHR(w, n)  _mm_srli_epi64(w, n)
+# define CSA_BS_SUFFIX     sse2
+# define CSA_BS_ATTR
+# include "csa_bs.h"
+#else
+# define CSA_BS_WORD       uint64_t
+# define CSA_BS_ZERO       UINT64_C(0)
+# define CSA_BS_SPLAT(c)   (c)
+# define CSA_BS_SHL(w, n)  ((w) << (n))
+# define CSA_BS_SHR(w, n)  ((w) >> (n))
+# define CSA_BS_SUFFIX     c
+# define CSA_BS_ATTR
+# include "csa_bs.h"
+#endif
+
+#if defined(__x86_64__) && (VLC_GCC_VERSION(4, 9) || defined(__clang__))
+# define CSA_BS_AVX2
+# include <immintrin.h>
+# define CSA_BS_WORD       __m256i
+# define CSA_BS_ZERO       _mm256_setzero_si256()
+# define CSA_BS_SPLAT(c)   _mm256_set1_epi64x(c)
+# define CSA_BS_SHL(w, n)  _mm256_slli_epi64(w, n)
+# define CSA_BS_SHR(w, n)  _mm256_srli_epi64(w, n)
+# define CSA_BS_SUFFIX     avx2
+# define CSA_BS_ATTR       __attribute__ ((__target__ ("avx2")))
+# include "csa_bs.h"
+#endif
+
+static void csa_BatchInit( csa_t *c )
+{
+#ifdef CSA_BS_AVX2
+    if( vlc_CPU_AVX2() )
+    {
+        c->pf_bs_stream = StreamCypher_avx2;
+        c->pf_bs_block = BlockDecypher_avx2;
+        c->i_bs_lanes = 8 * sizeof (__m256i);
+        return;
+    }
+#endif
+#if defined(__SSE2__)
+    c->pf_bs_stream = StreamCypher_sse2;
+    c->pf_bs_block = BlockDecypher_sse2;
+    c->i_bs_lanes = 8 * sizeof (__m128i);
+#else
+    c->pf_bs_stream = StreamCypher_c;
+    c->pf_bs_block = BlockDecypher_c;
+    c->i_bs_lanes = 8 * sizeof (uint64_t);
+#endif
+}
+
+static void csa_DecryptLanes( csa_t *c, bool odd, uint8_t *const *pp_payload,
+                              const unsigned *pi_size, unsigned i_lanes )
+{
+    uint8_t *ck = odd ? c->o_ck : c->e_ck;
+    uint8_t *kk = odd ? c->o_kk : c->e_kk;
+
+    assert( i_lanes <= c->i_bs_lanes && c->i_bs_lanes <= CSA_BS_MAX_LANES );
+
+    /* The bitsliced descrambler costs as much for few packets as for many:
+     * use the scalar one if most lanes would be wasted. */
+    if( i_lanes * 32 < c->i_bs_lanes )
+    {
+        for( unsigned i = 0; i < i_lanes; i++ )
+            csa_DecryptPayload( c, ck, kk, pp_payload[i], pi_size[i] );
+        return;
+    }
+
+    c->pf_bs_stream( ck, pp_payload, pi_size, i_lanes );
+    c->pf_bs_block( kk, pp_payload, pi_size, i_lanes );
+}
+
+unsigned csa_GetBatchLanes( const csa_t *c )
+{
+    return c->i_bs_lanes;
+}
+
+/*****************************************************************************
+ * csa_DecryptBatch:
+ *****************************************************************************/
+void csa_DecryptBatch( csa_t *c, uint8_t *const *pp_pkts, unsigned i_count,
+                       int i_pkt_size )
+{
+    /* payloads, sorted by key */
+    uint8_t *payload[2][CSA_BS_MAX_LANES];
+    unsigned size[2][CSA_BS_MAX_LANES];
+    unsigned n[2] = { 0, 0 };
+
+    for( unsigned i = 0; i < i_count; i++ )
+    {
+        uint8_t *pkt = pp_pkts[i];
+
+        /* transport scrambling control */
+        if( (pkt[3]&0x80) == 0 )
+            continue;
+
+        int i_hdr = 4;
+        if( pkt[3]&0x20 )
+        {
+            /* skip adaption field */
+            i_hdr += pkt[4] + 1;
+        }
+
+        if( 188 - i_hdr < 8 || i_pkt_size - i_hdr < 8 )
+        {
+            /* corner cases (less than one block) */
+            csa_Decrypt( c, pkt, i_pkt_size );
+            continue;
+        }
+
+        const int odd = (pkt[3]&0x40) != 0;
+
+        /* clear transport scrambling control */
+        pkt[3] &= 0x3f;
+
+        payload[odd][n[odd]] = &pkt[i_hdr];
+        size[odd][n[odd]] = i_pkt_size - i_hdr;
+
+        if( ++n[odd] == c->i_bs_lanes )
+        {
+            csa_DecryptLanes( c, odd, payload[odd], size[odd], n[odd] );
+            n[odd] = 0;
+        }
+    }
+
+    for( int odd = 0; odd < 2; odd++ )
+        if( n[odd] > 0 )
+            csa_DecryptLanes( c, odd, payload[odd], size[odd], n[odd] );
+}
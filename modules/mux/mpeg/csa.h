@@ -31,6 +31,8 @@ typedef struct csa_t csa_t;
 #define csa_UseKey  __csa_UseKey
 #define csa_Decrypt __csa_decrypt
 #define csa_Encrypt __csa_encrypt
+#define csa_DecryptBatch __csa_decrypt_batch
+#define csa_GetBatchLanes __csa_get_batch_lanes
 
 csa_t *csa_New( void );
 void   csa_Delete( csa_t * );
@@ -41,4 +43,13 @@ int    csa_UseKey( vlc_object_t *p_caller, csa_t *, bool use_odd );
 void   csa_Decrypt( csa_t *, uint8_t *pkt, int i_pkt_size );
 void   csa_Encrypt( csa_t *, uint8_t *pkt, int i_pkt_size );
 
+/* Descrambles many packets at once, several times faster than csa_Decrypt()
+ * if there are enough of them: the descramblers work on 64 to 256 packets
+ * in parallel, depending on the CPU. */
+void   csa_DecryptBatch( csa_t *, uint8_t *const *pp_pkts, unsigned i_count,
+                         int i_pkt_size );
+/* Number of packets descrambled in parallel (per key) by the selected
+ * descrambler, at most 256. */
+unsigned csa_GetBatchLanes( const csa_t * );
+
 #endif /* _CSA_H */
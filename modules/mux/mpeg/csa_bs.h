@@ -0,0 +1,499 @@
+/*****************************************************************************
+ * csa_bs.h: bitsliced CSA descrambler kernels
+ *****************************************************************************
+ * Copyright (C) 2016 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/* This file is a template included by csa.c once per machine word type.
+ * The following macros must be defined before inclusion:
+ *  CSA_BS_WORD       word type, supporting the ~ & | ^ operators
+ *  CSA_BS_ZERO       word with all bits cleared
+ *  CSA_BS_SPLAT(c)   word with every 64-bits element set to c
+ *  CSA_BS_SHL(w, n)  shift of every 64-bits element of w left by n bits
+ *  CSA_BS_SHR(w, n)  shift of every 64-bits element of w right by n bits
+ *  CSA_BS_SUFFIX     suffix of the generated function names
+ *  CSA_BS_ATTR       attributes of the generated functions
+ *
+ * The stream cypher is bitsliced: each bit of a word belongs to a different
+ * packet, bit l of the word being bit (l % 64) of its (l / 64)th 64-bits
+ * element. The block cypher is byte-sliced: each byte of a register belongs
+ * to a different packet, and only the S-box lookup is done byte by byte.
+ */
+
+#define CSA_BS_CAT2(a, b) a##_##b
+#define CSA_BS_CAT(a, b) CSA_BS_CAT2(a, b)
+#define CSA_BS(name) CSA_BS_CAT(name, CSA_BS_SUFFIX)
+
+/** Number of packets processed in parallel */
+#define CSA_BS_LANES (8 * sizeof (CSA_BS_WORD))
+
+/* Stream cypher S-boxes, as boolean functions of their 5 input bits */
+CSA_BS_ATTR
+static inline void CSA_BS(sbox1)( CSA_BS_WORD i4, CSA_BS_WORD i3,
+                                  CSA_BS_WORD i2, CSA_BS_WORD i1,
+                                  CSA_BS_WORD i0, CSA_BS_WORD *o1,
+                                  CSA_BS_WORD *o0 )
+{
+    const CSA_BS_WORD t0 = ~i0;
+    const CSA_BS_WORD t1 = t0 ^ i4;
+    const CSA_BS_WORD t2 = t1 | i2;
+    const CSA_BS_WORD t3 = i4 & t0;
+    const CSA_BS_WORD t4 = t0 & ~i4;
+    const CSA_BS_WORD t5 = t3 ^ (i2 & t0);
+    const CSA_BS_WORD t6 = t2 ^ (i1 & (t2 ^ t5));
+    const CSA_BS_WORD t7 = ~i2;
+    const CSA_BS_WORD t8 = ~t1;
+    const CSA_BS_WORD t9 = t7 ^ (i1 & t8);
+    const CSA_BS_WORD t10 = t6 ^ (i3 & (t6 ^ t9));
+    const CSA_BS_WORD t11 = i4 & i0;
+    const CSA_BS_WORD t12 = t11 ^ (i2 & i0);
+    const CSA_BS_WORD t13 = t12 ^ i1;
+    const CSA_BS_WORD t14 = t4 | i2;
+    const CSA_BS_WORD t15 = t14 ^ (i1 & t1);
+    const CSA_BS_WORD t16 = t13 ^ (i3 & (t13 ^ t15));
+    *o1 = t10;
+    *o0 = t16;
+}
+
+CSA_BS_ATTR
+static inline void CSA_BS(sbox2)( CSA_BS_WORD i4, CSA_BS_WORD i3,
+                                  CSA_BS_WORD i2, CSA_BS_WORD i1,
+                                  CSA_BS_WORD i0, CSA_BS_WORD *o1,
+                                  CSA_BS_WORD *o0 )
+{
+    const CSA_BS_WORD t0 = ~i1;
+    const CSA_BS_WORD t1 = t0 | i2;
+    const CSA_BS_WORD t2 = t1 ^ i3;
+    const CSA_BS_WORD t3 = i1 ^ i2;
+    const CSA_BS_WORD t4 = t3 ^ i3;
+    const CSA_BS_WORD t5 = t2 ^ (i0 & (t2 ^ t4));
+    const CSA_BS_WORD t6 = ~t3;
+    const CSA_BS_WORD t7 = t0 ^ (i3 & t6);
+    const CSA_BS_WORD t8 = i1 | i2;
+    const CSA_BS_WORD t9 = t8 ^ (i3 & i2);
+    const CSA_BS_WORD t10 = t7 ^ (i0 & (t7 ^ t9));
+    const CSA_BS_WORD t11 = t5 ^ (i4 & (t5 ^ t10));
+    const CSA_BS_WORD t12 = t0 ^ (i3 & t3);
+    const CSA_BS_WORD t13 = t6 ^ (i0 & (t6 ^ t12));
+    const CSA_BS_WORD t14 = t0 ^ i3;
+    const CSA_BS_WORD t15 = t14 ^ (i0 & t3);
+    const CSA_BS_WORD t16 = t13 ^ (i4 & (t13 ^ t15));
+    *o1 = t11;
+    *o0 = t16;
+}
+
+CSA_BS_ATTR
+static inline void CSA_BS(sbox3)( CSA_BS_WORD i4, CSA_BS_WORD i3,
+                                  CSA_BS_WORD i2, CSA_BS_WORD i1,
+                                  CSA_BS_WORD i0, CSA_BS_WORD *o1,
+                                  CSA_BS_WORD *o0 )
+{
+    const CSA_BS_WORD t0 = ~i0;
+    const CSA_BS_WORD t1 = t0 | i2;
+    const CSA_BS_WORD t2 = i2 & t0;
+    const CSA_BS_WORD t3 = t1 ^ (i3 & (t1 ^ t2));
+    const CSA_BS_WORD t4 = i0 ^ i2;
+    const CSA_BS_WORD t5 = t3 ^ (i1 & (t3 ^ t4));
+    const CSA_BS_WORD t6 = t4 ^ i3;
+    const CSA_BS_WORD t7 = i2 ^ (i3 & i0);
+    const CSA_BS_WORD t8 = t6 ^ (i1 & (t6 ^ t7));
+    const CSA_BS_WORD t9 = t5 ^ (i4 & (t5 ^ t8));
+    const CSA_BS_WORD t10 = i2 & i0;
+    const CSA_BS_WORD t11 = t10 ^ i3;
+    const CSA_BS_WORD t12 = t11 ^ (i1 & t0);
+    const CSA_BS_WORD t13 = t12 ^ i4;
+    *o1 = t9;
+    *o0 = t13;
+}
+
+CSA_BS_ATTR
+static inline void CSA_BS(sbox4)( CSA_BS_WORD i4, CSA_BS_WORD i3,
+                                  CSA_BS_WORD i2, CSA_BS_WORD i1,
+                                  CSA_BS_WORD i0, CSA_BS_WORD *o1,
+                                  CSA_BS_WORD *o0 )
+{
+    const CSA_BS_WORD t0 = i0 | ~i1;
+    const CSA_BS_WORD t1 = t0 ^ i2;
+    const CSA_BS_WORD t2 = ~i0;
+    const CSA_BS_WORD t3 = t2 ^ i1;
+    const CSA_BS_WORD t4 = t1 ^ (i3 & (t1 ^ t3));
+    const CSA_BS_WORD t5 = t2 | i1;
+    const CSA_BS_WORD t6 = t5 ^ (i2 & (t5 ^ i0));
+    const CSA_BS_WORD t7 = ~t5;
+    const CSA_BS_WORD t8 = t7 ^ (i2 & t0);
+    const CSA_BS_WORD t9 = t6 ^ (i3 & (t6 ^ t8));
+    const CSA_BS_WORD t10 = t4 ^ (i4 & (t4 ^ t9));
+    const CSA_BS_WORD t11 = ~t4;
+    const CSA_BS_WORD t12 = t9 ^ (i4 & (t9 ^ t11));
+    *o1 = t12;
+    *o0 = t10;
+}
+
+CSA_BS_ATTR
+static inline void CSA_BS(sbox5)( CSA_BS_WORD i4, CSA_BS_WORD i3,
+                                  CSA_BS_WORD i2, CSA_BS_WORD i1,
+                                  CSA_BS_WORD i0, CSA_BS_WORD *o1,
+                                  CSA_BS_WORD *o0 )
+{
+    const CSA_BS_WORD t0 = ~i3;
+    const CSA_BS_WORD t1 = t0 ^ i1;
+    const CSA_BS_WORD t2 = t0 | i1;
+    const CSA_BS_WORD t3 = t1 ^ (i2 & (t1 ^ t2));
+    const CSA_BS_WORD t4 = t2 ^ i2;
+    const CSA_BS_WORD t5 = t3 ^ (i4 & (t3 ^ t4));
+    const CSA_BS_WORD t6 = i1 & i3;
+    const CSA_BS_WORD t7 = t6 ^ (i2 & t2);
+    const CSA_BS_WORD t8 = t7 ^ (i4 & (t7 ^ t1));
+    const CSA_BS_WORD t9 = t5 ^ (i0 & (t5 ^ t8));
+    const CSA_BS_WORD t10 = t6 ^ i2;
+    const CSA_BS_WORD t11 = ~t1;
+    const CSA_BS_WORD t12 = i3 ^ (i2 & i1);
+    const CSA_BS_WORD t13 = t10 ^ (i4 & (t10 ^ t12));
+    const CSA_BS_WORD t14 = i3 | i1;
+    const CSA_BS_WORD t15 = t14 ^ (i2 & t11);
+    const CSA_BS_WORD t16 = t15 ^ i4;
+    const CSA_BS_WORD t17 = t13 ^ (i0 & (t13 ^ t16));
+    *o1 = t9;
+    *o0 = t17;
+}
+
+CSA_BS_ATTR
+static inline void CSA_BS(sbox6)( CSA_BS_WORD i4, CSA_BS_WORD i3,
+                                  CSA_BS_WORD i2, CSA_BS_WORD i1,
+                                  CSA_BS_WORD i0, CSA_BS_WORD *o1,
+                                  CSA_BS_WORD *o0 )
+{
+    const CSA_BS_WORD t0 = ~i1;
+    const CSA_BS_WORD t1 = t0 | i4;
+    const CSA_BS_WORD t2 = i2 & t1;
+    const CSA_BS_WORD t3 = t0 | ~i4;
+    const CSA_BS_WORD t4 = t3 ^ i2;
+    const CSA_BS_WORD t5 = t2 ^ (i0 & (t2 ^ t4));
+    const CSA_BS_WORD t6 = ~t1;
+    const CSA_BS_WORD t7 = t0 ^ (i2 & t6);
+    const CSA_BS_WORD t8 = i1 ^ (i0 & (i1 ^ t7));
+    const CSA_BS_WORD t9 = t5 ^ (i3 & (t5 ^ t8));
+    const CSA_BS_WORD t10 = i1 ^ i4;
+    const CSA_BS_WORD t11 = i1 | i4;
+    const CSA_BS_WORD t12 = ~t4;
+    const CSA_BS_WORD t13 = t10 ^ (i0 & t12);
+    const CSA_BS_WORD t14 = t10 ^ i2;
+    const CSA_BS_WORD t15 = t14 ^ (i0 & t11);
+    const CSA_BS_WORD t16 = t13 ^ (i3 & (t13 ^ t15));
+    *o1 = t16;
+    *o0 = t9;
+}
+
+CSA_BS_ATTR
+static inline void CSA_BS(sbox7)( CSA_BS_WORD i4, CSA_BS_WORD i3,
+                                  CSA_BS_WORD i2, CSA_BS_WORD i1,
+                                  CSA_BS_WORD i0, CSA_BS_WORD *o1,
+                                  CSA_BS_WORD *o0 )
+{
+    const CSA_BS_WORD t0 = i2 ^ i0;
+    const CSA_BS_WORD t1 = t0 ^ i3;
+    const CSA_BS_WORD t2 = t1 ^ (i4 & t0);
+    const CSA_BS_WORD t3 = ~i2;
+    const CSA_BS_WORD t4 = ~i0;
+    const CSA_BS_WORD t5 = t3 ^ (i3 & t4);
+    const CSA_BS_WORD t6 = t3 | i0;
+    const CSA_BS_WORD t7 = i0 & i2;
+    const CSA_BS_WORD t8 = t6 ^ (i3 & t3);
+    const CSA_BS_WORD t9 = t5 ^ (i4 & (t5 ^ t8));
+    const CSA_BS_WORD t10 = t2 ^ (i1 & (t2 ^ t9));
+    const CSA_BS_WORD t11 = t0 ^ (i3 & t3);
+    const CSA_BS_WORD t12 = t11 ^ i4;
+    const CSA_BS_WORD t13 = t7 ^ (i3 & t3);
+    const CSA_BS_WORD t14 = ~t7;
+    const CSA_BS_WORD t15 = t14 ^ (i3 & t0);
+    const CSA_BS_WORD t16 = t13 ^ (i4 & (t13 ^ t15));
+    const CSA_BS_WORD t17 = t12 ^ (i1 & (t12 ^ t16));
+    *o1 = t10;
+    *o0 = t17;
+}
+
+typedef struct
+{
+    CSA_BS_WORD A[11][4];
+    CSA_BS_WORD B[11][4];
+    CSA_BS_WORD X[4], Y[4], Z[4];
+    CSA_BS_WORD D[4], E[4], F[4];
+    CSA_BS_WORD p, q, r;
+} CSA_BS(state_t);
+
+/* One step of the stream cypher (see csa_StreamCypher() for details).
+ * in_a and in_b are the input nibbles during initialisation, NULL otherwise.
+ */
+CSA_BS_ATTR
+static inline void CSA_BS(Step)( CSA_BS(state_t) *c,
+                                 const CSA_BS_WORD *in_a,
+                                 const CSA_BS_WORD *in_b )
+{
+    CSA_BS_WORD s1[2], s2[2], s3[2], s4[2], s5[2], s6[2], s7[2];
+
+    CSA_BS(sbox1)( c->A[4][0], c->A[1][2], c->A[6][1], c->A[7][3], c->A[9][0],
+                   &s1[1], &s1[0] );
+    CSA_BS(sbox2)( c->A[2][1], c->A[3][2], c->A[6][3], c->A[7][0], c->A[9][1],
+                   &s2[1], &s2[0] );
+    CSA_BS(sbox3)( c->A[1][3], c->A[2][0], c->A[5][1], c->A[5][3], c->A[6][2],
+                   &s3[1], &s3[0] );
+    CSA_BS(sbox4)( c->A[3][3], c->A[1][1], c->A[2][3], c->A[4][2], c->A[8][0],
+                   &s4[1], &s4[0] );
+    CSA_BS(sbox5)( c->A[5][2], c->A[4][3], c->A[6][0], c->A[8][1], c->A[9][2],
+                   &s5[1], &s5[0] );
+    CSA_BS(sbox6)( c->A[3][1], c->A[4][1], c->A[5][0], c->A[7][2], c->A[9][3],
+                   &s6[1], &s6[0] );
+    CSA_BS(sbox7)( c->A[2][2], c->A[3][0], c->A[7][1], c->A[8][2], c->A[8][3],
+                   &s7[1], &s7[0] );
+
+    /* 4x4 xor producing the extra nibble for T3 */
+    CSA_BS_WORD extra_B[4];
+    extra_B[3] = c->B[3][0] ^ c->B[6][1] ^ c->B[7][2] ^ c->B[9][3];
+    extra_B[2] = c->B[6][0] ^ c->B[8][1] ^ c->B[3][3] ^ c->B[4][2];
+    extra_B[1] = c->B[5][3] ^ c->B[8][2] ^ c->B[4][0] ^ c->B[5][1];
+    extra_B[0] = c->B[9][2] ^ c->B[6][3] ^ c->B[3][1] ^ c->B[8][0];
+
+    /* T1 and T2 */
+    CSA_BS_WORD next_A1[4], next_B1[4];
+    for( int i = 0; i < 4; i++ )
+    {
+        next_A1[i] = c->A[10][i] ^ c->X[i];
+        next_B1[i] = c->B[7][i] ^ c->B[10][i] ^ c->Y[i];
+        if( in_a != NULL )
+        {
+            next_A1[i] ^= c->D[i] ^ in_a[i];
+            next_B1[i] ^= in_b[i];
+        }
+    }
+
+    /* if p=1, rotate next_B1 left */
+    const CSA_BS_WORD b3 = next_B1[3];
+    for( int i = 3; i > 0; i-- )
+        next_B1[i] ^= c->p & (next_B1[i] ^ next_B1[i - 1]);
+    next_B1[0] ^= c->p & (next_B1[0] ^ b3);
+
+    /* T3 */
+    for( int i = 0; i < 4; i++ )
+        c->D[i] = c->E[i] ^ c->Z[i] ^ extra_B[i];
+
+    /* T4: if q=1, F = Z + E + r with r the carry, otherwise F = E */
+    CSA_BS_WORD carry = c->r;
+    for( int i = 0; i < 4; i++ )
+    {
+        const CSA_BS_WORD t = c->Z[i] ^ c->E[i];
+        const CSA_BS_WORD sum = t ^ carry;
+        const CSA_BS_WORD next_E = c->F[i];
+
+        carry = (c->Z[i] & c->E[i]) | (carry & t);
+        c->F[i] = c->E[i] ^ (c->q & (c->E[i] ^ sum));
+        c->E[i] = next_E;
+    }
+    c->r ^= c->q & (c->r ^ carry);
+
+    memmove( &c->A[2], &c->A[1], 9 * sizeof (c->A[1]) );
+    memmove( &c->B[2], &c->B[1], 9 * sizeof (c->B[1]) );
+    memcpy( c->A[1], next_A1, sizeof (next_A1) );
+    memcpy( c->B[1], next_B1, sizeof (next_B1) );
+
+    c->X[3] = s4[0]; c->X[2] = s3[0]; c->X[1] = s2[1]; c->X[0] = s1[1];
+    c->Y[3] = s6[0]; c->Y[2] = s5[0]; c->Y[1] = s4[1]; c->Y[0] = s3[1];
+    c->Z[3] = s2[0]; c->Z[2] = s1[0]; c->Z[1] = s6[1]; c->Z[0] = s5[1];
+    c->p = s7[1];
+    c->q = s7[0];
+}
+
+/**
+ * Applies the stream cypher to the payloads of up to CSA_BS_LANES packets.
+ *
+ * The stream cypher is initialised with the first 8 bytes of each payload,
+ * and the generated stream is xored into the following bytes.
+ */
+CSA_BS_ATTR
+static void CSA_BS(StreamCypher)( const uint8_t ck[8],
+                                  uint8_t *const *pp_payload,
+                                  const unsigned *pi_size, unsigned i_lanes )
+{
+    enum { ELEMS = CSA_BS_LANES / 64 };
+    CSA_BS(state_t) c;
+    CSA_BS_WORD in[8][8];
+    uint64_t bits[8][8][ELEMS];
+    unsigned i_max = 0;
+
+    memset( &c, 0, sizeof (c) );
+
+    /* load first 32 bits of CK into A[1]..A[8], last 32 bits into B[1]..B[8]
+     * (the same key for every packet) */
+    for( int i = 0; i < 4; i++ )
+        for( int j = 0; j < 4; j++ )
+        {
+            if( (ck[i] >> (4 + j)) & 1 )
+                c.A[1 + 2 * i][j] = ~CSA_BS_ZERO;
+            if( (ck[i] >> j) & 1 )
+                c.A[2 + 2 * i][j] = ~CSA_BS_ZERO;
+            if( (ck[4 + i] >> (4 + j)) & 1 )
+                c.B[1 + 2 * i][j] = ~CSA_BS_ZERO;
+            if( (ck[4 + i] >> j) & 1 )
+                c.B[2 + 2 * i][j] = ~CSA_BS_ZERO;
+        }
+
+    /* slice the initialisation bytes */
+    memset( bits, 0, sizeof (bits) );
+    for( unsigned l = 0; l < i_lanes; l++ )
+    {
+        const uint64_t mask = UINT64_C(1) << (l % 64);
+
+        for( int i = 0; i < 8; i++ )
+            for( int j = 0; j < 8; j++ )
+                if( (pp_payload[l][i] >> j) & 1 )
+                    bits[i][j][l / 64] |= mask;
+        if( pi_size[l] > i_max )
+            i_max = pi_size[l];
+    }
+    memcpy( in, bits, sizeof (in) );
+
+    for( int i = 0; i < 8; i++ )
+    {
+        const CSA_BS_WORD *hi = &in[i][4], *lo = &in[i][0];
+
+        CSA_BS(Step)( &c, hi, lo );
+        CSA_BS(Step)( &c, lo, hi );
+        CSA_BS(Step)( &c, hi, lo );
+        CSA_BS(Step)( &c, lo, hi );
+    }
+
+    for( unsigned i_offset = 8; i_offset < i_max; i_offset += 8 )
+    {
+        CSA_BS_WORD out[8][8];
+
+        /* 2 output bits per step, 4 steps per byte */
+        for( int i = 0; i < 8; i++ )
+            for( int j = 3; j >= 0; j-- )
+            {
+                CSA_BS(Step)( &c, NULL, NULL );
+                out[i][2 * j + 1] = c.D[2] ^ c.D[3];
+                out[i][2 * j] = c.D[0] ^ c.D[1];
+            }
+        memcpy( bits, out, sizeof (bits) );
+
+        /* unslice 8 packets at a time with a 8x8 bits matrix transposition */
+        for( unsigned l = 0; l < i_lanes; l += 8 )
+            for( int i = 0; i < 8; i++ )
+            {
+                const unsigned e = l / 64, shift = l % 64;
+                uint64_t x = 0, t;
+
+                for( int j = 0; j < 8; j++ )
+                    x |= ((bits[i][j][e] >> shift) & 0xff) << (8 * j);
+
+                t = (x ^ (x >> 7)) & UINT64_C(0x00AA00AA00AA00AA);
+                x ^= t ^ (t << 7);
+                t = (x ^ (x >> 14)) & UINT64_C(0x0000CCCC0000CCCC);
+                x ^= t ^ (t << 14);
+                t = (x ^ (x >> 28)) & UINT64_C(0x00000000F0F0F0F0);
+                x ^= t ^ (t << 28);
+
+                for( unsigned k = 0; k < 8 && l + k < i_lanes; k++ )
+                    if( i_offset + i < pi_size[l + k] )
+                        pp_payload[l + k][i_offset + i] ^= x >> (8 * k);
+            }
+    }
+}
+
+/**
+ * Decyphers the blocks of the payloads of up to CSA_BS_LANES packets,
+ * after the stream cypher has been applied.
+ */
+CSA_BS_ATTR
+static void CSA_BS(BlockDecypher)( const uint8_t kk[57],
+                                   uint8_t *const *pp_payload,
+                                   const unsigned *pi_size, unsigned i_lanes )
+{
+    /* 8 registers of 1 byte per packet */
+    CSA_BS_WORD R[8][8], S[8];
+    unsigned i_blocks = 0;
+
+    for( unsigned l = 0; l < i_lanes; l++ )
+        if( pi_size[l] / 8 > i_blocks )
+            i_blocks = pi_size[l] / 8;
+
+    for( unsigned b = 0; b < i_blocks; b++ )
+    {
+        const size_t i_offset = 8 * b;
+
+        memset( R, 0, sizeof (R) );
+        for( unsigned l = 0; l < i_lanes; l++ )
+            if( i_offset + 8 <= pi_size[l] )
+                for( int i = 0; i < 8; i++ )
+                    ((uint8_t *)R[i])[l] = pp_payload[l][i_offset + i];
+
+        /* Register k (1..8) is R[(k - 1 + rot) % 8]: shifting all registers
+         * is done by decrementing rot. */
+        unsigned rot = 0;
+        for( int i = 56; i > 0; i-- )
+        {
+#define REG(k) R[(k - 1 + rot) & 7]
+            const uint8_t *r7 = (const uint8_t *)REG(7);
+            uint8_t *s = (uint8_t *)S;
+
+            for( unsigned l = 0; l < i_lanes; l++ )
+                s[l] = block_sbox[kk[i] ^ r7[l]];
+
+            for( int w = 0; w < 8; w++ )
+            {
+                const CSA_BS_WORD perm_out =
+                      CSA_BS_SHL(S[w] & CSA_BS_SPLAT(UINT64_C(0x2929292929292929)), 1)
+                    | CSA_BS_SHL(S[w] & CSA_BS_SPLAT(UINT64_C(0x0202020202020202)), 6)
+                    | CSA_BS_SHL(S[w] & CSA_BS_SPLAT(UINT64_C(0x0404040404040404)), 3)
+                    | CSA_BS_SHR(S[w] & CSA_BS_SPLAT(UINT64_C(0x1010101010101010)), 2)
+                    | CSA_BS_SHR(S[w] & CSA_BS_SPLAT(UINT64_C(0x4040404040404040)), 6)
+                    | CSA_BS_SHR(S[w] & CSA_BS_SPLAT(UINT64_C(0x8080808080808080)), 4);
+
+                REG(8)[w] ^= S[w];
+                REG(2)[w] ^= REG(8)[w];
+                REG(3)[w] ^= REG(8)[w];
+                REG(4)[w] ^= REG(8)[w];
+                REG(6)[w] ^= perm_out;
+            }
+            rot--;
+#undef REG
+        }
+
+        for( unsigned l = 0; l < i_lanes; l++ )
+        {
+            if( i_offset + 8 > pi_size[l] )
+                continue;
+
+            uint8_t *p = &pp_payload[l][i_offset];
+            const bool b_last = i_offset + 16 > pi_size[l];
+
+            for( int i = 0; i < 8; i++ )
+                p[i] = ((uint8_t *)R[i])[l] ^ (b_last ? 0 : p[8 + i]);
+        }
+    }
+}
+
+#undef CSA_BS_LANES
+#undef CSA_BS
+#undef CSA_BS_CAT
+#undef CSA_BS_CAT2
+#undef CSA_BS_WORD
+#undef CSA_BS_ZERO
+#undef CSA_BS_SPLAT
+#undef CSA_BS_SHL
+#undef CSA_BS_SHR
+#undef CSA_BS_SUFFIX
+#undef CSA_BS_ATTR
@@ -52,6 +52,12 @@ block_t *hxxx_AnnexB_to_xVC( block_t *p_block, uint8_t i_nal_length_size )
         off_t    move; /* move offset */
     } *p_list = NULL;
 
+    /* Start codes are rewritten in place: the payload must not be shared
+     * with other blocks (see stream_out duplicate) */
+    p_block = block_Unshare( p_block );
+    if( unlikely(p_block == NULL) )
+        return NULL;
+
     if(!p_block->i_buffer || p_block->p_buffer[0])
         goto error;
 
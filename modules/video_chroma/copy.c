@@ -32,20 +32,25 @@
 
 #include "copy.h"
 
-int CopyInitCache(copy_cache_t *cache, unsigned width)
+/* Frames at least that wide are split between threads by default */
+#define COPY_THREADS_MIN_WIDTH 3840
+#define COPY_THREADS_MAX       4
+
+static int CopyInitBuffer(copy_cache_t *cache, unsigned width)
 {
+    cache->pool = NULL;
 #ifdef CAN_COMPILE_SSE2
     cache->size = __MAX((width + 0x3f) & ~ 0x3f, 4096);
     cache->buffer = vlc_memalign(64, cache->size);
     if (!cache->buffer)
         return VLC_EGENERIC;
 #else
-    (void) cache; (void) width;
+    (void) width;
 #endif
     return VLC_SUCCESS;
 }
 
-void CopyCleanCache(copy_cache_t *cache)
+static void CopyCleanBuffer(copy_cache_t *cache)
 {
 #ifdef CAN_COMPILE_SSE2
     vlc_free(cache->buffer);
@@ -56,6 +61,226 @@ void CopyCleanCache(copy_cache_t *cache)
 #endif
 }
 
+typedef void (*copy_func_t)(picture_t *dst, uint8_t *src[], size_t src_pitch[],
+                            unsigned height, copy_cache_t *cache);
+
+/* One picture copy, split in bands of lines */
+struct copy_job
+{
+    copy_func_t func;
+    picture_t  *dst;
+    uint8_t   **src;
+    size_t     *src_pitch;
+    unsigned    src_planes;
+    unsigned    height;
+};
+
+struct copy_worker
+{
+    struct copy_pool *pool;
+    vlc_thread_t      thread;
+    copy_cache_t      cache;
+};
+
+struct copy_pool
+{
+    vlc_mutex_t lock;
+    vlc_cond_t  wait;
+    vlc_cond_t  done;
+    const struct copy_job *job;
+    unsigned    job_id;
+    unsigned    next;
+    unsigned    finished;
+    unsigned    slices;
+    bool        exit;
+    unsigned    count;
+    struct copy_worker worker[];
+};
+
+/* Copies the lines [first, end) of the luma plane, and the matching lines
+ * of the 4:2:0 chroma planes. The first line of every slice is even, so that
+ * the chroma lines are the same as with a single slice. */
+static void CopySlice(const struct copy_job *job, unsigned slice,
+                      unsigned slices, copy_cache_t *cache)
+{
+    const unsigned first = (job->height * slice / slices) & ~1u;
+    const unsigned end = slice + 1 < slices
+                       ? (job->height * (slice + 1) / slices) & ~1u
+                       : job->height;
+    if (first >= end)
+        return;
+
+    /* Only the planes are used by the copy functions */
+    picture_t dst;
+    dst.i_planes = job->dst->i_planes;
+    for (int n = 0; n < dst.i_planes; n++) {
+        dst.p[n] = job->dst->p[n];
+        dst.p[n].p_pixels += (size_t)dst.p[n].i_pitch * (n ? first / 2 : first);
+    }
+
+    uint8_t *src[3];
+    for (unsigned n = 0; n < job->src_planes; n++)
+        src[n] = job->src[n] + job->src_pitch[n] * (n ? first / 2 : first);
+
+    job->func(&dst, src, job->src_pitch, end - first, cache);
+}
+
+/* Copies the slices of the current job not taken yet by another thread.
+ * Must be called with the lock held. */
+static void CopySlices(struct copy_pool *pool, copy_cache_t *cache)
+{
+    while (pool->next < pool->slices) {
+        const struct copy_job *job = pool->job;
+        const unsigned slice = pool->next++;
+
+        vlc_mutex_unlock(&pool->lock);
+        CopySlice(job, slice, pool->slices, cache);
+        vlc_mutex_lock(&pool->lock);
+
+        if (++pool->finished == pool->slices)
+            vlc_cond_signal(&pool->done);
+    }
+}
+
+static void *CopyWorker(void *data)
+{
+    struct copy_worker *worker = data;
+    struct copy_pool *pool = worker->pool;
+    unsigned job_id = 0;
+
+    vlc_mutex_lock(&pool->lock);
+    for (;;) {
+        while (!pool->exit && pool->job_id == job_id)
+            vlc_cond_wait(&pool->wait, &pool->lock);
+        if (pool->exit)
+            break;
+
+        job_id = pool->job_id;
+        CopySlices(pool, &worker->cache);
+    }
+    vlc_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+static void CopyPoolDelete(struct copy_pool *pool)
+{
+    vlc_mutex_lock(&pool->lock);
+    pool->exit = true;
+    vlc_cond_broadcast(&pool->wait);
+    vlc_mutex_unlock(&pool->lock);
+
+    for (unsigned i = 0; i < pool->count; i++) {
+        vlc_join(pool->worker[i].thread, NULL);
+        CopyCleanBuffer(&pool->worker[i].cache);
+    }
+    vlc_cond_destroy(&pool->done);
+    vlc_cond_destroy(&pool->wait);
+    vlc_mutex_destroy(&pool->lock);
+    free(pool);
+}
+
+static struct copy_pool *CopyPoolNew(unsigned width, unsigned threads)
+{
+    struct copy_pool *pool = malloc(sizeof (*pool)
+                                    + (threads - 1) * sizeof (pool->worker[0]));
+    if (unlikely(pool == NULL))
+        return NULL;
+
+    vlc_mutex_init(&pool->lock);
+    vlc_cond_init(&pool->wait);
+    vlc_cond_init(&pool->done);
+    pool->job = NULL;
+    pool->job_id = 0;
+    pool->next = pool->finished = pool->slices = 0;
+    pool->exit = false;
+    pool->count = 0;
+
+    while (pool->count < threads - 1) {
+        struct copy_worker *worker = &pool->worker[pool->count];
+
+        worker->pool = pool;
+        if (CopyInitBuffer(&worker->cache, width))
+            break;
+        if (vlc_clone(&worker->thread, CopyWorker, worker,
+                      VLC_THREAD_PRIORITY_VIDEO)) {
+            CopyCleanBuffer(&worker->cache);
+            break;
+        }
+        pool->count++;
+    }
+
+    if (pool->count == 0) {
+        CopyPoolDelete(pool);
+        return NULL;
+    }
+    return pool;
+}
+
+int CopyInitCacheThreads(copy_cache_t *cache, unsigned width, unsigned threads)
+{
+    if (CopyInitBuffer(cache, width))
+        return VLC_EGENERIC;
+
+    if (threads == 0)
+        threads = __MIN(vlc_GetCPUCount(), COPY_THREADS_MAX);
+    /* Failing to start threads is not fatal: the copy is just slower */
+    if (threads > 1)
+        cache->pool = CopyPoolNew(width, threads);
+    return VLC_SUCCESS;
+}
+
+int CopyInitCache(copy_cache_t *cache, unsigned width)
+{
+    return CopyInitCacheThreads(cache, width,
+                                width >= COPY_THREADS_MIN_WIDTH ? 0 : 1);
+}
+
+void CopyCleanCache(copy_cache_t *cache)
+{
+    if (cache->pool != NULL) {
+        CopyPoolDelete(cache->pool);
+        cache->pool = NULL;
+    }
+    CopyCleanBuffer(cache);
+}
+
+/* Runs a copy function, over bands of lines in parallel if the cache has
+ * threads */
+static void Copy(copy_func_t func, picture_t *dst,
+                 uint8_t *src[], size_t src_pitch[], unsigned src_planes,
+                 unsigned height, copy_cache_t *cache)
+{
+    struct copy_pool *pool = cache->pool;
+
+    if (pool == NULL || height < 2 * (pool->count + 1)) {
+        func(dst, src, src_pitch, height, cache);
+        return;
+    }
+
+    const struct copy_job job = {
+        .func = func,
+        .dst = dst,
+        .src = src,
+        .src_pitch = src_pitch,
+        .src_planes = src_planes,
+        .height = height,
+    };
+
+    vlc_mutex_lock(&pool->lock);
+    pool->job = &job;
+    pool->next = 0;
+    pool->finished = 0;
+    pool->slices = pool->count + 1;
+    pool->job_id++;
+    vlc_cond_broadcast(&pool->wait);
+
+    CopySlices(pool, cache);
+    while (pool->finished < pool->slices)
+        vlc_cond_wait(&pool->done, &pool->lock);
+    pool->job = NULL;
+    vlc_mutex_unlock(&pool->lock);
+}
+
 #ifdef CAN_COMPILE_SSE2
 /* Copy 16/64 bytes from srcp to dstp loading data with the SSE>=2 instruction
  * load and storing data with the SSE>=2 instruction store.
@@ -78,6 +303,11 @@ void CopyCleanCache(copy_cache_t *cache)
         store " %%xmm4,   48(%[dst])\n" \
         : : [dst]"r"(dstp), [src]"r"(srcp) : "memory", "xmm1", "xmm2", "xmm3", "xmm4")
 
+#ifndef __AVX2__
+# undef vlc_CPU_AVX2
+# define vlc_CPU_AVX2() ((cpu & VLC_CPU_AVX2) != 0)
+#endif
+
 #ifndef __SSE4_1__
 # undef vlc_CPU_SSE4_1
 # define vlc_CPU_SSE4_1() ((cpu & VLC_CPU_SSE4_1) != 0)
@@ -261,6 +491,125 @@ static void SSE_SplitUV(uint8_t *dstu, size_t dstu_pitch,
     }
 }
 
+#ifdef CAN_COMPILE_AVX2
+/* Copy 32/128 bytes from srcp to dstp with the AVX(2) instructions load and
+ * store. */
+#define COPY32(dstp, srcp, load, store) \
+    asm volatile (                      \
+        load "  0(%[src]), %%ymm1\n"    \
+        store " %%ymm1,    0(%[dst])\n" \
+        : : [dst]"r"(dstp), [src]"r"(srcp) : "memory", "xmm1")
+
+#define COPY128(dstp, srcp, load, store) \
+    asm volatile (                      \
+        load "   0(%[src]), %%ymm1\n"   \
+        load "  32(%[src]), %%ymm2\n"   \
+        load "  64(%[src]), %%ymm3\n"   \
+        load "  96(%[src]), %%ymm4\n"   \
+        store " %%ymm1,     0(%[dst])\n" \
+        store " %%ymm2,    32(%[dst])\n" \
+        store " %%ymm3,    64(%[dst])\n" \
+        store " %%ymm4,    96(%[dst])\n" \
+        : : [dst]"r"(dstp), [src]"r"(srcp) : "memory", "xmm1", "xmm2", "xmm3", "xmm4")
+
+/* Same as CopyFromUswc with 32 bytes streaming loads */
+static void AVX2_CopyFromUswc(uint8_t *dst, size_t dst_pitch,
+                              const uint8_t *src, size_t src_pitch,
+                              unsigned width, unsigned height)
+{
+    asm volatile ("mfence");
+
+    for (unsigned y = 0; y < height; y++) {
+        unsigned x = 0;
+
+        if (width >= 32) {
+            x = (-(uintptr_t)src) & 0x1f;
+            if (x)
+                COPY32(dst, src, "vmovdqu", "vmovdqu");
+            for (; x+127 < width; x += 128)
+                COPY128(&dst[x], &src[x], "vmovntdqa", "vmovdqu");
+        }
+
+        for (; x < width; x++)
+            dst[x] = src[x];
+
+        src += src_pitch;
+        dst += dst_pitch;
+    }
+    asm volatile ("mfence");
+    asm volatile ("vzeroupper");
+}
+
+static void AVX2_Copy2d(uint8_t *dst, size_t dst_pitch,
+                        const uint8_t *src, size_t src_pitch,
+                        unsigned width, unsigned height)
+{
+    for (unsigned y = 0; y < height; y++) {
+        unsigned x = 0;
+
+        bool unaligned = ((intptr_t)dst & 0x1f) != 0;
+        if (!unaligned) {
+            for (; x+127 < width; x += 128)
+                COPY128(&dst[x], &src[x], "vmovdqu", "vmovntdq");
+        } else {
+            for (; x+127 < width; x += 128)
+                COPY128(&dst[x], &src[x], "vmovdqu", "vmovdqu");
+        }
+
+        for (; x < width; x++)
+            dst[x] = src[x];
+
+        src += src_pitch;
+        dst += dst_pitch;
+    }
+    asm volatile ("sfence");
+    asm volatile ("vzeroupper");
+}
+
+static void AVX2_SplitUV(uint8_t *dstu, size_t dstu_pitch,
+                         uint8_t *dstv, size_t dstv_pitch,
+                         const uint8_t *src, size_t src_pitch,
+                         unsigned width, unsigned height)
+{
+    const uint8_t shuffle[] = { 0, 2, 4, 6, 8, 10, 12, 14,
+                                1, 3, 5, 7, 9, 11, 13, 15 };
+
+    for (unsigned y = 0; y < height; y++) {
+        unsigned x;
+
+        /* pshufb groups U and V within each 128-bits lane, then vpermq
+         * gathers the U bytes in the low lane and the V bytes in the high
+         * lane */
+        for (x = 0; x < (width & ~31); x += 32) {
+            asm volatile (
+                "vbroadcasti128 (%[shuffle]), %%ymm7\n"
+                "vmovdqu     0(%[src]), %%ymm0\n"
+                "vmovdqu    32(%[src]), %%ymm1\n"
+                "vpshufb     %%ymm7, %%ymm0, %%ymm0\n"
+                "vpshufb     %%ymm7, %%ymm1, %%ymm1\n"
+                "vpermq      $0xd8, %%ymm0, %%ymm0\n"
+                "vpermq      $0xd8, %%ymm1, %%ymm1\n"
+                "vmovdqu     %%xmm0,  0(%[dst1])\n"
+                "vmovdqu     %%xmm1, 16(%[dst1])\n"
+                "vextracti128 $1, %%ymm0,  0(%[dst2])\n"
+                "vextracti128 $1, %%ymm1, 16(%[dst2])\n"
+                : : [dst1]"r"(&dstu[x]), [dst2]"r"(&dstv[x]), [src]"r"(&src[2*x]), [shuffle]"r"(shuffle) : "memory", "xmm0", "xmm1", "xmm7");
+        }
+
+        for (; x < width; x++) {
+            dstu[x] = src[2*x+0];
+            dstv[x] = src[2*x+1];
+        }
+        src  += src_pitch;
+        dstu += dstu_pitch;
+        dstv += dstv_pitch;
+    }
+    asm volatile ("vzeroupper");
+}
+#undef COPY128
+#undef COPY32
+#endif /* CAN_COMPILE_AVX2 */
+
 static void SSE_CopyPlane(uint8_t *dst, size_t dst_pitch,
                           const uint8_t *src, size_t src_pitch,
                           uint8_t *cache, size_t cache_size,
@@ -276,6 +625,17 @@ static void SSE_CopyPlane(uint8_t *dst, size_t dst_pitch,
     for (unsigned y = 0; y < height; y += hstep) {
         const unsigned hblock =  __MIN(hstep, height - y);
 
+#ifdef CAN_COMPILE_AVX2
+        if (vlc_CPU_AVX2()) {
+            AVX2_CopyFromUswc(cache, w16, src, src_pitch,
+                              src_pitch, hblock);
+            AVX2_Copy2d(dst, dst_pitch, cache, w16,
+                        src_pitch, hblock);
+            src += src_pitch * hblock;
+            dst += dst_pitch * hblock;
+            continue;
+        }
+#endif
         /* Copy a bunch of line into our cache */
         CopyFromUswc(cache, w16,
                      src, src_pitch,
@@ -298,20 +658,33 @@ static void SSE_SplitPlanes(uint8_t *dstu, size_t dstu_pitch,
                             uint8_t *cache, size_t cache_size,
                             unsigned height, unsigned cpu)
 {
-    const unsigned w16 = (2*src_pitch+15) & ~15;
+    /* src_pitch bytes hold src_pitch/2 U/V pairs */
+    const unsigned w16 = (src_pitch+15) & ~15;
     const unsigned hstep = cache_size / w16;
     assert(hstep > 0);
 
     for (unsigned y = 0; y < height; y += hstep) {
         const unsigned hblock =  __MIN(hstep, height - y);
 
+#ifdef CAN_COMPILE_AVX2
+        if (vlc_CPU_AVX2()) {
+            AVX2_CopyFromUswc(cache, w16, src, src_pitch,
+                              src_pitch, hblock);
+            AVX2_SplitUV(dstu, dstu_pitch, dstv, dstv_pitch,
+                         cache, w16, src_pitch/2, hblock);
+            src  += src_pitch  * hblock;
+            dstu += dstu_pitch * hblock;
+            dstv += dstv_pitch * hblock;
+            continue;
+        }
+#endif
         /* Copy a bunch of line into our cache */
         CopyFromUswc(cache, w16, src, src_pitch,
-                     2*src_pitch, hblock, cpu);
+                     src_pitch, hblock, cpu);
 
         /* Copy from our cache to the destination */
         SSE_SplitUV(dstu, dstu_pitch, dstv, dstv_pitch,
-                    cache, w16, src_pitch, hblock, cpu);
+                    cache, w16, src_pitch/2, hblock, cpu);
 
         /* */
         src  += src_pitch  * hblock;
@@ -426,7 +799,7 @@ static void SplitPlanes(uint8_t *dstu, size_t dstu_pitch,
                         unsigned height)
 {
     for (unsigned y = 0; y < height; y++) {
-        for (unsigned x = 0; x < src_pitch; x++) {
+        for (unsigned x = 0; x < src_pitch / 2; x++) {
             dstu[x] = src[2*x+0];
             dstv[x] = src[2*x+1];
         }
@@ -436,8 +809,8 @@ static void SplitPlanes(uint8_t *dstu, size_t dstu_pitch,
     }
 }
 
-void CopyFromNv12(picture_t *dst, uint8_t *src[2], size_t src_pitch[2],
-                  unsigned height, copy_cache_t *cache)
+static void DoCopyFromNv12(picture_t *dst, uint8_t *src[2], size_t src_pitch[2],
+                           unsigned height, copy_cache_t *cache)
 {
 #ifdef CAN_COMPILE_SSE2
     unsigned cpu = vlc_CPU();
@@ -455,8 +828,14 @@ void CopyFromNv12(picture_t *dst, uint8_t *src[2], size_t src_pitch[2],
                 src[1], src_pitch[1], height/2);
 }
 
-void CopyFromNv12ToNv12(picture_t *dst, uint8_t *src[2], size_t src_pitch[2],
+void CopyFromNv12(picture_t *dst, uint8_t *src[2], size_t src_pitch[2],
                   unsigned height, copy_cache_t *cache)
+{
+    Copy(DoCopyFromNv12, dst, src, src_pitch, 2, height, cache);
+}
+
+static void DoCopyFromNv12ToNv12(picture_t *dst, uint8_t *src[2], size_t src_pitch[2],
+                           unsigned height, copy_cache_t *cache)
 {
 #ifdef CAN_COMPILE_SSE2
     unsigned cpu = vlc_CPU();
@@ -473,6 +852,12 @@ void CopyFromNv12ToNv12(picture_t *dst, uint8_t *src[2], size_t src_pitch[2],
               src[1], src_pitch[1], height/2);
 }
 
+void CopyFromNv12ToNv12(picture_t *dst, uint8_t *src[2], size_t src_pitch[2],
+                  unsigned height, copy_cache_t *cache)
+{
+    Copy(DoCopyFromNv12ToNv12, dst, src, src_pitch, 2, height, cache);
+}
+
 void CopyFromNv12ToI420(picture_t *dst, uint8_t *src[2], size_t src_pitch[2],
                         unsigned height)
 {
@@ -483,8 +868,8 @@ void CopyFromNv12ToI420(picture_t *dst, uint8_t *src[2], size_t src_pitch[2],
                 src[1], src_pitch[1], height/2);
 }
 
-void CopyFromI420ToNv12(picture_t *dst, uint8_t *src[3], size_t src_pitch[3],
-                        unsigned height, copy_cache_t *cache)
+static void DoCopyFromI420ToNv12(picture_t *dst, uint8_t *src[3], size_t src_pitch[3],
+                                 unsigned height, copy_cache_t *cache)
 {
 #ifdef CAN_COMPILE_SSE2
     unsigned cpu = vlc_CPU();
@@ -521,8 +906,14 @@ void CopyFromI420ToNv12(picture_t *dst, uint8_t *src[3], size_t src_pitch[3],
     }
 }
 
-void CopyFromI420_10ToP010(picture_t *dst, uint8_t *src[3], size_t src_pitch[3],
+void CopyFromI420ToNv12(picture_t *dst, uint8_t *src[3], size_t src_pitch[3],
                         unsigned height, copy_cache_t *cache)
+{
+    Copy(DoCopyFromI420ToNv12, dst, src, src_pitch, 3, height, cache);
+}
+
+static void DoCopyFromI420_10ToP010(picture_t *dst, uint8_t *src[3], size_t src_pitch[3],
+                                 unsigned height, copy_cache_t *cache)
 {
     (void) cache;
 
@@ -561,9 +952,15 @@ void CopyFromI420_10ToP010(picture_t *dst, uint8_t *src[3], size_t src_pitch[3],
     }
 }
 
+void CopyFromI420_10ToP010(picture_t *dst, uint8_t *src[3], size_t src_pitch[3],
+                        unsigned height, copy_cache_t *cache)
+{
+    Copy(DoCopyFromI420_10ToP010, dst, src, src_pitch, 3, height, cache);
+}
 
-void CopyFromYv12(picture_t *dst, uint8_t *src[3], size_t src_pitch[3],
-                  unsigned height, copy_cache_t *cache)
+
+static void DoCopyFromYv12(picture_t *dst, uint8_t *src[3], size_t src_pitch[3],
+                           unsigned height, copy_cache_t *cache)
 {
 #ifdef CAN_COMPILE_SSE2
     unsigned cpu = vlc_CPU();
@@ -581,3 +978,9 @@ void CopyFromYv12(picture_t *dst, uint8_t *src[3], size_t src_pitch[3],
      CopyPlane(dst->p[2].p_pixels, dst->p[2].i_pitch,
                src[2], src_pitch[2], height / 2);
 }
+
+void CopyFromYv12(picture_t *dst, uint8_t *src[3], size_t src_pitch[3],
+                  unsigned height, copy_cache_t *cache)
+{
+    Copy(DoCopyFromYv12, dst, src, src_pitch, 3, height, cache);
+}
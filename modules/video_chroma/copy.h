@@ -29,9 +29,14 @@ typedef struct {
     uint8_t *buffer;
     size_t  size;
 # endif
+    struct copy_pool *pool;
 } copy_cache_t;
 
+/* Frames 4K wide or larger are copied by several threads */
 int  CopyInitCache(copy_cache_t *cache, unsigned width);
+/* Same as CopyInitCache with an explicit thread count (0 for automatic) */
+int  CopyInitCacheThreads(copy_cache_t *cache, unsigned width,
+                          unsigned threads);
 void CopyCleanCache(copy_cache_t *cache);
 
 /* Copy planes from NV12 to YV12 */
@@ -47,6 +47,177 @@
    Necessary preprocessor macros are defined in common.h. */
 #include "yadif.h"
 
+typedef void (*yadif_filter_t)(uint8_t *dst, uint8_t *prev, uint8_t *cur,
+                               uint8_t *next, int w, int prefs, int mrefs,
+                               int parity, int mode);
+
+/* Everything needed to render one output picture */
+struct yadif_job_t
+{
+    picture_t *p_dst;
+    const picture_t *p_prev;
+    const picture_t *p_cur;
+    const picture_t *p_next;
+    yadif_filter_t filter;
+    int i_field;
+    int i_parity;
+};
+
+/* Renders the rows [1 + (h - 2) * i_slice / i_slices,
+ * 1 + (h - 2) * (i_slice + 1) / i_slices) of each plane. The lines of one
+ * slice are independent of the others, so slices can be run concurrently. */
+static void RenderYadifSlice( const struct yadif_job_t *p_job,
+                              unsigned i_slice, unsigned i_slices )
+{
+    picture_t *p_dst = p_job->p_dst;
+    const int i_field = p_job->i_field;
+    const int yadif_parity = p_job->i_parity;
+
+    for( int n = 0; n < p_dst->i_planes; n++ )
+    {
+        const plane_t *prevp = &p_job->p_prev->p[n];
+        const plane_t *curp  = &p_job->p_cur->p[n];
+        const plane_t *nextp = &p_job->p_next->p[n];
+        plane_t *dstp        = &p_dst->p[n];
+
+        const int i_lines = dstp->i_visible_lines - 2;
+        const int i_first = 1 + (int64_t)i_lines * i_slice / i_slices;
+        const int i_last  = 1 + (int64_t)i_lines * (i_slice + 1) / i_slices;
+
+        for( int y = i_first; y < i_last; y++ )
+        {
+            if( (y % 2) == i_field  ||  yadif_parity == 2 )
+            {
+                memcpy( &dstp->p_pixels[y * dstp->i_pitch],
+                            &curp->p_pixels[y * curp->i_pitch], dstp->i_visible_pitch );
+            }
+            else
+            {
+                int mode;
+                /* Spatial checks only when enough data */
+                mode = (y >= 2 && y < dstp->i_visible_lines - 2) ? 0 : 2;
+
+                assert( prevp->i_pitch == curp->i_pitch && curp->i_pitch == nextp->i_pitch );
+                p_job->filter( &dstp->p_pixels[y * dstp->i_pitch],
+                               &prevp->p_pixels[y * prevp->i_pitch],
+                               &curp->p_pixels[y * curp->i_pitch],
+                               &nextp->p_pixels[y * nextp->i_pitch],
+                               dstp->i_visible_pitch,
+                               y < dstp->i_visible_lines - 2  ? curp->i_pitch : -curp->i_pitch,
+                               y  - 1  ?  -curp->i_pitch : curp->i_pitch,
+                               yadif_parity,
+                               mode );
+            }
+
+            /* We duplicate the first and last lines */
+            if( y == 1 )
+                memcpy(&dstp->p_pixels[(y-1) * dstp->i_pitch],
+                           &dstp->p_pixels[ y    * dstp->i_pitch],
+                           dstp->i_pitch);
+            else if( y == dstp->i_visible_lines - 2 )
+                memcpy(&dstp->p_pixels[(y+1) * dstp->i_pitch],
+                           &dstp->p_pixels[ y    * dstp->i_pitch],
+                           dstp->i_pitch);
+        }
+    }
+}
+
+/* Renders the slices of the current job not taken yet by another thread.
+ * Must be called with the lock held. */
+static void RenderYadifSlices( yadif_sys_t *p_yadif )
+{
+    while( p_yadif->i_next < p_yadif->i_slices )
+    {
+        const struct yadif_job_t *p_job = p_yadif->p_job;
+        const unsigned i_slice = p_yadif->i_next++;
+
+        vlc_mutex_unlock( &p_yadif->lock );
+        RenderYadifSlice( p_job, i_slice, p_yadif->i_slices );
+        vlc_mutex_lock( &p_yadif->lock );
+
+        if( ++p_yadif->i_done == p_yadif->i_slices )
+            vlc_cond_signal( &p_yadif->done );
+    }
+}
+
+static void *YadifWorker( void *data )
+{
+    yadif_sys_t *p_yadif = data;
+    unsigned i_job = 0;
+
+    vlc_mutex_lock( &p_yadif->lock );
+    for( ;; )
+    {
+        while( !p_yadif->b_exit && p_yadif->i_job == i_job )
+            vlc_cond_wait( &p_yadif->wait, &p_yadif->lock );
+        if( p_yadif->b_exit )
+            break;
+
+        i_job = p_yadif->i_job;
+        RenderYadifSlices( p_yadif );
+    }
+    vlc_mutex_unlock( &p_yadif->lock );
+    return NULL;
+}
+
+int YadifInit( filter_t *p_filter, unsigned i_threads )
+{
+    yadif_sys_t *p_yadif = &p_filter->p_sys->yadif;
+
+    if( i_threads == 0 )
+        i_threads = __MIN( vlc_GetCPUCount(), 8 );
+
+    p_yadif->i_slices = 1;
+    p_yadif->i_workers = 0;
+    p_yadif->p_workers = NULL;
+    p_yadif->p_job = NULL;
+    p_yadif->i_job = 0;
+    p_yadif->b_exit = false;
+    vlc_mutex_init( &p_yadif->lock );
+    vlc_cond_init( &p_yadif->wait );
+    vlc_cond_init( &p_yadif->done );
+
+    if( i_threads <= 1 )
+        return VLC_SUCCESS;
+
+    p_yadif->p_workers = malloc( (i_threads - 1) * sizeof(*p_yadif->p_workers) );
+    if( unlikely(p_yadif->p_workers == NULL) )
+        return VLC_ENOMEM;
+
+    while( p_yadif->i_workers < i_threads - 1 )
+    {
+        if( vlc_clone( &p_yadif->p_workers[p_yadif->i_workers], YadifWorker,
+                       p_yadif, VLC_THREAD_PRIORITY_VIDEO ) )
+        {
+            msg_Warn( p_filter, "cannot create Yadif thread" );
+            break;
+        }
+        p_yadif->i_workers++;
+    }
+    p_yadif->i_slices = p_yadif->i_workers + 1;
+
+    msg_Dbg( p_filter, "using %u Yadif slices", p_yadif->i_slices );
+    return VLC_SUCCESS;
+}
+
+void YadifClean( filter_t *p_filter )
+{
+    yadif_sys_t *p_yadif = &p_filter->p_sys->yadif;
+
+    vlc_mutex_lock( &p_yadif->lock );
+    p_yadif->b_exit = true;
+    vlc_cond_broadcast( &p_yadif->wait );
+    vlc_mutex_unlock( &p_yadif->lock );
+
+    for( unsigned i = 0; i < p_yadif->i_workers; i++ )
+        vlc_join( p_yadif->p_workers[i], NULL );
+    free( p_yadif->p_workers );
+
+    vlc_cond_destroy( &p_yadif->done );
+    vlc_cond_destroy( &p_yadif->wait );
+    vlc_mutex_destroy( &p_yadif->lock );
+}
+
 int RenderYadif( filter_t *p_filter, picture_t *p_dst, picture_t *p_src,
                  int i_order, int i_field )
 {
@@ -105,9 +276,13 @@ int RenderYadif( filter_t *p_filter, picture_t *p_dst, picture_t *p_src,
     if( p_prev && p_cur && p_next )
     {
         /* */
-        void (*filter)(uint8_t *dst, uint8_t *prev, uint8_t *cur, uint8_t *next,
-                       int w, int prefs, int mrefs, int parity, int mode);
+        yadif_filter_t filter;
 
+#if defined(HAVE_YADIF_AVX2)
+        if( vlc_CPU_AVX2() )
+            filter = yadif_filter_line_avx2;
+        else
+#endif
 #if defined(HAVE_YADIF_SSSE3)
         if( vlc_CPU_SSSE3() )
             filter = yadif_filter_line_ssse3;
@@ -126,51 +301,36 @@ int RenderYadif( filter_t *p_filter, picture_t *p_dst, picture_t *p_src,
             filter = yadif_filter_line_c;
 
         if( p_sys->chroma->pixel_size == 2 )
-            filter = yadif_filter_line_c_16bit;
+            filter = (yadif_filter_t)yadif_filter_line_c_16bit;
+
+        const struct yadif_job_t job = {
+            .p_dst = p_dst,
+            .p_prev = p_prev,
+            .p_cur = p_cur,
+            .p_next = p_next,
+            .filter = filter,
+            .i_field = i_field,
+            .i_parity = yadif_parity,
+        };
+        yadif_sys_t *p_yadif = &p_sys->yadif;
 
-        for( int n = 0; n < p_dst->i_planes; n++ )
+        if( p_yadif->i_slices > 1 )
         {
-            const plane_t *prevp = &p_prev->p[n];
-            const plane_t *curp  = &p_cur->p[n];
-            const plane_t *nextp = &p_next->p[n];
-            plane_t *dstp        = &p_dst->p[n];
+            vlc_mutex_lock( &p_yadif->lock );
+            p_yadif->p_job = &job;
+            p_yadif->i_next = 0;
+            p_yadif->i_done = 0;
+            p_yadif->i_job++;
+            vlc_cond_broadcast( &p_yadif->wait );
 
-            for( int y = 1; y < dstp->i_visible_lines - 1; y++ )
-            {
-                if( (y % 2) == i_field  ||  yadif_parity == 2 )
-                {
-                    memcpy( &dstp->p_pixels[y * dstp->i_pitch],
-                                &curp->p_pixels[y * curp->i_pitch], dstp->i_visible_pitch );
-                }
-                else
-                {
-                    int mode;
-                    /* Spatial checks only when enough data */
-                    mode = (y >= 2 && y < dstp->i_visible_lines - 2) ? 0 : 2;
-
-                    assert( prevp->i_pitch == curp->i_pitch && curp->i_pitch == nextp->i_pitch );
-                    filter( &dstp->p_pixels[y * dstp->i_pitch],
-                            &prevp->p_pixels[y * prevp->i_pitch],
-                            &curp->p_pixels[y * curp->i_pitch],
-                            &nextp->p_pixels[y * nextp->i_pitch],
-                            dstp->i_visible_pitch,
-                            y < dstp->i_visible_lines - 2  ? curp->i_pitch : -curp->i_pitch,
-                            y  - 1  ?  -curp->i_pitch : curp->i_pitch,
-                            yadif_parity,
-                            mode );
-                }
-
-                /* We duplicate the first and last lines */
-                if( y == 1 )
-                    memcpy(&dstp->p_pixels[(y-1) * dstp->i_pitch],
-                               &dstp->p_pixels[ y    * dstp->i_pitch],
-                               dstp->i_pitch);
-                else if( y == dstp->i_visible_lines - 2 )
-                    memcpy(&dstp->p_pixels[(y+1) * dstp->i_pitch],
-                               &dstp->p_pixels[ y    * dstp->i_pitch],
-                               dstp->i_pitch);
-            }
+            RenderYadifSlices( p_yadif );
+            while( p_yadif->i_done < p_yadif->i_slices )
+                vlc_cond_wait( &p_yadif->done, &p_yadif->lock );
+            p_yadif->p_job = NULL;
+            vlc_mutex_unlock( &p_yadif->lock );
         }
+        else
+            RenderYadifSlice( &job, 0, 1 );
 
         p_sys->i_frame_offset = 1; /* p_cur will be rendered at next frame, too */
 
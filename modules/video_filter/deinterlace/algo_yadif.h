@@ -34,11 +34,59 @@
 /* Forward declarations */
 struct filter_t;
 struct picture_t;
+struct yadif_job_t;
+
+/*****************************************************************************
+ * Data structures etc.
+ *****************************************************************************/
+
+/**
+ * Algorithm-specific state for Yadif.
+ *
+ * Each plane is split in i_slices bands of rows. The calling thread renders
+ * slices along with the worker threads; the slices are handed out in order
+ * to whichever thread asks first.
+ */
+typedef struct
+{
+    unsigned      i_slices;     /**< Number of slices, 1 when not threaded */
+    unsigned      i_workers;    /**< Number of worker threads */
+    vlc_thread_t *p_workers;
+
+    vlc_mutex_t   lock;
+    vlc_cond_t    wait;         /**< Signaled when a new job is posted */
+    vlc_cond_t    done;         /**< Signaled when all slices are rendered */
+    const struct yadif_job_t *p_job; /**< Current job, under lock */
+    unsigned      i_job;        /**< Job sequence number, under lock */
+    unsigned      i_next;       /**< Next slice to render, under lock */
+    unsigned      i_done;       /**< Number of slices rendered, under lock */
+    bool          b_exit;       /**< Workers shall exit, under lock */
+} yadif_sys_t;
 
 /*****************************************************************************
  * Functions
  *****************************************************************************/
 
+/**
+ * Starts the Yadif worker threads.
+ *
+ * @param p_filter The filter instance. Must be non-NULL.
+ * @param i_threads Number of threads rendering a picture, the calling one
+ *                  included. 0 picks one per CPU, up to 8.
+ * @return VLC error code (int). On error, Yadif still works, on the
+ *         calling thread only.
+ * @see YadifClean()
+ */
+int YadifInit( filter_t *p_filter, unsigned i_threads );
+
+/**
+ * Stops the Yadif worker threads, if any.
+ *
+ * @param p_filter The filter instance. Must be non-NULL.
+ * @see YadifInit()
+ */
+void YadifClean( filter_t *p_filter );
+
 /**
  * Yadif (Yet Another DeInterlacing Filter) from FFmpeg.
  * One field is copied as-is (i_field), the other is interpolated.
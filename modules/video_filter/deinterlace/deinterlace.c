@@ -55,6 +55,10 @@
 #define SOUT_MODE_TEXT N_("Streaming deinterlace mode")
 #define SOUT_MODE_LONGTEXT N_("Deinterlace method to use for streaming.")
 
+#define YADIF_THREADS_TEXT N_("Yadif threads")
+#define YADIF_THREADS_LONGTEXT N_("Number of threads rendering each picture "\
+                                  "in the Yadif modes (0 = automatic).")
+
 #define FILTER_CFG_PREFIX "sout-deinterlace-"
 
 /* Tooltips drop linefeeds (at least in the Qt GUI);
@@ -111,6 +115,9 @@ vlc_module_begin ()
                 PHOSPHOR_DIMMER_LONGTEXT, true )
         change_integer_list( phosphor_dimmer_list, phosphor_dimmer_list_text )
         change_safe ()
+    add_integer_with_range( FILTER_CFG_PREFIX "threads", 0, 0, 64,
+                            YADIF_THREADS_TEXT, YADIF_THREADS_LONGTEXT, true )
+        change_safe ()
     add_shortcut( "deinterlace" )
     set_callbacks( Open, Close )
 vlc_module_end ()
@@ -126,7 +133,7 @@ vlc_module_end ()
  * and reading logic for them implemented in Open().
  */
 static const char *const ppsz_filter_options[] = {
-    "mode", "phosphor-chroma", "phosphor-dimmer",
+    "mode", "phosphor-chroma", "phosphor-dimmer", "threads",
     NULL
 };
 
@@ -663,6 +670,13 @@ notsupp:
 
     IVTCClearState( p_filter );
 
+    if( p_sys->i_mode == DEINTERLACE_YADIF ||
+        p_sys->i_mode == DEINTERLACE_YADIF2X )
+        YadifInit( p_filter, var_GetInteger( p_filter,
+                                             FILTER_CFG_PREFIX "threads" ) );
+    else
+        YadifInit( p_filter, 1 );
+
 #if defined(CAN_COMPILE_C_ALTIVEC)
     if( pixel_size == 1 && vlc_CPU_ALTIVEC() )
         p_sys->pf_merge = MergeAltivec;
@@ -779,5 +793,6 @@ void Close( vlc_object_t *p_this )
     filter_t *p_filter = (filter_t*)p_this;
 
     Flush( p_filter );
+    YadifClean( p_filter );
     free( p_filter->p_sys );
 }
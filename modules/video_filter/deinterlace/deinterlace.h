@@ -120,6 +120,7 @@ struct filter_sys_t
 
     /* Algorithm-specific substructures */
     phosphor_sys_t phosphor; /**< Phosphor algorithm state. */
+    yadif_sys_t yadif;       /**< Yadif algorithm state. */
     ivtc_sys_t ivtc;         /**< IVTC algorithm state. */
 };
 
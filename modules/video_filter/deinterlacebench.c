@@ -0,0 +1,296 @@
+/*****************************************************************************
+ * deinterlacebench.c : deinterlacing benchmark plugin for vlc
+ *****************************************************************************
+ * Copyright (C) 2016 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/*****************************************************************************
+ * Preamble
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <vlc_common.h>
+#include <vlc_plugin.h>
+#include <vlc_modules.h>
+
+#include <vlc_filter.h>
+#include <vlc_picture.h>
+
+/*****************************************************************************
+ * Local prototypes
+ *****************************************************************************/
+static int Create( vlc_object_t * );
+static void Destroy( vlc_object_t * );
+
+static picture_t *Filter( filter_t *, picture_t * );
+
+/*****************************************************************************
+ * Module descriptor
+ *****************************************************************************/
+
+#define LOOPS_TEXT N_("Number of pictures to deinterlace")
+#define LOOPS_LONGTEXT N_("The number of input pictures the deinterlacer " \
+                          "will be timed on")
+
+#define MODE_TEXT N_("Deinterlace mode")
+#define MODE_LONGTEXT N_("Deinterlace method to benchmark")
+
+#define THREADS_TEXT N_("Threads")
+#define THREADS_LONGTEXT N_("Number of threads of the threaded run " \
+                            "(0 = automatic)")
+
+#define CFG_PREFIX "deinterlacebench-"
+
+vlc_module_begin ()
+    set_description( N_("Deinterlacing benchmark filter") )
+    set_shortname( N_("Deinterlacebench" ))
+    set_category( CAT_VIDEO )
+    set_subcategory( SUBCAT_VIDEO_VFILTER )
+    set_capability( "video filter", 0 )
+
+    set_section( N_("Benchmarking"), NULL )
+    add_integer( CFG_PREFIX "loops", 100, LOOPS_TEXT,
+              LOOPS_LONGTEXT, false )
+    add_string( CFG_PREFIX "mode", "yadif2x", MODE_TEXT,
+              MODE_LONGTEXT, false )
+    add_integer( CFG_PREFIX "threads", 0, THREADS_TEXT,
+              THREADS_LONGTEXT, false )
+
+    set_callbacks( Create, Destroy )
+vlc_module_end ()
+
+static const char *const ppsz_filter_options[] = {
+    "loops", "mode", "threads", NULL
+};
+
+/*****************************************************************************
+ * filter_sys_t: filter method descriptor
+ *****************************************************************************/
+
+/* The same deinterlacer is run serially and threaded on every picture, and
+ * both outputs are compared. */
+enum { RUN_SERIAL, RUN_THREADED, RUN_COUNT };
+
+struct filter_sys_t
+{
+    int i_loops, i_pictures, i_threads;
+    char *psz_mode;
+    bool b_done;
+    bool b_mismatch;
+
+    filter_t *p_deinterlace[RUN_COUNT];
+    mtime_t i_time[RUN_COUNT];
+};
+
+/*****************************************************************************
+ * Deinterlacer instances
+ *****************************************************************************/
+static picture_t *NewPicture( filter_t *p_deinterlace )
+{
+    return picture_NewFromFormat( &p_deinterlace->fmt_out.video );
+}
+
+static filter_t *deinterlacebench_Load( filter_t *p_filter, unsigned i_threads )
+{
+    filter_sys_t *p_sys = p_filter->p_sys;
+    char *psz_chain;
+
+    if( asprintf( &psz_chain, "deinterlace{mode=%s,threads=%u}",
+                  p_sys->psz_mode, i_threads ) == -1 )
+        return NULL;
+
+    filter_t *p_deinterlace = vlc_object_create( p_filter, sizeof(filter_t) );
+    if( !p_deinterlace )
+    {
+        free( psz_chain );
+        return NULL;
+    }
+
+    char *psz_name;
+    free( config_ChainCreate( &psz_name, &p_deinterlace->p_cfg, psz_chain ) );
+    free( psz_name );
+    free( psz_chain );
+
+    es_format_Copy( &p_deinterlace->fmt_in, &p_filter->fmt_in );
+    es_format_Copy( &p_deinterlace->fmt_out, &p_filter->fmt_in );
+    p_deinterlace->b_allow_fmt_out_change = true;
+    p_deinterlace->owner.video.buffer_new = NewPicture;
+
+    p_deinterlace->p_module = module_need( p_deinterlace, "video filter",
+                                           "deinterlace", true );
+    if( !p_deinterlace->p_module )
+    {
+        msg_Err( p_filter, "Unable to load the deinterlacer" );
+        config_ChainDestroy( p_deinterlace->p_cfg );
+        es_format_Clean( &p_deinterlace->fmt_in );
+        es_format_Clean( &p_deinterlace->fmt_out );
+        vlc_object_release( p_deinterlace );
+        return NULL;
+    }
+    return p_deinterlace;
+}
+
+static void deinterlacebench_Unload( filter_t *p_deinterlace )
+{
+    module_unneed( p_deinterlace, p_deinterlace->p_module );
+    config_ChainDestroy( p_deinterlace->p_cfg );
+    es_format_Clean( &p_deinterlace->fmt_in );
+    es_format_Clean( &p_deinterlace->fmt_out );
+    vlc_object_release( p_deinterlace );
+}
+
+/*****************************************************************************
+ * Create: allocates video thread output method
+ *****************************************************************************/
+static int Create( vlc_object_t *p_this )
+{
+    filter_t *p_filter = (filter_t *)p_this;
+    filter_sys_t *p_sys;
+
+    /* Allocate structure */
+    p_filter->p_sys = calloc( 1, sizeof( filter_sys_t ) );
+    if( p_filter->p_sys == NULL )
+        return VLC_ENOMEM;
+
+    p_sys = p_filter->p_sys;
+
+    /* needed to get options passed in transcode using the
+     * deinterlacebench{name=value} syntax */
+    config_ChainParse( p_filter, CFG_PREFIX, ppsz_filter_options,
+                       p_filter->p_cfg );
+
+    p_sys->i_loops = var_GetInteger( p_filter, CFG_PREFIX "loops" );
+    p_sys->i_threads = var_GetInteger( p_filter, CFG_PREFIX "threads" );
+    p_sys->psz_mode = var_GetNonEmptyString( p_filter, CFG_PREFIX "mode" );
+    if( p_sys->psz_mode == NULL || p_sys->i_threads < 0 )
+    {
+        free( p_sys->psz_mode );
+        free( p_sys );
+        return VLC_EGENERIC;
+    }
+
+    p_sys->p_deinterlace[RUN_SERIAL] = deinterlacebench_Load( p_filter, 1 );
+    p_sys->p_deinterlace[RUN_THREADED] =
+        deinterlacebench_Load( p_filter, p_sys->i_threads );
+    if( !p_sys->p_deinterlace[RUN_SERIAL] ||
+        !p_sys->p_deinterlace[RUN_THREADED] )
+    {
+        for( int i = 0; i < RUN_COUNT; i++ )
+            if( p_sys->p_deinterlace[i] )
+                deinterlacebench_Unload( p_sys->p_deinterlace[i] );
+        free( p_sys->psz_mode );
+        free( p_sys );
+        return VLC_EGENERIC;
+    }
+
+    p_filter->pf_video_filter = Filter;
+    return VLC_SUCCESS;
+}
+
+/*****************************************************************************
+ * Destroy: destroy video thread output method
+ *****************************************************************************/
+static void Destroy( vlc_object_t *p_this )
+{
+    filter_t *p_filter = (filter_t *)p_this;
+    filter_sys_t *p_sys = p_filter->p_sys;
+
+    for( int i = 0; i < RUN_COUNT; i++ )
+        if( p_sys->p_deinterlace[i] )
+            deinterlacebench_Unload( p_sys->p_deinterlace[i] );
+    free( p_sys->psz_mode );
+    free( p_sys );
+}
+
+/*****************************************************************************
+ * Render: passes the picture through, once timed
+ *****************************************************************************/
+static bool PicturesDiffer( const picture_t *p_a, const picture_t *p_b )
+{
+    if( !p_a || !p_b )
+        return p_a != p_b;
+
+    for( int i = 0; i < p_a->i_planes; i++ )
+    {
+        const plane_t *a = &p_a->p[i], *b = &p_b->p[i];
+
+        for( int y = 0; y < a->i_visible_lines; y++ )
+            if( memcmp( &a->p_pixels[y * a->i_pitch],
+                        &b->p_pixels[y * b->i_pitch], a->i_visible_pitch ) )
+                return true;
+    }
+    return false;
+}
+
+static picture_t *Filter( filter_t *p_filter, picture_t *p_pic )
+{
+    filter_sys_t *p_sys = p_filter->p_sys;
+    picture_t *p_out[RUN_COUNT];
+
+    if( p_sys->b_done )
+        return p_pic;
+
+    for( int i = 0; i < RUN_COUNT; i++ )
+    {
+        filter_t *p_deinterlace = p_sys->p_deinterlace[i];
+
+        mtime_t time = mdate();
+        p_out[i] = p_deinterlace->pf_video_filter( p_deinterlace,
+                                                   picture_Hold( p_pic ) );
+        p_sys->i_time[i] += mdate() - time;
+    }
+
+    /* Framerate doublers output several pictures */
+    for( picture_t *p_a = p_out[RUN_SERIAL], *p_b = p_out[RUN_THREADED];
+         p_a || p_b;
+         p_a = p_a ? p_a->p_next : NULL, p_b = p_b ? p_b->p_next : NULL )
+    {
+        if( PicturesDiffer( p_a, p_b ) && !p_sys->b_mismatch )
+        {
+            msg_Err( p_filter, "Threaded output differs from serial output "
+                     "at picture %d", p_sys->i_pictures );
+            p_sys->b_mismatch = true;
+        }
+    }
+    for( int i = 0; i < RUN_COUNT; i++ )
+        while( p_out[i] )
+        {
+            picture_t *p_next = p_out[i]->p_next;
+            picture_Release( p_out[i] );
+            p_out[i] = p_next;
+        }
+
+    if( ++p_sys->i_pictures < p_sys->i_loops )
+        return p_pic;
+
+    msg_Info( p_filter, "Deinterlaced %d pictures (%s)", p_sys->i_pictures,
+              p_sys->psz_mode );
+    msg_Info( p_filter, "Serial: %f ms/picture, threaded: %f ms/picture "
+              "(%.2fx)",
+              p_sys->i_time[RUN_SERIAL] / 1000.0f / p_sys->i_pictures,
+              p_sys->i_time[RUN_THREADED] / 1000.0f / p_sys->i_pictures,
+              (float) p_sys->i_time[RUN_SERIAL] /
+                  __MAX( p_sys->i_time[RUN_THREADED], 1 ) );
+    if( !p_sys->b_mismatch )
+        msg_Info( p_filter, "Threaded output matches serial output" );
+
+    p_sys->b_done = true;
+    return p_pic;
+}
@@ -152,6 +152,36 @@ static inline void rgb_to_yuv( uint8_t *y, uint8_t *u, uint8_t *v,
     *v =   ( ( 112 * r -  94 * g -  18 * b + 128 ) >> 8 ) + 128 ;
 }
 
+/*****************************************************************************
+ * Slicing helpers for filter_RunSlices()
+ *****************************************************************************/
+/* Bands of fewer luma lines are not worth waking a thread up for */
+#define SLICE_MIN_LINES 32
+
+static inline unsigned GetMaxSlices( const picture_t *p_pic )
+{
+    return __MAX( p_pic->p[0].i_visible_lines / SLICE_MIN_LINES, 1 );
+}
+
+/* Makes p_slice a view of the lines of one slice of each plane of p_pic.
+ * The view only holds the format and planes, it is not a real picture. */
+static inline void SlicePicture( picture_t *p_slice, const picture_t *p_pic,
+                                 unsigned i_slice, unsigned i_slices )
+{
+    p_slice->format = p_pic->format;
+    p_slice->i_planes = p_pic->i_planes;
+    for( int i = 0; i < p_pic->i_planes; i++ )
+    {
+        int i_first, i_end;
+
+        plane_SliceLines( &p_pic->p[i], i_slice, i_slices, &i_first, &i_end );
+        p_slice->p[i] = p_pic->p[i];
+        p_slice->p[i].p_pixels += i_first * p_pic->p[i].i_pitch;
+        p_slice->p[i].i_lines = i_end - i_first;
+        p_slice->p[i].i_visible_lines = i_end - i_first;
+    }
+}
+
 /*****************************************************************************
  *
  *****************************************************************************/
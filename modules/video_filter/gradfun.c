@@ -106,6 +106,7 @@ struct filter_sys_t {
     int              radius;
     const vlc_chroma_description_t *chroma;
     struct vf_priv_s cfg;
+    size_t           buf_size; /* Blur buffer size of each plane */
 };
 
 static int Open(vlc_object_t *object)
@@ -171,6 +172,41 @@ static void Close(vlc_object_t *object)
     free(sys);
 }
 
+struct gradfun_slices_t {
+    filter_t        *filter;
+    const picture_t *src;
+    picture_t       *dst;
+};
+
+static void FilterPlane(void *data, unsigned slice, unsigned slices)
+{
+    const struct gradfun_slices_t *p = data;
+    filter_sys_t *sys = p->filter->p_sys;
+    const video_format_t *fmt = &p->filter->fmt_in.video;
+
+    for (int i = slice; i < p->dst->i_planes; i += slices) {
+        const plane_t *srcp = &p->src->p[i];
+        plane_t       *dstp = &p->dst->p[i];
+
+        struct vf_priv_s cfg = sys->cfg;
+        if (cfg.buf)
+            cfg.buf += i * sys->buf_size;
+
+        const vlc_chroma_description_t *chroma = sys->chroma;
+        int w = fmt->i_width  * chroma->p[i].w.num / chroma->p[i].w.den;
+        int h = fmt->i_height * chroma->p[i].h.num / chroma->p[i].h.den;
+        int r = (cfg.radius  * chroma->p[i].w.num / chroma->p[i].w.den +
+                 cfg.radius  * chroma->p[i].h.num / chroma->p[i].h.den) / 2;
+        r = VLC_CLIP((r + 1) & ~1, RADIUS_MIN, RADIUS_MAX);
+        if (__MIN(w, h) > 2 * r && cfg.buf) {
+            filter_plane(&cfg, dstp->p_pixels, srcp->p_pixels,
+                         w, h, dstp->i_pitch, srcp->i_pitch, r);
+        } else {
+            plane_CopyPixels(dstp, srcp);
+        }
+    }
+}
+
 static picture_t *Filter(filter_t *filter, picture_t *src)
 {
     filter_sys_t *sys = filter->p_sys;
@@ -191,28 +227,22 @@ static picture_t *Filter(filter_t *filter, picture_t *src)
 
     cfg->thresh = (1 << 15) / strength;
     if (cfg->radius != radius) {
-        cfg->radius = radius;
-        cfg->buf    = vlc_memalign(16,
-                                   (((fmt->i_width + 15) & ~15) * (cfg->radius + 1) / 2 + 32) * sizeof(*cfg->buf));
+        /* One blur buffer per plane, so that planes can be filtered in
+         * parallel */
+        cfg->radius    = radius;
+        sys->buf_size  = ((fmt->i_width + 15) & ~15) * (cfg->radius + 1) / 2 + 32;
+        vlc_free(cfg->buf);
+        cfg->buf       = vlc_memalign(16, dst->i_planes * sys->buf_size * sizeof(*cfg->buf));
     }
 
-    for (int i = 0; i < dst->i_planes; i++) {
-        const plane_t *srcp = &src->p[i];
-        plane_t       *dstp = &dst->p[i];
-
-        const vlc_chroma_description_t *chroma = sys->chroma;
-        int w = fmt->i_width  * chroma->p[i].w.num / chroma->p[i].w.den;
-        int h = fmt->i_height * chroma->p[i].h.num / chroma->p[i].h.den;
-        int r = (cfg->radius  * chroma->p[i].w.num / chroma->p[i].w.den +
-                 cfg->radius  * chroma->p[i].h.num / chroma->p[i].h.den) / 2;
-        r = VLC_CLIP((r + 1) & ~1, RADIUS_MIN, RADIUS_MAX);
-        if (__MIN(w, h) > 2 * r && cfg->buf) {
-            filter_plane(cfg, dstp->p_pixels, srcp->p_pixels,
-                         w, h, dstp->i_pitch, srcp->i_pitch, r);
-        } else {
-            plane_CopyPixels(dstp, srcp);
-        }
-    }
+    /* The blur is a running sum down the lines, so only the planes can be
+     * processed in parallel */
+    struct gradfun_slices_t slices = {
+        .filter = filter,
+        .src    = src,
+        .dst    = dst,
+    };
+    filter_RunSlices(filter, FilterPlane, &slices, dst->i_planes);
 
     picture_CopyProperties(dst, src);
     picture_Release(src);
@@ -38,6 +38,8 @@
 
 #include <vlc_rand.h>
 
+#include "filter_picture.h"
+
 /*****************************************************************************
  * Module descriptor
  *****************************************************************************/
@@ -222,14 +224,21 @@ static void Scale(int16_t *dst, int16_t *src, int scale)
 
 static void PlaneFilter(filter_t *filter,
                         plane_t *dst, const plane_t *src,
-                        int16_t *bank, uint32_t *seed)
+                        int16_t *bank, uint32_t plane_seed,
+                        int y_first, int y_end)
 {
     filter_sys_t *sys = filter->p_sys;
 
-    for (int y = 0; y < dst->i_visible_lines; y += BLEND_SIZE) {
+    for (int y = y_first; y < y_end; y += BLEND_SIZE) {
+        /* Each row of blocks has its own random sequence, so that the noise
+         * does not depend on how the picture is sliced */
+        uint32_t seed = plane_seed ^ (y * UINT32_C(0x9e3779b9));
+        if (seed == 0)
+            seed = URAND_SEED;
+
         for (int x = 0; x < dst->i_visible_pitch; x += BLEND_SIZE) {
-            int bx = urand(seed) % (BANK_SIZE - BLEND_SIZE + 1);
-            int by = urand(seed) % (BANK_SIZE - BLEND_SIZE + 1);
+            int bx = urand(&seed) % (BANK_SIZE - BLEND_SIZE + 1);
+            int by = urand(&seed) % (BANK_SIZE - BLEND_SIZE + 1);
             const int16_t *noise = &bank[by * BANK_SIZE + bx];
 
             int w  = dst->i_visible_pitch - x;
@@ -245,6 +254,43 @@ static void PlaneFilter(filter_t *filter,
                            __MIN(w, BLEND_SIZE), __MIN(h, BLEND_SIZE));
         }
     }
+}
+
+struct grain_slices_t {
+    filter_t        *filter;
+    const picture_t *src;
+    picture_t       *dst;
+    uint32_t        seed[PICTURE_PLANE_MAX];
+};
+
+static void FilterSlice(void *data, unsigned slice, unsigned slices)
+{
+    const struct grain_slices_t *p = data;
+    filter_sys_t *sys = p->filter->p_sys;
+
+    for (int i = 0; i < p->dst->i_planes; i++) {
+        const plane_t *srcp = &p->src->p[i];
+        plane_t       *dstp = &p->dst->p[i];
+
+        if (i == 0 || sys->is_uv_filtered) {
+            /* Slices are made of whole rows of blocks */
+            const int rows = (dstp->i_visible_lines + BLEND_SIZE - 1) / BLEND_SIZE;
+            const int y_first = rows * slice / slices * BLEND_SIZE;
+            const int y_end   = rows * (slice + 1) / slices * BLEND_SIZE;
+
+            int16_t *bank = i == 0 ? sys->bank_y :
+                                     sys->bank_uv;
+            PlaneFilter(p->filter, dstp, srcp, bank, p->seed[i],
+                        y_first, y_end);
+        }
+        else {
+            picture_t src, dst;
+
+            SlicePicture(&src, p->src, slice, slices);
+            SlicePicture(&dst, p->dst, slice, slices);
+            plane_CopyPixels(&dst.p[i], &src.p[i]);
+        }
+    }
     if (sys->emms)
         sys->emms();
 }
@@ -270,19 +316,14 @@ static picture_t *Filter(filter_t *filter, picture_t *src)
         Scale(sys->bank_uv, sys->bank, sys->scale / 2);
     }
 
-    for (int i = 0; i < dst->i_planes; i++) {
-        const plane_t *srcp = &src->p[i];
-        plane_t       *dstp = &dst->p[i];
-
-        if (i == 0 || sys->is_uv_filtered) {
-            int16_t *bank = i == 0 ? sys->bank_y :
-                                     sys->bank_uv;
-            PlaneFilter(filter, dstp, srcp, bank, &sys->seed);
-        }
-        else {
-            plane_CopyPixels(dstp, srcp);
-        }
-    }
+    struct grain_slices_t slices = {
+        .filter = filter,
+        .src    = src,
+        .dst    = dst,
+    };
+    for (int i = 0; i < dst->i_planes; i++)
+        slices.seed[i] = urand(&sys->seed);
+    filter_RunSlices(filter, FilterSlice, &slices, GetMaxSlices(src));
 
     picture_CopyProperties(dst, src);
     picture_Release(src);
@@ -90,6 +90,7 @@ struct filter_sys_t
 {
     const vlc_chroma_description_t *chroma;
     int w[3], h[3];
+    int wmax; /* Line buffer size of each plane */
 
     struct vf_priv_s cfg;
     bool   b_recalc_coefs;
@@ -137,7 +138,10 @@ static int Open(vlc_object_t *this)
         if (sys->w[i] > wmax) wmax = sys->w[i];
         sys->h[i] = fmt_out->i_height * chroma->p[i].h.num / chroma->p[i].h.den;
     }
-    cfg->Line = malloc(wmax*sizeof(unsigned int));
+    /* One line buffer per plane, so that planes can be denoised in
+     * parallel */
+    sys->wmax = wmax;
+    cfg->Line = malloc(3*wmax*sizeof(unsigned int));
     if (!cfg->Line) {
         free(sys);
         return VLC_ENOMEM;
@@ -191,6 +195,31 @@ static void Close(vlc_object_t *this)
 /*****************************************************************************
  * Filter
  *****************************************************************************/
+struct hqdn3d_slices_t
+{
+    filter_sys_t *sys;
+    const picture_t *src;
+    picture_t *dst;
+};
+
+static void FilterPlane(void *data, unsigned slice, unsigned slices)
+{
+    const struct hqdn3d_slices_t *p = data;
+    filter_sys_t *sys = p->sys;
+    struct vf_priv_s *cfg = &sys->cfg;
+
+    for (unsigned i = slice; i < 3; i += slices) {
+        int *spat = cfg->Coefs[i == 0 ? 0 : 2];
+        int *temp = cfg->Coefs[i == 0 ? 1 : 3];
+
+        deNoise(p->src->p[i].p_pixels, p->dst->p[i].p_pixels,
+                cfg->Line + i * sys->wmax, &cfg->Frame[i],
+                sys->w[i], sys->h[i],
+                p->src->p[i].i_pitch, p->dst->p[i].i_pitch,
+                spat, spat, temp);
+    }
+}
+
 static picture_t *Filter(filter_t *filter, picture_t *src)
 {
     picture_t *dst;
@@ -220,24 +249,14 @@ static picture_t *Filter(filter_t *filter, picture_t *src)
     }
     vlc_mutex_unlock( &sys->coefs_mutex );
 
-    deNoise(src->p[0].p_pixels, dst->p[0].p_pixels,
-            cfg->Line, &cfg->Frame[0], sys->w[0], sys->h[0],
-            src->p[0].i_pitch, dst->p[0].i_pitch,
-            cfg->Coefs[0],
-            cfg->Coefs[0],
-            cfg->Coefs[1]);
-    deNoise(src->p[1].p_pixels, dst->p[1].p_pixels,
-            cfg->Line, &cfg->Frame[1], sys->w[1], sys->h[1],
-            src->p[1].i_pitch, dst->p[1].i_pitch,
-            cfg->Coefs[2],
-            cfg->Coefs[2],
-            cfg->Coefs[3]);
-    deNoise(src->p[2].p_pixels, dst->p[2].p_pixels,
-            cfg->Line, &cfg->Frame[2], sys->w[2], sys->h[2],
-            src->p[2].i_pitch, dst->p[2].i_pitch,
-            cfg->Coefs[2],
-            cfg->Coefs[2],
-            cfg->Coefs[3]);
+    /* The spatial filter is recursive both along and across the lines, so
+     * only the planes can be processed in parallel */
+    struct hqdn3d_slices_t slices = {
+        .sys = sys,
+        .src = src,
+        .dst = dst,
+    };
+    filter_RunSlices(filter, FilterPlane, &slices, 3);
 
     if(unlikely(!cfg->Frame[0] || !cfg->Frame[1] || !cfg->Frame[2]))
     {
@@ -42,6 +42,7 @@ static int  Create      ( vlc_object_t * );
 static void Destroy     ( vlc_object_t * );
 
 static picture_t *Filter( filter_t *, picture_t * );
+static void FilterSlice( void *, unsigned, unsigned );
 
 /*****************************************************************************
  * Module descriptor
@@ -90,6 +91,13 @@ static void Destroy( vlc_object_t *p_this )
     (void)p_this;
 }
 
+struct invert_slices_t
+{
+    const picture_t *p_pic;
+    picture_t *p_outpic;
+    int i_planes;
+};
+
 /*****************************************************************************
  * Render: displays previously rendered output
  *****************************************************************************
@@ -125,6 +133,30 @@ static picture_t *Filter( filter_t *p_filter, picture_t *p_pic )
         i_planes = p_pic->i_planes;
     }
 
+    struct invert_slices_t slices = {
+        .p_pic = p_pic,
+        .p_outpic = p_outpic,
+        .i_planes = i_planes,
+    };
+    filter_RunSlices( p_filter, FilterSlice, &slices, GetMaxSlices( p_pic ) );
+
+    return CopyInfoAndRelease( p_outpic, p_pic );
+}
+
+/*****************************************************************************
+ * FilterSlice: inverts the lines of one slice of the picture
+ *****************************************************************************/
+static void FilterSlice( void *p_data, unsigned i_slice, unsigned i_slices )
+{
+    const struct invert_slices_t *p_slices = p_data;
+    picture_t pic, outpic;
+    const picture_t *p_pic = &pic;
+    picture_t *p_outpic = &outpic;
+    const int i_planes = p_slices->i_planes;
+
+    SlicePicture( &pic, p_slices->p_pic, i_slice, i_slices );
+    SlicePicture( &outpic, p_slices->p_outpic, i_slice, i_slices );
+
     for( int i_index = 0 ; i_index < i_planes ; i_index++ )
     {
         uint8_t *p_in, *p_in_end, *p_line_end, *p_out;
@@ -168,6 +200,4 @@ static picture_t *Filter( filter_t *p_filter, picture_t *p_pic )
                      - p_outpic->p[i_index].i_visible_pitch;
         }
     }
-
-    return CopyInfoAndRelease( p_outpic, p_pic );
 }
@@ -160,46 +160,50 @@ static void Destroy( vlc_object_t *p_this )
     free( p_sys );
 }
 
-/*****************************************************************************
- * Render: displays previously rendered output
- *****************************************************************************
- * This function send the currently rendered image to Invert image, waits
- * until it is displayed and switch the two rendering buffers, preparing next
- * frame.
- *****************************************************************************/
-static picture_t *Filter( filter_t *p_filter, picture_t *p_pic )
+struct sharpen_slices_t
 {
+    const picture_t *p_pic;
     picture_t *p_outpic;
-    uint8_t *restrict p_src = NULL;
-    uint8_t *restrict p_out = NULL;
-    int i_src_pitch;
-    int i_out_pitch;
+    int sigma;
+};
+
+static void FilterSlice( void *p_data, unsigned i_slice, unsigned i_slices )
+{
+    const struct sharpen_slices_t *p_slices = p_data;
+    const picture_t *p_pic = p_slices->p_pic;
+    picture_t *p_outpic = p_slices->p_outpic;
     int pix;
     const int v1 = -1;
     const int v2 = 3; /* 2^3 = 8 */
     const unsigned i_visible_lines = p_pic->p[Y_PLANE].i_visible_lines;
     const unsigned i_visible_pitch = p_pic->p[Y_PLANE].i_visible_pitch;
-    const int sigma = var_GetFloat( p_filter, FILTER_PREFIX "sigma" ) * (1 << 20);
-
-    p_outpic = filter_NewPicture( p_filter );
-    if( !p_outpic )
-    {
-        picture_Release( p_pic );
-        return NULL;
-    }
+    const int sigma = p_slices->sigma;
 
     /* process the Y plane */
-    p_src = p_pic->p[Y_PLANE].p_pixels;
-    p_out = p_outpic->p[Y_PLANE].p_pixels;
-    i_src_pitch = p_pic->p[Y_PLANE].i_pitch;
-    i_out_pitch = p_outpic->p[Y_PLANE].i_pitch;
+    const uint8_t *restrict p_src = p_pic->p[Y_PLANE].p_pixels;
+    uint8_t *restrict p_out = p_outpic->p[Y_PLANE].p_pixels;
+    const int i_src_pitch = p_pic->p[Y_PLANE].i_pitch;
+    const int i_out_pitch = p_outpic->p[Y_PLANE].i_pitch;
 
-    /* perform convolution only on Y plane. Avoid border line. */
-    vlc_mutex_lock( &p_filter->p_sys->lock );
+    /* Lines of this slice: the neighbour lines are read from the source, so
+     * slices do not depend on each other */
+    int i_first, i_end;
+    plane_SliceLines( &p_pic->p[Y_PLANE], i_slice, i_slices, &i_first, &i_end );
 
-    memcpy(p_out, p_src, i_visible_pitch);
+    /* perform convolution only on Y plane. Avoid border line. */
+    if( i_first == 0 )
+    {
+        memcpy(p_out, p_src, i_visible_pitch);
+        i_first = 1;
+    }
+    if( (unsigned)i_end == i_visible_lines )
+    {
+        memcpy(&p_out[(i_visible_lines - 1) * i_out_pitch],
+               &p_src[(i_visible_lines - 1) * i_src_pitch], i_visible_pitch);
+        i_end--;
+    }
 
-    for( unsigned i = 1; i < i_visible_lines - 1; i++ )
+    for( int i = i_first; i < i_end; i++ )
     {
         p_out[i * i_out_pitch] = p_src[i * i_src_pitch];
 
@@ -223,13 +227,44 @@ static picture_t *Filter( filter_t *p_filter, picture_t *p_pic )
         p_out[i * i_out_pitch + i_visible_pitch - 1] =
             p_src[i * i_src_pitch + i_visible_pitch - 1];
     }
-    memcpy(&p_out[(i_visible_lines - 1) * i_out_pitch],
-           &p_src[(i_visible_lines - 1) * i_src_pitch], i_visible_pitch);
 
-    vlc_mutex_unlock( &p_filter->p_sys->lock );
+    /* the chroma planes are copied as is */
+    picture_t pic, outpic;
+
+    SlicePicture( &pic, p_pic, i_slice, i_slices );
+    SlicePicture( &outpic, p_outpic, i_slice, i_slices );
+    plane_CopyPixels( &outpic.p[U_PLANE], &pic.p[U_PLANE] );
+    plane_CopyPixels( &outpic.p[V_PLANE], &pic.p[V_PLANE] );
+}
 
-    plane_CopyPixels( &p_outpic->p[U_PLANE], &p_pic->p[U_PLANE] );
-    plane_CopyPixels( &p_outpic->p[V_PLANE], &p_pic->p[V_PLANE] );
+/*****************************************************************************
+ * Render: displays previously rendered output
+ *****************************************************************************
+ * This function send the currently rendered image to Invert image, waits
+ * until it is displayed and switch the two rendering buffers, preparing next
+ * frame.
+ *****************************************************************************/
+static picture_t *Filter( filter_t *p_filter, picture_t *p_pic )
+{
+    picture_t *p_outpic;
+    const int sigma = var_GetFloat( p_filter, FILTER_PREFIX "sigma" ) * (1 << 20);
+
+    p_outpic = filter_NewPicture( p_filter );
+    if( !p_outpic )
+    {
+        picture_Release( p_pic );
+        return NULL;
+    }
+
+    struct sharpen_slices_t slices = {
+        .p_pic = p_pic,
+        .p_outpic = p_outpic,
+        .sigma = sigma,
+    };
+
+    vlc_mutex_lock( &p_filter->p_sys->lock );
+    filter_RunSlices( p_filter, FilterSlice, &slices, GetMaxSlices( p_pic ) );
+    vlc_mutex_unlock( &p_filter->p_sys->lock );
 
     return CopyInfoAndRelease( p_outpic, p_pic );
 }
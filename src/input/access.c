@@ -201,13 +201,31 @@ static block_t *AStreamReadBlock(stream_t *s, bool *restrict eof)
 
     if (block != NULL && input != NULL)
     {
-        uint64_t total;
+        uint64_t total, packets;
+
+        /* Batching accesses return several packets per block */
+        if (vlc_stream_Control(access, STREAM_GET_PACKETS,
+                               &packets) != VLC_SUCCESS)
+            packets = 1;
 
         vlc_mutex_lock(&input->p->counters.counters_lock);
         stats_Update(input->p->counters.p_read_bytes, block->i_buffer, &total);
         stats_Update(input->p->counters.p_input_bitrate, total, NULL);
-        stats_Update(input->p->counters.p_read_packets, 1, NULL);
+        stats_Update(input->p->counters.p_read_packets, packets, NULL);
         vlc_mutex_unlock(&input->p->counters.counters_lock);
+
+        /* Lossy accesses flag the first block following a loss */
+        uint64_t dropped, overruns;
+
+        if ((block->i_flags & (BLOCK_FLAG_DISCONTINUITY|BLOCK_FLAG_CORRUPTED))
+         && vlc_stream_Control(access, STREAM_GET_LOSS,
+                               &dropped, &overruns) == VLC_SUCCESS)
+        {
+            vlc_mutex_lock(&input->p->counters.counters_lock);
+            stats_Update(input->p->counters.p_read_dropped, dropped, NULL);
+            stats_Update(input->p->counters.p_read_overruns, overruns, NULL);
+            vlc_mutex_unlock(&input->p->counters.counters_lock);
+        }
     }
 
     return block;
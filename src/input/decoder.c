@@ -64,6 +64,15 @@ enum reload
     RELOAD_DECODER_AOUT /* Stop the aout and reload the decoder module */
 };
 
+/* Output format change of the packetizer stage, applied by the decoder thread
+ * before decoding the i_block-th packetized block */
+struct decoder_fmt_change
+{
+    uint64_t i_block;
+    es_format_t fmt;
+    struct decoder_fmt_change *p_next;
+};
+
 struct decoder_owner_sys_t
 {
     input_thread_t  *p_input;
@@ -84,6 +93,27 @@ struct decoder_owner_sys_t
     decoder_t *p_packetizer;
     bool b_packetizer;
 
+    /* Packetizer stage: when enabled, the packetizer runs in its own thread
+     * ahead of the decoder thread */
+    struct
+    {
+        block_fifo_t *p_fifo; /* blocks to packetize, NULL if disabled */
+        vlc_thread_t  thread;
+        vlc_cond_t    wait;   /* signaled when a block is dequeued */
+        es_format_t   fmt;    /* current output format of the packetizer */
+        atomic_uint   flushes;
+        bool          b_flushing;
+        bool          b_draining;
+        bool          b_idle;
+        bool          b_pace; /* the input is paced on the stage */
+
+        /* Protected by the decoder fifo lock */
+        bool     b_closing;
+        uint64_t i_queued;
+        uint64_t i_dequeued;
+        struct decoder_fmt_change *p_fmt_changes;
+    } stage;
+
     /* Current format in use by the output */
     es_format_t    fmt;
 
@@ -1058,7 +1088,7 @@ static void DecoderProcessVideo( decoder_t *p_dec, block_t *p_block )
 {
     decoder_owner_sys_t *p_owner = p_dec->p_owner;
 
-    if( p_owner->p_packetizer )
+    if( p_owner->p_packetizer && p_owner->stage.p_fifo == NULL )
     {
         block_t *p_packetized_block;
         block_t **pp_block = p_block ? &p_block : NULL;
@@ -1252,7 +1282,7 @@ static void DecoderProcessAudio( decoder_t *p_dec, block_t *p_block )
 {
     decoder_owner_sys_t *p_owner = p_dec->p_owner;
 
-    if( p_owner->p_packetizer )
+    if( p_owner->p_packetizer && p_owner->stage.p_fifo == NULL )
     {
         block_t *p_packetized_block;
         block_t **pp_block = p_block ? &p_block : NULL;
@@ -1460,7 +1490,9 @@ static void DecoderProcessFlush( decoder_t *p_dec )
     if( p_dec->b_error )
         return;
 
-    if( p_packetizer != NULL && p_packetizer->pf_flush != NULL )
+    /* The packetizer stage flushes its packetizer itself */
+    if( p_packetizer != NULL && p_owner->stage.p_fifo == NULL
+     && p_packetizer->pf_flush != NULL )
         p_packetizer->pf_flush( p_packetizer );
 
     if ( p_dec->pf_flush != NULL )
@@ -1501,6 +1533,223 @@ static void DecoderProcessFlush( decoder_t *p_dec )
     vlc_mutex_unlock( &p_owner->lock );
 }
 
+/**
+ * Restarts the decoder module on a format change of the packetizer stage
+ */
+static void DecoderStageReload( decoder_t *p_dec, const es_format_t *p_fmt )
+{
+    if( p_dec->b_error || es_format_IsSimilar( &p_dec->fmt_in, p_fmt ) )
+        return;
+
+    msg_Dbg( p_dec, "restarting module due to input format change");
+
+    /* Drain the decoder module */
+    if( p_dec->fmt_out.i_cat == VIDEO_ES )
+        DecoderDecodeVideo( p_dec, NULL );
+    else
+        DecoderDecodeAudio( p_dec, NULL );
+
+    ReloadDecoder( p_dec, false, p_fmt, RELOAD_DECODER );
+}
+
+/**
+ * Returns the last format change to apply before the next packetized block,
+ * and discards the older ones. Must be called with the decoder fifo locked.
+ */
+static struct decoder_fmt_change *DecoderStageGetFormatLocked( decoder_owner_sys_t *p_owner )
+{
+    struct decoder_fmt_change *p_change = NULL;
+
+    while( p_owner->stage.p_fmt_changes != NULL
+        && p_owner->stage.p_fmt_changes->i_block <= p_owner->stage.i_dequeued )
+    {
+        if( p_change != NULL )
+        {
+            es_format_Clean( &p_change->fmt );
+            free( p_change );
+        }
+        p_change = p_owner->stage.p_fmt_changes;
+        p_owner->stage.p_fmt_changes = p_change->p_next;
+    }
+    return p_change;
+}
+
+/**
+ * Queues packetized blocks to the decoder thread, after the new format of
+ * the packetizer if it changed
+ */
+static void DecoderStageQueue( decoder_t *p_dec, block_t *p_chain,
+                               const es_format_t *p_fmt, unsigned flushes,
+                               bool b_pace )
+{
+    decoder_owner_sys_t *p_owner = p_dec->p_owner;
+    struct decoder_fmt_change *p_change = NULL;
+
+    if( p_fmt != NULL )
+    {
+        p_change = malloc( sizeof( *p_change ) );
+        if( likely(p_change != NULL) )
+        {
+            es_format_Init( &p_change->fmt, UNKNOWN_ES, 0 );
+            es_format_Copy( &p_change->fmt, p_fmt );
+            p_change->p_next = NULL;
+        }
+    }
+
+    vlc_fifo_Lock( p_owner->p_fifo );
+    /* Pace on the decoder as the input is paced on the stage, otherwise the
+     * demuxer would be drained into the decoder fifo */
+    while( b_pace && !p_owner->stage.b_closing
+        && vlc_fifo_GetCount( p_owner->p_fifo ) >= 10
+        && flushes == atomic_load( &p_owner->stage.flushes ) )
+        vlc_fifo_WaitCond( p_owner->p_fifo, &p_owner->wait_fifo );
+
+    if( p_change != NULL )
+    {
+        struct decoder_fmt_change **pp_last = &p_owner->stage.p_fmt_changes;
+        while( *pp_last != NULL )
+            pp_last = &(*pp_last)->p_next;
+        p_change->i_block = p_owner->stage.i_queued;
+        *pp_last = p_change;
+    }
+
+    if( flushes != atomic_load( &p_owner->stage.flushes ) )
+    {   /* Flushed while packetizing: the blocks are stale */
+        vlc_fifo_Unlock( p_owner->p_fifo );
+        block_ChainRelease( p_chain );
+        return;
+    }
+
+    for( block_t *p_block = p_chain; p_block != NULL; p_block = p_block->p_next )
+        p_owner->stage.i_queued++;
+    vlc_fifo_QueueUnlocked( p_owner->p_fifo, p_chain );
+    vlc_fifo_Unlock( p_owner->p_fifo );
+}
+
+static void DecoderStageProcess( decoder_t *p_dec, block_t *p_block,
+                                 unsigned flushes, bool b_pace )
+{
+    decoder_owner_sys_t *p_owner = p_dec->p_owner;
+    decoder_t *p_packetizer = p_owner->p_packetizer;
+    block_t *p_packetized_block;
+    block_t **pp_block = p_block ? &p_block : NULL;
+
+    while( (p_packetized_block =
+            p_packetizer->pf_packetize( p_packetizer, pp_block ) ) )
+    {
+        bool b_changed = !es_format_IsSimilar( &p_owner->stage.fmt,
+                                               &p_packetizer->fmt_out );
+        if( b_changed )
+        {
+            es_format_Clean( &p_owner->stage.fmt );
+            es_format_Copy( &p_owner->stage.fmt, &p_packetizer->fmt_out );
+        }
+
+        if( p_packetizer->pf_get_cc )
+            DecoderGetCc( p_dec, p_packetizer );
+
+        DecoderStageQueue( p_dec, p_packetized_block,
+                           b_changed ? &p_owner->stage.fmt : NULL, flushes,
+                           b_pace );
+    }
+}
+
+/**
+ * The packetizer stage main loop
+ *
+ * It packetizes the input blocks ahead of the decoder thread, so that parsing
+ * and decoding the elementary stream run concurrently.
+ *
+ * \param p_dec the decoder
+ */
+static void *DecoderStageThread( void *p_data )
+{
+    decoder_t *p_dec = (decoder_t *)p_data;
+    decoder_owner_sys_t *p_owner = p_dec->p_owner;
+    block_fifo_t *p_fifo = p_owner->stage.p_fifo;
+
+    vlc_fifo_Lock( p_fifo );
+    vlc_fifo_CleanupPush( p_fifo );
+
+    for( ;; )
+    {
+        if( p_owner->stage.b_flushing )
+        {
+            int canc = vlc_savecancel();
+
+            vlc_fifo_Unlock( p_fifo );
+            if( p_owner->p_packetizer->pf_flush != NULL )
+                p_owner->p_packetizer->pf_flush( p_owner->p_packetizer );
+            vlc_fifo_Lock( p_fifo );
+
+            vlc_restorecancel( canc );
+            p_owner->stage.b_flushing = false;
+            continue;
+        }
+
+        vlc_cond_signal( &p_owner->stage.wait );
+        vlc_testcancel(); /* forced expedited cancellation in case of stop */
+
+        block_t *p_block = vlc_fifo_DequeueUnlocked( p_fifo );
+        if( p_block == NULL )
+        {
+            if( likely(!p_owner->stage.b_draining) )
+            {
+                if( !p_owner->stage.b_idle )
+                {   /* Wake up input_DecoderWait(), as the decoder thread
+                     * may not get any block from us anymore */
+                    p_owner->stage.b_idle = true;
+                    vlc_fifo_Unlock( p_fifo );
+
+                    vlc_mutex_lock( &p_owner->lock );
+                    vlc_cond_signal( &p_owner->wait_acknowledge );
+                    vlc_mutex_unlock( &p_owner->lock );
+
+                    vlc_fifo_Lock( p_fifo );
+                    continue;
+                }
+                /* Wait for a block to packetize (or a request to drain) */
+                vlc_fifo_Wait( p_fifo );
+                continue;
+            }
+            p_owner->stage.b_draining = false;
+        }
+        p_owner->stage.b_idle = false;
+
+        unsigned flushes = atomic_load( &p_owner->stage.flushes );
+        bool b_pace = p_owner->stage.b_pace;
+        vlc_fifo_Unlock( p_fifo );
+
+        int canc = vlc_savecancel();
+        DecoderStageProcess( p_dec, p_block, flushes, b_pace );
+
+        if( p_block == NULL )
+        {   /* The packetizer is drained, now drain the decoder */
+            vlc_fifo_Lock( p_owner->p_fifo );
+            p_owner->b_draining = true;
+            vlc_fifo_Signal( p_owner->p_fifo );
+            vlc_fifo_Unlock( p_owner->p_fifo );
+        }
+        vlc_restorecancel( canc );
+
+        vlc_fifo_Lock( p_fifo );
+    }
+    vlc_cleanup_pop();
+    vlc_assert_unreachable();
+}
+
+static bool DecoderStageIsIdle( decoder_owner_sys_t *p_owner )
+{
+    if( p_owner->stage.p_fifo == NULL )
+        return true;
+
+    vlc_fifo_Lock( p_owner->stage.p_fifo );
+    bool b_idle = p_owner->stage.b_idle
+               && vlc_fifo_IsEmpty( p_owner->stage.p_fifo );
+    vlc_fifo_Unlock( p_owner->stage.p_fifo );
+    return b_idle;
+}
+
 /**
  * The decoding main loop
  *
@@ -1571,6 +1820,12 @@ static void *DecoderThread( void *p_data )
         vlc_testcancel(); /* forced expedited cancellation in case of stop */
 
         block_t *p_block = vlc_fifo_DequeueUnlocked( p_owner->p_fifo );
+        struct decoder_fmt_change *p_fmt_change = NULL;
+        if( p_block != NULL && p_owner->stage.p_fifo != NULL )
+        {
+            p_fmt_change = DecoderStageGetFormatLocked( p_owner );
+            p_owner->stage.i_dequeued++;
+        }
         if( p_block == NULL )
         {
             if( likely(!p_owner->b_draining) )
@@ -1588,6 +1843,12 @@ static void *DecoderThread( void *p_data )
         vlc_fifo_Unlock( p_owner->p_fifo );
 
         int canc = vlc_savecancel();
+        if( p_fmt_change != NULL )
+        {
+            DecoderStageReload( p_dec, &p_fmt_change->fmt );
+            es_format_Clean( &p_fmt_change->fmt );
+            free( p_fmt_change );
+        }
         DecoderProcess( p_dec, p_block );
 
         if( p_block == NULL )
@@ -1651,6 +1912,7 @@ static decoder_t * CreateDecoder( vlc_object_t *p_parent,
     p_owner->p_sout = p_sout;
     p_owner->p_sout_input = NULL;
     p_owner->p_packetizer = NULL;
+    p_owner->stage.p_fifo = NULL;
 
     p_owner->b_fmt_description = false;
     p_owner->p_description = NULL;
@@ -1780,6 +2042,20 @@ static void DeleteDecoder( decoder_t * p_dec )
     /* Free all packets still in the decoder fifo. */
     block_FifoRelease( p_owner->p_fifo );
 
+    if( p_owner->stage.p_fifo != NULL )
+    {
+        block_FifoRelease( p_owner->stage.p_fifo );
+        while( p_owner->stage.p_fmt_changes != NULL )
+        {
+            struct decoder_fmt_change *p_change = p_owner->stage.p_fmt_changes;
+            p_owner->stage.p_fmt_changes = p_change->p_next;
+            es_format_Clean( &p_change->fmt );
+            free( p_change );
+        }
+        es_format_Clean( &p_owner->stage.fmt );
+        vlc_cond_destroy( &p_owner->stage.wait );
+    }
+
     /* Cleanup */
     if( p_owner->p_aout )
     {
@@ -1860,6 +2136,56 @@ static void DecoderUnsupportedCodec( decoder_t *p_dec, const es_format_t *fmt )
     }
 }
 
+static void DecoderStageNew( decoder_t *p_dec, int i_priority )
+{
+    decoder_owner_sys_t *p_owner = p_dec->p_owner;
+
+    p_owner->stage.p_fifo = block_FifoNew();
+    if( unlikely(p_owner->stage.p_fifo == NULL) )
+        return;
+
+    vlc_cond_init( &p_owner->stage.wait );
+    es_format_Init( &p_owner->stage.fmt, UNKNOWN_ES, 0 );
+    es_format_Copy( &p_owner->stage.fmt, &p_dec->fmt_in );
+    atomic_init( &p_owner->stage.flushes, 0 );
+    p_owner->stage.b_flushing = false;
+    p_owner->stage.b_draining = false;
+    p_owner->stage.b_idle = false;
+    p_owner->stage.b_pace = false;
+    p_owner->stage.b_closing = false;
+    p_owner->stage.i_queued = 0;
+    p_owner->stage.i_dequeued = 0;
+    p_owner->stage.p_fmt_changes = NULL;
+
+    if( vlc_clone( &p_owner->stage.thread, DecoderStageThread, p_dec,
+                   i_priority ) )
+    {
+        msg_Err( p_dec, "cannot spawn packetizer thread" );
+        es_format_Clean( &p_owner->stage.fmt );
+        vlc_cond_destroy( &p_owner->stage.wait );
+        block_FifoRelease( p_owner->stage.p_fifo );
+        p_owner->stage.p_fifo = NULL;
+    }
+}
+
+static void DecoderStageDelete( decoder_t *p_dec )
+{
+    decoder_owner_sys_t *p_owner = p_dec->p_owner;
+
+    if( p_owner->stage.p_fifo == NULL )
+        return;
+
+    /* The pacing wait is not a cancellation point (packetizing is not
+     * cancellable), and the decoder fifo may not be consumed anymore */
+    vlc_fifo_Lock( p_owner->p_fifo );
+    p_owner->stage.b_closing = true;
+    vlc_cond_broadcast( &p_owner->wait_fifo );
+    vlc_fifo_Unlock( p_owner->p_fifo );
+
+    vlc_cancel( p_owner->stage.thread );
+    vlc_join( p_owner->stage.thread, NULL );
+}
+
 /* TODO: pass p_sout through p_resource? -- Courmisch */
 static decoder_t *decoder_New( vlc_object_t *p_parent, input_thread_t *p_input,
                                const es_format_t *fmt, input_clock_t *p_clock,
@@ -1896,10 +2222,17 @@ static decoder_t *decoder_New( vlc_object_t *p_parent, input_thread_t *p_input,
     else
         i_priority = VLC_THREAD_PRIORITY_VIDEO;
 
+    /* Spawn the packetizer stage thread, if requested */
+    if( p_dec->p_owner->p_packetizer != NULL
+     && ( p_dec->fmt_out.i_cat == VIDEO_ES || p_dec->fmt_out.i_cat == AUDIO_ES )
+     && var_InheritBool( p_dec, "packetizer-thread" ) )
+        DecoderStageNew( p_dec, i_priority );
+
     /* Spawn the decoder thread */
     if( vlc_clone( &p_dec->p_owner->thread, DecoderThread, p_dec, i_priority ) )
     {
         msg_Err( p_dec, "cannot spawn decoder thread" );
+        DecoderStageDelete( p_dec );
         DeleteDecoder( p_dec );
         return NULL;
     }
@@ -1944,6 +2277,8 @@ void input_DecoderDelete( decoder_t *p_dec )
 {
     decoder_owner_sys_t *p_owner = p_dec->p_owner;
 
+    DecoderStageDelete( p_dec );
+
     vlc_cancel( p_owner->thread );
 
     vlc_fifo_Lock( p_owner->p_fifo );
@@ -1991,18 +2326,27 @@ void input_DecoderDelete( decoder_t *p_dec )
 void input_DecoderDecode( decoder_t *p_dec, block_t *p_block, bool b_do_pace )
 {
     decoder_owner_sys_t *p_owner = p_dec->p_owner;
+    block_fifo_t *p_fifo = p_owner->p_fifo;
+    vlc_cond_t *p_wait = &p_owner->wait_fifo;
 
-    vlc_fifo_Lock( p_owner->p_fifo );
+    /* Feed the packetizer stage if any */
+    if( p_owner->stage.p_fifo != NULL )
+    {
+        p_fifo = p_owner->stage.p_fifo;
+        p_wait = &p_owner->stage.wait;
+    }
+
+    vlc_fifo_Lock( p_fifo );
     if( !b_do_pace )
     {
         /* FIXME: ideally we would check the time amount of data
          * in the FIFO instead of its size. */
         /* 400 MiB, i.e. ~ 50mb/s for 60s */
-        if( vlc_fifo_GetBytes( p_owner->p_fifo ) > 400*1024*1024 )
+        if( vlc_fifo_GetBytes( p_fifo ) > 400*1024*1024 )
         {
             msg_Warn( p_dec, "decoder/packetizer fifo full (data not "
                       "consumed quickly enough), resetting fifo!" );
-            block_ChainRelease( vlc_fifo_DequeueAllUnlocked( p_owner->p_fifo ) );
+            block_ChainRelease( vlc_fifo_DequeueAllUnlocked( p_fifo ) );
         }
     }
     else
@@ -2010,12 +2354,14 @@ void input_DecoderDecode( decoder_t *p_dec, block_t *p_block, bool b_do_pace )
     {   /* The FIFO is not consumed when waiting, so pacing would deadlock VLC.
          * Locking is not necessary as b_waiting is only read, not written by
          * the decoder thread. */
-        while( vlc_fifo_GetCount( p_owner->p_fifo ) >= 10 )
-            vlc_fifo_WaitCond( p_owner->p_fifo, &p_owner->wait_fifo );
+        while( vlc_fifo_GetCount( p_fifo ) >= 10 )
+            vlc_fifo_WaitCond( p_fifo, p_wait );
     }
 
-    vlc_fifo_QueueUnlocked( p_owner->p_fifo, p_block );
-    vlc_fifo_Unlock( p_owner->p_fifo );
+    if( p_owner->stage.p_fifo != NULL )
+        p_owner->stage.b_pace = b_do_pace && !p_owner->b_waiting;
+    vlc_fifo_QueueUnlocked( p_fifo, p_block );
+    vlc_fifo_Unlock( p_fifo );
 }
 
 bool input_DecoderIsEmpty( decoder_t * p_dec )
@@ -2024,6 +2370,9 @@ bool input_DecoderIsEmpty( decoder_t * p_dec )
 
     assert( !p_owner->b_waiting );
 
+    if( !DecoderStageIsIdle( p_owner ) )
+        return false;
+
     if( block_FifoCount( p_dec->p_owner->p_fifo ) > 0 )
         return false;
 
@@ -2058,6 +2407,15 @@ void input_DecoderDrain( decoder_t *p_dec )
 {
     decoder_owner_sys_t *p_owner = p_dec->p_owner;
 
+    if( p_owner->stage.p_fifo != NULL )
+    {   /* The stage drains the decoder once the packetizer is drained */
+        vlc_fifo_Lock( p_owner->stage.p_fifo );
+        p_owner->stage.b_draining = true;
+        vlc_fifo_Signal( p_owner->stage.p_fifo );
+        vlc_fifo_Unlock( p_owner->stage.p_fifo );
+        return;
+    }
+
     vlc_fifo_Lock( p_owner->p_fifo );
     p_owner->b_draining = true;
     vlc_fifo_Signal( p_owner->p_fifo );
@@ -2072,10 +2430,28 @@ void input_DecoderFlush( decoder_t *p_dec )
 {
     decoder_owner_sys_t *p_owner = p_dec->p_owner;
 
+    if( p_owner->stage.p_fifo != NULL )
+    {
+        vlc_fifo_Lock( p_owner->stage.p_fifo );
+        /* Blocks being packetized are discarded when queued */
+        atomic_fetch_add( &p_owner->stage.flushes, 1 );
+        block_ChainRelease( vlc_fifo_DequeueAllUnlocked( p_owner->stage.p_fifo ) );
+        p_owner->stage.b_flushing = true;
+        vlc_fifo_Signal( p_owner->stage.p_fifo );
+        vlc_fifo_Unlock( p_owner->stage.p_fifo );
+    }
+
     vlc_fifo_Lock( p_owner->p_fifo );
 
     /* Empty the fifo */
     block_ChainRelease( vlc_fifo_DequeueAllUnlocked( p_owner->p_fifo ) );
+    /* Pending format changes apply to the next packetized block */
+    if( p_owner->stage.p_fifo != NULL )
+    {
+        p_owner->stage.i_dequeued = p_owner->stage.i_queued;
+        /* Wake up the stage if it is pacing on the decoder */
+        vlc_cond_broadcast( &p_owner->wait_fifo );
+    }
 
     /* Don't need to wait for the DecoderThread to flush. Indeed, if called a
      * second time, this function will clear the FIFO again before anything was
@@ -2240,8 +2616,10 @@ void input_DecoderWait( decoder_t *p_dec )
          * owner */
         if( p_owner->paused )
             break;
+        /* Only the input thread feeds the stage, it can't be woken up */
+        bool b_stage_idle = DecoderStageIsIdle( p_owner );
         vlc_fifo_Lock( p_owner->p_fifo );
-        if( p_owner->b_idle && vlc_fifo_IsEmpty( p_owner->p_fifo ) )
+        if( b_stage_idle && p_owner->b_idle && vlc_fifo_IsEmpty( p_owner->p_fifo ) )
         {
             msg_Err( p_dec, "buffer deadlock prevented" );
             vlc_fifo_Unlock( p_owner->p_fifo );
@@ -2305,8 +2683,11 @@ bool input_DecoderHasFormatChanged( decoder_t *p_dec, es_format_t *p_fmt, vlc_me
 size_t input_DecoderGetFifoSize( decoder_t *p_dec )
 {
     decoder_owner_sys_t *p_owner = p_dec->p_owner;
+    size_t i_size = block_FifoSize( p_owner->p_fifo );
 
-    return block_FifoSize( p_owner->p_fifo );
+    if( p_owner->stage.p_fifo != NULL )
+        i_size += block_FifoSize( p_owner->stage.p_fifo );
+    return i_size;
 }
 
 void input_DecoderGetObjects( decoder_t *p_dec,
@@ -37,6 +37,10 @@
 #endif
 #include <sys/stat.h>
 #include <unistd.h>
+#include <fcntl.h>
+#ifdef HAVE_MMAP
+#  include <sys/mman.h>
+#endif
 
 #include <vlc_common.h>
 #include <vlc_fs.h>
@@ -84,7 +88,7 @@ typedef struct attribute_packed
 {
     es_out_id_t *p_es;
     block_t *p_block;
-    int     i_offset;  /* We do not use file > INT_MAX */
+    int     i_offset;  /* Position in the ring, we do not use file > INT_MAX */
 } ts_cmd_send_t;
 
 typedef struct attribute_packed
@@ -165,12 +169,15 @@ struct ts_storage_t
 #ifdef _WIN32
     char    *psz_file;  /* Filename */
 #endif
-    size_t  i_file_max; /* Max size in bytes */
-    int64_t i_file_size;/* Current size in bytes */
-    FILE    *p_filew;   /* FILE handle for data writing */
-    FILE    *p_filer;   /* FILE handle for data reading */
-
-    /* */
+    size_t  i_file_max; /* Ring size in bytes */
+    size_t  i_file_size;/* Bytes in use, including wrap padding */
+    size_t  i_file_r;   /* Offset of the oldest stored data */
+    size_t  i_file_w;   /* Offset of the next write */
+    uint8_t *p_map;     /* Mapping of the whole ring, or NULL */
+    FILE    *p_filew;   /* FILE handle for data writing without mapping */
+    FILE    *p_filer;   /* FILE handle for data reading without mapping */
+
+    /* Commands ring: i_cmd_r <= i_cmd_w, indexes are modulo i_cmd_max */
     int      i_cmd_r;
     int      i_cmd_w;
     int      i_cmd_max;
@@ -268,6 +275,7 @@ static bool         TsStorageIsFull( ts_storage_t *, const ts_cmd_t *p_cmd );
 static bool         TsStorageIsEmpty( ts_storage_t * );
 static void         TsStoragePushCmd( ts_storage_t *, const ts_cmd_t *p_cmd, bool b_flush );
 static void         TsStoragePopCmd( ts_storage_t *p_storage, ts_cmd_t *p_cmd, bool b_flush );
+static size_t       TsStorageSendSize( const block_t * );
 
 static void CmdClean( ts_cmd_t * );
 static void cmd_cleanup_routine( void *p ) { CmdClean( p ); }
@@ -855,7 +863,12 @@ static void TsPushCmd( ts_thread_t *p_ts, ts_cmd_t *p_cmd )
 
     if( !p_ts->p_storage_w || TsStorageIsFull( p_ts->p_storage_w, p_cmd ) )
     {
-        ts_storage_t *p_storage = TsStorageNew( p_ts->psz_tmp_path, p_ts->i_tmp_size_max );
+        int64_t i_size_max = p_ts->i_tmp_size_max;
+        if( p_cmd->i_type == C_SEND )
+            i_size_max = __MAX( i_size_max,
+                                (int64_t)TsStorageSendSize( p_cmd->u.send.p_block ) );
+
+        ts_storage_t *p_storage = TsStorageNew( p_ts->psz_tmp_path, i_size_max );
 
         if( !p_storage )
         {
@@ -1113,20 +1126,47 @@ static ts_storage_t *TsStorageNew( const char *psz_tmp_path, int64_t i_tmp_size_
         return NULL;
     }
 
-    p_storage->p_filew = fdopen( fd, "w+b" );
-    if( p_storage->p_filew == NULL )
+    p_storage->i_file_max = i_tmp_size_max;
+    p_storage->p_map = NULL;
+    p_storage->p_filew = NULL;
+    p_storage->p_filer = NULL;
+
+#if defined(HAVE_MMAP) && defined(HAVE_POSIX_FALLOCATE) && !defined(TEST_NO_MMAP)
+    /* The ring is allocated on disk upfront, so that running out of space
+     * fails here instead of faulting on a later write to the mapping */
+    if( posix_fallocate( fd, 0, p_storage->i_file_max ) == 0 )
     {
-        vlc_close( fd );
-        vlc_unlink( psz_file );
-        goto error;
+        void *p_map = mmap( NULL, p_storage->i_file_max, PROT_READ|PROT_WRITE,
+                            MAP_SHARED, fd, 0 );
+        if( p_map != MAP_FAILED )
+            p_storage->p_map = p_map;
     }
+#endif
 
-    p_storage->p_filer = vlc_fopen( psz_file, "rb" );
-    if( p_storage->p_filer == NULL )
+    if( p_storage->p_map != NULL )
     {
-        fclose( p_storage->p_filew );
-        vlc_unlink( psz_file );
-        goto error;
+        vlc_close( fd );
+    }
+    else
+    {
+        p_storage->p_filew = fdopen( fd, "w+b" );
+        if( p_storage->p_filew == NULL )
+        {
+            vlc_close( fd );
+            vlc_unlink( psz_file );
+            goto error;
+        }
+
+        p_storage->p_filer = vlc_fopen( psz_file, "rb" );
+        if( p_storage->p_filer == NULL )
+        {
+            fclose( p_storage->p_filew );
+            vlc_unlink( psz_file );
+            goto error;
+        }
+        /* The writer overwrites the ring behind the reader: a read buffer
+         * could return stale data after seeking back into it */
+        setvbuf( p_storage->p_filer, NULL, _IONBF, 0 );
     }
 
 #ifndef _WIN32
@@ -1138,8 +1178,9 @@ static ts_storage_t *TsStorageNew( const char *psz_tmp_path, int64_t i_tmp_size_
     p_storage->p_next = NULL;
 
     /* */
-    p_storage->i_file_max = i_tmp_size_max;
     p_storage->i_file_size = 0;
+    p_storage->i_file_r = 0;
+    p_storage->i_file_w = 0;
 
     /* */
     p_storage->i_cmd_w = 0;
@@ -1172,8 +1213,14 @@ static void TsStorageDelete( ts_storage_t *p_storage )
     }
     free( p_storage->p_cmd );
 
-    fclose( p_storage->p_filer );
-    fclose( p_storage->p_filew );
+#ifdef HAVE_MMAP
+    if( p_storage->p_map != NULL )
+        munmap( p_storage->p_map, p_storage->i_file_max );
+#endif
+    if( p_storage->p_filer != NULL )
+        fclose( p_storage->p_filer );
+    if( p_storage->p_filew != NULL )
+        fclose( p_storage->p_filew );
 #ifdef _WIN32
     vlc_unlink( p_storage->psz_file );
     free( p_storage->psz_file );
@@ -1183,7 +1230,8 @@ static void TsStorageDelete( ts_storage_t *p_storage )
 
 static void TsStoragePack( ts_storage_t *p_storage )
 {
-    /* Try to release a bit of memory */
+    /* Try to release a bit of memory (only if the commands ring never
+     * wrapped, as its indexes would change otherwise) */
     if( p_storage->i_cmd_w >= p_storage->i_cmd_max )
         return;
 
@@ -1193,21 +1241,66 @@ static void TsStoragePack( ts_storage_t *p_storage )
     if( p_new )
         p_storage->p_cmd = p_new;
 }
+static size_t TsStorageSendSize( const block_t *p_block )
+{
+    return sizeof(*p_block) + p_block->i_buffer;
+}
+/* Returns the offset where i_size bytes can be stored contiguously, and the
+ * number of bytes skipped at the end of the ring to get there */
+static size_t TsStorageWriteOffset( const ts_storage_t *p_storage, size_t i_size,
+                                    size_t *pi_pad )
+{
+    if( p_storage->i_file_w + i_size > p_storage->i_file_max )
+    {
+        *pi_pad = p_storage->i_file_max - p_storage->i_file_w;
+        return 0;
+    }
+    *pi_pad = 0;
+    return p_storage->i_file_w;
+}
 static bool TsStorageIsFull( ts_storage_t *p_storage, const ts_cmd_t *p_cmd )
 {
-    if( p_cmd && p_cmd->i_type == C_SEND && p_storage->i_cmd_w > 0 )
+    if( p_cmd && p_cmd->i_type == C_SEND )
     {
-        size_t i_size = sizeof(*p_cmd->u.send.p_block) + p_cmd->u.send.p_block->i_buffer;
+        size_t i_size = TsStorageSendSize( p_cmd->u.send.p_block );
+        size_t i_pad;
 
-        if( p_storage->i_file_size + i_size >= p_storage->i_file_max )
+        TsStorageWriteOffset( p_storage, i_size, &i_pad );
+        if( p_storage->i_file_size + i_pad + i_size > p_storage->i_file_max )
             return true;
     }
-    return p_storage->i_cmd_w >= p_storage->i_cmd_max;
+    return p_storage->i_cmd_w - p_storage->i_cmd_r >= p_storage->i_cmd_max;
 }
 static bool TsStorageIsEmpty( ts_storage_t *p_storage )
 {
     return !p_storage || p_storage->i_cmd_r >= p_storage->i_cmd_w;
 }
+static int TsStorageWrite( ts_storage_t *p_storage, size_t i_offset,
+                           const void *p_data, size_t i_data )
+{
+    if( p_storage->p_map != NULL )
+    {
+        memcpy( &p_storage->p_map[i_offset], p_data, i_data );
+        return VLC_SUCCESS;
+    }
+    if( fseek( p_storage->p_filew, i_offset, SEEK_SET ) ||
+        fwrite( p_data, i_data, 1, p_storage->p_filew ) != 1 )
+        return VLC_EGENERIC;
+    return VLC_SUCCESS;
+}
+static int TsStorageRead( ts_storage_t *p_storage, size_t i_offset,
+                          void *p_data, size_t i_data )
+{
+    if( p_storage->p_map != NULL )
+    {
+        memcpy( p_data, &p_storage->p_map[i_offset], i_data );
+        return VLC_SUCCESS;
+    }
+    if( fseek( p_storage->p_filer, i_offset, SEEK_SET ) ||
+        fread( p_data, i_data, 1, p_storage->p_filer ) != 1 )
+        return VLC_EGENERIC;
+    return VLC_SUCCESS;
+}
 static void TsStoragePushCmd( ts_storage_t *p_storage, const ts_cmd_t *p_cmd, bool b_flush )
 {
     ts_cmd_t cmd = *p_cmd;
@@ -1217,46 +1310,52 @@ static void TsStoragePushCmd( ts_storage_t *p_storage, const ts_cmd_t *p_cmd, bo
     if( cmd.i_type == C_SEND )
     {
         block_t *p_block = cmd.u.send.p_block;
+        size_t i_size = TsStorageSendSize( p_block );
+        size_t i_pad;
+        size_t i_offset = TsStorageWriteOffset( p_storage, i_size, &i_pad );
 
         cmd.u.send.p_block = NULL;
-        cmd.u.send.i_offset = ftell( p_storage->p_filew );
+        cmd.u.send.i_offset = i_offset;
 
-        if( fwrite( p_block, sizeof(*p_block), 1, p_storage->p_filew ) != 1 )
+        if( TsStorageWrite( p_storage, i_offset, p_block, sizeof(*p_block) ) ||
+            ( p_block->i_buffer > 0 &&
+              TsStorageWrite( p_storage, i_offset + sizeof(*p_block),
+                              p_block->p_buffer, p_block->i_buffer ) ) )
         {
             block_Release( p_block );
             return;
         }
-        p_storage->i_file_size += sizeof(*p_block);
-        if( p_block->i_buffer > 0 )
-        {
-            if( fwrite( p_block->p_buffer, p_block->i_buffer, 1, p_storage->p_filew ) != 1 )
-            {
-                block_Release( p_block );
-                return;
-            }
-        }
-        p_storage->i_file_size += p_block->i_buffer;
         block_Release( p_block );
 
-        if( b_flush )
+        p_storage->i_file_size += i_pad + i_size;
+        p_storage->i_file_w = i_offset + i_size;
+
+        if( b_flush && p_storage->p_filew != NULL )
             fflush( p_storage->p_filew );
     }
-    p_storage->p_cmd[p_storage->i_cmd_w++] = cmd;
+    p_storage->p_cmd[p_storage->i_cmd_w++ % p_storage->i_cmd_max] = cmd;
 }
 static void TsStoragePopCmd( ts_storage_t *p_storage, ts_cmd_t *p_cmd, bool b_flush )
 {
     assert( !TsStorageIsEmpty( p_storage ) );
 
-    *p_cmd = p_storage->p_cmd[p_storage->i_cmd_r++];
+    *p_cmd = p_storage->p_cmd[p_storage->i_cmd_r++ % p_storage->i_cmd_max];
+    if( p_storage->i_cmd_r >= p_storage->i_cmd_max )
+    {
+        p_storage->i_cmd_r -= p_storage->i_cmd_max;
+        p_storage->i_cmd_w -= p_storage->i_cmd_max;
+    }
+
     if( p_cmd->i_type == C_SEND )
     {
+        const size_t i_offset = p_cmd->u.send.i_offset;
         block_t block;
 
-        if( !b_flush &&
-            !fseek( p_storage->p_filer, p_cmd->u.send.i_offset, SEEK_SET ) &&
-            fread( &block, sizeof(block), 1, p_storage->p_filer ) == 1 )
+        if( !TsStorageRead( p_storage, i_offset, &block, sizeof(block) ) )
         {
-            block_t *p_block = block_Alloc( block.i_buffer );
+            block_t *p_block = NULL;
+            if( !b_flush )
+                p_block = block_Alloc( block.i_buffer );
             if( p_block )
             {
                 p_block->i_dts      = block.i_dts;
@@ -1264,9 +1363,21 @@ static void TsStoragePopCmd( ts_storage_t *p_storage, ts_cmd_t *p_cmd, bool b_fl
                 p_block->i_flags    = block.i_flags;
                 p_block->i_length   = block.i_length;
                 p_block->i_nb_samples = block.i_nb_samples;
-                p_block->i_buffer = fread( p_block->p_buffer, 1, block.i_buffer, p_storage->p_filer );
+                if( block.i_buffer > 0 &&
+                    TsStorageRead( p_storage, i_offset + sizeof(block),
+                                   p_block->p_buffer, block.i_buffer ) )
+                    p_block->i_buffer = 0;
             }
-            p_cmd->u.send.p_block = p_block;
+            p_cmd->u.send.p_block = p_block ? p_block : block_Alloc( 1 );
+
+            /* Release the data, and the padding before it if the writer
+             * wrapped around there */
+            size_t i_size = sizeof(block) + block.i_buffer;
+            if( i_offset < p_storage->i_file_r )
+                i_size += p_storage->i_file_max - p_storage->i_file_r;
+            assert( p_storage->i_file_size >= i_size );
+            p_storage->i_file_size -= i_size;
+            p_storage->i_file_r = i_offset + sizeof(block) + block.i_buffer;
         }
         else
         {
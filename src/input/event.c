@@ -32,10 +32,18 @@
 #include <vlc_input.h>
 #include "input_internal.h"
 #include "event.h"
+#include "../misc/variables.h"
 #include <assert.h>
 
 /* */
 static void Trigger( input_thread_t *, int i_type );
+
+/* Variables updated many times per second during playback */
+static var_handle_t position_handle = VAR_HANDLE_INIT( "position" );
+static var_handle_t time_handle = VAR_HANDLE_INIT( "time" );
+static var_handle_t length_handle = VAR_HANDLE_INIT( "length" );
+static var_handle_t rate_handle = VAR_HANDLE_INIT( "rate" );
+static var_handle_t intf_event_handle = VAR_HANDLE_INIT( "intf-event" );
 static void VarListAdd( input_thread_t *,
                         const char *psz_variable, int i_event,
                         int i_value, const char *psz_text );
@@ -62,11 +70,11 @@ void input_SendEventPosition( input_thread_t *p_input, double f_position, mtime_
 
     /* */
     val.f_float = f_position;
-    var_Change( p_input, "position", VLC_VAR_SETVALUE, &val, NULL );
+    var_ChangeHandle( p_input, &position_handle, VLC_VAR_SETVALUE, &val, NULL );
 
     /* */
     val.i_int = i_time;
-    var_Change( p_input, "time", VLC_VAR_SETVALUE, &val, NULL );
+    var_ChangeHandle( p_input, &time_handle, VLC_VAR_SETVALUE, &val, NULL );
 
     Trigger( p_input, INPUT_EVENT_POSITION );
 }
@@ -75,13 +83,15 @@ void input_SendEventLength( input_thread_t *p_input, mtime_t i_length )
     vlc_value_t val;
 
     /* FIXME ugly + what about meta change event ? */
-    if( var_GetInteger( p_input, "length" ) == i_length )
+    if( var_GetHandle( p_input, &length_handle, &val ) != VLC_SUCCESS )
+        val.i_int = 0;
+    if( val.i_int == i_length )
         return;
 
     input_item_SetDuration( p_input->p->p_item, i_length );
 
     val.i_int = i_length;
-    var_Change( p_input, "length", VLC_VAR_SETVALUE, &val, NULL );
+    var_ChangeHandle( p_input, &length_handle, VLC_VAR_SETVALUE, &val, NULL );
 
     Trigger( p_input, INPUT_EVENT_LENGTH );
 }
@@ -94,7 +104,7 @@ void input_SendEventRate( input_thread_t *p_input, int i_rate )
     vlc_value_t val;
 
     val.f_float = (float)INPUT_RATE_DEFAULT / (float)i_rate;
-    var_Change( p_input, "rate", VLC_VAR_SETVALUE, &val, NULL );
+    var_ChangeHandle( p_input, &rate_handle, VLC_VAR_SETVALUE, &val, NULL );
 
     Trigger( p_input, INPUT_EVENT_RATE );
 }
@@ -324,11 +334,205 @@ void input_SendEventBookmark( input_thread_t *p_input )
 }
 
 /*****************************************************************************
- *
+ * Events delivery
+ *****************************************************************************
+ * With --input-event-rate, the high frequency events are delivered on a
+ * dispatcher thread rather than on the thread that sends them, so that slow
+ * callbacks do not stall the input. They only tell that some variables
+ * changed, so pending ones are coalesced and delivered at most at the given
+ * rate. The other events are still delivered by the sender: their consumers
+ * read the variables they refer to (e.g. "state") when notified, so they
+ * cannot be delayed. The pending coalesced events are delivered before them.
  *****************************************************************************/
+static bool IsCoalesced( int i_type )
+{
+    switch( i_type )
+    {
+        case INPUT_EVENT_POSITION:
+        case INPUT_EVENT_STATISTICS:
+        case INPUT_EVENT_CACHE:
+        case INPUT_EVENT_SIGNAL:
+            return true;
+        default:
+            return false;
+    }
+}
+
+static void Deliver( input_thread_t *p_input, int i_type )
+{
+    vlc_value_t val;
+
+    val.i_int = i_type;
+    var_SetHandle( p_input, &intf_event_handle, val );
+}
+
+static unsigned DeliverMask( input_thread_t *p_input, uint32_t i_mask )
+{
+    unsigned i_count = 0;
+
+    for( int i_type = 0; i_mask != 0; i_type++, i_mask >>= 1 )
+        if( i_mask & 1 )
+        {
+            Deliver( p_input, i_type );
+            i_count++;
+        }
+    return i_count;
+}
+
+static void *EventsThread( void *data )
+{
+    input_thread_t *p_input = data;
+    input_thread_private_t *p = p_input->p;
+
+    vlc_mutex_lock( &p->events.lock );
+    for( ;; )
+    {
+        if( p->events.i_pending != 0 )
+        {
+            mtime_t i_deadline = p->events.i_last + p->events.i_interval;
+            mtime_t i_now = mdate();
+
+            if( i_now < i_deadline && !p->events.b_stop )
+            {
+                vlc_cond_timedwait( &p->events.wait, &p->events.lock,
+                                    i_deadline );
+                continue;
+            }
+
+            uint32_t i_pending = p->events.i_pending;
+
+            p->events.i_pending = 0;
+            p->events.i_last = i_now;
+            vlc_mutex_unlock( &p->events.lock );
+            unsigned i_delivered = DeliverMask( p_input, i_pending );
+            vlc_mutex_lock( &p->events.lock );
+            p->events.i_delivered += i_delivered;
+            continue;
+        }
+
+        if( p->events.b_stop )
+            break;
+        vlc_cond_wait( &p->events.wait, &p->events.lock );
+    }
+    vlc_mutex_unlock( &p->events.lock );
+    return NULL;
+}
+
+void input_EventsInit( input_thread_t *p_input )
+{
+    input_thread_private_t *p = p_input->p;
+
+    vlc_mutex_init( &p->events.lock );
+    vlc_cond_init( &p->events.wait );
+    p->events.b_running = false;
+    p->events.b_stop = false;
+    p->events.i_pending = 0;
+    p->events.i_posted = p->events.i_delivered = p->events.i_coalesced = 0;
+}
+
+void input_EventsClean( input_thread_t *p_input )
+{
+    input_thread_private_t *p = p_input->p;
+
+    assert( !p->events.b_running );
+    vlc_cond_destroy( &p->events.wait );
+    vlc_mutex_destroy( &p->events.lock );
+}
+
+/**
+ * Starts the events dispatcher thread, if enabled.
+ */
+int input_EventsStart( input_thread_t *p_input )
+{
+    input_thread_private_t *p = p_input->p;
+    int64_t i_rate = var_InheritInteger( p_input, "input-event-rate" );
+
+    if( i_rate <= 0 || p_input->b_preparsing )
+        return VLC_SUCCESS;
+
+    p->events.i_interval = CLOCK_FREQ / i_rate;
+    p->events.i_start = p->events.i_last = mdate();
+    p->events.b_stop = false;
+    if( vlc_clone( &p->events.thread, EventsThread, p_input,
+                   VLC_THREAD_PRIORITY_LOW ) )
+    {
+        msg_Warn( p_input, "cannot create events thread" );
+        return VLC_EGENERIC;
+    }
+    p->events.b_running = true;
+    return VLC_SUCCESS;
+}
+
+/**
+ * Delivers the pending events, and stops the events dispatcher thread.
+ *
+ * Later events are delivered synchronously.
+ */
+void input_EventsStop( input_thread_t *p_input )
+{
+    input_thread_private_t *p = p_input->p;
+
+    if( !p->events.b_running )
+        return;
+
+    vlc_mutex_lock( &p->events.lock );
+    p->events.b_stop = true;
+    vlc_cond_signal( &p->events.wait );
+    vlc_mutex_unlock( &p->events.lock );
+
+    vlc_join( p->events.thread, NULL );
+
+    vlc_mutex_lock( &p->events.lock );
+    p->events.b_running = false;
+    vlc_mutex_unlock( &p->events.lock );
+
+    mtime_t i_duration = mdate() - p->events.i_start;
+    msg_Dbg( p_input, "events: %u posted, %u coalesced, %u delivered "
+             "(%.1f/s)", p->events.i_posted, p->events.i_coalesced,
+             p->events.i_delivered,
+             i_duration > 0 ? p->events.i_delivered * (double)CLOCK_FREQ
+                              / i_duration : 0. );
+}
+
 static void Trigger( input_thread_t *p_input, int i_type )
 {
-    var_SetInteger( p_input, "intf-event", i_type );
+    input_thread_private_t *p = p_input->p;
+    uint32_t i_pending = 0;
+
+    assert( i_type >= 0 && i_type < 32 );
+
+    vlc_mutex_lock( &p->events.lock );
+    if( p->events.b_running && !p->events.b_stop )
+    {
+        p->events.i_posted++;
+        if( IsCoalesced( i_type ) )
+        {
+            if( p->events.i_pending & (1u << i_type) )
+                p->events.i_coalesced++;
+            else
+            {
+                p->events.i_pending |= 1u << i_type;
+                vlc_cond_signal( &p->events.wait );
+            }
+            vlc_mutex_unlock( &p->events.lock );
+            return;
+        }
+
+        /* Keep the order: deliver the pending coalesced events first */
+        i_pending = p->events.i_pending;
+        p->events.i_pending = 0;
+        p->events.i_delivered++;
+    }
+    vlc_mutex_unlock( &p->events.lock );
+
+    unsigned i_delivered = DeliverMask( p_input, i_pending );
+    if( i_delivered > 0 )
+    {
+        vlc_mutex_lock( &p->events.lock );
+        p->events.i_delivered += i_delivered;
+        vlc_mutex_unlock( &p->events.lock );
+    }
+    Deliver( p_input, i_type );
 }
 static void VarListAdd( input_thread_t *p_input,
                         const char *psz_variable, int i_event,
@@ -26,6 +26,14 @@
 
 #include <vlc_common.h>
 
+/*****************************************************************************
+ * Events delivery
+ *****************************************************************************/
+void input_EventsInit( input_thread_t * );
+void input_EventsClean( input_thread_t * );
+int  input_EventsStart( input_thread_t * );
+void input_EventsStop( input_thread_t * );
+
 /*****************************************************************************
  * Event for input.c
  *****************************************************************************/
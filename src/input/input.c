@@ -172,11 +172,14 @@ int input_Start( input_thread_t *p_input )
         func = Preparse;
 
     assert( !p_input->p->is_running );
+    /* Events are delivered synchronously if this fails */
+    input_EventsStart( p_input );
     /* Create thread and wait for its readiness. */
     p_input->p->is_running = !vlc_clone( &p_input->p->thread, func, p_input,
                                          VLC_THREAD_PRIORITY_INPUT );
     if( !p_input->p->is_running )
     {
+        input_EventsStop( p_input );
         input_ChangeState( p_input, ERROR_S );
         msg_Err( p_input, "cannot create input thread" );
         return VLC_EGENERIC;
@@ -216,6 +219,7 @@ void input_Close( input_thread_t *p_input )
 {
     if( p_input->p->is_running )
         vlc_join( p_input->p->thread, NULL );
+    input_EventsStop( p_input );
     vlc_interrupt_deinit( &p_input->p->interrupt );
     vlc_object_release( p_input );
 }
@@ -252,6 +256,7 @@ static void input_Destructor( vlc_object_t *obj )
 
     vlc_cond_destroy( &p_input->p->wait_control );
     vlc_mutex_destroy( &p_input->p->lock_control );
+    input_EventsClean( p_input );
     free( p_input->p );
 }
 
@@ -300,6 +305,7 @@ static input_thread_t *Create( vlc_object_t *p_parent, input_item_t *p_item,
         vlc_object_release( p_input );
         return NULL;
     }
+    input_EventsInit( p_input );
 
     /* Parse input options */
     input_item_ApplyOptions( VLC_OBJECT(p_input), p_item );
@@ -799,6 +805,8 @@ static void InitStatistics( input_thread_t * p_input )
     {
         INIT_COUNTER( read_bytes, COUNTER );
         INIT_COUNTER( read_packets, COUNTER );
+        INIT_COUNTER( read_dropped, COUNTER );
+        INIT_COUNTER( read_overruns, COUNTER );
         INIT_COUNTER( demux_read, COUNTER );
         INIT_COUNTER( input_bitrate, DERIVATIVE );
         INIT_COUNTER( demux_bitrate, DERIVATIVE );
@@ -1380,6 +1388,8 @@ error:
                                p_input->p->counters.p_##c = NULL; } while(0)
         EXIT_COUNTER( read_bytes );
         EXIT_COUNTER( read_packets );
+        EXIT_COUNTER( read_dropped );
+        EXIT_COUNTER( read_overruns );
         EXIT_COUNTER( demux_read );
         EXIT_COUNTER( input_bitrate );
         EXIT_COUNTER( demux_bitrate );
@@ -1445,6 +1455,8 @@ static void End( input_thread_t * p_input )
             stats_ComputeInputStats( p_input, p_input->p->p_item->p_stats );
             CL_CO( read_bytes );
             CL_CO( read_packets );
+            CL_CO( read_dropped );
+            CL_CO( read_overruns );
             CL_CO( demux_read );
             CL_CO( input_bitrate );
             CL_CO( demux_bitrate );
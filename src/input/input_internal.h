@@ -141,6 +141,8 @@ struct input_thread_private_t
     struct {
         counter_t *p_read_packets;
         counter_t *p_read_bytes;
+        counter_t *p_read_dropped;
+        counter_t *p_read_overruns;
         counter_t *p_input_bitrate;
         counter_t *p_demux_read;
         counter_t *p_demux_bitrate;
@@ -167,6 +169,22 @@ struct input_thread_private_t
 
     vlc_thread_t thread;
     vlc_interrupt_t interrupt;
+
+    /* Asynchronous events delivery (see event.c) */
+    struct
+    {
+        vlc_mutex_t  lock;
+        vlc_cond_t   wait;
+        vlc_thread_t thread;
+        bool         b_running;
+        bool         b_stop;
+        mtime_t      i_interval; /* between deliveries of coalesced events */
+        mtime_t      i_last;     /* last delivery of coalesced events */
+        uint32_t     i_pending;  /* coalesced events, one bit per type */
+        /* Counters */
+        mtime_t      i_start;
+        unsigned     i_posted, i_delivered, i_coalesced;
+    } events;
 };
 
 /***************************************************************************
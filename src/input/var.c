@@ -35,6 +35,7 @@
 #include <stdlib.h>
 
 #include "input_internal.h"
+#include "event.h"
 
 /*****************************************************************************
  * Callbacks
@@ -615,17 +616,9 @@ static int TimeCallback( vlc_object_t *p_this, char const *psz_cmd,
     /* Update "position" for better intf behaviour */
     const int64_t i_length = var_GetInteger( p_input, "length" );
     if( i_length > 0 && newval.i_int >= 0 && newval.i_int <= i_length )
-    {
-        vlc_value_t val;
-
-        val.f_float = (double)newval.i_int/(double)i_length;
-        var_Change( p_input, "position", VLC_VAR_SETVALUE, &val, NULL );
-        /*
-         * Notify the intf that a new event has been occurred.
-         * XXX this is a bit hackish but it's the only way to do it now.
-         */
-        var_SetInteger( p_input, "intf-event", INPUT_EVENT_POSITION );
-    }
+        input_SendEventPosition( p_input,
+                                 (double)newval.i_int/(double)i_length,
+                                 newval.i_int );
 
     input_ControlPush( p_input, INPUT_CONTROL_SET_TIME, &newval );
     return VLC_SUCCESS;
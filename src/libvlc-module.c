@@ -85,6 +85,12 @@ static const char *const ppsz_snap_formats[] =
     "This is the verbosity level (0=only errors and " \
     "standard messages, 1=warnings, 2=debug).")
 
+#define LOG_ASYNC_TEXT N_("Asynchronous logging")
+#define LOG_ASYNC_LONGTEXT N_( \
+    "Write the log messages from a background thread, so that logging " \
+    "does not slow down the other threads. Messages may be dropped if " \
+    "they are emitted faster than they can be written.")
+
 #define OPEN_TEXT N_("Default stream")
 #define OPEN_LONGTEXT N_( \
     "This stream will always be opened at VLC startup." )
@@ -643,6 +649,14 @@ static const char *const ppsz_prefres[] = {
 #define INPUT_FAST_SEEK_LONGTEXT N_( \
     "Favor speed over precision while seeking" )
 
+#define INPUT_EVENT_RATE_TEXT N_("Events rate")
+#define INPUT_EVENT_RATE_LONGTEXT N_( \
+    "Deliver the position, statistics, cache and signal events to the " \
+    "interfaces from a separate thread, at most this many times per " \
+    "second, so that slow interfaces do not stall the playback. The other " \
+    "events are always sent immediately. With 0, all events are sent " \
+    "immediately by the input thread." )
+
 #define INPUT_RATE_TEXT N_("Playback speed")
 #define INPUT_RATE_LONGTEXT N_( \
     "This defines the playback speed (nominal speed is 1.0)." )
@@ -901,6 +915,12 @@ static const char *const ppsz_prefres[] = {
     "This allows you to select a list of encoders that VLC will use in " \
     "priority.")
 
+#define PACKETIZER_THREAD_TEXT N_("Packetize in a separate thread")
+#define PACKETIZER_THREAD_LONGTEXT N_( \
+    "Run the packetizer of each audio and video stream in its own thread, " \
+    "ahead of the decoder. This spreads the parsing of complex streams " \
+    "over more CPU cores, at the cost of one more thread per stream.")
+
 /*****************************************************************************
  * Sout
  ****************************************************************************/
@@ -1719,6 +1739,9 @@ vlc_module_begin ()
     add_bool( "input-fast-seek", false,
               INPUT_FAST_SEEK_TEXT, INPUT_FAST_SEEK_LONGTEXT, false )
         change_safe ()
+    add_integer( "input-event-rate", 0,
+                 INPUT_EVENT_RATE_TEXT, INPUT_EVENT_RATE_LONGTEXT, true )
+        change_integer_range( 0, 1000 )
     add_float( "rate", 1.,
                INPUT_RATE_TEXT, INPUT_RATE_LONGTEXT, false )
 
@@ -1876,6 +1899,8 @@ vlc_module_begin ()
                 CODEC_LONGTEXT, true )
     add_string( "encoder",  NULL, ENCODER_TEXT,
                 ENCODER_LONGTEXT, true )
+    add_bool( "packetizer-thread", false, PACKETIZER_THREAD_TEXT,
+              PACKETIZER_THREAD_LONGTEXT, true )
 
     set_subcategory( SUBCAT_INPUT_ACCESS )
     add_category_hint( N_("Input"), INPUT_CAT_LONGTEXT , false )
@@ -2058,6 +2083,7 @@ vlc_module_begin ()
                  false )
         change_short('v')
         change_volatile ()
+    add_bool( "log-async", false, LOG_ASYNC_TEXT, LOG_ASYNC_LONGTEXT, true )
     add_obsolete_string( "verbose-objects" ) /* since 2.1.0 */
 #if !defined(_WIN32) && !defined(__OS2__)
     add_bool( "daemon", 0, DAEMON_TEXT, DAEMON_LONGTEXT, true )
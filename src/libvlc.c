@@ -547,6 +547,8 @@ void libvlc_InternalCleanup( libvlc_int_t *p_libvlc )
     /* Free module bank. It is refcounted, so we call this each time  */
     vlc_LogDeinit (p_libvlc);
     module_EndBank (true);
+    /* Free the recycled blocks, lest memory debuggers report leaks */
+    block_PoolDrain ();
 #if defined(_WIN32) || defined(__OS2__)
     system_End( );
 #endif
@@ -48,6 +48,11 @@ size_t EnumClockSource( vlc_object_t *, const char *, char ***, char *** );
 void vlc_CPU_init(void);
 void vlc_CPU_dump(vlc_object_t *);
 
+/*
+ * Block pool
+ */
+void block_PoolDrain(void);
+
 /*
  * Threads subsystem
  */
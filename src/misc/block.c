@@ -37,6 +37,8 @@
 #include <vlc_common.h>
 #include <vlc_block.h>
 #include <vlc_fs.h>
+#include <vlc_atomic.h>
+#include "libvlc.h"
 
 /**
  * @section Block handling functions.
@@ -124,28 +126,364 @@ static void BlockMetaCopy( block_t *restrict out, const block_t *in )
 /** Initial reserved header and footer size. */
 #define BLOCK_PADDING      32
 
-block_t *block_Alloc (size_t size)
+/**
+ * @section Block pool
+ *
+ * Small and medium blocks are recycled instead of being returned to the C
+ * run-time. Free blocks are sorted by size classes, four per power of two so
+ * that rounding wastes less than a quarter of the payload, and kept in a small
+ * per-thread magazine first, so that most allocations and releases take no
+ * lock. Magazines exchange blocks with a global depot in batches. The depot is
+ * drained when a libvlc instance is cleaned up.
+ *
+ * Recycled memory defeats use-after-free detection by memory debuggers. The
+ * pool is therefore disabled when building with AddressSanitizer, or if the
+ * VLC_BLOCK_POOL environment variable is set to 0.
+ */
+#if defined (__SANITIZE_ADDRESS__)
+# define BLOCK_POOL_DISABLED 1
+#elif defined (__has_feature)
+# if __has_feature(address_sanitizer)
+#  define BLOCK_POOL_DISABLED 1
+# endif
+#endif
+
+#define BLOCK_POOL_MIN_SHIFT 8 /* 256 bytes */
+#define BLOCK_POOL_MAX_SHIFT 16 /* 64 KiB */
+#define BLOCK_POOL_STEPS     4 /* size classes per power of two */
+#define BLOCK_POOL_CLASSES \
+    (1 + (BLOCK_POOL_MAX_SHIFT - BLOCK_POOL_MIN_SHIFT) * BLOCK_POOL_STEPS)
+#define BLOCK_POOL_MAGAZINE 32 /* maximum blocks per class per thread */
+#define BLOCK_POOL_MAGAZINE_BYTES (64 << 10)
+#define BLOCK_POOL_DEPOT_BYTES (256 << 10) /* per class */
+
+/** Overhead of block_Alloc() besides the payload */
+#define BLOCK_OVERHEAD (BLOCK_ALIGN + (2 * BLOCK_PADDING))
+
+/* Class 0 is 256 bytes. Then each power of two 2^n is split in four steps of
+ * 2^(n-2) bytes: 320, 384, 448, 512, 640, 768... */
+static size_t block_pool_ClassSize (unsigned cls)
+{
+    if (cls == 0)
+        return (size_t)1 << BLOCK_POOL_MIN_SHIFT;
+
+    cls--;
+    unsigned shift = BLOCK_POOL_MIN_SHIFT - 2 + cls / BLOCK_POOL_STEPS;
+    return (size_t)(BLOCK_POOL_STEPS + 1 + cls % BLOCK_POOL_STEPS) << shift;
+}
+
+/** Gets the smallest size class fitting a payload size. */
+static unsigned block_pool_Class (size_t size)
+{
+    assert (size <= ((size_t)1 << BLOCK_POOL_MAX_SHIFT));
+
+    if (size <= ((size_t)1 << BLOCK_POOL_MIN_SHIFT))
+        return 0;
+
+    size--;
+    unsigned msb = (sizeof (unsigned) * 8) - 1 - clz (size);
+    unsigned step = (size >> (msb - 2)) - BLOCK_POOL_STEPS;
+    return 1 + (msb - BLOCK_POOL_MIN_SHIFT) * BLOCK_POOL_STEPS + step;
+}
+
+static unsigned block_pool_MagazineSize (unsigned cls)
+{
+    size_t n = BLOCK_POOL_MAGAZINE_BYTES / block_pool_ClassSize (cls);
+    return (n > BLOCK_POOL_MAGAZINE) ? BLOCK_POOL_MAGAZINE : (n < 2) ? 2 : n;
+}
+
+static unsigned block_pool_DepotSize (unsigned cls)
+{
+    return BLOCK_POOL_DEPOT_BYTES / block_pool_ClassSize (cls);
+}
+
+typedef struct
+{
+    unsigned count[BLOCK_POOL_CLASSES];
+    block_t *blocks[BLOCK_POOL_CLASSES][BLOCK_POOL_MAGAZINE];
+} block_magazine_t;
+
+static struct
+{
+    vlc_mutex_t lock;
+    block_t *depot[BLOCK_POOL_CLASSES]; /**< linked through p_next */
+    unsigned depot_count[BLOCK_POOL_CLASSES];
+    vlc_threadvar_t magazine;
+    atomic_int state; /**< 0: not initialized, 1: enabled, -1: disabled */
+    atomic_uint_fast64_t hits;
+    atomic_uint_fast64_t misses;
+    atomic_size_t cached;
+} pool = {
+    .lock = VLC_STATIC_MUTEX,
+    .state = ATOMIC_VAR_INIT(0),
+    .hits = ATOMIC_VAR_INIT(0),
+    .misses = ATOMIC_VAR_INIT(0),
+    .cached = ATOMIC_VAR_INIT(0),
+};
+
+static void block_pool_Free (block_t *block, unsigned cls)
+{
+    atomic_fetch_sub_explicit (&pool.cached, block_pool_ClassSize (cls),
+                               memory_order_relaxed);
+    free (block);
+}
+
+/** Moves the last n blocks of a magazine class to the depot. */
+static void block_pool_Flush (block_magazine_t *mag, unsigned cls, unsigned n)
+{
+    unsigned max = block_pool_DepotSize (cls);
+    block_t *excess = NULL;
+
+    vlc_mutex_lock (&pool.lock);
+    while (n-- > 0)
+    {
+        block_t *block = mag->blocks[cls][--mag->count[cls]];
+
+        if (pool.depot_count[cls] < max)
+        {
+            block->p_next = pool.depot[cls];
+            pool.depot[cls] = block;
+            pool.depot_count[cls]++;
+        }
+        else
+        {
+            block->p_next = excess;
+            excess = block;
+        }
+    }
+    vlc_mutex_unlock (&pool.lock);
+
+    while (excess != NULL)
+    {
+        block_t *next = excess->p_next;
+        block_pool_Free (excess, cls);
+        excess = next;
+    }
+}
+
+/** Refills a magazine class from the depot with up to n blocks. */
+static void block_pool_Fill (block_magazine_t *mag, unsigned cls, unsigned n)
+{
+    vlc_mutex_lock (&pool.lock);
+    while (n-- > 0 && pool.depot[cls] != NULL)
+    {
+        block_t *block = pool.depot[cls];
+
+        pool.depot[cls] = block->p_next;
+        pool.depot_count[cls]--;
+        mag->blocks[cls][mag->count[cls]++] = block;
+    }
+    vlc_mutex_unlock (&pool.lock);
+}
+
+static void block_pool_ThreadExit (void *data)
 {
-    /* 2 * BLOCK_PADDING: pre + post padding */
-    const size_t alloc = sizeof (block_t) + BLOCK_ALIGN + (2 * BLOCK_PADDING)
-                       + size;
-    if (unlikely(alloc <= size))
+    block_magazine_t *mag = data;
+
+    for (unsigned cls = 0; cls < BLOCK_POOL_CLASSES; cls++)
+        if (mag->count[cls] > 0)
+            block_pool_Flush (mag, cls, mag->count[cls]);
+    free (mag);
+}
+
+static int block_pool_Init (void)
+{
+    int state = -1;
+
+    vlc_mutex_lock (&pool.lock);
+    if (atomic_load_explicit (&pool.state, memory_order_relaxed) != 0)
+        state = atomic_load_explicit (&pool.state, memory_order_relaxed);
+    else
+    {
+#ifndef BLOCK_POOL_DISABLED
+        const char *env = getenv ("VLC_BLOCK_POOL");
+
+        if ((env == NULL || atoi (env) != 0)
+         && vlc_threadvar_create (&pool.magazine, block_pool_ThreadExit) == 0)
+            state = 1;
+#endif
+        atomic_store_explicit (&pool.state, state, memory_order_release);
+    }
+    vlc_mutex_unlock (&pool.lock);
+    return state;
+}
+
+/** Gets the magazine of the calling thread, or NULL if the pool is off. */
+static block_magazine_t *block_pool_GetMagazine (void)
+{
+    int state = atomic_load_explicit (&pool.state, memory_order_acquire);
+
+    if (unlikely(state == 0))
+        state = block_pool_Init ();
+    if (state < 0)
         return NULL;
 
-    block_t *b = malloc (alloc);
-    if (unlikely(b == NULL))
+    block_magazine_t *mag = vlc_threadvar_get (pool.magazine);
+    if (unlikely(mag == NULL))
+    {
+        mag = calloc (1, sizeof (*mag));
+        if (unlikely(mag == NULL))
+            return NULL;
+        if (unlikely(vlc_threadvar_set (pool.magazine, mag)))
+        {
+            free (mag);
+            return NULL;
+        }
+    }
+    return mag;
+}
+
+static void block_pool_Release (block_t *block)
+{
+    assert (block->p_start == (unsigned char *)(block + 1));
+    block_Invalidate (block);
+
+    size_t size = block->i_size - BLOCK_OVERHEAD;
+    unsigned cls = block_pool_Class (size);
+    assert (block_pool_ClassSize (cls) == size);
+
+    atomic_fetch_add_explicit (&pool.cached, size, memory_order_relaxed);
+
+    block_magazine_t *mag = block_pool_GetMagazine ();
+    if (unlikely(mag == NULL))
+    {
+        block_pool_Free (block, cls);
+        return;
+    }
+
+    unsigned max = block_pool_MagazineSize (cls);
+    if (mag->count[cls] >= max)
+        block_pool_Flush (mag, cls, (max + 1) / 2);
+    mag->blocks[cls][mag->count[cls]++] = block;
+}
+
+/**
+ * Allocates a block of the size class fitting the given payload size,
+ * preferably from the pool.
+ * @param sizep payload size [IN], size class [OUT]
+ * @return a block, NULL if the pool is disabled or the size is too large
+ */
+static block_t *block_pool_Alloc (size_t *sizep)
+{
+    size_t size = *sizep;
+
+    if (size > block_pool_ClassSize (BLOCK_POOL_CLASSES - 1))
+        return NULL;
+
+    block_magazine_t *mag = block_pool_GetMagazine ();
+    if (mag == NULL)
         return NULL;
 
-    block_Init (b, b + 1, alloc - sizeof (*b));
+    unsigned cls = block_pool_Class (size);
+    size = block_pool_ClassSize (cls);
+    *sizep = size;
+
+    if (mag->count[cls] == 0)
+        block_pool_Fill (mag, cls, (block_pool_MagazineSize (cls) + 1) / 2);
+
+    block_t *b;
+
+    if (mag->count[cls] > 0)
+    {
+        b = mag->blocks[cls][--mag->count[cls]];
+        atomic_fetch_sub_explicit (&pool.cached, size, memory_order_relaxed);
+        atomic_fetch_add_explicit (&pool.hits, 1, memory_order_relaxed);
+    }
+    else
+    {
+        b = malloc (sizeof (*b) + BLOCK_OVERHEAD + size);
+        if (unlikely(b == NULL))
+            return NULL;
+        atomic_fetch_add_explicit (&pool.misses, 1, memory_order_relaxed);
+    }
+    b->pf_release = block_pool_Release;
+    return b;
+}
+
+/**
+ * Frees the blocks cached in the depot and in the magazine of the calling
+ * thread. Other threads flush their magazine to the depot when they exit.
+ */
+void block_PoolDrain (void)
+{
+    if (atomic_load_explicit (&pool.state, memory_order_acquire) <= 0)
+        return;
+
+    block_magazine_t *mag = vlc_threadvar_get (pool.magazine);
+    if (mag != NULL)
+        for (unsigned cls = 0; cls < BLOCK_POOL_CLASSES; cls++)
+            if (mag->count[cls] > 0)
+                block_pool_Flush (mag, cls, mag->count[cls]);
+
+    for (unsigned cls = 0; cls < BLOCK_POOL_CLASSES; cls++)
+    {
+        vlc_mutex_lock (&pool.lock);
+        block_t *block = pool.depot[cls];
+        pool.depot[cls] = NULL;
+        pool.depot_count[cls] = 0;
+        vlc_mutex_unlock (&pool.lock);
+
+        while (block != NULL)
+        {
+            block_t *next = block->p_next;
+            block_pool_Free (block, cls);
+            block = next;
+        }
+    }
+}
+
+/**
+ * Retrieves the block pool statistics.
+ *
+ * @param stats structure to fill with the current counters
+ * @return true if the pool is enabled, false if it is disabled (in which case
+ * all the counters are zero)
+ */
+bool block_PoolGetStats (block_pool_stats_t *stats)
+{
+    stats->i_hits = atomic_load_explicit (&pool.hits, memory_order_relaxed);
+    stats->i_misses = atomic_load_explicit (&pool.misses, memory_order_relaxed);
+    stats->i_cached = atomic_load_explicit (&pool.cached, memory_order_relaxed);
+
+    int state = atomic_load_explicit (&pool.state, memory_order_acquire);
+    if (state == 0)
+        state = block_pool_Init ();
+    return state > 0;
+}
+
+block_t *block_Alloc (size_t size)
+{
+    size_t capacity = size;
+    block_t *b = block_pool_Alloc (&capacity);
+
+    if (b == NULL)
+    {
+        /* 2 * BLOCK_PADDING: pre + post padding */
+        const size_t alloc = sizeof (block_t) + BLOCK_OVERHEAD + size;
+        if (unlikely(alloc <= size))
+            return NULL;
+
+        b = malloc (alloc);
+        if (unlikely(b == NULL))
+            return NULL;
+        capacity = size;
+        b->pf_release = block_generic_Release;
+    }
+
+    block_free_t release = b->pf_release;
+
+    block_Init (b, b + 1, BLOCK_OVERHEAD + capacity);
     static_assert ((BLOCK_PADDING % BLOCK_ALIGN) == 0,
                    "BLOCK_PADDING must be a multiple of BLOCK_ALIGN");
     b->p_buffer += BLOCK_PADDING + BLOCK_ALIGN - 1;
     b->p_buffer = (void *)(((uintptr_t)b->p_buffer) & ~(BLOCK_ALIGN - 1));
     b->i_buffer = size;
-    b->pf_release = block_generic_Release;
+    b->pf_release = release;
     return b;
 }
 
+static bool block_IsShared (const block_t *);
+
 block_t *block_TryRealloc (block_t *p_block, ssize_t i_prebody, size_t i_body)
 {
     block_Check( p_block );
@@ -180,9 +518,12 @@ block_t *block_TryRealloc (block_t *p_block, ssize_t i_prebody, size_t i_body)
 
     size_t requested = i_prebody + i_body;
 
+    /* Shared payloads are read-only: copy them before expanding */
+    bool b_shared = block_IsShared( p_block );
+
     if( p_block->i_buffer == 0 )
     {   /* Corner case: nothing to preserve */
-        if( requested <= p_block->i_size )
+        if( requested <= p_block->i_size && !b_shared )
         {   /* Enough room: recycle buffer */
             size_t extra = p_block->i_size - requested;
 
@@ -207,7 +548,8 @@ block_t *block_TryRealloc (block_t *p_block, ssize_t i_prebody, size_t i_body)
     /* Second, reallocate the buffer if we lack space. */
     assert( i_prebody >= 0 );
     if( (size_t)(p_block->p_buffer - p_start) < (size_t)i_prebody
-     || (size_t)(p_end - p_block->p_buffer) < i_body )
+     || (size_t)(p_end - p_block->p_buffer) < i_body
+     || (b_shared && (i_prebody > 0 || i_body > p_block->i_buffer)) )
     {
         block_t *p_rea = block_Alloc( requested );
         if( p_rea == NULL )
@@ -245,6 +587,168 @@ block_t *block_Realloc (block_t *block, ssize_t prebody, size_t body)
     return rea;
 }
 
+typedef struct
+{
+    atomic_uintptr_t refs;
+    block_t *block; /**< block owning the payload */
+} block_payload_t;
+
+typedef struct
+{
+    block_t self;
+    block_payload_t *payload;
+} block_shared_t;
+
+static void block_shared_Release (block_t *block)
+{
+    block_shared_t *sb = (block_shared_t *)block;
+    block_payload_t *payload = sb->payload;
+
+    block_Invalidate (block);
+    free (sb);
+
+    if (atomic_fetch_sub (&payload->refs, 1) == 1)
+    {
+        block_Release (payload->block);
+        free (payload);
+    }
+}
+
+static block_t *block_shared_New (block_payload_t *payload,
+                                  const block_t *ref)
+{
+    block_shared_t *sb = malloc (sizeof (*sb));
+    if (unlikely(sb == NULL))
+        return NULL;
+
+    block_t *block = &sb->self;
+
+    block_Init (block, ref->p_start, ref->i_size);
+    block->p_buffer = ref->p_buffer;
+    block->i_buffer = ref->i_buffer;
+    block_CopyProperties (block, (block_t *)ref);
+    block->pf_release = block_shared_Release;
+    sb->payload = payload;
+    return block;
+}
+
+static bool block_IsShared (const block_t *block)
+{
+    if (block->pf_release != block_shared_Release)
+        return false;
+
+    const block_shared_t *sb = (const block_shared_t *)block;
+    return atomic_load (&sb->payload->refs) > 1;
+}
+
+/**
+ * Converts a block into a reference-counted shared block.
+ *
+ * The payload is not copied. More references to it can then be obtained with
+ * block_Share(). The payload of a shared block must be treated as read-only:
+ * block_Realloc() copies it before expanding it, and block_Unshare() returns
+ * a block whose payload can be written to.
+ *
+ * @param block block to convert (not to be used anymore)
+ * @return shared block, or NULL on error (the block is released then)
+ */
+block_t *block_MakeShared (block_t *block)
+{
+    block_Check (block);
+
+    if (block->pf_release == block_shared_Release)
+        return block;
+
+    block_payload_t *payload = malloc (sizeof (*payload));
+    if (unlikely(payload == NULL))
+    {
+        block_Release (block);
+        return NULL;
+    }
+
+    atomic_init (&payload->refs, 1);
+    payload->block = block;
+
+    block_t *sb = block_shared_New (payload, block);
+    if (unlikely(sb == NULL))
+    {
+        free (payload);
+        block_Release (block);
+        return NULL;
+    }
+
+    sb->p_next = block->p_next;
+    block->p_next = NULL;
+    return sb;
+}
+
+/**
+ * Creates a new reference to the payload of a block.
+ *
+ * If the block was made shared with block_MakeShared(), the payload is not
+ * copied. Otherwise, this is equivalent to block_Duplicate().
+ *
+ * @return a new block (that is not chained), or NULL on error
+ */
+block_t *block_Share (block_t *block)
+{
+    block_Check (block);
+
+    if (block->pf_release != block_shared_Release)
+        return block_Duplicate (block);
+
+    block_shared_t *sb = (block_shared_t *)block;
+    block_t *ref = block_shared_New (sb->payload, block);
+
+    if (likely(ref != NULL))
+        atomic_fetch_add (&sb->payload->refs, 1);
+    return ref;
+}
+
+/**
+ * Ensures that the payload of a block can be written to.
+ *
+ * If the payload is shared with other blocks, it is copied.
+ *
+ * @param block block (not to be used anymore)
+ * @return a block with an exclusively owned payload, or NULL on error (the
+ * block is released then)
+ */
+block_t *block_Unshare (block_t *block)
+{
+    block_Check (block);
+
+    if (block->pf_release != block_shared_Release)
+        return block;
+
+    block_shared_t *sb = (block_shared_t *)block;
+    block_payload_t *payload = sb->payload;
+    block_t *out;
+
+    if (atomic_load (&payload->refs) == 1)
+    {   /* Last reference: give the payload owner back */
+        out = payload->block;
+        out->p_buffer = block->p_buffer;
+        out->i_buffer = block->i_buffer;
+        BlockMetaCopy (out, block);
+        block_Invalidate (block);
+        free (sb);
+        free (payload);
+        return out;
+    }
+
+    out = block_Alloc (block->i_buffer);
+    if (unlikely(out == NULL))
+    {
+        block_Release (block);
+        return NULL;
+    }
+    memcpy (out->p_buffer, block->p_buffer, block->i_buffer);
+    BlockMetaCopy (out, block);
+    block_Release (block);
+    return out;
+}
+
 static void block_heap_Release (block_t *block)
 {
     block_Invalidate (block);
@@ -29,6 +29,7 @@
 #include <vlc_modules.h>
 #include <vlc_spu.h>
 #include <libvlc.h>
+#include "slices.h"
 #include <assert.h>
 
 typedef struct chained_filter_t
@@ -58,6 +59,8 @@ struct filter_chain_t
     es_format_t fmt_in; /**< Chain input format (constant) */
     es_format_t fmt_out; /**< Chain current output format */
     unsigned length; /**< Number of filters */
+    vlc_slices_t *slices; /**< Slice workers (if any) */
+    bool slices_held; /**< Whether slice workers were requested yet */
     bool b_allow_fmt_out_change; /**< Can the output format be changed? */
     char psz_capability[]; /**< Module capability for all chained filters */
 };
@@ -85,6 +88,8 @@ static filter_chain_t *filter_chain_NewInner( const filter_owner_t *callbacks,
     es_format_Init( &chain->fmt_in, UNKNOWN_ES, 0 );
     es_format_Init( &chain->fmt_out, UNKNOWN_ES, 0 );
     chain->length = 0;
+    chain->slices = NULL;
+    chain->slices_held = false;
     chain->b_allow_fmt_out_change = fmt_out_change;
     strcpy( chain->psz_capability, cap );
 
@@ -127,6 +132,33 @@ static picture_t *filter_chain_VideoBufferNew( filter_t *filter )
     }
 }
 
+/** Chained filter slices dispatcher function */
+static void filter_chain_VideoRunSlices( filter_t *filter,
+                                         void (*func)( void *, unsigned,
+                                                       unsigned ),
+                                         void *data, unsigned max )
+{
+    filter_chain_t *chain = filter->owner.sys;
+
+    /* The workers are only started once a filter needs them */
+    if( !chain->slices_held )
+    {
+        chain->slices = vlc_slices_Hold();
+        chain->slices_held = true;
+    }
+
+    if( chain->slices == NULL )
+    {
+        func( data, 0, 1 );
+        return;
+    }
+
+    unsigned count = vlc_slices_Count( chain->slices );
+    if( count > max )
+        count = max;
+    vlc_slices_Run( chain->slices, func, data, count );
+}
+
 #undef filter_chain_NewVideo
 filter_chain_t *filter_chain_NewVideo( vlc_object_t *obj, bool allow_change,
                                        const filter_owner_t *restrict owner )
@@ -135,6 +167,7 @@ filter_chain_t *filter_chain_NewVideo( vlc_object_t *obj, bool allow_change,
         .sys = obj,
         .video = {
             .buffer_new = filter_chain_VideoBufferNew,
+            .run_slices = filter_chain_VideoRunSlices,
         },
     };
 
@@ -153,6 +186,8 @@ void filter_chain_Delete( filter_chain_t *p_chain )
     es_format_Clean( &p_chain->fmt_in );
     es_format_Clean( &p_chain->fmt_out );
 
+    if( p_chain->slices != NULL )
+        vlc_slices_Release( p_chain->slices );
     free( p_chain );
 }
 /**
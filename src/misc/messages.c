@@ -38,6 +38,7 @@
 #include <assert.h>
 
 #include <vlc_common.h>
+#include <vlc_atomic.h>
 #include <vlc_interface.h>
 #include <vlc_charset.h>
 #include <vlc_modules.h>
@@ -205,6 +206,236 @@ static void Win32DebugOutputMsg (void* d, int type, const vlc_log_t *p_item,
 }
 #endif
 
+/*** Asynchronous logging ***/
+
+/* The ring is a bounded multiple producers queue (after D. Vyukov): each
+ * slot carries a sequence number telling whether it is free for the
+ * producer at a given position, or ready for the consumer. */
+#define VLC_LOG_ASYNC_SLOTS 1024 /* must be a power of two */
+#define VLC_LOG_ASYNC_TEXT  448
+
+typedef struct
+{
+    atomic_size_t seq;
+    int type;
+    vlc_log_t meta;
+    const char *msg;
+    char *heap; /* message too long for the text buffer, or NULL */
+    char text[VLC_LOG_ASYNC_TEXT]; /* module, header and message */
+} vlc_log_slot_t;
+
+struct vlc_log_async
+{
+    vlc_log_cb cb;
+    void *opaque;
+    vlc_thread_t thread;
+    vlc_mutex_t lock;
+    vlc_cond_t wait;
+    bool stop;
+    atomic_bool sleeping;
+    atomic_size_t tail; /* next position for producers */
+    size_t head; /* next position for the consumer */
+    atomic_uint dropped;
+    unsigned reported;
+    vlc_log_slot_t slots[VLC_LOG_ASYNC_SLOTS];
+};
+
+static void vlc_LogAsyncCall(vlc_log_async_t *async, int type,
+                             const vlc_log_t *item, const char *format, ...)
+{
+    va_list ap;
+
+    va_start(ap, format);
+    async->cb(async->opaque, type, item, format, ap);
+    va_end(ap);
+}
+
+static bool vlc_LogAsyncReady(vlc_log_async_t *async)
+{
+    vlc_log_slot_t *slot = &async->slots[async->head
+                                         & (VLC_LOG_ASYNC_SLOTS - 1)];
+
+    return atomic_load(&slot->seq) == async->head + 1;
+}
+
+static void vlc_LogAsyncDrain(vlc_log_async_t *async)
+{
+    while (vlc_LogAsyncReady(async))
+    {
+        vlc_log_slot_t *slot = &async->slots[async->head
+                                             & (VLC_LOG_ASYNC_SLOTS - 1)];
+
+        vlc_LogAsyncCall(async, slot->type, &slot->meta, "%s", slot->msg);
+        free(slot->heap);
+        atomic_store_explicit(&slot->seq, async->head + VLC_LOG_ASYNC_SLOTS,
+                              memory_order_release);
+        async->head++;
+    }
+
+    unsigned dropped = atomic_load_explicit(&async->dropped,
+                                            memory_order_relaxed);
+    if (dropped != async->reported)
+    {
+        const vlc_log_t meta = {
+            .psz_object_type = "logger",
+            .psz_module = "core",
+            .line = -1,
+            .tid = vlc_thread_id(),
+        };
+
+        vlc_LogAsyncCall(async, VLC_MSG_WARN, &meta,
+                         "%u log messages dropped", dropped - async->reported);
+        async->reported = dropped;
+    }
+}
+
+static void *vlc_LogAsyncThread(void *data)
+{
+    vlc_log_async_t *async = data;
+    bool stop;
+
+    do
+    {
+        vlc_LogAsyncDrain(async);
+
+        vlc_mutex_lock(&async->lock);
+        while (!async->stop)
+        {   /* Set before every check: a producer may have cleared it for a
+             * later slot, while the head slot was not published yet. */
+            atomic_store(&async->sleeping, true);
+            if (vlc_LogAsyncReady(async))
+                break;
+            vlc_cond_wait(&async->wait, &async->lock);
+        }
+        atomic_store(&async->sleeping, false);
+        stop = async->stop;
+        vlc_mutex_unlock(&async->lock);
+    }
+    while (!stop);
+
+    vlc_LogAsyncDrain(async);
+    return NULL;
+}
+
+vlc_log_async_t *vlc_LogAsyncCreate(vlc_log_cb cb, void *opaque)
+{
+    vlc_log_async_t *async = malloc(sizeof (*async));
+    if (unlikely(async == NULL))
+        return NULL;
+
+    async->cb = cb;
+    async->opaque = opaque;
+    vlc_mutex_init(&async->lock);
+    vlc_cond_init(&async->wait);
+    async->stop = false;
+    atomic_init(&async->sleeping, false);
+    atomic_init(&async->tail, 0);
+    async->head = 0;
+    atomic_init(&async->dropped, 0);
+    async->reported = 0;
+    for (size_t i = 0; i < VLC_LOG_ASYNC_SLOTS; i++)
+        atomic_init(&async->slots[i].seq, i);
+
+    if (vlc_clone(&async->thread, vlc_LogAsyncThread, async,
+                  VLC_THREAD_PRIORITY_LOW))
+    {
+        vlc_cond_destroy(&async->wait);
+        vlc_mutex_destroy(&async->lock);
+        free(async);
+        return NULL;
+    }
+    return async;
+}
+
+void vlc_LogAsyncDestroy(vlc_log_async_t *async)
+{
+    vlc_mutex_lock(&async->lock);
+    async->stop = true;
+    vlc_cond_signal(&async->wait);
+    vlc_mutex_unlock(&async->lock);
+
+    vlc_join(async->thread, NULL);
+    vlc_cond_destroy(&async->wait);
+    vlc_mutex_destroy(&async->lock);
+    free(async);
+}
+
+/* Copies a string into the slot text buffer, truncating it to max bytes */
+static const char *vlc_LogAsyncCopy(char **buf, const char *str, size_t max)
+{
+    char *copy = *buf;
+    size_t len = strnlen(str, max - 1);
+
+    memcpy(copy, str, len);
+    copy[len] = '\0';
+    *buf += len + 1;
+    return copy;
+}
+
+void vlc_LogAsync(vlc_log_async_t *async, int type, const vlc_log_t *item,
+                  const char *format, va_list ap)
+{
+    vlc_log_slot_t *slot;
+    size_t pos = atomic_load_explicit(&async->tail, memory_order_relaxed);
+
+    /* Claim a slot */
+    for (;;)
+    {
+        slot = &async->slots[pos & (VLC_LOG_ASYNC_SLOTS - 1)];
+
+        size_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+
+        if (diff == 0)
+        {
+            if (atomic_compare_exchange_weak_explicit(&async->tail, &pos,
+                        pos + 1, memory_order_relaxed, memory_order_relaxed))
+                break;
+        }
+        else if (diff < 0)
+        {   /* Full: the consumer is late */
+            atomic_fetch_add_explicit(&async->dropped, 1,
+                                      memory_order_relaxed);
+            return;
+        }
+        else
+            pos = atomic_load_explicit(&async->tail, memory_order_relaxed);
+    }
+
+    /* Format the message in the slot. Object types are static constants, as
+     * are file and function names; the module name may not be. */
+    char *buf = slot->text;
+
+    slot->type = type;
+    slot->meta = *item;
+    slot->meta.psz_module = vlc_LogAsyncCopy(&buf, item->psz_module, 32);
+    if (item->psz_header != NULL)
+        slot->meta.psz_header = vlc_LogAsyncCopy(&buf, item->psz_header, 64);
+
+    size_t len = slot->text + sizeof (slot->text) - buf;
+    va_list aq;
+    va_copy(aq, ap);
+    int n = vsnprintf(buf, len, format, aq);
+    va_end(aq);
+
+    slot->msg = buf;
+    slot->heap = NULL;
+    if (unlikely(n < 0))
+        slot->msg = "message lost";
+    else if ((size_t)n >= len && vasprintf(&slot->heap, format, ap) != -1)
+        slot->msg = slot->heap; /* otherwise, keep the truncated message */
+
+    /* Publish it, and wake up the consumer if it sleeps */
+    atomic_store(&slot->seq, pos + 1);
+    if (atomic_load(&async->sleeping)
+     && atomic_exchange(&async->sleeping, false))
+    {
+        vlc_mutex_lock(&async->lock);
+        vlc_cond_signal(&async->wait);
+        vlc_mutex_unlock(&async->lock);
+    }
+}
+
 typedef struct vlc_log_early_t
 {
     struct vlc_log_early_t *next;
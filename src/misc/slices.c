@@ -0,0 +1,231 @@
+/*****************************************************************************
+ * slices.c: shared worker pool for sliced picture processing
+ *****************************************************************************
+ * Copyright (C) 2016 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <assert.h>
+#include <stdlib.h>
+
+#include <vlc_common.h>
+#include "slices.h"
+
+/* Beyond that, memory bandwidth is the limit for pixel-local filters */
+#define VLC_SLICES_MAX_THREADS 8
+
+struct vlc_slices_job
+{
+    struct vlc_slices_job *next_job;
+    void (*func)(void *, unsigned, unsigned);
+    void *data;
+    unsigned count; /**< Number of slices */
+    unsigned next; /**< Next slice to run */
+    unsigned done; /**< Number of finished slices */
+};
+
+struct vlc_slices
+{
+    vlc_mutex_t lock;
+    vlc_cond_t wait; /**< Workers wait for jobs */
+    vlc_cond_t done; /**< Callers wait for the end of their job */
+    struct vlc_slices_job *first, **lastp; /**< Jobs with slices left */
+    bool exit;
+
+    unsigned refs;
+    unsigned count; /**< Worker threads */
+    vlc_thread_t threads[];
+};
+
+static vlc_mutex_t slices_lock = VLC_STATIC_MUTEX;
+static vlc_slices_t *slices_pool = NULL;
+
+/* Takes the next slice of the first pending job (pool lock held) */
+static unsigned vlc_slices_Take(vlc_slices_t *pool,
+                                struct vlc_slices_job *job)
+{
+    unsigned slice = job->next++;
+
+    if (job->next == job->count)
+    {   /* Last slice is taken: remove the job from the queue */
+        struct vlc_slices_job **pp = &pool->first;
+
+        while (*pp != job)
+            pp = &(*pp)->next_job;
+        *pp = job->next_job;
+        if (pool->lastp == &job->next_job)
+            pool->lastp = pp;
+    }
+    return slice;
+}
+
+static void *vlc_slices_Thread(void *data)
+{
+    vlc_slices_t *pool = data;
+
+    vlc_mutex_lock(&pool->lock);
+    for (;;)
+    {
+        while (!pool->exit && pool->first == NULL)
+            vlc_cond_wait(&pool->wait, &pool->lock);
+        if (pool->exit)
+            break;
+
+        struct vlc_slices_job *job = pool->first;
+        unsigned slice = vlc_slices_Take(pool, job);
+
+        vlc_mutex_unlock(&pool->lock);
+        job->func(job->data, slice, job->count);
+        vlc_mutex_lock(&pool->lock);
+
+        if (++job->done == job->count)
+            vlc_cond_broadcast(&pool->done);
+    }
+    vlc_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+static void vlc_slices_Stop(vlc_slices_t *pool)
+{
+    vlc_mutex_lock(&pool->lock);
+    pool->exit = true;
+    vlc_cond_broadcast(&pool->wait);
+    vlc_mutex_unlock(&pool->lock);
+
+    for (unsigned i = 0; i < pool->count; i++)
+        vlc_join(pool->threads[i], NULL);
+
+    vlc_cond_destroy(&pool->done);
+    vlc_cond_destroy(&pool->wait);
+    vlc_mutex_destroy(&pool->lock);
+    free(pool);
+}
+
+static vlc_slices_t *vlc_slices_Start(void)
+{
+    unsigned count = vlc_GetCPUCount();
+    if (count > VLC_SLICES_MAX_THREADS)
+        count = VLC_SLICES_MAX_THREADS;
+    if (count <= 1)
+        return NULL;
+    count--; /* the caller runs slices too */
+
+    vlc_slices_t *pool = malloc(sizeof (*pool)
+                                + count * sizeof (pool->threads[0]));
+    if (unlikely(pool == NULL))
+        return NULL;
+
+    vlc_mutex_init(&pool->lock);
+    vlc_cond_init(&pool->wait);
+    vlc_cond_init(&pool->done);
+    pool->first = NULL;
+    pool->lastp = &pool->first;
+    pool->exit = false;
+    pool->refs = 1;
+    pool->count = 0;
+
+    while (pool->count < count)
+    {
+        if (vlc_clone(&pool->threads[pool->count], vlc_slices_Thread, pool,
+                      VLC_THREAD_PRIORITY_VIDEO))
+            break;
+        pool->count++;
+    }
+
+    if (pool->count == 0)
+    {
+        vlc_slices_Stop(pool);
+        return NULL;
+    }
+    return pool;
+}
+
+vlc_slices_t *vlc_slices_Hold(void)
+{
+    vlc_slices_t *pool;
+
+    vlc_mutex_lock(&slices_lock);
+    pool = slices_pool;
+    if (pool != NULL)
+        pool->refs++;
+    else
+        pool = slices_pool = vlc_slices_Start();
+    vlc_mutex_unlock(&slices_lock);
+    return pool;
+}
+
+void vlc_slices_Release(vlc_slices_t *pool)
+{
+    vlc_mutex_lock(&slices_lock);
+    assert(pool == slices_pool);
+    if (--pool->refs == 0)
+        slices_pool = NULL;
+    else
+        pool = NULL;
+    vlc_mutex_unlock(&slices_lock);
+
+    if (pool != NULL)
+        vlc_slices_Stop(pool);
+}
+
+unsigned vlc_slices_Count(const vlc_slices_t *pool)
+{
+    return pool->count + 1;
+}
+
+void vlc_slices_Run(vlc_slices_t *pool,
+                    void (*func)(void *, unsigned, unsigned), void *data,
+                    unsigned count)
+{
+    if (count <= 1)
+    {
+        func(data, 0, 1);
+        return;
+    }
+
+    struct vlc_slices_job job = {
+        .next_job = NULL,
+        .func = func,
+        .data = data,
+        .count = count,
+        .next = 0,
+        .done = 0,
+    };
+
+    vlc_mutex_lock(&pool->lock);
+    *pool->lastp = &job;
+    pool->lastp = &job.next_job;
+    vlc_cond_broadcast(&pool->wait);
+
+    /* Run slices of this job here too rather than sleep */
+    while (job.next < job.count)
+    {
+        unsigned slice = vlc_slices_Take(pool, &job);
+
+        vlc_mutex_unlock(&pool->lock);
+        func(data, slice, count);
+        vlc_mutex_lock(&pool->lock);
+        job.done++;
+    }
+
+    while (job.done < job.count)
+        vlc_cond_wait(&pool->done, &pool->lock);
+    vlc_mutex_unlock(&pool->lock);
+}
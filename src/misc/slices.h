@@ -0,0 +1,55 @@
+/*****************************************************************************
+ * slices.h: shared worker pool for sliced picture processing
+ *****************************************************************************
+ * Copyright (C) 2016 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifndef LIBVLC_SLICES_H
+# define LIBVLC_SLICES_H 1
+
+typedef struct vlc_slices vlc_slices_t;
+
+/**
+ * Gets a reference to the process-wide slice worker pool.
+ *
+ * @return the pool, or NULL if slicing would not help (single CPU) or
+ * on error
+ */
+vlc_slices_t *vlc_slices_Hold(void);
+
+/**
+ * Releases a reference to the slice worker pool.
+ * The workers are stopped once the last reference is gone.
+ */
+void vlc_slices_Release(vlc_slices_t *);
+
+/**
+ * @return the number of threads that can run slices at the same time,
+ * including the calling thread
+ */
+unsigned vlc_slices_Count(const vlc_slices_t *);
+
+/**
+ * Calls a function once for each slice index, from the pool workers and the
+ * calling thread, and waits for all the calls to return.
+ *
+ * Several threads may run jobs on the same pool at the same time.
+ */
+void vlc_slices_Run(vlc_slices_t *, void (*)(void *, unsigned, unsigned),
+                    void *, unsigned count);
+
+#endif
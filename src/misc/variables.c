@@ -28,9 +28,6 @@
 # include "config.h"
 #endif
 
-#ifdef HAVE_SEARCH_H
-# include <search.h>
-#endif
 #include <assert.h>
 #include <float.h>
 #include <math.h>
@@ -66,13 +63,23 @@ typedef struct callback_table_t
     callback_entry_t * p_entries;
 } callback_table_t;
 
+/**
+ * An interned variable name, shared by all the variables of that name.
+ */
+typedef struct var_name_t
+{
+    uint32_t     hash;
+    unsigned     refs;
+    char         psz[];
+} var_name_t;
+
 /**
  * The structure describing a variable.
  * \note vlc_value_t is the common union for variable values
  */
 struct variable_t
 {
-    char *       psz_name; /**< The variable unique name (must be first) */
+    var_name_t * name; /**< The variable unique name, interned */
 
     /** The variable's exported value */
     vlc_value_t  val;
@@ -140,23 +147,241 @@ int_ops    = { CmpInt,     DupDummy,  FreeDummy,  },
 string_ops = { CmpString,  DupString, FreeString, },
 coords_ops = { NULL,       DupDummy,  FreeDummy,  };
 
-static int varcmp( const void *a, const void *b )
+/*****************************************************************************
+ * Hash tables
+ *****************************************************************************
+ * Variables, and the interned names, are kept in open-addressed hash tables
+ * with linear probing. Removed entries leave a tombstone behind, unless they
+ * end a probe sequence, so that the other entries remain reachable.
+ *****************************************************************************/
+static char var_tombstone;
+#define VAR_DELETED ((void *)&var_tombstone)
+
+static uint32_t VarHash( const char *psz )
+{
+    uint32_t hash = 2166136261u; /* FNV-1a */
+
+    while( *psz )
+        hash = (hash ^ (unsigned char)*psz++) * 16777619u;
+    return hash;
+}
+
+static const var_name_t *VarName( const void *entry )
 {
-    const variable_t *va = a, *vb = b;
+    return ((const variable_t *)entry)->name;
+}
+
+static const var_name_t *NameName( const void *entry )
+{
+    return entry;
+}
+
+static bool TableLive( const void *entry )
+{
+    return entry != NULL && entry != VAR_DELETED;
+}
 
-    /* psz_name must be first */
-    assert( va == (const void *)&va->psz_name );
-    return strcmp( va->psz_name, vb->psz_name );
+/* Returns the slot of the entry with the given name, or SIZE_MAX */
+static size_t TableFind( const var_table_t *t, const char *psz, uint32_t hash,
+                         const var_name_t *(*nameof)( const void * ) )
+{
+    if( t->slots == NULL )
+        return SIZE_MAX;
+
+    for( size_t i = hash & t->mask;; i = (i + 1) & t->mask )
+    {
+        const void *entry = t->slots[i];
+        if( entry == NULL )
+            return SIZE_MAX;
+        if( entry != VAR_DELETED )
+        {
+            const var_name_t *name = nameof( entry );
+            if( name->hash == hash && !strcmp( name->psz, psz ) )
+                return i;
+        }
+    }
 }
 
+/* Returns the slot of an entry known to be in the table */
+static size_t TableIndex( const var_table_t *t, const void *entry,
+                          uint32_t hash )
+{
+    size_t i = hash & t->mask;
+
+    while( t->slots[i] != entry )
+        i = (i + 1) & t->mask;
+    return i;
+}
+
+/* Inserts an entry known not to be in the table, with a slot to spare */
+static void TableInsert( var_table_t *t, void *entry, uint32_t hash )
+{
+    size_t i = hash & t->mask;
+
+    while( TableLive( t->slots[i] ) )
+        i = (i + 1) & t->mask;
+    if( t->slots[i] == NULL )
+        t->used++;
+    t->slots[i] = entry;
+    t->count++;
+}
+
+/* Ensures that one more entry can be inserted, rehashing if needed */
+static int TableReserve( var_table_t *t,
+                         const var_name_t *(*nameof)( const void * ) )
+{
+    /* Keep at least a quarter of the slots empty, so probes stay short */
+    if( t->slots != NULL && 4 * (t->used + 1) <= 3 * (t->mask + 1) )
+        return VLC_SUCCESS;
+
+    size_t size = 16;
+    while( size < 2 * (t->count + 1) )
+        size *= 2;
+
+    var_table_t nt = { calloc( size, sizeof (void *) ), size - 1, 0, 0 };
+    if( unlikely(nt.slots == NULL) )
+        return VLC_ENOMEM;
+
+    for( size_t i = 0; t->slots != NULL && i <= t->mask; i++ )
+        if( TableLive( t->slots[i] ) )
+            TableInsert( &nt, t->slots[i], nameof( t->slots[i] )->hash );
+    free( t->slots );
+    *t = nt;
+    return VLC_SUCCESS;
+}
+
+static void TableRemove( var_table_t *t, size_t i )
+{
+    assert( TableLive( t->slots[i] ) );
+
+    if( t->slots[(i + 1) & t->mask] == NULL )
+    {
+        t->slots[i] = NULL;
+        t->used--;
+    }
+    else
+        t->slots[i] = VAR_DELETED;
+    t->count--;
+}
+
+/*****************************************************************************
+ * Names interning
+ *****************************************************************************/
+static struct
+{
+    vlc_mutex_t lock;
+    var_table_t table;
+} var_names = { VLC_STATIC_MUTEX, { NULL, 0, 0, 0 } };
+
+static var_name_t *NameHold( const char *psz )
+{
+    var_table_t *t = &var_names.table;
+    uint32_t hash = VarHash( psz );
+    var_name_t *name = NULL;
+
+    vlc_mutex_lock( &var_names.lock );
+    size_t i = TableFind( t, psz, hash, NameName );
+    if( i != SIZE_MAX )
+    {
+        name = t->slots[i];
+        name->refs++;
+    }
+    else if( TableReserve( t, NameName ) == VLC_SUCCESS )
+    {
+        size_t len = strlen( psz ) + 1;
+
+        name = malloc( sizeof (*name) + len );
+        if( likely(name != NULL) )
+        {
+            name->hash = hash;
+            name->refs = 1;
+            memcpy( name->psz, psz, len );
+            TableInsert( t, name, hash );
+        }
+    }
+    vlc_mutex_unlock( &var_names.lock );
+    return name;
+}
+
+static void NameRelease( var_name_t *name )
+{
+    var_table_t *t = &var_names.table;
+
+    vlc_mutex_lock( &var_names.lock );
+    assert( name->refs > 0 );
+    if( --name->refs == 0 )
+    {
+        TableRemove( t, TableIndex( t, name, name->hash ) );
+        if( t->count == 0 )
+        {
+            free( t->slots );
+            *t = (var_table_t){ NULL, 0, 0, 0 };
+        }
+    }
+    else
+        name = NULL;
+    vlc_mutex_unlock( &var_names.lock );
+    free( name );
+}
+
+/**
+ * Finds a variable by name. The variable lock is held on return, in any case.
+ */
 static variable_t *Lookup( vlc_object_t *obj, const char *psz_name )
 {
     vlc_object_internals_t *priv = vlc_internals( obj );
-    variable_t **pp_var;
+    uint32_t hash = VarHash( psz_name );
 
     vlc_mutex_lock(&priv->var_lock);
-    pp_var = tfind( &psz_name, &priv->var_root, varcmp );
-    return (pp_var != NULL) ? *pp_var : NULL;
+    size_t i = TableFind( &priv->var_table, psz_name, hash, VarName );
+    return (i != SIZE_MAX) ? priv->var_table.slots[i] : NULL;
+}
+
+/**
+ * Finds a variable by handle. The variable lock is held on return, in any case.
+ */
+static variable_t *LookupHandle( vlc_object_t *obj, var_handle_t *handle )
+{
+    vlc_object_internals_t *priv = vlc_internals( obj );
+    const var_name_t *name;
+
+    name = (const var_name_t *)atomic_load_explicit( &handle->name,
+                                                     memory_order_acquire );
+    if( unlikely(name == NULL) )
+    {
+        /* The handle keeps its reference to the name forever */
+        var_name_t *held = NameHold( handle->psz_name );
+        uintptr_t expected = 0;
+
+        if( held != NULL
+         && !atomic_compare_exchange_strong( &handle->name, &expected,
+                                             (uintptr_t)held ) )
+            NameRelease( held ); /* same interned name, lost the race */
+        name = held;
+    }
+
+    vlc_mutex_lock( &priv->var_lock );
+
+    const var_table_t *t = &priv->var_table;
+    if( unlikely(name == NULL) || t->slots == NULL )
+        return NULL;
+
+    size_t i = atomic_load_explicit( &handle->slot, memory_order_relaxed );
+    if( i <= t->mask && TableLive( t->slots[i] )
+     && VarName( t->slots[i] ) == name )
+        return t->slots[i];
+
+    for( i = name->hash & t->mask;; i = (i + 1) & t->mask )
+    {
+        variable_t *var = t->slots[i];
+        if( var == NULL )
+            return NULL;
+        if( var != VAR_DELETED && var->name == name )
+        {
+            atomic_store_explicit( &handle->slot, i, memory_order_relaxed );
+            return var;
+        }
+    }
 }
 
 static void Destroy( variable_t *p_var )
@@ -173,7 +398,8 @@ static void Destroy( variable_t *p_var )
         free( p_var->choices_text.p_values );
     }
 
-    free( p_var->psz_name );
+    if( p_var->name != NULL )
+        NameRelease( p_var->name );
     free( p_var->psz_text );
     free( p_var->value_callbacks.p_entries );
     free( p_var );
@@ -285,9 +511,9 @@ static void TriggerListCallback(vlc_object_t *obj, variable_t *var,
 /**
  * Initialize a vlc variable
  *
- * We hash the given string and insert it into the sorted list. The insertion
- * may require slow memory copies, but think about what we gain in the log(n)
- * lookup phase when setting/getting the variable value!
+ * The name is interned and the variable is inserted in the hash table of the
+ * object, so that lookups need only hash the name once and seldom compare
+ * strings.
  *
  * \param p_this The object in which to create the variable
  * \param psz_name The name of the variable
@@ -302,7 +528,12 @@ int var_Create( vlc_object_t *p_this, const char *psz_name, int i_type )
     if( p_var == NULL )
         return VLC_ENOMEM;
 
-    p_var->psz_name = strdup( psz_name );
+    p_var->name = NameHold( psz_name );
+    if( unlikely(p_var->name == NULL) )
+    {
+        free( p_var );
+        return VLC_ENOMEM;
+    }
     p_var->psz_text = NULL;
 
     p_var->i_type = i_type & ~VLC_VAR_DOINHERIT;
@@ -361,22 +592,28 @@ int var_Create( vlc_object_t *p_this, const char *psz_name, int i_type )
         var_Inherit(p_this, psz_name, i_type, &p_var->val);
 
     vlc_object_internals_t *p_priv = vlc_internals( p_this );
-    variable_t **pp_var, *p_oldvar;
+    var_table_t *p_table = &p_priv->var_table;
+    uint32_t i_hash = p_var->name->hash;
     int ret = VLC_SUCCESS;
 
     vlc_mutex_lock( &p_priv->var_lock );
 
-    pp_var = tsearch( p_var, &p_priv->var_root, varcmp );
-    if( unlikely(pp_var == NULL) )
-        ret = VLC_ENOMEM;
-    else if( (p_oldvar = *pp_var) == p_var ) /* Variable create */
-        p_var = NULL; /* Variable created */
-    else /* Variable already exists */
+    size_t i_slot = TableFind( p_table, psz_name, i_hash, VarName );
+    if( i_slot != SIZE_MAX ) /* Variable already exists */
     {
+        variable_t *p_oldvar = p_table->slots[i_slot];
+
         assert (((i_type ^ p_oldvar->i_type) & VLC_VAR_CLASS) == 0);
         p_oldvar->i_usage++;
         p_oldvar->i_type |= i_type & VLC_VAR_ISCOMMAND;
     }
+    else if( unlikely(TableReserve( p_table, VarName ) != VLC_SUCCESS) )
+        ret = VLC_ENOMEM;
+    else
+    {
+        TableInsert( p_table, p_var, i_hash );
+        p_var = NULL; /* Variable created */
+    }
     vlc_mutex_unlock( &p_priv->var_lock );
 
     /* If we did not need to create a new variable, free everything... */
@@ -388,8 +625,7 @@ int var_Create( vlc_object_t *p_this, const char *psz_name, int i_type )
 /**
  * Destroy a vlc variable
  *
- * Look for the variable and destroy it if it is found. As in var_Create we
- * do a call to memmove() but we have performance counterparts elsewhere.
+ * Look for the variable and destroy it if it is found and no longer used.
  *
  * \param p_this The object that holds the variable
  * \param psz_name The name of the variable
@@ -409,7 +645,9 @@ void (var_Destroy)(vlc_object_t *p_this, const char *psz_name)
     else if( --p_var->i_usage == 0 )
     {
         assert(!p_var->b_incallback);
-        tdelete( p_var, &p_priv->var_root, varcmp );
+        TableRemove( &p_priv->var_table,
+                     TableIndex( &p_priv->var_table, p_var,
+                                 p_var->name->hash ) );
     }
     else
     {
@@ -422,42 +660,27 @@ void (var_Destroy)(vlc_object_t *p_this, const char *psz_name)
         Destroy( p_var );
 }
 
-static void CleanupVar( void *var )
-{
-    Destroy( var );
-}
-
 void var_DestroyAll( vlc_object_t *obj )
 {
-    vlc_object_internals_t *priv = vlc_internals( obj );
+    var_table_t *t = &vlc_internals( obj )->var_table;
 
-    tdestroy( priv->var_root, CleanupVar );
-    priv->var_root = NULL;
+    for( size_t i = 0; t->slots != NULL && i <= t->mask; i++ )
+        if( TableLive( t->slots[i] ) )
+            Destroy( t->slots[i] );
+    free( t->slots );
+    *t = (var_table_t){ NULL, 0, 0, 0 };
 }
 
-#undef var_Change
-/**
- * Perform an action on a variable
- *
- * \param p_this The object that holds the variable
- * \param psz_name The name of the variable
- * \param i_action The action to perform. Must be one of \ref var_action
- * \param p_val First action parameter
- * \param p_val2 Second action parameter
- */
-int var_Change( vlc_object_t *p_this, const char *psz_name,
-                int i_action, vlc_value_t *p_val, vlc_value_t *p_val2 )
+/* Performs an action on a looked up variable, and releases the lock */
+static int VarChange( vlc_object_t *p_this, variable_t *p_var,
+                      int i_action, vlc_value_t *p_val, vlc_value_t *p_val2 )
 {
     int ret = VLC_SUCCESS;
-    variable_t *p_var;
     vlc_value_t oldval;
     vlc_value_t newval;
 
-    assert( p_this );
-
     vlc_object_internals_t *p_priv = vlc_internals( p_this );
 
-    p_var = Lookup( p_this, psz_name );
     if( p_var == NULL )
     {
         vlc_mutex_unlock( &p_priv->var_lock );
@@ -512,7 +735,8 @@ int var_Change( vlc_object_t *p_this, const char *psz_name,
                 ( p_val2 && p_val2->psz_string ) ?
                 strdup( p_val2->psz_string ) : NULL;
 
-            TriggerListCallback(p_this, p_var, psz_name, VLC_VAR_ADDCHOICE, p_val);
+            TriggerListCallback(p_this, p_var, p_var->name->psz, VLC_VAR_ADDCHOICE,
+                                p_val);
             break;
         }
         case VLC_VAR_DELCHOICE:
@@ -536,7 +760,8 @@ int var_Change( vlc_object_t *p_this, const char *psz_name,
             REMOVE_ELEM( p_var->choices_text.p_values,
                          p_var->choices_text.i_count, i );
 
-            TriggerListCallback(p_this, p_var, psz_name, VLC_VAR_DELCHOICE, p_val);
+            TriggerListCallback(p_this, p_var, p_var->name->psz, VLC_VAR_DELCHOICE,
+                                p_val);
             break;
         }
         case VLC_VAR_CHOICESCOUNT:
@@ -555,7 +780,8 @@ int var_Change( vlc_object_t *p_this, const char *psz_name,
             p_var->choices.p_values = NULL;
             p_var->choices_text.i_count = 0;
             p_var->choices_text.p_values = NULL;
-            TriggerListCallback(p_this, p_var, psz_name, VLC_VAR_CLEARCHOICES, NULL);
+            TriggerListCallback(p_this, p_var, p_var->name->psz,
+                                VLC_VAR_CLEARCHOICES, NULL);
             break;
         case VLC_VAR_SETVALUE:
             /* Duplicate data if needed */
@@ -616,6 +842,40 @@ int var_Change( vlc_object_t *p_this, const char *psz_name,
     return ret;
 }
 
+#undef var_Change
+/**
+ * Perform an action on a variable
+ *
+ * \param p_this The object that holds the variable
+ * \param psz_name The name of the variable
+ * \param i_action The action to perform. Must be one of \ref var_action
+ * \param p_val First action parameter
+ * \param p_val2 Second action parameter
+ */
+int var_Change( vlc_object_t *p_this, const char *psz_name,
+                int i_action, vlc_value_t *p_val, vlc_value_t *p_val2 )
+{
+    assert( p_this );
+
+    return VarChange( p_this, Lookup( p_this, psz_name ), i_action,
+                      p_val, p_val2 );
+}
+
+#undef var_ChangeHandle
+/**
+ * Perform an action on a variable designated by a handle
+ *
+ * \see var_Change
+ */
+int var_ChangeHandle( vlc_object_t *p_this, var_handle_t *p_handle,
+                      int i_action, vlc_value_t *p_val, vlc_value_t *p_val2 )
+{
+    assert( p_this );
+
+    return VarChange( p_this, LookupHandle( p_this, p_handle ), i_action,
+                      p_val, p_val2 );
+}
+
 #undef var_GetAndSet
 /**
  * Perform a Get and Set on a variable
@@ -716,18 +976,14 @@ int var_Type( vlc_object_t *p_this, const char *psz_name )
     return i_type;
 }
 
-#undef var_SetChecked
-int var_SetChecked( vlc_object_t *p_this, const char *psz_name,
-                    int expected_type, vlc_value_t val )
+/* Sets the value of a looked up variable, and releases the lock */
+static int VarSet( vlc_object_t *p_this, variable_t *p_var,
+                   int expected_type, vlc_value_t val )
 {
-    variable_t *p_var;
     vlc_value_t oldval;
 
-    assert( p_this );
-
     vlc_object_internals_t *p_priv = vlc_internals( p_this );
 
-    p_var = Lookup( p_this, psz_name );
     if( p_var == NULL )
     {
         vlc_mutex_unlock( &p_priv->var_lock );
@@ -753,7 +1009,7 @@ int var_SetChecked( vlc_object_t *p_this, const char *psz_name,
     p_var->val = val;
 
     /* Deal with callbacks */
-    TriggerCallback( p_this, p_var, psz_name, oldval );
+    TriggerCallback( p_this, p_var, p_var->name->psz, oldval );
 
     /* Free data if needed */
     p_var->ops->pf_free( &oldval );
@@ -762,6 +1018,29 @@ int var_SetChecked( vlc_object_t *p_this, const char *psz_name,
     return VLC_SUCCESS;
 }
 
+#undef var_SetChecked
+int var_SetChecked( vlc_object_t *p_this, const char *psz_name,
+                    int expected_type, vlc_value_t val )
+{
+    assert( p_this );
+
+    return VarSet( p_this, Lookup( p_this, psz_name ), expected_type, val );
+}
+
+#undef var_SetHandle
+/**
+ * Set the value of a variable designated by a handle
+ *
+ * \see var_Set
+ */
+int var_SetHandle( vlc_object_t *p_this, var_handle_t *p_handle,
+                   vlc_value_t val )
+{
+    assert( p_this );
+
+    return VarSet( p_this, LookupHandle( p_this, p_handle ), 0, val );
+}
+
 #undef var_Set
 /**
  * Set a variable's value
@@ -775,17 +1054,13 @@ int var_Set( vlc_object_t *p_this, const char *psz_name, vlc_value_t val )
     return var_SetChecked( p_this, psz_name, 0, val );
 }
 
-#undef var_GetChecked
-int var_GetChecked( vlc_object_t *p_this, const char *psz_name,
-                    int expected_type, vlc_value_t *p_val )
+/* Gets the value of a looked up variable, and releases the lock */
+static int VarGet( vlc_object_t *p_this, variable_t *p_var,
+                   int expected_type, vlc_value_t *p_val )
 {
-    assert( p_this );
-
     vlc_object_internals_t *p_priv = vlc_internals( p_this );
-    variable_t *p_var;
     int err = VLC_SUCCESS;
 
-    p_var = Lookup( p_this, psz_name );
     if( p_var != NULL )
     {
         assert( expected_type == 0 ||
@@ -805,6 +1080,29 @@ int var_GetChecked( vlc_object_t *p_this, const char *psz_name,
     return err;
 }
 
+#undef var_GetChecked
+int var_GetChecked( vlc_object_t *p_this, const char *psz_name,
+                    int expected_type, vlc_value_t *p_val )
+{
+    assert( p_this );
+
+    return VarGet( p_this, Lookup( p_this, psz_name ), expected_type, p_val );
+}
+
+#undef var_GetHandle
+/**
+ * Get the value of a variable designated by a handle
+ *
+ * \see var_Get
+ */
+int var_GetHandle( vlc_object_t *p_this, var_handle_t *p_handle,
+                   vlc_value_t *p_val )
+{
+    assert( p_this );
+
+    return VarGet( p_this, LookupHandle( p_this, p_handle ), 0, p_val );
+}
+
 #undef var_Get
 /**
  * Get a variable's value
@@ -1310,13 +1608,16 @@ void var_FreeList( vlc_value_t *p_val, vlc_value_t *p_val2 )
     }
 }
 
-static void DumpVariable(const void *data, const VISIT which, const int depth)
+static int DumpCmp(const void *a, const void *b)
 {
-    if (which != postorder && which != leaf)
-        return;
-    (void) depth;
+    const variable_t *va = *(const variable_t **)a;
+    const variable_t *vb = *(const variable_t **)b;
 
-    const variable_t *var = *(const variable_t **)data;
+    return strcmp(va->name->psz, vb->name->psz);
+}
+
+static void DumpVariable(const variable_t *var)
+{
     const char *typename = "unknown";
 
     switch (var->i_type & VLC_VAR_TYPE)
@@ -1331,7 +1632,7 @@ static void DumpVariable(const void *data, const VISIT which, const int depth)
         default:               typename = "unknown";     break;
     }
 
-    printf(" *-o \"%s\" (%s", var->psz_name, typename);
+    printf(" *-o \"%s\" (%s", var->name->psz, typename);
     if (var->psz_text != NULL)
         printf(", %s", var->psz_text);
     putchar(')');
@@ -1371,10 +1672,25 @@ static void DumpVariable(const void *data, const VISIT which, const int depth)
 
 void DumpVariables(vlc_object_t *obj)
 {
+    const var_table_t *t = &vlc_internals(obj)->var_table;
+
     vlc_mutex_lock(&vlc_internals(obj)->var_lock);
-    if (vlc_internals(obj)->var_root == NULL)
+    if (t->count == 0)
         puts(" `-o No variables");
     else
-        twalk(vlc_internals(obj)->var_root, DumpVariable);
+    {
+        /* Print in name order, as the hash table order is meaningless */
+        const variable_t **vars = xmalloc(t->count * sizeof (*vars));
+        size_t n = 0;
+
+        for (size_t i = 0; i <= t->mask; i++)
+            if (TableLive(t->slots[i]))
+                vars[n++] = t->slots[i];
+        assert(n == t->count);
+        qsort(vars, n, sizeof (*vars), DumpCmp);
+        for (size_t i = 0; i < n; i++)
+            DumpVariable(vars[i]);
+        free(vars);
+    }
     vlc_mutex_unlock(&vlc_internals(obj)->var_lock);
 }
@@ -30,12 +30,23 @@
  */
 typedef struct vlc_object_internals vlc_object_internals_t;
 
+/**
+ * Open-addressed hash table of the variables of an object.
+ */
+typedef struct var_table
+{
+    void          **slots;
+    size_t          mask; /* slots count minus one */
+    size_t          count; /* live entries */
+    size_t          used; /* live entries and tombstones */
+} var_table_t;
+
 struct vlc_object_internals
 {
     char           *psz_name; /* given name */
 
     /* Object variables */
-    void           *var_root;
+    var_table_t     var_table;
     vlc_mutex_t     var_lock;
     vlc_cond_t      var_wait;
 
@@ -57,4 +68,30 @@ void DumpVariables(vlc_object_t *obj);
 
 extern void var_DestroyAll( vlc_object_t * );
 
+/**
+ * Cached variable name, for the hot paths of the core.
+ *
+ * A handle must have static storage duration. The name is interned on first
+ * use, then variables are found by pointer comparison, starting from the
+ * slot where the variable was last found, rather than by string hashing and
+ * comparison.
+ */
+typedef struct var_handle
+{
+    const char       *psz_name;
+    atomic_uintptr_t  name; /* interned name, 0 until first use */
+    atomic_uint       slot; /* hint: last slot the variable was found in */
+} var_handle_t;
+
+# define VAR_HANDLE_INIT( psz ) { psz, ATOMIC_VAR_INIT(0), ATOMIC_VAR_INIT(0) }
+
+int var_ChangeHandle( vlc_object_t *, var_handle_t *, int,
+                      vlc_value_t *, vlc_value_t * );
+int var_SetHandle( vlc_object_t *, var_handle_t *, vlc_value_t );
+int var_GetHandle( vlc_object_t *, var_handle_t *, vlc_value_t * );
+#define var_ChangeHandle(a,b,c,d,e) \
+    var_ChangeHandle(VLC_OBJECT(a),b,c,d,e)
+#define var_SetHandle(a,b,c) var_SetHandle(VLC_OBJECT(a),b,c)
+#define var_GetHandle(a,b,c) var_GetHandle(VLC_OBJECT(a),b,c)
+
 #endif
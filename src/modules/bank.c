@@ -45,12 +45,29 @@
 #include "config/configuration.h"
 #include "modules/modules.h"
 
+/** Modules of a capability, sorted by decreasing score */
+typedef struct
+{
+    const char *name;
+    module_t **modules;
+    size_t count;
+    /** Shortcuts of the modules, sorted case-insensitively, then by index */
+    module_shortcut_t *shortcuts;
+    size_t shortcuts_count;
+} module_cap_t;
+
 static struct
 {
     vlc_mutex_t lock;
     module_t *head;
     unsigned usage;
-} modules = { VLC_STATIC_MUTEX, NULL, 0 };
+
+    /* Capabilities index, sorted by name */
+    module_cap_t *caps;
+    size_t caps_count;
+    module_t **sorted;
+    module_shortcut_t *shortcuts;
+} modules = { VLC_STATIC_MUTEX, NULL, 0, NULL, 0, NULL, NULL };
 
 /*****************************************************************************
  * Local prototypes
@@ -59,6 +76,8 @@ static struct
 static void AllocateAllPlugins (vlc_object_t *);
 #endif
 static module_t *module_InitStatic (vlc_plugin_cb);
+static void module_IndexBank (void);
+static void module_UnindexBank (void);
 
 static void module_StoreBank (module_t *module)
 {
@@ -111,6 +130,7 @@ void module_InitBank (void)
         if (likely(module != NULL))
             module_StoreBank (module);
         config_SortConfig ();
+        module_IndexBank ();
     }
     modules.usage++;
 
@@ -143,6 +163,7 @@ void module_EndBank (bool b_plugins)
     if (--modules.usage == 0)
     {
         config_UnsortConfig ();
+        module_UnindexBank ();
         head = modules.head;
         modules.head = NULL;
     }
@@ -185,6 +206,7 @@ size_t module_LoadPlugins (vlc_object_t *obj)
 #endif
         config_UnsortConfig ();
         config_SortConfig ();
+        module_IndexBank ();
     }
     vlc_mutex_unlock (&modules.lock);
 
@@ -247,6 +269,132 @@ static int modulecmp (const void *a, const void *b)
     return (*mb)->i_score - (*ma)->i_score;
 }
 
+static int modulecapcmp (const void *a, const void *b)
+{
+    const module_t *const *ma = a, *const *mb = b;
+    int ret = strcmp (module_get_capability (*ma),
+                      module_get_capability (*mb));
+
+    return ret ? ret : modulecmp (a, b);
+}
+
+static int shortcutcmp (const void *a, const void *b)
+{
+    const module_shortcut_t *sa = a, *sb = b;
+    int ret = strcasecmp (sa->name, sb->name);
+
+    if (ret == 0)
+        ret = (sa->index > sb->index) - (sa->index < sb->index);
+    return ret;
+}
+
+static void module_UnindexBank (void)
+{
+    free (modules.shortcuts);
+    free (modules.sorted);
+    free (modules.caps);
+    modules.shortcuts = NULL;
+    modules.sorted = NULL;
+    modules.caps = NULL;
+    modules.caps_count = 0;
+}
+
+/**
+ * Indexes the modules by capability.
+ *
+ * The bank is read-only once the plug-ins are loaded, so that the modules of
+ * a capability are sorted by score, and their shortcuts by name, once and for
+ * all rather than on every module lookup.
+ */
+static void module_IndexBank (void)
+{
+    /*vlc_assert_locked (&modules.lock); not for static mutexes :( */
+    size_t n = 0, ncaps = 0, nshortcuts = 0;
+
+    module_UnindexBank ();
+
+    for (module_t *mod = modules.head; mod != NULL; mod = mod->next)
+        n += 1 + mod->submodule_count;
+    if (n == 0)
+        return;
+
+    module_t **tab = xmalloc (n * sizeof (*tab));
+    size_t i = 0;
+
+    for (module_t *mod = modules.head; mod != NULL; mod = mod->next)
+    {
+        tab[i++] = mod;
+        for (module_t *subm = mod->submodule; subm != NULL; subm = subm->next)
+            tab[i++] = subm;
+    }
+    assert (i == n);
+    qsort (tab, n, sizeof (*tab), modulecapcmp);
+
+    for (i = 0; i < n; i++)
+    {
+        if (i == 0 || strcmp (module_get_capability (tab[i]),
+                              module_get_capability (tab[i - 1])))
+            ncaps++;
+        nshortcuts += tab[i]->i_shortcuts;
+    }
+
+    module_cap_t *caps = xmalloc (ncaps * sizeof (*caps));
+    module_shortcut_t *shortcuts = (nshortcuts > 0)
+        ? xmalloc (nshortcuts * sizeof (*shortcuts)) : NULL;
+    module_cap_t *cap = NULL;
+    module_shortcut_t *sc = shortcuts;
+
+    for (i = 0; i < n; i++)
+    {
+        const char *name = module_get_capability (tab[i]);
+
+        if (cap == NULL || strcmp (name, cap->name))
+        {
+            if (cap != NULL)
+                qsort (cap->shortcuts, cap->shortcuts_count,
+                       sizeof (*sc), shortcutcmp);
+            cap = (cap != NULL) ? cap + 1 : caps;
+            cap->name = name;
+            cap->modules = tab + i;
+            cap->count = 0;
+            cap->shortcuts = sc;
+            cap->shortcuts_count = 0;
+        }
+
+        for (unsigned j = 0; j < tab[i]->i_shortcuts; j++)
+        {
+            sc->name = tab[i]->pp_shortcuts[j];
+            sc->index = cap->count;
+            sc++;
+        }
+        cap->shortcuts_count += tab[i]->i_shortcuts;
+        cap->count++;
+    }
+    if (cap != NULL)
+        qsort (cap->shortcuts, cap->shortcuts_count, sizeof (*sc),
+               shortcutcmp);
+    assert (cap == NULL || cap == caps + ncaps - 1);
+    assert (sc == shortcuts + nshortcuts);
+
+    modules.caps = caps;
+    modules.caps_count = ncaps;
+    modules.sorted = tab;
+    modules.shortcuts = shortcuts;
+}
+
+static int capcmp (const void *key, const void *elem)
+{
+    const module_cap_t *cap = elem;
+
+    return strcmp (key, cap->name);
+}
+
+static const module_cap_t *module_FindCap (const char *name)
+{
+    return bsearch (name, modules.caps, modules.caps_count,
+                    sizeof (*modules.caps), capcmp);
+}
+
 /**
  * Builds a sorted list of all VLC modules with a given capability.
  * The list is sorted from the highest module score to the lowest.
@@ -257,37 +405,59 @@ static int modulecmp (const void *a, const void *b)
  */
 ssize_t module_list_cap (module_t ***restrict list, const char *cap)
 {
-    /* TODO: This is quite inefficient. List should be sorted by capability. */
-    ssize_t n = 0;
+    const module_cap_t *c = module_FindCap (cap);
+    size_t n = (c != NULL) ? c->count : 0;
 
     assert (list != NULL);
 
-    for (module_t *mod = modules.head; mod != NULL; mod = mod->next)
-    {
-         if (module_provides (mod, cap))
-             n++;
-         for (module_t *subm = mod->submodule; subm != NULL; subm = subm->next)
-             if (module_provides (subm, cap))
-                 n++;
-    }
-
     module_t **tab = malloc (sizeof (*tab) * n);
     *list = tab;
-    if (unlikely(tab == NULL))
+    if (unlikely(tab == NULL) && n > 0)
         return -1;
 
-    for (module_t *mod = modules.head; mod != NULL; mod = mod->next)
+    if (n > 0)
+        memcpy (tab, c->modules, sizeof (*tab) * n);
+    return n;
+}
+
+/**
+ * Finds the modules with a given capability and shortcut.
+ * @param tab pointer to the matching shortcuts [OUT]; their index is the
+ *            position of the module in the module_list_cap() list, in
+ *            increasing order, i.e. from the highest module score
+ * @param cap capability of modules to look for
+ * @param name shortcut to look for (case insensitive)
+ * @return the number of matching shortcuts
+ */
+size_t module_list_cap_shortcut (const module_shortcut_t **restrict tab,
+                                 const char *cap, const char *name)
+{
+    const module_cap_t *c = module_FindCap (cap);
+    size_t low = 0, high;
+
+    *tab = NULL;
+    if (c == NULL)
+        return 0;
+
+    /* Lower bound */
+    high = c->shortcuts_count;
+    while (low < high)
     {
-         if (module_provides (mod, cap))
-             *(tab++)= mod;
-         for (module_t *subm = mod->submodule; subm != NULL; subm = subm->next)
-             if (module_provides (subm, cap))
-                 *(tab++) = subm;
+        size_t mid = low + (high - low) / 2;
+
+        if (strcasecmp (c->shortcuts[mid].name, name) < 0)
+            low = mid + 1;
+        else
+            high = mid;
     }
 
-    assert (tab == *list + n);
-    qsort (*list, n, sizeof (*tab), modulecmp);
-    return n;
+    size_t end = low;
+    while (end < c->shortcuts_count
+        && !strcasecmp (c->shortcuts[end].name, name))
+        end++;
+
+    *tab = c->shortcuts + low;
+    return end - low;
 }
 
 #ifdef HAVE_DYNAMIC_PLUGINS
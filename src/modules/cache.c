@@ -34,7 +34,11 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <unistd.h>
+#include <fcntl.h>
 #include <assert.h>
+#ifdef HAVE_MMAP
+# include <sys/mman.h>
+#endif
 
 #include <vlc_common.h>
 #include "libvlc.h"
@@ -45,23 +49,92 @@
 #include "config/configuration.h"
 
 #include <vlc_fs.h>
+#include <vlc_atomic.h>
 
 #include "modules/modules.h"
 
-
 /*****************************************************************************
  * Local prototypes
  *****************************************************************************/
 #ifdef HAVE_DYNAMIC_PLUGINS
 /* Sub-version number
  * (only used to avoid breakage in dev version when cache structure changes) */
-#define CACHE_SUBVERSION_NUM 23
+#define CACHE_SUBVERSION_NUM 24
 
 /* Cache filename */
 #define CACHE_NAME "plugins.dat"
 /* Magic for the cache filename */
 #define CACHE_STRING "cache "PACKAGE_NAME" "PACKAGE_VERSION
+#ifdef DISTRO_VERSION
+/* Allow binary maintaner to pass a string to detect new binary version */
+# define CACHE_PREFIX CACHE_STRING DISTRO_VERSION
+#else
+# define CACHE_PREFIX CACHE_STRING
+#endif
 
+/*
+ * The cache file is an image of the module descriptors, which is mapped in
+ * memory and used in place: strings, shortcuts and configuration tables point
+ * into the mapping, so that loading does not allocate nor copy them.
+ *
+ * The file starts with CACHE_PREFIX and the native 32-bits sub-version number,
+ * followed by the header at CACHE_HEADER_OFFSET. Every reference is an offset
+ * from the start of the file (0 meaning NULL), so the image is position
+ * independent. Tables of pointers (shortcuts, choices lists and configuration
+ * items) are stored as native structures whose pointer fields hold offsets,
+ * and are relocated in place when loaded; the file is mapped copy-on-write.
+ * The layout is native, hence the header checks the ABI it was written with.
+ */
+#define CACHE_ALIGN 16
+#define CACHE_HEADER_OFFSET \
+    ((sizeof (CACHE_PREFIX) - 1 + 4 + CACHE_ALIGN - 1) & ~(CACHE_ALIGN - 1))
+
+typedef struct
+{
+    uint32_t pointer_size;   /**< sizeof (void *) */
+    uint32_t config_size;    /**< sizeof (module_config_t) */
+    uint64_t size;           /**< Total file size */
+    uint64_t entries;        /**< Offset of the cache_file_entry_t table */
+    uint64_t count;          /**< Number of entries */
+} cache_file_header_t;
+
+typedef struct
+{
+    uint64_t path;           /**< Plug-in path relative to the directory */
+    int64_t  mtime;
+    int64_t  size;
+    uint64_t module;         /**< Offset of the cache_file_module_t */
+} cache_file_entry_t;
+
+typedef struct
+{
+    uint64_t shortname;
+    uint64_t longname;
+    uint64_t help;
+    uint64_t capability;
+    uint64_t domain;
+    uint64_t shortcuts;      /**< Offset of the shortcuts strings table */
+    uint64_t config;         /**< Offset of the module_config_t table */
+    uint64_t submodules;     /**< Offset of the cache_file_module_t table */
+    int32_t  score;
+    uint32_t shortcuts_count;
+    uint32_t config_count;
+    uint32_t config_items;
+    uint32_t bool_items;
+    uint32_t submodules_count;
+    uint8_t  unloadable;
+} cache_file_module_t;
+
+/** Mapped cache file, shared by the modules loaded from it */
+struct cache_map_t
+{
+    unsigned char *base;
+    size_t size;
+    atomic_uint refs;
+    bool mapped;
+};
+
+#define CacheOffset(off) ((void *)(uintptr_t)(off))
 
 void CacheDelete( vlc_object_t *obj, const char *dir )
 {
@@ -76,207 +149,290 @@ void CacheDelete( vlc_object_t *obj, const char *dir )
     free( path );
 }
 
-#define LOAD_IMMEDIATE(a) \
-    if (fread (&(a), sizeof (char), sizeof (a), file) != sizeof (a)) \
-        goto error
-#define LOAD_FLAG(a) \
-    do { \
-        unsigned char b; \
-        LOAD_IMMEDIATE(b); \
-        if (b > 1) \
-            goto error; \
-        (a) = b; \
-    } while (0)
-
-static int CacheLoadString (char **p, FILE *file)
+static cache_map_t *CacheMap (vlc_object_t *obj, const char *path)
 {
-    char *psz = NULL;
-    uint16_t size;
+    int fd = vlc_open (path, O_RDONLY);
+    if (fd == -1)
+    {
+        msg_Warn (obj, "cannot read %s: %s", path, vlc_strerror_c(errno));
+        return NULL;
+    }
 
-    LOAD_IMMEDIATE (size);
-    if (size > 16384)
+    cache_map_t *map = malloc (sizeof (*map));
+    struct stat st;
+
+    if (unlikely(map == NULL) || fstat (fd, &st))
+        goto error;
+    if (st.st_size < (off_t)(CACHE_HEADER_OFFSET + sizeof (cache_file_header_t))
+     || (uintmax_t)st.st_size > SIZE_MAX)
     {
-error:
-        return -1;
+        msg_Warn (obj, "This doesn't look like a valid plugins cache");
+        goto error;
     }
 
-    if (size > 0)
+    map->size = st.st_size;
+    atomic_init (&map->refs, 1);
+    map->mapped = false;
+#ifdef HAVE_MMAP
+    /* Private writable mapping: only the relocated pages are copied */
+    map->base = mmap (NULL, map->size, PROT_READ|PROT_WRITE, MAP_PRIVATE,
+                      fd, 0);
+    if (map->base != MAP_FAILED)
+        map->mapped = true;
+    else
+#endif
     {
-        psz = malloc (size+1);
-        if (unlikely(psz == NULL))
+        map->base = malloc (map->size);
+        if (unlikely(map->base == NULL))
             goto error;
-        if (fread (psz, 1, size, file) != size)
+
+        for (size_t done = 0; done < map->size;)
         {
-            free (psz);
-            goto error;
+            ssize_t val = read (fd, map->base + done, map->size - done);
+            if (val <= 0)
+            {
+                if (val < 0 && errno == EINTR)
+                    continue;
+                msg_Err (obj, "plugins cache read error: %s",
+                         vlc_strerror_c(errno));
+                free (map->base);
+                goto error;
+            }
+            done += val;
         }
-        psz[size] = '\0';
     }
-    *p = psz;
-    return 0;
+    vlc_close (fd);
+    return map;
+
+error:
+    free (map);
+    vlc_close (fd);
+    return NULL;
 }
 
-#define LOAD_STRING(a) \
-    if (CacheLoadString (&(a), file)) goto error
+static cache_map_t *CacheHold (cache_map_t *map)
+{
+    atomic_fetch_add (&map->refs, 1);
+    return map;
+}
 
-static int CacheLoadConfig (module_config_t *cfg, FILE *file)
+/**
+ * Releases a reference to a plugins cache mapping.
+ *
+ * Each module loaded from the cache holds one, as its descriptor strings and
+ * tables live in the mapping.
+ */
+void CacheRelease (cache_map_t *map)
 {
-    LOAD_IMMEDIATE (cfg->i_type);
-    LOAD_IMMEDIATE (cfg->i_short);
-    LOAD_FLAG (cfg->b_advanced);
-    LOAD_FLAG (cfg->b_internal);
-    LOAD_FLAG (cfg->b_unsaveable);
-    LOAD_FLAG (cfg->b_safe);
-    LOAD_FLAG (cfg->b_removed);
-    LOAD_STRING (cfg->psz_type);
-    LOAD_STRING (cfg->psz_name);
-    LOAD_STRING (cfg->psz_text);
-    LOAD_STRING (cfg->psz_longtext);
-    LOAD_IMMEDIATE (cfg->list_count);
-
-    if (IsConfigStringType (cfg->i_type))
-    {
-        LOAD_STRING (cfg->orig.psz);
-        if (cfg->orig.psz != NULL)
-            cfg->value.psz = strdup (cfg->orig.psz);
-        else
-            cfg->value.psz = NULL;
+    if (atomic_fetch_sub (&map->refs, 1) != 1)
+        return;
 
-        if (cfg->list_count)
-            cfg->list.psz = xmalloc (cfg->list_count * sizeof (char *));
-        else /* TODO: fix config_GetPszChoices() instead of this hack: */
-            LOAD_IMMEDIATE(cfg->list.psz_cb);
-        for (unsigned i = 0; i < cfg->list_count; i++)
-        {
-            LOAD_STRING (cfg->list.psz[i]);
-            if (cfg->list.psz[i] == NULL /* NULL -> empty string */
-             && (cfg->list.psz[i] = calloc (1, 1)) == NULL)
-                goto error;
-        }
-    }
+#ifdef HAVE_MMAP
+    if (map->mapped)
+        munmap (map->base, map->size);
     else
+#endif
+        free (map->base);
+    free (map);
+}
+
+/* Checks that a table lies within the mapping, returns NULL if not or
+ * if it is empty */
+static void *CacheGetTable (const cache_map_t *map, uint64_t offset,
+                            size_t count, size_t size)
+{
+    if (count == 0 || (offset % CACHE_ALIGN) != 0 || offset >= map->size
+     || count > (map->size - offset) / size)
+        return NULL;
+    return map->base + offset;
+}
+
+static int CacheGetString (const cache_map_t *map, uint64_t offset,
+                           char **restrict strp)
+{
+    if (offset == 0)
     {
-        LOAD_IMMEDIATE (cfg->orig);
-        LOAD_IMMEDIATE (cfg->min);
-        LOAD_IMMEDIATE (cfg->max);
-        cfg->value = cfg->orig;
-
-        if (cfg->list_count)
-            cfg->list.i = xmalloc (cfg->list_count * sizeof (int));
-        else /* TODO: fix config_GetPszChoices() instead of this hack: */
-            LOAD_IMMEDIATE(cfg->list.i_cb);
-        for (unsigned i = 0; i < cfg->list_count; i++)
-             LOAD_IMMEDIATE (cfg->list.i[i]);
-    }
-    cfg->list_text = xmalloc (cfg->list_count * sizeof (char *));
-    for (unsigned i = 0; i < cfg->list_count; i++)
-    {
-        LOAD_STRING (cfg->list_text[i]);
-        if (cfg->list_text[i] == NULL /* NULL -> empty string */
-         && (cfg->list_text[i] = calloc (1, 1)) == NULL)
-            goto error;
+        *strp = NULL;
+        return 0;
     }
-
+    if (offset >= map->size
+     || memchr (map->base + offset, '\0', map->size - offset) == NULL)
+        return -1;
+    *strp = (char *)map->base + offset;
     return 0;
-error:
-    return -1; /* FIXME: leaks */
 }
 
-static int CacheLoadModuleConfig (module_t *module, FILE *file)
+/* Relocates a string pointer of a table in place */
+static int CacheRelocString (const cache_map_t *map, char **strp)
+{
+    return CacheGetString (map, (uintptr_t)*strp, strp);
+}
+
+/* Relocates a table of non-NULL strings in place */
+static char **CacheRelocStrings (const cache_map_t *map, void *table,
+                                 size_t count)
+{
+    char **tab = CacheGetTable (map, (uintptr_t)table, count, sizeof (*tab));
+    if (tab == NULL)
+        return NULL;
+
+    for (size_t i = 0; i < count; i++)
+        if (tab[i] == NULL || CacheRelocString (map, &tab[i]))
+            return NULL;
+    return tab;
+}
+
+static int CacheLoadConfig (const cache_map_t *map, module_t *module,
+                            const cache_file_module_t *rec)
 {
-    uint16_t lines;
+    const size_t count = rec->config_count;
+    module_config_t *tab = CacheGetTable (map, rec->config, count,
+                                          sizeof (*tab));
+    size_t i;
 
-    /* Calculate the structure length */
-    LOAD_IMMEDIATE (module->i_config_items);
-    LOAD_IMMEDIATE (module->i_bool_items);
-    LOAD_IMMEDIATE (lines);
+    if (tab == NULL && count > 0)
+        return -1;
 
-    /* Allocate memory */
-    if (lines)
+    for (i = 0; i < count; i++)
     {
-        module->p_config = malloc (lines * sizeof (module_config_t));
-        if (unlikely(module->p_config == NULL))
+        module_config_t *cfg = tab + i;
+
+        if (CacheRelocString (map, &cfg->psz_type)
+         || CacheRelocString (map, &cfg->psz_name)
+         || CacheRelocString (map, &cfg->psz_text)
+         || CacheRelocString (map, &cfg->psz_longtext))
+            goto error;
+
+        /* If list_count is zero, the list holds the callback pointer
+         * (see AllocatePluginFile()) */
+        if (IsConfigStringType (cfg->i_type))
         {
-            module->confsize = 0;
-            return -1;
+            if (CacheRelocString (map, &cfg->orig.psz))
+                goto error;
+            if (cfg->list_count > 0)
+            {
+                cfg->list.psz = CacheRelocStrings (map, cfg->list.psz,
+                                                   cfg->list_count);
+                if (cfg->list.psz == NULL)
+                    goto error;
+            }
+        }
+        else if (cfg->list_count > 0)
+        {
+            cfg->list.i = CacheGetTable (map, (uintptr_t)cfg->list.i,
+                                         cfg->list_count, sizeof (int));
+            if (cfg->list.i == NULL)
+                goto error;
+        }
+
+        if (cfg->list_count > 0)
+        {
+            cfg->list_text = CacheRelocStrings (map, cfg->list_text,
+                                                cfg->list_count);
+            if (cfg->list_text == NULL)
+                goto error;
+        }
+        else
+            cfg->list_text = NULL;
+
+        /* The current value is the only string that is freed and
+         * replaced at run-time (see config_PutPsz()) */
+        if (IsConfigStringType (cfg->i_type))
+        {
+            cfg->value.psz = NULL;
+            if (cfg->orig.psz != NULL
+             && (cfg->value.psz = strdup (cfg->orig.psz)) == NULL)
+                goto error;
         }
+        else
+            cfg->value = cfg->orig;
     }
-    else
-        module->p_config = NULL;
-    module->confsize = lines;
 
-    /* Do the duplication job */
-    for (size_t i = 0; i < lines; i++)
-        if (CacheLoadConfig (module->p_config + i, file))
-            return -1;
+    module->p_config = tab;
+    module->confsize = count;
+    module->i_config_items = rec->config_items;
+    module->i_bool_items = rec->bool_items;
     return 0;
+
 error:
-    return -1; /* FIXME: leaks */
+    while (i > 0)
+        if (IsConfigStringType (tab[--i].i_type))
+            free (tab[i].value.psz);
+    return -1;
 }
 
-static module_t *CacheLoadModule (FILE *file)
+static int CacheLoadModule (const cache_map_t *map, module_t *module,
+                            const cache_file_module_t *rec)
 {
-    module_t *module = vlc_module_create (NULL);
-    if (unlikely(module == NULL))
-        return NULL;
-
-    /* Load additional infos */
-    LOAD_STRING(module->psz_shortname);
-    LOAD_STRING(module->psz_longname);
-    LOAD_STRING(module->psz_help);
+    if (CacheGetString (map, rec->shortname, &module->psz_shortname)
+     || CacheGetString (map, rec->longname, &module->psz_longname)
+     || CacheGetString (map, rec->help, &module->psz_help)
+     || CacheGetString (map, rec->capability, &module->psz_capability)
+     || CacheGetString (map, rec->domain, &module->domain))
+        return -1;
 
-    LOAD_IMMEDIATE(module->i_shortcuts);
-    if (module->i_shortcuts > MODULE_SHORTCUT_MAX)
-        goto error;
-    else
+    if (rec->shortcuts_count > MODULE_SHORTCUT_MAX)
+        return -1;
+    if (rec->shortcuts_count > 0)
     {
-        module->pp_shortcuts =
-            xmalloc (sizeof (*module->pp_shortcuts) * module->i_shortcuts);
-        for (unsigned j = 0; j < module->i_shortcuts; j++)
-            LOAD_STRING(module->pp_shortcuts[j]);
+        module->pp_shortcuts = CacheRelocStrings (map,
+                                                  CacheOffset(rec->shortcuts),
+                                                  rec->shortcuts_count);
+        if (module->pp_shortcuts == NULL)
+            return -1;
     }
+    module->i_shortcuts = rec->shortcuts_count;
 
-    LOAD_STRING(module->psz_capability);
-    LOAD_IMMEDIATE(module->i_score);
-    LOAD_IMMEDIATE(module->b_unloadable);
+    module->i_score = rec->score;
+    module->b_unloadable = rec->unloadable != 0;
 
-    /* Config stuff */
-    if (CacheLoadModuleConfig (module, file) != VLC_SUCCESS)
-        goto error;
+    if (CacheLoadConfig (map, module, rec))
+        return -1;
 
-    LOAD_STRING(module->domain);
     if (module->domain != NULL)
         vlc_bindtextdomain (module->domain);
+    return 0;
+}
 
-    uint32_t submodules;
-    LOAD_IMMEDIATE(submodules);
+static module_t *CacheNewModule (cache_map_t *map, module_t *parent)
+{
+    module_t *module = vlc_module_create (parent);
+    if (likely(module != NULL))
+        module->cache = CacheHold (map);
+    return module;
+}
 
-    for (; submodules > 0; submodules--)
-    {
-        module_t *submodule = vlc_module_create (module);
+static module_t *CacheLoadPlugin (cache_map_t *map, uint64_t offset)
+{
+    const cache_file_module_t *rec = CacheGetTable (map, offset, 1,
+                                                    sizeof (*rec));
+    if (rec == NULL)
+        return NULL;
 
-        free (submodule->pp_shortcuts);
-        LOAD_STRING(submodule->psz_shortname);
-        LOAD_STRING(submodule->psz_longname);
+    module_t *module = CacheNewModule (map, NULL);
+    if (unlikely(module == NULL))
+        return NULL;
+    if (CacheLoadModule (map, module, rec))
+        goto error;
 
-        LOAD_IMMEDIATE(submodule->i_shortcuts);
-        if (submodule->i_shortcuts > MODULE_SHORTCUT_MAX)
-            goto error;
-        else
-        {
-            submodule->pp_shortcuts =
-                xmalloc (sizeof (*submodule->pp_shortcuts) * submodule->i_shortcuts);
-            for (unsigned j = 0; j < submodule->i_shortcuts; j++)
-                LOAD_STRING(submodule->pp_shortcuts[j]);
-        }
+    const size_t count = rec->submodules_count;
+    const cache_file_module_t *subs = CacheGetTable (map, rec->submodules,
+                                                     count, sizeof (*subs));
+    if (subs == NULL && count > 0)
+        goto error;
 
-        LOAD_STRING(submodule->psz_capability);
-        LOAD_IMMEDIATE(submodule->i_score);
+    /* Submodules are prepended to the list: load them backward */
+    for (size_t i = count; i > 0; i--)
+    {
+        module_t *submodule = CacheNewModule (map, module);
+        if (unlikely(submodule == NULL)
+         || CacheLoadModule (map, submodule, &subs[i - 1]))
+            goto error;
     }
-
     return module;
+
 error:
-    vlc_module_destroy(module);
+    vlc_module_destroy (module);
     return NULL;
 }
 
@@ -291,10 +447,6 @@ error:
 size_t CacheLoad( vlc_object_t *p_this, const char *dir, module_cache_t **r )
 {
     char *psz_filename;
-    FILE *file;
-    int i_size, i_read;
-    char p_cachestring[sizeof(CACHE_STRING)];
-    int32_t i_marker;
 
     assert( dir != NULL );
 
@@ -304,189 +456,247 @@ size_t CacheLoad( vlc_object_t *p_this, const char *dir, module_cache_t **r )
 
     msg_Dbg( p_this, "loading plugins cache file %s", psz_filename );
 
-    file = vlc_fopen( psz_filename, "rb" );
-    if( !file )
-    {
-        msg_Warn( p_this, "cannot read %s: %s", psz_filename,
-                  vlc_strerror_c(errno) );
-        free( psz_filename );
-        return 0;
-    }
+    cache_map_t *map = CacheMap( p_this, psz_filename );
     free( psz_filename );
-
-    /* Check the file is a plugins cache */
-    i_size = sizeof(CACHE_STRING) - 1;
-    i_read = fread( p_cachestring, 1, i_size, file );
-    if( i_read != i_size ||
-        memcmp( p_cachestring, CACHE_STRING, i_size ) )
-    {
-        msg_Warn( p_this, "This doesn't look like a valid plugins cache" );
-        fclose( file );
+    if( map == NULL )
         return 0;
-    }
 
-#ifdef DISTRO_VERSION
-    /* Check for distribution specific version */
-    char p_distrostring[sizeof( DISTRO_VERSION )];
-    i_size = sizeof( DISTRO_VERSION ) - 1;
-    i_read = fread( p_distrostring, 1, i_size, file );
-    if( i_read != i_size ||
-        memcmp( p_distrostring, DISTRO_VERSION, i_size ) )
+    /* Check the file is a plugins cache */
+    if( memcmp( map->base, CACHE_PREFIX, sizeof(CACHE_PREFIX) - 1 ) )
     {
         msg_Warn( p_this, "This doesn't look like a valid plugins cache" );
-        fclose( file );
-        return 0;
-    }
-#endif
-
-    /* Check sub-version number */
-    i_read = fread( &i_marker, 1, sizeof(i_marker), file );
-    if( i_read != sizeof(i_marker) || i_marker != CACHE_SUBVERSION_NUM )
-    {
-        msg_Warn( p_this, "This doesn't look like a valid plugins cache "
-                  "(corrupted header)" );
-        fclose( file );
+        CacheRelease( map );
         return 0;
     }
 
-    /* Check header marker */
-    i_read = fread( &i_marker, 1, sizeof(i_marker), file );
-    if( i_read != sizeof(i_marker) ||
-        i_marker != ftell( file ) - (int)sizeof(i_marker) )
+    /* Check sub-version number and header */
+    uint32_t i_marker;
+    const cache_file_header_t *hdr =
+        (const void *)(map->base + CACHE_HEADER_OFFSET);
+
+    memcpy( &i_marker, map->base + sizeof(CACHE_PREFIX) - 1,
+            sizeof(i_marker) );
+    if( i_marker != CACHE_SUBVERSION_NUM
+     || hdr->pointer_size != sizeof(void *)
+     || hdr->config_size != sizeof(module_config_t)
+     || hdr->size != map->size )
     {
         msg_Warn( p_this, "This doesn't look like a valid plugins cache "
                   "(corrupted header)" );
-        fclose( file );
+        CacheRelease( map );
         return 0;
     }
 
     module_cache_t *cache = NULL;
     size_t count = 0;
-    char *path = NULL;
+    const cache_file_entry_t *entries =
+        CacheGetTable( map, hdr->entries, hdr->count, sizeof(*entries) );
+    if( entries == NULL && hdr->count > 0 )
+        goto error;
 
-    for (;;)
+    for( size_t i = 0; i < hdr->count; i++ )
     {
-        module_t *module = CacheLoadModule (file);
-        if (module == NULL)
-        {
-            if (feof (file))
-                break;
-            goto error;
-        }
-
+        const cache_file_entry_t *entry = entries + i;
         struct stat st;
+        char *path;
+
+        if( CacheGetString( map, entry->path, &path ) || path == NULL )
+            goto error;
 
-        /* Load common info */
-        LOAD_STRING(path);
-        if (path == NULL)
+        module_t *module = CacheLoadPlugin( map, entry->module );
+        if( module == NULL )
             goto error;
-        LOAD_IMMEDIATE(st.st_mtime);
-        LOAD_IMMEDIATE(st.st_size);
 
-        CacheAdd (&cache, &count, path, &st, module);
-        free (path);
-        path = NULL;
-        /* TODO: deal with errors */
+        st.st_mtime = entry->mtime;
+        st.st_size = entry->size;
+        if( CacheAdd( &cache, &count, path, &st, module ) )
+        {
+            vlc_module_destroy( module );
+            goto error;
+        }
     }
 
-    fclose( file );
+    /* The loaded modules keep the mapping */
+    CacheRelease( map );
 
     *r = cache;
     return count;
 
 error:
-    free( path );
-    if (ferror (file))
-        msg_Err(p_this, "plugins cache read error: %s", vlc_strerror_c(errno));
     msg_Warn( p_this, "plugins cache not loaded (corrupted)" );
 
-    /* TODO: cleanup */
-    fclose( file );
+    for( size_t i = 0; i < count; i++ )
+    {
+        vlc_module_destroy( cache[i].p_module );
+        free( cache[i].path );
+    }
+    free( cache );
+    CacheRelease( map );
     return 0;
 }
 
-#define SAVE_IMMEDIATE( a ) \
-    if (fwrite (&(a), sizeof(a), 1, file) != 1) \
-        goto error
-#define SAVE_FLAG(a) \
-    do { \
-        char b = (a); \
-        SAVE_IMMEDIATE(b); \
-    } while (0)
-
-static int CacheSaveString (FILE *file, const char *str)
+/** Cache file image being built */
+typedef struct
 {
-    uint16_t size = (str != NULL) ? strlen (str) : 0;
+    unsigned char *data;
+    size_t size;
+    size_t alloc;
+    bool error;
+} cache_image_t;
+
+/* Appends data to the image, returns its offset (0 on error) */
+static uint64_t CacheAppend (cache_image_t *img, const void *data,
+                             size_t len, size_t align)
+{
+    size_t offset = (img->size + align - 1) & ~(align - 1);
 
-    SAVE_IMMEDIATE (size);
-    if (size != 0 && fwrite (str, 1, size, file) != size)
+    if (img->error)
+        return 0;
+    if (offset + len > img->alloc)
     {
-error:
-        return -1;
+        size_t alloc = img->alloc ? img->alloc : 65536;
+        while (offset + len > alloc)
+            alloc *= 2;
+
+        unsigned char *buf = realloc (img->data, alloc);
+        if (unlikely(buf == NULL))
+        {
+            img->error = true;
+            return 0;
+        }
+        img->data = buf;
+        img->alloc = alloc;
     }
-    return 0;
+
+    memset (img->data + img->size, 0, offset - img->size);
+    if (len > 0)
+        memcpy (img->data + offset, data, len);
+    img->size = offset + len;
+    return offset;
 }
 
-#define SAVE_STRING( a ) \
-    if (CacheSaveString (file, (a))) \
-        goto error
+static uint64_t CacheSaveString (cache_image_t *img, const char *str)
+{
+    if (str == NULL)
+        return 0;
+    return CacheAppend (img, str, strlen (str) + 1, 1);
+}
 
-static int CacheSaveConfig (FILE *file, const module_config_t *cfg)
+/* Saves a table of strings, NULL ones are saved as empty strings */
+static uint64_t CacheSaveStrings (cache_image_t *img, char *const *strv,
+                                  size_t count)
 {
-    SAVE_IMMEDIATE (cfg->i_type);
-    SAVE_IMMEDIATE (cfg->i_short);
-    SAVE_FLAG (cfg->b_advanced);
-    SAVE_FLAG (cfg->b_internal);
-    SAVE_FLAG (cfg->b_unsaveable);
-    SAVE_FLAG (cfg->b_safe);
-    SAVE_FLAG (cfg->b_removed);
-    SAVE_STRING (cfg->psz_type);
-    SAVE_STRING (cfg->psz_name);
-    SAVE_STRING (cfg->psz_text);
-    SAVE_STRING (cfg->psz_longtext);
-    SAVE_IMMEDIATE (cfg->list_count);
-
-    if (IsConfigStringType (cfg->i_type))
+    if (count == 0)
+        return 0;
+
+    char **tab = malloc (count * sizeof (*tab));
+    if (unlikely(tab == NULL))
     {
-        SAVE_STRING (cfg->orig.psz);
-        if (cfg->list_count == 0)
-            SAVE_IMMEDIATE (cfg->list.psz_cb); /* XXX: see CacheLoadConfig() */
-        for (unsigned i = 0; i < cfg->list_count; i++)
-            SAVE_STRING (cfg->list.psz[i]);
+        img->error = true;
+        return 0;
     }
-    else
+
+    for (size_t i = 0; i < count; i++)
+        tab[i] = CacheOffset(CacheSaveString (img, strv[i] ? strv[i] : ""));
+
+    uint64_t offset = CacheAppend (img, tab, count * sizeof (*tab),
+                                   CACHE_ALIGN);
+    free (tab);
+    return offset;
+}
+
+static uint64_t CacheSaveConfig (cache_image_t *img,
+                                 const module_config_t *config, size_t count)
+{
+    if (count == 0)
+        return 0;
+
+    module_config_t *tab = malloc (count * sizeof (*tab));
+    if (unlikely(tab == NULL))
     {
-        SAVE_IMMEDIATE (cfg->orig);
-        SAVE_IMMEDIATE (cfg->min);
-        SAVE_IMMEDIATE (cfg->max);
-        if (cfg->list_count == 0)
-            SAVE_IMMEDIATE (cfg->list.i_cb); /* XXX: see CacheLoadConfig() */
-        for (unsigned i = 0; i < cfg->list_count; i++)
-             SAVE_IMMEDIATE (cfg->list.i[i]);
+        img->error = true;
+        return 0;
     }
-    for (unsigned i = 0; i < cfg->list_count; i++)
-        SAVE_STRING (cfg->list_text[i]);
+    memcpy (tab, config, count * sizeof (*tab));
 
-    return 0;
-error:
-    return -1;
+    for (size_t i = 0; i < count; i++)
+    {
+        const module_config_t *src = config + i;
+        module_config_t *cfg = tab + i;
+
+        cfg->psz_type = CacheOffset(CacheSaveString (img, src->psz_type));
+        cfg->psz_name = CacheOffset(CacheSaveString (img, src->psz_name));
+        cfg->psz_text = CacheOffset(CacheSaveString (img, src->psz_text));
+        cfg->psz_longtext =
+            CacheOffset(CacheSaveString (img, src->psz_longtext));
+
+        /* XXX: if list_count is zero, the callback is saved as is */
+        if (IsConfigStringType (src->i_type))
+        {
+            cfg->value.psz = NULL;
+            cfg->orig.psz = CacheOffset(CacheSaveString (img, src->orig.psz));
+            if (src->list_count > 0)
+                cfg->list.psz = CacheOffset(CacheSaveStrings (img,
+                                              src->list.psz, src->list_count));
+        }
+        else
+        {
+            cfg->value = src->orig;
+            if (src->list_count > 0)
+                cfg->list.i = CacheOffset(CacheAppend (img, src->list.i,
+                                    src->list_count * sizeof (int),
+                                    CACHE_ALIGN));
+        }
+        cfg->list_text = CacheOffset(CacheSaveStrings (img, src->list_text,
+                                                       src->list_count));
+    }
+
+    uint64_t offset = CacheAppend (img, tab, count * sizeof (*tab),
+                                   CACHE_ALIGN);
+    free (tab);
+    return offset;
 }
 
-static int CacheSaveModuleConfig (FILE *file, const module_t *module)
+static void CacheSaveModule (cache_image_t *img, const module_t *module,
+                             cache_file_module_t *rec)
 {
-    uint16_t lines = module->confsize;
+    memset (rec, 0, sizeof (*rec));
+    rec->shortname = CacheSaveString (img, module->psz_shortname);
+    rec->longname = CacheSaveString (img, module->psz_longname);
+    rec->help = CacheSaveString (img, module->psz_help);
+    rec->capability = CacheSaveString (img, module->psz_capability);
+    rec->domain = CacheSaveString (img, module->domain);
+    rec->shortcuts = CacheSaveStrings (img, module->pp_shortcuts,
+                                       module->i_shortcuts);
+    rec->config = CacheSaveConfig (img, module->p_config, module->confsize);
+    rec->score = module->i_score;
+    rec->shortcuts_count = module->i_shortcuts;
+    rec->config_count = module->confsize;
+    rec->config_items = module->i_config_items;
+    rec->bool_items = module->i_bool_items;
+    rec->unloadable = module->b_unloadable;
+
+    const size_t count = module->submodule_count;
+    if (count == 0)
+        return;
 
-    SAVE_IMMEDIATE (module->i_config_items);
-    SAVE_IMMEDIATE (module->i_bool_items);
-    SAVE_IMMEDIATE (lines);
+    cache_file_module_t *subs = malloc (count * sizeof (*subs));
+    if (unlikely(subs == NULL))
+    {
+        img->error = true;
+        return;
+    }
 
-    for (size_t i = 0; i < lines; i++)
-        if (CacheSaveConfig (file, module->p_config + i))
-           goto error;
+    size_t n = 0;
+    for (const module_t *sub = module->submodule;
+         sub != NULL && n < count;
+         sub = sub->next)
+        CacheSaveModule (img, sub, subs + n++);
 
-    return 0;
-error:
-    return -1;
+    rec->submodules = CacheAppend (img, subs, n * sizeof (*subs),
+                                   CACHE_ALIGN);
+    rec->submodules_count = n;
+    free (subs);
 }
 
 static int CacheSaveBank( FILE *file, const module_cache_t *, size_t );
@@ -542,92 +752,66 @@ out:
     free (entries);
 }
 
-static int CacheSaveSubmodule (FILE *, const module_t *);
-
 static int CacheSaveBank (FILE *file, const module_cache_t *cache,
                           size_t i_cache)
 {
-    uint32_t i_file_size = 0;
-
-    /* Contains version number */
-    if (fputs (CACHE_STRING, file) == EOF)
-        goto error;
-#ifdef DISTRO_VERSION
-    /* Allow binary maintaner to pass a string to detect new binary version*/
-    if (fputs( DISTRO_VERSION, file ) == EOF)
-        goto error;
-#endif
-    /* Sub-version number (to avoid breakage in the dev version when cache
-     * structure changes) */
-    i_file_size = CACHE_SUBVERSION_NUM;
-    if (fwrite (&i_file_size, sizeof (i_file_size), 1, file) != 1 )
-        goto error;
-
-    /* Header marker */
-    i_file_size = ftell( file );
-    if (fwrite (&i_file_size, sizeof (i_file_size), 1, file) != 1)
+    cache_image_t img = { NULL, 0, 0, false };
+    cache_file_header_t hdr;
+    cache_file_entry_t *entries = NULL;
+
+    /* Contains version number, and the sub-version number (to avoid
+     * breakage in the dev version when cache structure changes) */
+    uint32_t i_marker = CACHE_SUBVERSION_NUM;
+    CacheAppend (&img, CACHE_PREFIX, sizeof (CACHE_PREFIX) - 1, 1);
+    CacheAppend (&img, &i_marker, sizeof (i_marker), 1);
+
+    /* Header placeholder, completed last */
+    memset (&hdr, 0, sizeof (hdr));
+    if (CacheAppend (&img, &hdr, sizeof (hdr), CACHE_ALIGN)
+                                                    != CACHE_HEADER_OFFSET)
         goto error;
 
-    for (unsigned i = 0; i < i_cache; i++)
+    if (i_cache > 0)
     {
-        module_t *module = cache[i].p_module;
-        uint32_t i_submodule;
-
-        /* Save additional infos */
-        SAVE_STRING(module->psz_shortname);
-        SAVE_STRING(module->psz_longname);
-        SAVE_STRING(module->psz_help);
-        SAVE_IMMEDIATE(module->i_shortcuts);
-        for (unsigned j = 0; j < module->i_shortcuts; j++)
-            SAVE_STRING(module->pp_shortcuts[j]);
-
-        SAVE_STRING(module->psz_capability);
-        SAVE_IMMEDIATE(module->i_score);
-        SAVE_IMMEDIATE(module->b_unloadable);
-
-        /* Config stuff */
-        if (CacheSaveModuleConfig (file, module))
-            goto error;
-
-        SAVE_STRING(module->domain);
-
-        i_submodule = module->submodule_count;
-        SAVE_IMMEDIATE( i_submodule );
-        if (CacheSaveSubmodule (file, module->submodule))
+        entries = calloc (i_cache, sizeof (*entries));
+        if (unlikely(entries == NULL))
             goto error;
+    }
 
-        /* Save common info */
-        SAVE_STRING(cache[i].path);
-        SAVE_IMMEDIATE(cache[i].mtime);
-        SAVE_IMMEDIATE(cache[i].size);
+    for (size_t i = 0; i < i_cache; i++)
+    {
+        cache_file_module_t rec;
+
+        CacheSaveModule (&img, cache[i].p_module, &rec);
+        entries[i].module = CacheAppend (&img, &rec, sizeof (rec),
+                                         CACHE_ALIGN);
+        entries[i].path = CacheSaveString (&img, cache[i].path);
+        entries[i].mtime = cache[i].mtime;
+        entries[i].size = cache[i].size;
     }
 
-    if (fflush (file)) /* flush libc buffers */
+    hdr.entries = CacheAppend (&img, entries, i_cache * sizeof (*entries),
+                               CACHE_ALIGN);
+    if (img.error)
         goto error;
-    return 0; /* success! */
 
-error:
-    return -1;
-}
+    hdr.pointer_size = sizeof (void *);
+    hdr.config_size = sizeof (module_config_t);
+    hdr.size = img.size;
+    hdr.count = i_cache;
+    memcpy (img.data + CACHE_HEADER_OFFSET, &hdr, sizeof (hdr));
 
-static int CacheSaveSubmodule( FILE *file, const module_t *p_module )
-{
-    if( !p_module )
-        return 0;
-    if( CacheSaveSubmodule( file, p_module->next ) )
+    if (fwrite (img.data, 1, img.size, file) != img.size)
         goto error;
-
-    SAVE_STRING( p_module->psz_shortname );
-    SAVE_STRING( p_module->psz_longname );
-    SAVE_IMMEDIATE( p_module->i_shortcuts );
-    for( unsigned j = 0; j < p_module->i_shortcuts; j++ )
-         SAVE_STRING( p_module->pp_shortcuts[j] );
-
-    SAVE_STRING( p_module->psz_capability );
-    SAVE_IMMEDIATE( p_module->i_score );
-    return 0;
+    if (fflush (file)) /* flush libc buffers */
+        goto error;
+    free (entries);
+    free (img.data);
+    return 0; /* success! */
 
 error:
+    free (entries);
+    free (img.data);
     return -1;
 }
 
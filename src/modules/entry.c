@@ -81,6 +81,7 @@ module_t *vlc_module_create (module_t *parent)
     /*module->handle = garbage */
     module->psz_filename = NULL;
     module->domain = NULL;
+    module->cache = NULL;
     return module;
 }
 
@@ -98,6 +99,20 @@ void vlc_module_destroy (module_t *module)
         vlc_module_destroy (m);
     }
 
+#ifdef HAVE_DYNAMIC_PLUGINS
+    if (module->cache != NULL)
+    {   /* Only the current string values were allocated, see CacheLoad() */
+        for (size_t i = 0; i < module->confsize; i++)
+            if (IsConfigStringType (module->p_config[i].i_type))
+                free (module->p_config[i].value.psz);
+
+        free (module->psz_filename);
+        CacheRelease (module->cache);
+        free (module);
+        return;
+    }
+#endif
+
     config_Free (module->p_config, module->confsize);
 
     free (module->domain);
@@ -157,18 +157,6 @@ void module_stop (vlc_object_t *obj, const module_t *m)
         deactivate (obj);
 }
 
-static bool module_match_name (const module_t *m, const char *name)
-{
-     /* Plugins with zero score must be matched explicitly. */
-     if (!strcasecmp ("any", name))
-         return m->i_score > 0;
-
-     for (unsigned i = 0; i < m->i_shortcuts; i++)
-          if (!strcasecmp (m->pp_shortcuts[i], name))
-              return true;
-     return false;
-}
-
 static int module_load (vlc_object_t *obj, module_t *m,
                         vlc_activate_t init, va_list args)
 {
@@ -264,13 +252,22 @@ module_t *vlc_module_load(vlc_object_t *obj, const char *capability,
         if (!strcasecmp ("none", shortcut))
             goto done;
 
-        obj->obj.force = strict && strcasecmp ("any", shortcut);
-        for (ssize_t i = 0; i < total; i++)
+        const bool any = !strcasecmp ("any", shortcut);
+        const module_shortcut_t *matches = NULL;
+        size_t count = total;
+
+        if (!any) /* only the candidates with that shortcut, by score */
+            count = module_list_cap_shortcut (&matches, capability, shortcut);
+
+        obj->obj.force = strict && !any;
+        for (size_t j = 0; j < count; j++)
         {
+            size_t i = (matches != NULL) ? matches[j].index : j;
             module_t *cand = mods[i];
             if (cand == NULL)
                 continue; // module failed in previous iteration
-            if (!module_match_name (cand, shortcut))
+            /* Plugins with zero score must be matched explicitly. */
+            if (any && cand->i_score <= 0)
                 continue;
             mods[i] = NULL; // only try each module once at most...
 
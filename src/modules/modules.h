@@ -25,6 +25,7 @@
 # define LIBVLC_MODULES_H 1
 
 typedef struct module_cache_t module_cache_t;
+typedef struct cache_map_t cache_map_t;
 
 /*****************************************************************************
  * Module cache description structure
@@ -98,6 +99,8 @@ struct module_t
     module_handle_t     handle;                             /* Unique handle */
     char *              psz_filename;                     /* Module filename */
     char *              domain;                            /* gettext domain */
+    cache_map_t *       cache;  /* Plugins cache holding the strings and
+                                   the config, NULL if they are allocated */
 };
 
 module_t *vlc_plugin_describe (vlc_plugin_cb);
@@ -112,6 +115,16 @@ int module_Map (vlc_object_t *, module_t *);
 
 ssize_t module_list_cap (module_t ***, const char *);
 
+/** Shortcut of a module within the list of modules of a capability */
+typedef struct
+{
+    const char *name;
+    size_t index;   /**< Position in the module_list_cap() list */
+} module_shortcut_t;
+
+size_t module_list_cap_shortcut (const module_shortcut_t **, const char *,
+                                 const char *);
+
 int vlc_bindtextdomain (const char *);
 
 /* Low-level OS-dependent handler */
@@ -123,6 +136,7 @@ void module_Unload (module_handle_t);
 void   CacheMerge (vlc_object_t *, module_t *, module_t *);
 void   CacheDelete(vlc_object_t *, const char *);
 size_t CacheLoad  (vlc_object_t *, const char *, module_cache_t **);
+void   CacheRelease (cache_map_t *);
 
 struct stat;
 
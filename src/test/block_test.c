@@ -84,10 +84,141 @@ static void test_block (void)
     //assert (block == NULL);
 }
 
+static void test_block_Share (void)
+{
+    block_t *block = block_Alloc (sizeof (text));
+    assert (block != NULL);
+    memcpy (block->p_buffer, text, sizeof (text));
+    block->i_pts = 42;
+
+    block = block_MakeShared (block);
+    assert (block != NULL);
+    assert (block_MakeShared (block) == block);
+
+    block_t *ref = block_Share (block);
+    assert (ref != NULL);
+    assert (ref->p_buffer == block->p_buffer);
+    assert (ref->i_buffer == sizeof (text));
+    assert (ref->i_pts == 42);
+
+    /* Shrinking does not touch the shared payload */
+    ref = block_Realloc (ref, -5, sizeof (text));
+    assert (ref != NULL);
+    assert (ref->p_buffer == block->p_buffer + 5);
+    assert (ref->i_buffer == sizeof (text) - 5);
+
+    /* Expanding copies it */
+    ref = block_Realloc (ref, 5, sizeof (text) - 5);
+    assert (ref != NULL);
+    assert (ref->i_buffer == sizeof (text));
+    assert (ref->p_buffer != block->p_buffer);
+    memset (ref->p_buffer, 0, 5);
+    assert (!memcmp (block->p_buffer, text, sizeof (text)));
+    assert (!memcmp (ref->p_buffer + 5, text + 5, sizeof (text) - 5));
+    block_Release (ref);
+
+    /* Writable copy while shared */
+    ref = block_Share (block);
+    assert (ref != NULL);
+    block_t *copy = block_Unshare (ref);
+    assert (copy != NULL);
+    assert (copy->p_buffer != block->p_buffer);
+    assert (!memcmp (copy->p_buffer, text, sizeof (text)));
+    assert (copy->i_pts == 42);
+    block_Release (copy);
+
+    /* Last reference gets the payload back without copy */
+    uint8_t *payload = block->p_buffer;
+    block = block_Unshare (block);
+    assert (block != NULL);
+    assert (block->p_buffer == payload);
+    block = block_Realloc (block, 0, sizeof (text) + 100);
+    assert (block != NULL);
+    block_Release (block);
+}
+
+static void *test_block_PoolRelease (void *data)
+{
+    block_Release (data);
+    return NULL;
+}
+
+static void test_block_Pool (void)
+{
+    block_pool_stats_t before, after;
+    bool enabled = block_PoolGetStats (&before);
+
+    block_t *block = block_Alloc (1000);
+    assert (block != NULL);
+    assert (((uintptr_t)block->p_buffer % 32) == 0);
+    assert (block->i_buffer == 1000);
+    memset (block->p_buffer, 0xAA, block->i_buffer);
+    block_Release (block);
+
+    block_PoolGetStats (&after);
+    if (!enabled)
+    {
+        assert (after.i_hits == 0 && after.i_misses == 0);
+        assert (after.i_cached == 0);
+        return;
+    }
+    assert (after.i_hits + after.i_misses == before.i_hits + before.i_misses + 1);
+    assert (after.i_cached >= 1000);
+
+    /* Same size class: served from the calling thread magazine */
+    void *addr = block;
+    before = after;
+    block = block_Alloc (900);
+    assert (block != NULL);
+    assert ((void *)block == addr);
+    assert (block->i_buffer == 900);
+    assert (block->i_flags == 0 && block->i_pts == VLC_TS_INVALID);
+    block_PoolGetStats (&after);
+    assert (after.i_hits == before.i_hits + 1);
+    assert (after.i_cached < before.i_cached);
+
+    /* Released by another thread: recycled through the depot on exit */
+    vlc_thread_t th;
+    if (vlc_clone (&th, test_block_PoolRelease, block,
+                   VLC_THREAD_PRIORITY_LOW) == 0)
+    {
+        vlc_join (th, NULL);
+        before = after;
+        block = block_Alloc (1024);
+        assert (block != NULL);
+        block_PoolGetStats (&after);
+        assert (after.i_hits == before.i_hits + 1);
+    }
+    block_Release (block);
+
+    /* Size classes waste less than a quarter of medium payloads */
+    for (size_t size = 300; size <= 65536; size += size / 7)
+    {
+        block = block_Alloc (size);
+        assert (block != NULL);
+        block_PoolGetStats (&before);
+        block_Release (block);
+        block_PoolGetStats (&after);
+        assert (after.i_cached - before.i_cached >= size);
+        assert (after.i_cached - before.i_cached < size + size / 4);
+    }
+
+    /* Large blocks bypass the pool */
+    before = after;
+    block = block_Alloc (1 << 20);
+    assert (block != NULL);
+    block_Release (block);
+    block_PoolGetStats (&after);
+    assert (after.i_hits == before.i_hits);
+    assert (after.i_misses == before.i_misses);
+}
+
 int main (void)
 {
     test_block_File ();
     test_block ();
+    test_block_Share ();
+    test_block_Pool ();
     return 0;
 }
 
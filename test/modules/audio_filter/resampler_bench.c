@@ -0,0 +1,302 @@
+/*****************************************************************************
+ * resampler_bench.c: audio resamplers quality and speed benchmark
+ *****************************************************************************
+ * Copyright (C) 2016 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#undef NDEBUG
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vlc_common.h>
+#include <vlc_aout.h>
+#include <vlc_filter.h>
+#include <vlc_modules.h>
+#include <vlc_block.h>
+#include "../../../lib/libvlc_internal.h"
+
+#include <vlc/vlc.h>
+
+/* The resamplers are loaded by name, through their "audio resampler"
+ * submodule, so that they are compared on the same input whatever their
+ * priorities. Those which are not built are skipped. */
+static const char *const resamplers[] = {
+    "polyphase_resampler",
+    "speex_resampler",
+    "bandlimited_resampler",
+    "ugly_resampler",
+};
+
+static const struct
+{
+    unsigned in;
+    unsigned out;
+} ratios[] = {
+    { 44100, 48000 },
+    { 48000, 44100 },
+    { 96000, 48000 },
+    { 48000, 48002 }, /* like the drift compensation of the audio output */
+};
+
+#define BLOCK_FRAMES 1024
+
+static filter_t *ResamplerNew (vlc_object_t *parent, const char *name,
+                               unsigned in_rate, unsigned out_rate,
+                               uint16_t channels)
+{
+    filter_t *filter = vlc_object_create (parent, sizeof (*filter));
+    assert (filter != NULL);
+
+    audio_sample_format_t fmt = {
+        .i_format = VLC_CODEC_FL32,
+        .i_rate = in_rate,
+        .i_physical_channels = channels,
+        .i_original_channels = channels,
+    };
+    aout_FormatPrepare (&fmt);
+
+    filter->fmt_in.audio = fmt;
+    filter->fmt_in.i_codec = fmt.i_format;
+    fmt.i_rate = out_rate;
+    filter->fmt_out.audio = fmt;
+    filter->fmt_out.i_codec = fmt.i_format;
+    filter->p_module = module_need (filter, "audio resampler", name, true);
+    if (filter->p_module == NULL)
+    {
+        vlc_object_release (filter);
+        return NULL;
+    }
+    return filter;
+}
+
+static void ResamplerDelete (filter_t *filter)
+{
+    module_unneed (filter, filter->p_module);
+    vlc_object_release (filter);
+}
+
+/* Resamples frames samples by blocks, the output is appended to out if not
+ * NULL. Returns the number of output frames. */
+static size_t Run (filter_t *filter, const float *in, size_t frames,
+                   unsigned channels, float *out, size_t out_max)
+{
+    size_t done = 0;
+    mtime_t pts = VLC_TS_0;
+
+    for (size_t i = 0; i < frames; i += BLOCK_FRAMES)
+    {
+        const size_t n = __MIN(BLOCK_FRAMES, frames - i);
+        block_t *block = block_Alloc (n * channels * sizeof (float));
+        assert (block != NULL);
+
+        memcpy (block->p_buffer, in + i * channels,
+                n * channels * sizeof (float));
+        block->i_nb_samples = n;
+        block->i_pts = pts;
+        block->i_length = n * CLOCK_FREQ / filter->fmt_in.audio.i_rate;
+        pts += block->i_length;
+
+        block = filter->pf_audio_filter (filter, block);
+        if (block == NULL)
+            continue;
+        if (out != NULL)
+        {
+            size_t m = __MIN(block->i_nb_samples, out_max - done);
+            memcpy (out + done * channels, block->p_buffer,
+                    m * channels * sizeof (float));
+        }
+        done += block->i_nb_samples;
+        block_Release (block);
+    }
+    return done;
+}
+
+/* The phase is reduced first, so that the input is exact to the float
+ * precision */
+static float Sine (double freq, size_t i, unsigned rate)
+{
+    return .5 * sin (2. * M_PI * fmod (freq * i, rate) / rate);
+}
+
+/* THD+N of a resampled sine: the output is fitted to a sine of the expected
+ * frequency, whatever its delay, and the residue is compared to it. */
+static double SineNoise (const float *x, size_t n, double freq)
+{
+    const double w = 2. * M_PI * freq;
+    double cc = 0., ss = 0., cs = 0., xc = 0., xs = 0.;
+
+    for (size_t i = 0; i < n; i++)
+    {
+        const double c = cos (w * i), s = sin (w * i);
+        cc += c * c;
+        ss += s * s;
+        cs += c * s;
+        xc += x[i] * c;
+        xs += x[i] * s;
+    }
+
+    const double det = cc * ss - cs * cs;
+    const double a = (xc * ss - xs * cs) / det;
+    const double b = (xs * cc - xc * cs) / det;
+    double signal = 0., noise = 0.;
+
+    for (size_t i = 0; i < n; i++)
+    {
+        const double y = a * cos (w * i) + b * sin (w * i);
+        signal += y * y;
+        noise += (x[i] - y) * (x[i] - y);
+    }
+    return 10. * log10 (noise / signal);
+}
+
+static void Quality (vlc_object_t *parent, const char *name,
+                     unsigned in_rate, unsigned out_rate)
+{
+    const size_t frames = in_rate; /* 1 second */
+    const size_t out_max = (uint64_t)frames * out_rate / in_rate + 1;
+    const size_t skip = out_rate / 10; /* warm up */
+    float *in = malloc (frames * sizeof (float));
+    float *out = malloc (out_max * sizeof (float));
+    assert (in != NULL && out != NULL);
+
+    printf ("  %-22s", name);
+
+    /* In band tones: THD+N */
+    const double tones[] = { 1000., 10000., 18000. };
+    for (size_t t = 0; t < ARRAY_SIZE(tones); t++)
+    {
+        filter_t *filter = ResamplerNew (parent, name, in_rate, out_rate,
+                                         AOUT_CHAN_CENTER);
+        if (filter == NULL)
+        {
+            printf (" not available\n");
+            goto out;
+        }
+
+        for (size_t i = 0; i < frames; i++)
+            in[i] = Sine (tones[t], i, in_rate);
+        size_t n = Run (filter, in, frames, 1, out, out_max);
+        n = __MIN(n, out_max);
+        ResamplerDelete (filter);
+
+        if (n > 2 * skip)
+            printf (" %5.0f Hz %6.1f dB", tones[t],
+                    SineNoise (out + skip, n - 2 * skip,
+                               tones[t] / out_rate));
+    }
+
+    /* Out of band tone when downsampling: aliasing */
+    if (out_rate < in_rate)
+    {
+        const double tone = (in_rate + out_rate) / 4.;
+        filter_t *filter = ResamplerNew (parent, name, in_rate, out_rate,
+                                         AOUT_CHAN_CENTER);
+        assert (filter != NULL);
+
+        for (size_t i = 0; i < frames; i++)
+            in[i] = Sine (tone, i, in_rate);
+        size_t n = __MIN(Run (filter, in, frames, 1, out, out_max), out_max);
+        ResamplerDelete (filter);
+
+        double energy = 0.;
+        for (size_t i = skip; i + skip < n; i++)
+            energy += out[i] * out[i];
+        if (n > 2 * skip)
+            printf (", alias %6.1f dB",
+                    10. * log10 (energy / (n - 2 * skip) / .125));
+    }
+    printf ("\n");
+out:
+    free (out);
+    free (in);
+}
+
+static void Speed (vlc_object_t *parent, const char *name,
+                   unsigned in_rate, unsigned out_rate, uint16_t layout,
+                   unsigned seconds)
+{
+    const unsigned channels = popcount (layout);
+    const size_t frames = (size_t)in_rate * seconds;
+    float *in = malloc (frames * channels * sizeof (float));
+    assert (in != NULL);
+
+    for (size_t i = 0; i < frames * channels; i++)
+        in[i] = rand () / (float)RAND_MAX - .5f;
+
+    filter_t *filter = ResamplerNew (parent, name, in_rate, out_rate, layout);
+    if (filter != NULL)
+    {
+        mtime_t start = mdate ();
+        size_t n = Run (filter, in, frames, channels, NULL, 0);
+        mtime_t elapsed = mdate () - start;
+
+        ResamplerDelete (filter);
+        if (n == 0)
+            n = 1;
+        printf (" %2u ch %7.2f ns", channels,
+                elapsed * 1000. / n / channels);
+    }
+    free (in);
+}
+
+int main (int argc, char *argv[])
+{
+    unsigned seconds = 10;
+    if (argc > 1)
+        seconds = strtoul (argv[1], NULL, 0);
+
+    setenv ("VLC_PLUGIN_PATH", "../modules", 1);
+
+    libvlc_instance_t *vlc = libvlc_new (0, NULL);
+    assert (vlc != NULL);
+    vlc_object_t *parent = VLC_OBJECT(vlc->p_libvlc_int);
+
+    printf ("Quality: THD+N of sines, aliasing of a tone above the output "
+            "Nyquist frequency\n");
+    for (size_t r = 0; r < ARRAY_SIZE(ratios); r++)
+    {
+        printf (" %u -> %u Hz\n", ratios[r].in, ratios[r].out);
+        for (size_t i = 0; i < ARRAY_SIZE(resamplers); i++)
+            Quality (parent, resamplers[i], ratios[r].in, ratios[r].out);
+    }
+
+    printf ("Speed: time per output sample and channel, %u s of noise\n",
+            seconds);
+    for (size_t r = 0; r < ARRAY_SIZE(ratios); r++)
+    {
+        printf (" %u -> %u Hz\n", ratios[r].in, ratios[r].out);
+        for (size_t i = 0; i < ARRAY_SIZE(resamplers); i++)
+        {
+            printf ("  %-22s", resamplers[i]);
+            Speed (parent, resamplers[i], ratios[r].in, ratios[r].out,
+                   AOUT_CHANS_STEREO, seconds);
+            Speed (parent, resamplers[i], ratios[r].in, ratios[r].out,
+                   AOUT_CHANS_7_1, seconds);
+            printf ("\n");
+        }
+    }
+
+    libvlc_release (vlc);
+    return 0;
+}
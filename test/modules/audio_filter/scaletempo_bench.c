@@ -0,0 +1,352 @@
+/*****************************************************************************
+ * scaletempo_bench.c: scaletempo overlap search benchmark
+ *****************************************************************************
+ * Copyright (C) 2016 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/* Usage: scaletempo_bench [file.f32 [channels [rate]]]
+ *
+ * The file is raw native-endian 32-bits float PCM, 2 channels at 48 kHz by
+ * default. Without a file, 10 seconds of a fixed synthetic signal (decaying
+ * harmonic notes over noise) are used instead, in stereo and in 7.1.
+ * The search quality is estimated with the THD+N of sines played at the same
+ * speeds. */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#undef NDEBUG
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vlc_common.h>
+#include <vlc_aout.h>
+#include <vlc_filter.h>
+#include <vlc_modules.h>
+#include <vlc_block.h>
+#include "../../../lib/libvlc_internal.h"
+
+#include <vlc/vlc.h>
+
+static const float rates[] = { .5f, 1.5f, 2.f };
+static const char *const modes[] = { "full", "coarse" };
+
+#define BLOCK_FRAMES 1024
+
+static uint16_t Layout (unsigned channels)
+{
+    static const uint16_t layouts[] = {
+        0, AOUT_CHAN_CENTER, AOUT_CHANS_STEREO, AOUT_CHANS_3_0,
+        AOUT_CHANS_4_0, AOUT_CHANS_5_0, AOUT_CHANS_5_1, AOUT_CHANS_7_0,
+        AOUT_CHANS_7_1,
+    };
+    return channels < ARRAY_SIZE(layouts) ? layouts[channels] : 0;
+}
+
+/* Deterministic test signal: notes of a few harmonics with an exponential
+ * decay, changing every quarter of a second, over low level noise */
+static float *Generate (unsigned channels, unsigned rate, size_t frames)
+{
+    float *pcm = malloc (frames * channels * sizeof (float));
+    assert (pcm != NULL);
+
+    const size_t note = rate / 4;
+    unsigned seed = 1;
+
+    for (size_t i = 0; i < frames; i++)
+    {
+        const size_t n = i / note;
+        const double f0 = 110. * pow (2., (n * 7 % 24) / 12.);
+        const double t = (double)(i % note) / rate;
+        double v = 0.;
+
+        for (unsigned h = 1; h <= 4; h++)
+            v += sin (2. * M_PI * fmod (f0 * h * t, 1.)) / h;
+        v *= .25 * exp (-4. * t);
+
+        for (unsigned c = 0; c < channels; c++)
+        {
+            seed = seed * 1103515245 + 12345;
+            pcm[i * channels + c] = v * (1. - .1 * c / channels)
+                                  + ((seed >> 16) & 0x7fff) / 32768.f * .01f;
+        }
+    }
+    return pcm;
+}
+
+static filter_t *ScaletempoNew (vlc_object_t *parent, const char *mode,
+                                unsigned channels, unsigned rate)
+{
+    filter_t *filter = vlc_object_create (parent, sizeof (*filter));
+    assert (filter != NULL);
+
+    var_Create (filter, "scaletempo-search-mode", VLC_VAR_STRING);
+    var_SetString (filter, "scaletempo-search-mode", mode);
+
+    audio_sample_format_t fmt = {
+        .i_format = VLC_CODEC_FL32,
+        .i_rate = rate,
+        .i_physical_channels = Layout (channels),
+        .i_original_channels = Layout (channels),
+    };
+    aout_FormatPrepare (&fmt);
+
+    filter->fmt_in.audio = fmt;
+    filter->fmt_in.i_codec = fmt.i_format;
+    filter->fmt_out.audio = fmt;
+    filter->fmt_out.i_codec = fmt.i_format;
+    filter->p_module = module_need (filter, "audio filter", "scaletempo",
+                                    true);
+    if (filter->p_module == NULL)
+    {
+        vlc_object_release (filter);
+        return NULL;
+    }
+    return filter;
+}
+
+static void ScaletempoDelete (filter_t *filter)
+{
+    module_unneed (filter, filter->p_module);
+    vlc_object_release (filter);
+}
+
+/* Plays the PCM at the given speed, as the audio output does: the input
+ * rate of the filter is scaled. Returns the output, *out_frames is set to its
+ * length and *elapsed to the processing time. */
+static float *Run (filter_t *filter, const float *pcm, size_t frames,
+                   unsigned channels, float speed, size_t *out_frames,
+                   mtime_t *elapsed)
+{
+    const unsigned rate = filter->fmt_in.audio.i_rate;
+    size_t out_max = frames / speed + 2 * rate, done = 0;
+    float *out = malloc (out_max * channels * sizeof (float));
+    assert (out != NULL);
+
+    filter->fmt_in.audio.i_rate = lroundf (rate * speed);
+    *elapsed = 0;
+
+    for (size_t i = 0; i < frames; i += BLOCK_FRAMES)
+    {
+        const size_t n = __MIN(BLOCK_FRAMES, frames - i);
+        block_t *block = block_Alloc (n * channels * sizeof (float));
+        assert (block != NULL);
+
+        memcpy (block->p_buffer, pcm + i * channels,
+                n * channels * sizeof (float));
+        block->i_nb_samples = n;
+        block->i_pts = VLC_TS_0 + i * CLOCK_FREQ / rate;
+        block->i_length = n * CLOCK_FREQ / rate;
+
+        mtime_t start = mdate ();
+        block = filter->pf_audio_filter (filter, block);
+        *elapsed += mdate () - start;
+        if (block == NULL)
+            continue;
+
+        size_t m = __MIN(block->i_nb_samples, out_max - done);
+        memcpy (out + done * channels, block->p_buffer,
+                m * channels * sizeof (float));
+        done += m;
+        block_Release (block);
+    }
+    filter->fmt_in.audio.i_rate = rate;
+    *out_frames = done;
+    return out;
+}
+
+/* THD+N of a sine played at another speed: each window of the output is
+ * fitted to a sine of the same frequency, and the residue is compared to it.
+ * Fitting by windows ignores slow phase drifts, which are inaudible, but not
+ * the discontinuities of badly aligned overlaps. */
+#define FIT_WINDOW 4096
+
+static double SineNoise (const float *x, size_t n, unsigned channels,
+                         double freq)
+{
+    const double w = 2. * M_PI * freq;
+    double signal = 0., noise = 0.;
+
+    for (size_t start = 0; start + FIT_WINDOW <= n; start += FIT_WINDOW)
+    {
+        const float *p = x + start * channels;
+        double cc = 0., ss = 0., cs = 0., xc = 0., xs = 0.;
+
+        for (size_t i = 0; i < FIT_WINDOW; i++)
+        {
+            const double c = cos (w * i), s = sin (w * i);
+            cc += c * c;
+            ss += s * s;
+            cs += c * s;
+            xc += p[i * channels] * c;
+            xs += p[i * channels] * s;
+        }
+
+        const double det = cc * ss - cs * cs;
+        const double a = (xc * ss - xs * cs) / det;
+        const double b = (xs * cc - xc * cs) / det;
+
+        for (size_t i = 0; i < FIT_WINDOW; i++)
+        {
+            const double y = a * cos (w * i) + b * sin (w * i);
+            const double e = p[i * channels] - y;
+            signal += y * y;
+            noise += e * e;
+        }
+    }
+    return 10. * log10 (noise / signal);
+}
+
+static void Bench (vlc_object_t *parent, const float *pcm, size_t frames,
+                   unsigned channels, unsigned rate)
+{
+    static const double tones[] = { 441., 2637. };
+    const size_t tone_frames = 2 * rate;
+    float *tone = malloc (tone_frames * channels * sizeof (float));
+    assert (tone != NULL);
+
+    printf (" %u channels, %u Hz, %.1f s\n", channels, rate,
+            (double)frames / rate);
+
+    for (size_t r = 0; r < ARRAY_SIZE(rates); r++)
+        for (size_t m = 0; m < ARRAY_SIZE(modes); m++)
+        {
+            filter_t *filter = ScaletempoNew (parent, modes[m], channels,
+                                              rate);
+            if (filter == NULL)
+            {
+                printf ("  scaletempo not available\n");
+                goto out;
+            }
+
+            size_t out_frames;
+            mtime_t elapsed;
+            float *out = Run (filter, pcm, frames, channels, rates[r],
+                              &out_frames, &elapsed);
+            ScaletempoDelete (filter);
+            free (out);
+
+            printf ("  %.1fx %-6s %7.2f ns/frame %7.0fx realtime",
+                    rates[r], modes[m],
+                    elapsed * 1000. / (out_frames ? out_frames : 1),
+                    out_frames * (double)CLOCK_FREQ / rate
+                    / (elapsed ? elapsed : 1));
+
+            for (size_t t = 0; t < ARRAY_SIZE(tones); t++)
+            {
+                for (size_t i = 0; i < tone_frames; i++)
+                    for (unsigned c = 0; c < channels; c++)
+                        tone[i * channels + c] =
+                            .5 * sin (2. * M_PI * fmod (tones[t] * i, rate)
+                                      / rate);
+
+                filter = ScaletempoNew (parent, modes[m], channels, rate);
+                assert (filter != NULL);
+                mtime_t dummy;
+                out = Run (filter, tone, tone_frames, channels, rates[r],
+                           &out_frames, &dummy);
+                ScaletempoDelete (filter);
+
+                /* skip the start-up of the filter */
+                const size_t skip = rate / 10;
+                if (out_frames > 2 * skip)
+                    printf (" %4.0f Hz %6.1f dB", tones[t],
+                            SineNoise (out + skip * channels,
+                                       out_frames - 2 * skip, channels,
+                                       tones[t] / rate));
+                free (out);
+            }
+            printf ("\n");
+        }
+out:
+    free (tone);
+}
+
+int main (int argc, char *argv[])
+{
+    unsigned channels = 2, rate = 48000;
+
+    if (argc > 2)
+        channels = strtoul (argv[2], NULL, 0);
+    if (argc > 3)
+        rate = strtoul (argv[3], NULL, 0);
+    if (Layout (channels) == 0)
+    {
+        fprintf (stderr, "unsupported channels count %u\n", channels);
+        return 1;
+    }
+
+    setenv ("VLC_PLUGIN_PATH", "../modules", 1);
+
+    libvlc_instance_t *vlc = libvlc_new (0, NULL);
+    assert (vlc != NULL);
+    vlc_object_t *parent = VLC_OBJECT(vlc->p_libvlc_int);
+
+    printf ("Scaletempo: time per output frame, THD+N of sines\n");
+
+    if (argc > 1)
+    {
+        FILE *file = fopen (argv[1], "rb");
+        if (file == NULL)
+        {
+            perror (argv[1]);
+            libvlc_release (vlc);
+            return 1;
+        }
+
+        float *pcm = NULL;
+        size_t frames = 0, size = 0;
+        for (;;)
+        {
+            if (frames == size)
+            {
+                size = size ? 2 * size : rate;
+                pcm = realloc (pcm, size * channels * sizeof (float));
+                assert (pcm != NULL);
+            }
+            size_t n = fread (pcm + frames * channels,
+                              channels * sizeof (float), size - frames, file);
+            if (n == 0)
+                break;
+            frames += n;
+        }
+        fclose (file);
+
+        Bench (parent, pcm, frames, channels, rate);
+        free (pcm);
+    }
+    else
+    {
+        const unsigned layouts[] = { 2, 8 };
+
+        for (size_t i = 0; i < ARRAY_SIZE(layouts); i++)
+        {
+            const size_t frames = 10 * rate;
+            float *pcm = Generate (layouts[i], rate, frames);
+
+            Bench (parent, pcm, frames, layouts[i], rate);
+            free (pcm);
+        }
+    }
+
+    libvlc_release (vlc);
+    return 0;
+}
@@ -0,0 +1,129 @@
+/*****************************************************************************
+ * volume.c: test the SIMD software volume kernels against the C ones
+ *****************************************************************************
+ * Copyright (C) 2016 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#undef NDEBUG
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vlc_common.h>
+#include <vlc_block.h>
+#include <vlc_cpu.h>
+#include <vlc_fourcc.h>
+#include "../../../modules/audio_mixer/amplify.h"
+
+/* 7.1 at 192 kHz is 1536 samples per millisecond: also cover partial SIMD
+ * vectors at both ends of a buffer */
+static const size_t lengths[] = { 0, 1, 3, 7, 8, 15, 16, 17, 31, 33, 1536 };
+/* Unity gain is a no-op, the large gain clips integer samples */
+static const float gains[] = { 1.f, 0.f, 0.25f, 0.7071f, 1.f / 3.f, 1.5f,
+                               2.f, 100.f };
+
+static void Fill(uint8_t *p, size_t size, vlc_fourcc_t format)
+{
+    switch (format)
+    {
+        case VLC_CODEC_FL32:
+            for (size_t i = 0; i < size / sizeof (float); i++)
+                ((float *)p)[i] = (rand() / (float)RAND_MAX) * 2.f - 1.f;
+            break;
+        case VLC_CODEC_FL64:
+            for (size_t i = 0; i < size / sizeof (double); i++)
+                ((double *)p)[i] = (rand() / (double)RAND_MAX) * 2. - 1.;
+            break;
+        default:
+            for (size_t i = 0; i < size; i++)
+                p[i] = rand();
+    }
+}
+
+static void Test(const char *name, vlc_fourcc_t format, size_t sample_size,
+                 amplify_t ref, amplify_t func)
+{
+    printf("%s: ", name);
+
+    for (size_t i = 0; i < ARRAY_SIZE(lengths); i++)
+        for (size_t j = 0; j < ARRAY_SIZE(gains); j++)
+            /* with and without a vector aligned start */
+            for (unsigned offset = 0; offset < 2; offset++)
+            {
+                const size_t size = lengths[i] * sample_size;
+                block_t *a = block_Alloc(size + sample_size);
+                block_t *b = block_Alloc(size + sample_size);
+                assert(a != NULL && b != NULL);
+
+                a->p_buffer += offset * sample_size;
+                a->i_buffer = size;
+                Fill(a->p_buffer, size, format);
+                b->p_buffer += offset * sample_size;
+                b->i_buffer = size;
+                memcpy(b->p_buffer, a->p_buffer, size);
+
+                ref(NULL, a, gains[j]);
+                func(NULL, b, gains[j]);
+                if (memcmp(a->p_buffer, b->p_buffer, size))
+                {
+                    printf("mismatch with %zu samples, gain %f\n",
+                           lengths[i], gains[j]);
+                    exit(1);
+                }
+                block_Release(b);
+                block_Release(a);
+            }
+    printf("OK\n");
+}
+
+int main(void)
+{
+    srand(0);
+
+#ifdef AMPLIFY_X86
+    if (vlc_CPU_SSE())
+        Test("FL32 SSE", VLC_CODEC_FL32, 4, amplify_FL32_c, amplify_FL32_sse);
+    if (vlc_CPU_AVX())
+        Test("FL32 AVX", VLC_CODEC_FL32, 4, amplify_FL32_c, amplify_FL32_avx);
+    if (vlc_CPU_SSE2())
+        Test("FL64 SSE2", VLC_CODEC_FL64, 8, amplify_FL64_c,
+             amplify_FL64_sse2);
+    if (vlc_CPU_AVX())
+        Test("FL64 AVX", VLC_CODEC_FL64, 8, amplify_FL64_c, amplify_FL64_avx);
+    if (vlc_CPU_SSE2())
+        Test("S16N SSE2", VLC_CODEC_S16N, 2, amplify_S16N_c,
+             amplify_S16N_sse2);
+    if (vlc_CPU_AVX2())
+        Test("S16N AVX2", VLC_CODEC_S16N, 2, amplify_S16N_c,
+             amplify_S16N_avx2);
+#endif
+#ifdef AMPLIFY_NEON
+    Test("FL32 NEON", VLC_CODEC_FL32, 4, amplify_FL32_c, amplify_FL32_neon);
+    Test("S16N NEON", VLC_CODEC_S16N, 2, amplify_S16N_c, amplify_S16N_neon);
+#endif
+
+    /* The selected kernels too, whichever they are */
+    Test("FL32", VLC_CODEC_FL32, 4, amplify_FL32_c, amplify_SelectFL32());
+    Test("FL64", VLC_CODEC_FL64, 8, amplify_FL64_c, amplify_SelectFL64());
+    Test("S16N", VLC_CODEC_S16N, 2, amplify_S16N_c, amplify_SelectS16N());
+    return 0;
+}
@@ -0,0 +1,314 @@
+/*****************************************************************************
+ * ts_bench.c: TS demuxer throughput benchmark
+ *****************************************************************************
+ * Copyright (C) 2016 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#undef NDEBUG
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vlc_common.h>
+#include <vlc_demux.h>
+#include <vlc_es_out.h>
+#include <vlc_block.h>
+#include "../../../lib/libvlc_internal.h"
+#include "../../libvlc/test.h"
+
+#include <vlc/vlc.h>
+
+#define TS_SIZE 188
+
+/* Synthetic multiplex: one PAT, one PMT per program, and one video plus
+ * one audio elementary stream per program, interleaved packet by packet
+ * so that every lookup hits a different PID. */
+#define PROGRAMS      32
+#define PMT_PID(p)    (0x100 + (p))
+#define VIDEO_PID(p)  (0x200 + 2 * (p))
+#define AUDIO_PID(p)  (0x201 + 2 * (p))
+
+static uint32_t crc32_mpeg( const uint8_t *p, size_t i )
+{
+    uint32_t crc = 0xffffffff;
+    while( i-- )
+    {
+        crc ^= (uint32_t)*p++ << 24;
+        for( int k = 0; k < 8; k++ )
+            crc = (crc & 0x80000000) ? (crc << 1) ^ 0x04c11db7 : crc << 1;
+    }
+    return crc;
+}
+
+static uint8_t *ts_header( uint8_t *p, uint16_t i_pid, bool b_start,
+                           uint8_t *pi_cc )
+{
+    p[0] = 0x47;
+    p[1] = (b_start ? 0x40 : 0x00) | (i_pid >> 8);
+    p[2] = i_pid & 0xff;
+    p[3] = 0x10 | (*pi_cc & 0x0f);
+    *pi_cc = (*pi_cc + 1) & 0x0f;
+    return &p[4];
+}
+
+static void ts_section( uint8_t *p, uint16_t i_pid, const uint8_t *p_section,
+                        size_t i_section, uint8_t *pi_cc )
+{
+    uint8_t *p_payload = ts_header( p, i_pid, true, pi_cc );
+    memset( p_payload, 0xff, TS_SIZE - 4 );
+    p_payload[0] = 0; /* pointer field */
+    memcpy( &p_payload[1], p_section, i_section );
+}
+
+static size_t psi_finish( uint8_t *p_section, size_t i_body )
+{
+    /* i_body counts everything after the 3 bytes header, minus CRC */
+    size_t i_length = i_body + 4;
+    p_section[1] = 0xb0 | (i_length >> 8);
+    p_section[2] = i_length & 0xff;
+    uint32_t crc = crc32_mpeg( p_section, 3 + i_body );
+    SetDWBE( &p_section[3 + i_body], crc );
+    return 3 + i_length;
+}
+
+static void ts_pat( uint8_t *p, uint8_t *pi_cc )
+{
+    uint8_t sec[TS_SIZE];
+    size_t i = 3;
+    sec[0] = 0x00;
+    SetWBE( &sec[i], 1 ); i += 2;  /* transport stream id */
+    sec[i++] = 0xc1;               /* version 0, current */
+    sec[i++] = 0;
+    sec[i++] = 0;
+    for( int j = 0; j < PROGRAMS; j++ )
+    {
+        SetWBE( &sec[i], j + 1 ); i += 2;
+        SetWBE( &sec[i], 0xe000 | PMT_PID(j) ); i += 2;
+    }
+    ts_section( p, 0, sec, psi_finish( sec, i - 3 ), pi_cc );
+}
+
+static void ts_pmt( uint8_t *p, int i_program, uint8_t *pi_cc )
+{
+    uint8_t sec[TS_SIZE];
+    size_t i = 3;
+    sec[0] = 0x02;
+    SetWBE( &sec[i], i_program + 1 ); i += 2;
+    sec[i++] = 0xc1;
+    sec[i++] = 0;
+    sec[i++] = 0;
+    SetWBE( &sec[i], 0xe000 | VIDEO_PID(i_program) ); i += 2; /* PCR PID */
+    SetWBE( &sec[i], 0xf000 ); i += 2;
+    sec[i++] = 0x02; /* MPEG-2 video */
+    SetWBE( &sec[i], 0xe000 | VIDEO_PID(i_program) ); i += 2;
+    SetWBE( &sec[i], 0xf000 ); i += 2;
+    sec[i++] = 0x04; /* MPEG-2 audio */
+    SetWBE( &sec[i], 0xe000 | AUDIO_PID(i_program) ); i += 2;
+    SetWBE( &sec[i], 0xf000 ); i += 2;
+    ts_section( p, PMT_PID(i_program), sec, psi_finish( sec, i - 3 ), pi_cc );
+}
+
+static void ts_pes( uint8_t *p, uint16_t i_pid, uint8_t i_stream_id,
+                    bool b_start, int64_t i_ts, bool b_pcr, uint8_t *pi_cc )
+{
+    uint8_t *p_payload = ts_header( p, i_pid, b_start, pi_cc );
+    size_t i_left = TS_SIZE - 4;
+
+    if( b_pcr )
+    {
+        p[3] |= 0x20;
+        p_payload[0] = 7;
+        p_payload[1] = 0x10;
+        int64_t i_base = i_ts;
+        p_payload[2] = i_base >> 25;
+        p_payload[3] = i_base >> 17;
+        p_payload[4] = i_base >> 9;
+        p_payload[5] = i_base >> 1;
+        p_payload[6] = ((i_base & 1) << 7) | 0x7e;
+        p_payload[7] = 0;
+        p_payload += 8;
+        i_left -= 8;
+    }
+
+    if( b_start )
+    {
+        static const uint8_t startcode[3] = { 0, 0, 1 };
+        memcpy( p_payload, startcode, 3 );
+        p_payload[3] = i_stream_id;
+        p_payload[4] = p_payload[5] = 0; /* unbounded */
+        p_payload[6] = 0x80;
+        p_payload[7] = 0x80; /* PTS only */
+        p_payload[8] = 5;
+        p_payload[9] = 0x21 | ((i_ts >> 29) & 0x0e);
+        p_payload[10] = i_ts >> 22;
+        p_payload[11] = 0x01 | ((i_ts >> 14) & 0xfe);
+        p_payload[12] = i_ts >> 7;
+        p_payload[13] = 0x01 | ((i_ts << 1) & 0xfe);
+        p_payload += 14;
+        i_left -= 14;
+    }
+
+    memset( p_payload, 0x5a, i_left );
+}
+
+static uint8_t *ts_generate( size_t i_packets )
+{
+    uint8_t *p_buf = malloc( i_packets * TS_SIZE );
+    if( p_buf == NULL )
+        return NULL;
+
+    uint8_t cc[0x2000] = { 0 };
+    size_t i = 0;
+    int64_t i_ts = 90000;
+
+    while( i < i_packets )
+    {
+        /* tables every PROGRAMS * 40 packets, like a 100ms repetition */
+        if( i_packets - i < PROGRAMS + 1 )
+            break;
+        ts_pat( &p_buf[i++ * TS_SIZE], &cc[0] );
+        for( int p = 0; p < PROGRAMS; p++ )
+            ts_pmt( &p_buf[i++ * TS_SIZE], p, &cc[PMT_PID(p)] );
+
+        for( int j = 0; j < 20 && i + 2 * PROGRAMS <= i_packets; j++ )
+        {
+            for( int p = 0; p < PROGRAMS; p++ )
+            {
+                ts_pes( &p_buf[i++ * TS_SIZE], VIDEO_PID(p), 0xe0, j == 0,
+                        i_ts, j == 0, &cc[VIDEO_PID(p)] );
+                ts_pes( &p_buf[i++ * TS_SIZE], AUDIO_PID(p), 0xc0, j % 4 == 0,
+                        i_ts, false, &cc[AUDIO_PID(p)] );
+            }
+        }
+        i_ts += 3600;
+    }
+
+    /* pad with null packets */
+    for( ; i < i_packets; i++ )
+    {
+        uint8_t dummy_cc = 0;
+        uint8_t *p_payload = ts_header( &p_buf[i * TS_SIZE], 0x1fff, false,
+                                        &dummy_cc );
+        memset( p_payload, 0xff, TS_SIZE - 4 );
+    }
+    return p_buf;
+}
+
+/* Counting es_out: drops everything it receives */
+struct es_out_sys_t
+{
+    unsigned i_es;
+    uint64_t i_blocks;
+};
+
+static es_out_id_t *EsOutAdd( es_out_t *out, const es_format_t *fmt )
+{
+    (void) fmt;
+    return (es_out_id_t *)(uintptr_t)++out->p_sys->i_es;
+}
+
+static int EsOutSend( es_out_t *out, es_out_id_t *id, block_t *block )
+{
+    (void) id;
+    out->p_sys->i_blocks++;
+    block_ChainRelease( block );
+    return VLC_SUCCESS;
+}
+
+static void EsOutDel( es_out_t *out, es_out_id_t *id )
+{
+    (void) out; (void) id;
+}
+
+static int EsOutControl( es_out_t *out, int query, va_list args )
+{
+    (void) out; (void) args;
+    switch( query )
+    {
+        case ES_OUT_GET_ES_STATE:
+        {
+            va_arg( args, es_out_id_t * );
+            *va_arg( args, bool * ) = true;
+            return VLC_SUCCESS;
+        }
+        default:
+            return VLC_EGENERIC;
+    }
+}
+
+int main( int argc, char *argv[] )
+{
+    size_t i_packets = 200000;
+    if( argc > 1 )
+        i_packets = strtoul( argv[1], NULL, 0 );
+
+    test_init();
+
+    uint8_t *p_buf = ts_generate( i_packets );
+    assert( p_buf != NULL );
+
+    libvlc_instance_t *vlc = libvlc_new( 0, NULL );
+    assert( vlc != NULL );
+    vlc_object_t *parent = VLC_OBJECT(vlc->p_libvlc_int);
+
+    struct es_out_sys_t sys = { 0, 0 };
+    es_out_t out = {
+        .pf_add = EsOutAdd,
+        .pf_send = EsOutSend,
+        .pf_del = EsOutDel,
+        .pf_control = EsOutControl,
+        .p_sys = &sys,
+    };
+
+    stream_t *s = vlc_stream_MemoryNew( parent, p_buf, i_packets * TS_SIZE,
+                                        true );
+    assert( s != NULL );
+
+    demux_t *demux = demux_New( parent, "ts", "", s, &out );
+    if( demux == NULL )
+    {
+        fprintf( stderr, "TS demuxer not available, skipping\n" );
+        vlc_stream_Delete( s );
+        libvlc_release( vlc );
+        free( p_buf );
+        return 77;
+    }
+
+    mtime_t i_start = mdate();
+    while( demux_Demux( demux ) == VLC_DEMUXER_SUCCESS );
+    mtime_t i_elapsed = mdate() - i_start;
+
+    demux_Delete( demux );
+    vlc_stream_Delete( s );
+    libvlc_release( vlc );
+    free( p_buf );
+
+    if( i_elapsed <= 0 )
+        i_elapsed = 1;
+    printf( "%zu packets, %d programs, %u es, %"PRIu64" blocks out\n",
+            i_packets, PROGRAMS, sys.i_es, sys.i_blocks );
+    printf( "%.3f s, %.0f packets/s, %.1f Mbit/s\n",
+            i_elapsed / (double)CLOCK_FREQ,
+            i_packets * (double)CLOCK_FREQ / i_elapsed,
+            i_packets * TS_SIZE * 8. / i_elapsed );
+    return 0;
+}
@@ -0,0 +1,161 @@
+/*****************************************************************************
+ * csa_bench.c: CSA descrambler throughput benchmark
+ *****************************************************************************
+ * Copyright (C) 2016 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#undef NDEBUG
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vlc_common.h>
+#include "../../../lib/libvlc_internal.h"
+#include "../../../modules/mux/mpeg/csa.h"
+#include "../../libvlc/test.h"
+
+#include <vlc/vlc.h>
+
+#define TS_SIZE 188
+
+/* Scrambled packets with either key, some with an adaptation field */
+static void Generate( vlc_object_t *obj, csa_t *csa, uint8_t *p_buf,
+                      unsigned i_packets, int i_pkt_size )
+{
+    for( unsigned i = 0; i < i_packets; i++ )
+    {
+        uint8_t *p = &p_buf[i * TS_SIZE];
+
+        for( int j = 0; j < TS_SIZE; j++ )
+            p[j] = rand();
+        p[0] = 0x47;
+        p[1] = 0x01;
+        p[2] = 0x00;
+        p[3] = 0x10 | (i & 0xf);
+        if( (rand() % 8) == 0 )
+        {
+            p[3] |= 0x20;
+            p[4] = rand() % 184;
+        }
+        csa_UseKey( obj, csa, rand() & 1 );
+        csa_Encrypt( csa, p, i_pkt_size );
+    }
+}
+
+static mtime_t Scalar( csa_t *csa, uint8_t *p_buf, unsigned i_packets,
+                       int i_pkt_size )
+{
+    mtime_t i_start = mdate();
+    for( unsigned i = 0; i < i_packets; i++ )
+        csa_Decrypt( csa, &p_buf[i * TS_SIZE], i_pkt_size );
+    return mdate() - i_start;
+}
+
+static mtime_t Batch( csa_t *csa, uint8_t *p_buf, unsigned i_packets,
+                      int i_pkt_size, unsigned i_batch )
+{
+    uint8_t *pkts[256];
+
+    assert( i_batch <= ARRAY_SIZE(pkts) );
+    mtime_t i_start = mdate();
+    for( unsigned i = 0; i < i_packets; i += i_batch )
+    {
+        unsigned n = __MIN( i_batch, i_packets - i );
+        for( unsigned j = 0; j < n; j++ )
+            pkts[j] = &p_buf[(i + j) * TS_SIZE];
+        csa_DecryptBatch( csa, pkts, n, i_pkt_size );
+    }
+    return mdate() - i_start;
+}
+
+static void Report( const char *psz_name, unsigned i_packets,
+                    mtime_t i_elapsed )
+{
+    if( i_elapsed <= 0 )
+        i_elapsed = 1;
+    printf( "%-10s %8.1f Mbit/s\n", psz_name,
+            i_packets * TS_SIZE * 8. / i_elapsed );
+}
+
+int main( int argc, char *argv[] )
+{
+    unsigned i_packets = 20000;
+    if( argc > 1 )
+        i_packets = strtoul( argv[1], NULL, 0 );
+
+    test_init();
+
+    libvlc_instance_t *vlc = libvlc_new( 0, NULL );
+    assert( vlc != NULL );
+    vlc_object_t *obj = VLC_OBJECT(vlc->p_libvlc_int);
+
+    csa_t *csa = csa_New();
+    assert( csa != NULL );
+    char odd[] = "0x0123456789abcdef", even[] = "0xfedcba9876543210";
+    csa_SetCW( obj, csa, odd, true );
+    csa_SetCW( obj, csa, even, false );
+
+    uint8_t *p_clear = malloc( i_packets * TS_SIZE );
+    uint8_t *p_ref = malloc( i_packets * TS_SIZE );
+    uint8_t *p_buf = malloc( i_packets * TS_SIZE );
+    assert( p_clear != NULL && p_ref != NULL && p_buf != NULL );
+
+    /* full packets, and partial descrambling (ts-csa-pkt) */
+    static const int pkt_sizes[] = { TS_SIZE, 100 };
+    for( size_t k = 0; k < ARRAY_SIZE(pkt_sizes); k++ )
+    {
+        const int i_pkt_size = pkt_sizes[k];
+
+        Generate( obj, csa, p_ref, i_packets, i_pkt_size );
+        memcpy( p_clear, p_ref, i_packets * TS_SIZE );
+
+        printf( "%d bytes descrambled per packet:\n", i_pkt_size );
+        Report( "scalar", i_packets,
+                Scalar( csa, p_clear, i_packets, i_pkt_size ) );
+
+        /* The batch API must give the same output as the scalar one */
+        static const unsigned batches[] = { 1, 7, 32, 64, 128, 256 };
+        for( size_t i = 0; i < ARRAY_SIZE(batches); i++ )
+        {
+            char psz_name[16];
+
+            memcpy( p_buf, p_ref, i_packets * TS_SIZE );
+            mtime_t i_elapsed = Batch( csa, p_buf, i_packets, i_pkt_size,
+                                       batches[i] );
+            if( memcmp( p_buf, p_clear, i_packets * TS_SIZE ) )
+            {
+                fprintf( stderr, "batch of %u: output mismatch\n",
+                         batches[i] );
+                return 1;
+            }
+            snprintf( psz_name, sizeof (psz_name), "batch %u", batches[i] );
+            Report( psz_name, i_packets, i_elapsed );
+        }
+    }
+
+    free( p_buf );
+    free( p_ref );
+    free( p_clear );
+    csa_Delete( csa );
+    libvlc_release( vlc );
+    return 0;
+}
@@ -0,0 +1,218 @@
+/*****************************************************************************
+ * copy_bench.c: GPU surface copy throughput benchmark
+ *****************************************************************************
+ * Copyright (C) 2016 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#undef NDEBUG
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vlc_common.h>
+#include <vlc_picture.h>
+#include "../../../modules/video_chroma/copy.h"
+
+/* There is no GPU here: the "surfaces" are plain memory buffers laid out
+ * like mapped decoder surfaces, with all planes in one buffer and a pitch
+ * aligned to 64 bytes. The destination pictures are wider than the
+ * surfaces, so that the copies go through the cache buffer instead of
+ * falling back to a single memcpy() per plane. */
+struct surface
+{
+    uint8_t *base;
+    size_t   size;
+    uint8_t *plane[3];
+    size_t   pitch[3];
+};
+
+enum copy_type
+{
+    NV12_TO_YV12,
+    NV12_TO_NV12,
+    P010_TO_P010,
+    I420_TO_I420,
+};
+
+static const struct
+{
+    const char    *name;
+    enum copy_type type;
+    vlc_fourcc_t   dst_chroma;
+    unsigned       planes;
+    unsigned       pixel_size;
+} tests[] = {
+    { "NV12->YV12", NV12_TO_YV12, VLC_CODEC_YV12, 2, 1 },
+    { "NV12->NV12", NV12_TO_NV12, VLC_CODEC_NV12, 2, 1 },
+    { "P010->P010", P010_TO_P010, VLC_CODEC_P010, 2, 2 },
+    { "I420->I420", I420_TO_I420, VLC_CODEC_I420, 3, 1 },
+};
+
+static void SurfaceInit(struct surface *s, unsigned planes, unsigned width,
+                        unsigned height, unsigned pixel_size)
+{
+    const size_t pitch = (width * pixel_size + 63) & ~63;
+
+    s->pitch[0] = pitch;
+    if (planes == 2)
+        s->pitch[1] = pitch; /* interleaved U/V */
+    else
+        s->pitch[1] = s->pitch[2] = pitch / 2;
+
+    s->size = pitch * height + (planes - 1) * s->pitch[1] * (height / 2);
+    s->base = vlc_memalign(64, s->size);
+    assert(s->base != NULL);
+    for (size_t i = 0; i < s->size; i++)
+        s->base[i] = rand();
+
+    s->plane[0] = s->base;
+    for (unsigned n = 1; n < planes; n++)
+        s->plane[n] = s->plane[n - 1]
+                    + s->pitch[n - 1] * (n == 1 ? height : height / 2);
+}
+
+static void Copy(enum copy_type type, picture_t *dst, struct surface *s,
+                 unsigned height, copy_cache_t *cache)
+{
+    switch (type)
+    {
+        case NV12_TO_YV12:
+            CopyFromNv12(dst, s->plane, s->pitch, height, cache);
+            break;
+        case NV12_TO_NV12:
+        case P010_TO_P010:
+            CopyFromNv12ToNv12(dst, s->plane, s->pitch, height, cache);
+            break;
+        case I420_TO_I420:
+            CopyFromYv12(dst, s->plane, s->pitch, height, cache);
+            break;
+    }
+}
+
+static bool Check(enum copy_type type, const picture_t *dst,
+                  const struct surface *s, unsigned planes, unsigned height)
+{
+    for (unsigned n = 0; n < planes; n++)
+    {
+        const unsigned lines = n ? height / 2 : height;
+
+        for (unsigned y = 0; y < lines; y++)
+        {
+            const uint8_t *src = s->plane[n] + y * s->pitch[n];
+
+            if (type == NV12_TO_YV12 && n == 1)
+            {
+                const uint8_t *u = dst->p[2].p_pixels + y * dst->p[2].i_pitch;
+                const uint8_t *v = dst->p[1].p_pixels + y * dst->p[1].i_pitch;
+
+                for (size_t x = 0; x < s->pitch[1] / 2; x++)
+                    if (u[x] != src[2*x] || v[x] != src[2*x+1])
+                        return false;
+            }
+            else if (memcmp(dst->p[n].p_pixels + y * dst->p[n].i_pitch,
+                            src, s->pitch[n]))
+                return false;
+        }
+    }
+    return true;
+}
+
+static double GBps(size_t size, unsigned frames, mtime_t elapsed)
+{
+    if (elapsed <= 0)
+        elapsed = 1;
+    return (double)size * frames / elapsed / 1000.;
+}
+
+static void Bench(unsigned width, unsigned height, unsigned frames)
+{
+    const unsigned threads = __MIN(vlc_GetCPUCount(), 4);
+
+    printf("%ux%u, %u frames:\n", width, height, frames);
+    for (size_t i = 0; i < ARRAY_SIZE(tests); i++)
+    {
+        struct surface s;
+        SurfaceInit(&s, tests[i].planes, width, height, tests[i].pixel_size);
+
+        picture_t *dst = picture_New(tests[i].dst_chroma, width + 64, height,
+                                     1, 1);
+        assert(dst != NULL);
+        uint8_t *ref = vlc_memalign(64, s.size);
+        assert(ref != NULL);
+
+        mtime_t start = mdate();
+        for (unsigned f = 0; f < frames; f++)
+            memcpy(ref, s.base, s.size);
+        const double memcpy_rate = GBps(s.size, frames, mdate() - start);
+
+        printf(" %s  memcpy %6.2f GB/s", tests[i].name, memcpy_rate);
+
+        const unsigned counts[] = { 1, threads };
+        for (size_t j = 0; j < ARRAY_SIZE(counts); j++)
+        {
+            if (j > 0 && counts[j] <= 1)
+                break;
+
+            copy_cache_t cache;
+            if (CopyInitCacheThreads(&cache, width * tests[i].pixel_size,
+                                     counts[j]))
+                abort();
+
+            /* Clear every plane, so that Check() does not pass on the
+             * output of the previous run */
+            for (int p = 0; p < dst->i_planes; p++)
+                memset(dst->p[p].p_pixels, 0,
+                       dst->p[p].i_pitch * dst->p[p].i_lines);
+            Copy(tests[i].type, dst, &s, height, &cache);
+            if (!Check(tests[i].type, dst, &s, tests[i].planes, height))
+            {
+                fprintf(stderr, "%s with %u thread(s): output mismatch\n",
+                        tests[i].name, counts[j]);
+                exit(1);
+            }
+
+            start = mdate();
+            for (unsigned f = 0; f < frames; f++)
+                Copy(tests[i].type, dst, &s, height, &cache);
+            printf(", %u thread(s) %6.2f GB/s", counts[j],
+                   GBps(s.size, frames, mdate() - start));
+
+            CopyCleanCache(&cache);
+        }
+        printf("\n");
+
+        vlc_free(ref);
+        picture_Release(dst);
+        vlc_free(s.base);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned frames = 100;
+    if (argc > 1)
+        frames = strtoul(argv[1], NULL, 0);
+
+    Bench(1920, 1080, frames);
+    Bench(3840, 2160, frames / 4 + 1);
+    return 0;
+}
@@ -0,0 +1,114 @@
+/*****************************************************************************
+ * yadif.c: test the SIMD Yadif line filters against the C one
+ *****************************************************************************
+ * Copyright (C) 2016 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#undef NDEBUG
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vlc_common.h>
+#include <vlc_cpu.h>
+#include "../../../modules/video_filter/deinterlace/common.h"
+#include "../../../modules/video_filter/deinterlace/yadif.h"
+
+typedef void (*yadif_filter_t)(uint8_t *dst, uint8_t *prev, uint8_t *cur,
+                               uint8_t *next, int w, int prefs, int mrefs,
+                               int parity, int mode);
+
+/* Cover partial SIMD vectors, with odd widths in particular */
+static const int widths[] = { 1, 3, 15, 16, 17, 31, 33, 47, 64, 65, 719, 1920 };
+
+#define MARGIN 32 /* Horizontal margin, the filters read around the pixels */
+#define PITCH  (MARGIN + 1920 + MARGIN)
+#define LINES  5  /* The filtered line, and two lines above and below */
+
+static void Fill(uint8_t *p, size_t size, bool flat)
+{
+    /* Flat pictures take the other branches of the spatial checks */
+    for (size_t i = 0; i < size; i++)
+        p[i] = flat ? 120 + (rand() & 7) : rand();
+}
+
+static void Filter(yadif_filter_t filter, uint8_t *dst,
+                   uint8_t pics[3][LINES * PITCH], int w, int parity,
+                   int mode)
+{
+    const size_t offset = 2 * PITCH + MARGIN;
+
+    filter(dst, &pics[0][offset], &pics[1][offset], &pics[2][offset], w,
+           PITCH, -PITCH, parity, mode);
+}
+
+static void Test(yadif_filter_t filter, const char *name)
+{
+    static uint8_t pics[3][LINES * PITCH];
+    uint8_t ref[1920], out[1920];
+
+    for (size_t i = 0; i < ARRAY_SIZE(widths); i++)
+        for (int flat = 0; flat < 2; flat++)
+            for (int parity = 0; parity < 2; parity++)
+                for (int mode = 0; mode <= 2; mode += 2)
+                {
+                    const int w = widths[i];
+
+                    for (int j = 0; j < 3; j++)
+                        Fill(pics[j], sizeof (pics[j]), flat);
+
+                    Filter(yadif_filter_line_c, ref, pics, w, parity, mode);
+                    Filter(filter, out, pics, w, parity, mode);
+                    if (memcmp(ref, out, w))
+                    {
+                        fprintf(stderr, "%s: width %d, parity %d, mode %d: "
+                                "output differs from C\n", name, w, parity,
+                                mode);
+                        abort();
+                    }
+                }
+    printf("%s: bit-exact with C\n", name);
+}
+
+int main(void)
+{
+    srand(0);
+
+#if defined(HAVE_YADIF_AVX2)
+    if (vlc_CPU_AVX2())
+        Test(yadif_filter_line_avx2, "avx2");
+#endif
+#if defined(HAVE_YADIF_SSSE3)
+    if (vlc_CPU_SSSE3())
+        Test(yadif_filter_line_ssse3, "ssse3");
+#endif
+#if defined(HAVE_YADIF_SSE2)
+    if (vlc_CPU_SSE2())
+        Test(yadif_filter_line_sse2, "sse2");
+#endif
+#if defined(HAVE_YADIF_MMX)
+    if (vlc_CPU_MMX())
+        Test(yadif_filter_line_mmx, "mmx");
+#endif
+    (void) yadif_filter_line_c_16bit;
+    return 0;
+}
@@ -0,0 +1,132 @@
+/*****************************************************************************
+ * fifo_bench.c: block FIFO throughput benchmark
+ *****************************************************************************
+ * Copyright (C) 2016 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#undef NDEBUG
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <vlc_common.h>
+#include <vlc_block.h>
+
+/* Mimics the input thread feeding a decoder thread: the producer blocks while
+ * the FIFO is full (like pace-controlled decoders), the consumer while it is
+ * empty. Both sides count how many times they had to wait. */
+struct bench
+{
+    vlc_fifo_t *fifo;
+    vlc_cond_t  wait_space;
+    size_t      max_depth;
+    unsigned    count;
+    unsigned    producer_waits;
+    unsigned    consumer_waits;
+};
+
+static void *Producer( void *data )
+{
+    struct bench *b = data;
+
+    for( unsigned i = 0; i < b->count; i++ )
+    {
+        block_t *block = block_Alloc( 188 );
+        assert( block != NULL );
+        block->i_dts = i;
+
+        vlc_fifo_Lock( b->fifo );
+        while( b->max_depth && vlc_fifo_GetCount( b->fifo ) >= b->max_depth )
+        {
+            b->producer_waits++;
+            vlc_fifo_WaitCond( b->fifo, &b->wait_space );
+        }
+        vlc_fifo_QueueUnlocked( b->fifo, block );
+        vlc_fifo_Unlock( b->fifo );
+    }
+    return NULL;
+}
+
+static void Consume( struct bench *b )
+{
+    for( unsigned i = 0; i < b->count; i++ )
+    {
+        block_t *block;
+
+        vlc_fifo_Lock( b->fifo );
+        vlc_cond_signal( &b->wait_space );
+        while( vlc_fifo_IsEmpty( b->fifo ) )
+        {
+            b->consumer_waits++;
+            vlc_fifo_Wait( b->fifo );
+        }
+        block = vlc_fifo_DequeueUnlocked( b->fifo );
+        vlc_fifo_Unlock( b->fifo );
+
+        assert( block->i_dts == (mtime_t)i );
+        block_Release( block );
+    }
+}
+
+static void Run( unsigned count, size_t max_depth )
+{
+    struct bench b = {
+        .fifo = block_FifoNew(),
+        .max_depth = max_depth,
+        .count = count,
+    };
+    vlc_thread_t th;
+
+    assert( b.fifo != NULL );
+    vlc_cond_init( &b.wait_space );
+
+    mtime_t start = mdate();
+    if( vlc_clone( &th, Producer, &b, VLC_THREAD_PRIORITY_LOW ) )
+        abort();
+    Consume( &b );
+    vlc_join( th, NULL );
+    mtime_t elapsed = mdate() - start;
+
+    vlc_cond_destroy( &b.wait_space );
+    block_FifoRelease( b.fifo );
+
+    if( elapsed <= 0 )
+        elapsed = 1;
+    char depth[16] = "unbounded";
+    if( max_depth )
+        snprintf( depth, sizeof (depth), "%zu", max_depth );
+    printf( "depth %-9s %10.0f blocks/s, %9u consumer waits, "
+            "%9u producer waits\n", depth,
+            count * (double)CLOCK_FREQ / elapsed,
+            b.consumer_waits, b.producer_waits );
+}
+
+int main( int argc, char *argv[] )
+{
+    unsigned count = 1000000;
+    if( argc > 1 )
+        count = strtoul( argv[1], NULL, 0 );
+
+    Run( count, 0 );
+    Run( count, 10 );
+    Run( count, 1 );
+    return 0;
+}
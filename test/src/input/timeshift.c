@@ -0,0 +1,115 @@
+/*****************************************************************************
+ * timeshift.c: timeshift storage ring unit test
+ *****************************************************************************
+ * Copyright (C) 2016 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#undef NDEBUG
+#include "../../../src/input/es_out_timeshift.c"
+
+/* Not exported by the core */
+void input_ControlPush( input_thread_t *p_input, int i_type,
+                        vlc_value_t *p_val )
+{
+    (void) p_input; (void) i_type; (void) p_val;
+    abort();
+}
+
+#ifndef vlc_assert_locked
+void vlc_assert_locked( vlc_mutex_t *p_lock )
+{
+    (void) p_lock;
+}
+#endif
+
+#define RING_SIZE (64 * 1024)
+#define BLOCKS    5000
+
+static uint8_t Pattern( unsigned i_block, size_t i )
+{
+    return i_block * 13 + i * 7;
+}
+
+static void Push( ts_storage_t *p_storage, unsigned i_block )
+{
+    /* Sizes do not divide the ring, so that the writer wraps at many
+     * offsets, with padding */
+    size_t i_size = 1 + (i_block * 997) % 3001;
+    block_t *p_block = block_Alloc( i_size );
+    assert( p_block != NULL );
+
+    for( size_t i = 0; i < i_size; i++ )
+        p_block->p_buffer[i] = Pattern( i_block, i );
+    p_block->i_pts = p_block->i_dts = VLC_TS_0 + i_block;
+
+    ts_cmd_t cmd = { .i_type = C_SEND };
+    cmd.u.send.p_block = p_block;
+    assert( !TsStorageIsFull( p_storage, &cmd ) );
+    TsStoragePushCmd( p_storage, &cmd, true );
+}
+
+static void Pop( ts_storage_t *p_storage, unsigned i_block )
+{
+    ts_cmd_t cmd;
+
+    TsStoragePopCmd( p_storage, &cmd, false );
+    assert( cmd.i_type == C_SEND );
+
+    block_t *p_block = cmd.u.send.p_block;
+    assert( p_block->i_pts == VLC_TS_0 + i_block );
+    assert( p_block->i_buffer == 1 + (i_block * 997) % 3001 );
+    for( size_t i = 0; i < p_block->i_buffer; i++ )
+        assert( p_block->p_buffer[i] == Pattern( i_block, i ) );
+    block_Release( p_block );
+}
+
+int main( void )
+{
+    ts_storage_t *p_storage = TsStorageNew( NULL, RING_SIZE );
+    assert( p_storage != NULL );
+#ifdef TEST_NO_MMAP
+    assert( p_storage->p_map == NULL );
+#endif
+
+    /* Read right behind the writer, and with more and more data in the
+     * ring, so that the reader seeks into data overwritten since its
+     * previous read */
+    unsigned i_pushed = 0, i_popped = 0;
+
+    while( i_popped < BLOCKS )
+    {
+        unsigned i_depth = 1 + (i_popped / 500) % 8;
+        block_t dummy = { .i_buffer = 1 + (i_pushed * 997) % 3001 };
+        ts_cmd_t next = { .i_type = C_SEND };
+        next.u.send.p_block = &dummy;
+
+        if( i_pushed - i_popped < i_depth
+         && !TsStorageIsFull( p_storage, &next ) )
+            Push( p_storage, i_pushed++ );
+        else
+            Pop( p_storage, i_popped++ );
+    }
+    /* The ring wrapped around many times */
+    assert( (size_t)i_pushed * 1500 > 10 * RING_SIZE );
+
+    while( !TsStorageIsEmpty( p_storage ) )
+        Pop( p_storage, i_popped++ );
+    assert( i_popped == i_pushed );
+
+    TsStorageDelete( p_storage );
+    return 0;
+}
@@ -0,0 +1,172 @@
+/*****************************************************************************
+ * messages.c: test the asynchronous logger
+ *****************************************************************************
+ * Copyright (C) 2016 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#undef NDEBUG
+#include <assert.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vlc_common.h>
+
+#define THREADS 8
+#define BURST   64  /* messages per thread and per round, fits in the ring */
+#define ROUNDS  200
+
+static vlc_mutex_t lock;
+static vlc_cond_t logged;
+static unsigned delivered, dropped;
+static unsigned next[THREADS];
+
+static void Log(void *opaque, int type, const vlc_log_t *item,
+                const char *format, va_list ap)
+{
+    unsigned thread, seq;
+
+    assert(opaque == &lock);
+    assert(!strcmp(format, "%s"));
+
+    const char *msg = va_arg(ap, const char *);
+
+    vlc_mutex_lock(&lock);
+    if (type == VLC_MSG_WARN && !strcmp(item->psz_object_type, "logger"))
+    {   /* Dropped messages report */
+        fprintf(stderr, "%s\n", msg);
+        dropped++;
+    }
+    else
+    {
+        assert(!strcmp(item->psz_module, "test"));
+        int n = sscanf(msg, "thread %u message %u", &thread, &seq);
+
+        assert(n == 2);
+        assert(thread < THREADS);
+        /* Every message once, in order for each thread */
+        assert(seq == next[thread]);
+        next[thread]++;
+        delivered++;
+    }
+    vlc_cond_signal(&logged);
+    vlc_mutex_unlock(&lock);
+}
+
+static vlc_log_async_t *async;
+static char padding[1024];
+static vlc_mutex_t round_lock;
+static vlc_cond_t round_wait;
+static unsigned current_round;
+
+static void Emit(const vlc_log_t *item, const char *format, ...)
+{
+    va_list ap;
+
+    va_start(ap, format);
+    vlc_LogAsync(async, VLC_MSG_DBG, item, format, ap);
+    va_end(ap);
+}
+
+static void *Thread(void *data)
+{
+    unsigned thread = (uintptr_t)data;
+    const vlc_log_t item = {
+        .psz_object_type = "test",
+        .psz_module = "test",
+        .line = -1,
+    };
+    unsigned seq = 0;
+
+    for (unsigned r = 0; r < ROUNDS; r++)
+    {
+        vlc_mutex_lock(&round_lock);
+        while (current_round == r)
+            vlc_cond_wait(&round_wait, &round_lock);
+        vlc_mutex_unlock(&round_lock);
+
+        /* The consumer sleeps between rounds: the producers race to wake
+         * it up, and to publish while it checks the ring */
+        for (unsigned i = 0; i < BURST; i++)
+        {   /* Long messages take longer to publish */
+            const char *pad = ((thread + i) & 1) ? padding : "";
+
+            Emit(&item, "thread %u message %u%s", thread, seq++, pad);
+        }
+    }
+    return NULL;
+}
+
+int main(void)
+{
+    vlc_thread_t threads[THREADS];
+
+    vlc_mutex_init(&lock);
+    vlc_cond_init(&logged);
+    vlc_mutex_init(&round_lock);
+    vlc_cond_init(&round_wait);
+    memset(padding, ' ', sizeof (padding) - 1);
+
+    async = vlc_LogAsyncCreate(Log, &lock);
+    assert(async != NULL);
+
+    for (uintptr_t i = 0; i < THREADS; i++)
+        assert(vlc_clone(&threads[i], Thread, (void *)i,
+                         VLC_THREAD_PRIORITY_LOW) == 0);
+
+    for (unsigned r = 1; r <= ROUNDS; r++)
+    {
+        vlc_mutex_lock(&round_lock);
+        current_round = r;
+        vlc_cond_broadcast(&round_wait);
+        vlc_mutex_unlock(&round_lock);
+
+        /* All the messages of the round must be delivered without any
+         * further message to wake up the consumer */
+        mtime_t deadline = mdate() + 5 * CLOCK_FREQ;
+
+        vlc_mutex_lock(&lock);
+        while (delivered < r * THREADS * BURST)
+            if (vlc_cond_timedwait(&logged, &lock, deadline))
+            {
+                fprintf(stderr, "round %u: %u messages not delivered\n", r,
+                        r * THREADS * BURST - delivered);
+                abort();
+            }
+        assert(dropped == 0);
+        vlc_mutex_unlock(&lock);
+    }
+
+    for (unsigned i = 0; i < THREADS; i++)
+        vlc_join(threads[i], NULL);
+
+    vlc_LogAsyncDestroy(async);
+
+    assert(delivered == ROUNDS * THREADS * BURST);
+    assert(dropped == 0);
+
+    vlc_cond_destroy(&round_wait);
+    vlc_mutex_destroy(&round_lock);
+    vlc_cond_destroy(&logged);
+    vlc_mutex_destroy(&lock);
+    return 0;
+}
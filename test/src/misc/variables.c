@@ -443,6 +443,47 @@ static void test_creation_and_type( libvlc_int_t *p_libvlc )
     assert( var_Get( p_libvlc, "bla", &val ) == VLC_ENOVAR );
 }
 
+/* Many variables, to exercise the growth and tombstones of the hash table,
+ * then a lookup microbenchmark, only timed long enough to be meaningful if
+ * the VLC_TEST_BENCH environment variable is set */
+static void test_lookup( libvlc_int_t *p_libvlc )
+{
+    enum { count = 1000 };
+    static char names[count][20];
+    const unsigned loops = getenv( "VLC_TEST_BENCH" ) != NULL ? 1000 : 10;
+
+    for( unsigned i = 0; i < count; i++ )
+    {
+        snprintf( names[i], sizeof (names[i]), "bench-%u", i );
+        assert( var_Create( p_libvlc, names[i], VLC_VAR_INTEGER ) == VLC_SUCCESS );
+        var_SetInteger( p_libvlc, names[i], i );
+    }
+
+    for( unsigned i = 0; i < count; i += 2 )
+        var_Destroy( p_libvlc, names[i] );
+
+    for( unsigned i = 0; i < count; i++ )
+    {
+        if( i & 1 )
+            assert( var_GetInteger( p_libvlc, names[i] ) == i );
+        else
+            assert( var_Type( p_libvlc, names[i] ) == 0 );
+    }
+
+    mtime_t start = mdate();
+    for( unsigned j = 0; j < loops; j++ )
+        for( unsigned i = 1; i < count; i += 2 )
+            var_SetInteger( p_libvlc, names[i],
+                            var_GetInteger( p_libvlc, names[i] ) );
+    mtime_t elapsed = mdate() - start;
+
+    log( "%u variables: %.1f ns per get and set\n", count / 2,
+         elapsed * 1000. / (loops * (count / 2)) );
+
+    for( unsigned i = 1; i < count; i += 2 )
+        var_Destroy( p_libvlc, names[i] );
+}
+
 static void test_variables( libvlc_instance_t *p_vlc )
 {
     libvlc_int_t *p_libvlc = p_vlc->p_libvlc_int;
@@ -480,6 +521,9 @@ static void test_variables( libvlc_instance_t *p_vlc )
 
     log( "Testing type at creation\n" );
     test_creation_and_type( p_libvlc );
+
+    log( "Testing lookups\n" );
+    test_lookup( p_libvlc );
 }
 
 
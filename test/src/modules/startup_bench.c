@@ -0,0 +1,96 @@
+/*****************************************************************************
+ * startup_bench.c: LibVLC start-up time benchmark
+ *****************************************************************************
+ * Copyright (C) 2016 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/* Usage: startup_bench [iterations]
+ *
+ * Measures the time from libvlc_new() to a ready instance, that is with all
+ * the plug-ins enumerated, without and with the plugins cache. The cache of
+ * the build tree plug-ins is regenerated first. The module bank is released
+ * with the last instance, so that every iteration starts from scratch, but
+ * the files are in the OS page cache after the first one. */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#undef NDEBUG
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <vlc_common.h>
+
+#include <vlc/vlc.h>
+
+static int cmp (const void *a, const void *b)
+{
+    const mtime_t *ta = a, *tb = b;
+
+    return (*ta > *tb) - (*ta < *tb);
+}
+
+static mtime_t Start (int argc, const char *const *argv)
+{
+    mtime_t start = mdate ();
+    libvlc_instance_t *vlc = libvlc_new (argc, argv);
+    mtime_t elapsed = mdate () - start;
+
+    assert (vlc != NULL);
+    libvlc_release (vlc);
+    return elapsed;
+}
+
+static void Bench (const char *name, const char *arg, unsigned count)
+{
+    const char *argv[] = { arg };
+    mtime_t *times = malloc (count * sizeof (*times));
+    assert (times != NULL);
+
+    for (unsigned i = 0; i < count; i++)
+        times[i] = Start (arg != NULL, argv);
+    qsort (times, count, sizeof (*times), cmp);
+
+    printf (" %-12s min %8.2f ms, median %8.2f ms, max %8.2f ms\n", name,
+            times[0] / 1000., times[count / 2] / 1000.,
+            times[count - 1] / 1000.);
+    free (times);
+}
+
+int main (int argc, char *argv[])
+{
+    unsigned count = 20;
+    if (argc > 1)
+        count = strtoul (argv[1], NULL, 0);
+    if (count == 0)
+        return 1;
+
+    setenv ("VLC_PLUGIN_PATH", "../modules", 1);
+
+    printf ("Start-up: libvlc_new() time over %u iterations\n", count);
+
+    /* Cold start, then regenerate the cache with the current format */
+    printf (" %-12s %8.2f ms\n", "first", Start (0, NULL) / 1000.);
+    const char *reset[] = { "--reset-plugins-cache" };
+    Start (1, reset);
+
+    Bench ("no cache", "--no-plugins-cache", count);
+    Bench ("cache", NULL, count);
+    return 0;
+}